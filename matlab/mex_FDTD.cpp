@@ -70,6 +70,8 @@ void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
     unsigned int* double_precision = (unsigned int*)NULL;
     unsigned int* force_partition_to = (unsigned int*)NULL;
     unsigned int* octave = (unsigned int*)NULL;
+    std::vector<std::string> input_streams;
+    std::vector<SweepConfig> sweep;
     
     /////////// Parse input argumets
     // Input is a struct containing....
@@ -84,7 +86,7 @@ void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
     mexPrintf("_________________________________\n");
     mexPrintf("Parse input arguments\n");
     
-    if(nrhs == 15) {
+    if(nrhs >= 15 && nrhs <= 17) {
         // Vertices
         size_of_vertices = mxGetNumberOfElements(prhs[0]); 
         vertices = (float*)mxGetData(prhs[0]);
@@ -170,6 +172,50 @@ void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
         
         force_partition_to = (unsigned int*)mxGetData(prhs[13]);
         octave = (unsigned int*)mxGetData(prhs[14]);
+
+        // Optional cell array of signal files for the DATA_STREAM sources
+        if(nrhs >= 16 && mxIsCell(prhs[15])) {
+            for(unsigned int i = 0; i < mxGetNumberOfElements(prhs[15]); i++) {
+                char* path = mxArrayToString(mxGetCell(prhs[15], i));
+                if(path) {
+                    input_streams.push_back(std::string(path));
+                    mxFree(path);
+                }
+            }
+        }
+
+        // Optional cell array of sweep runs over one mesh, each a struct
+        // with the fields 'sources' (single 6xN as above), 'receivers'
+        // (single 3xM) and 'steps' (uint32, 0 keeps number_of_steps)
+        if(nrhs == 17 && mxIsCell(prhs[16])) {
+            for(unsigned int i = 0; i < mxGetNumberOfElements(prhs[16]); i++) {
+                const mxArray* run = mxGetCell(prhs[16], i);
+                if(!run || !mxIsStruct(run))
+                    mexErrMsgTxt("A sweep run is not a struct");
+                SweepConfig config;
+                const mxArray* srcs = mxGetField(run, 0, "sources");
+                if(srcs) {
+                    float* s_list = (float*)mxGetData(srcs);
+                    for(unsigned int j = 0; j < mxGetN(srcs); j++) {
+                        unsigned int idx = j*6;
+                        config.addSource(Source(s_list[idx], s_list[idx+1], s_list[idx+2],
+                                         (enum SrcType)((unsigned int)s_list[idx+3]),
+                                         (enum InputType)((unsigned int)s_list[idx+4]), s_list[idx+5]));
+                    }
+                }
+                const mxArray* recs = mxGetField(run, 0, "receivers");
+                if(recs) {
+                    float* r_list = (float*)mxGetData(recs);
+                    for(unsigned int j = 0; j < mxGetN(recs); j++)
+                        config.addReceiver(r_list[j*3], r_list[j*3+1], r_list[j*3+2]);
+                }
+                const mxArray* steps = mxGetField(run, 0, "steps");
+                if(steps && mxGetNumberOfElements(steps) > 0)
+                    config.num_steps = *((unsigned int*)mxGetData(steps));
+                sweep.push_back(config);
+            }
+            mexPrintf("Number of sweep runs : %u \n", (unsigned int)sweep.size());
+        }
     }
     else {
         mexErrMsgTxt("Not enough input argumets");
@@ -214,6 +260,17 @@ void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
         }
     }
     
+    // The files are streamed, their samples are not copied here
+    for(unsigned int i = 0; i < input_streams.size(); i++) {
+        const std::string& path = input_streams.at(i);
+        enum InputStreamFormat format = *double_precision == 1 ? STREAM_RAW_DOUBLE : STREAM_RAW_FLOAT;
+        if(path.size() > 4 && (path.substr(path.size()-4) == ".wav" ||
+                               path.substr(path.size()-4) == ".WAV"))
+            format = STREAM_WAV;
+        if(!app.m_parameters.addInputStream(path, format))
+            mexPrintf("Can not read input stream %s \n", path.c_str());
+    }
+
     for(unsigned int i = 0; i < number_of_sources; i++) {
         unsigned int idx = i*6;
         app.m_parameters.addSource(Source(src_list[idx], src_list[idx+1], src_list[idx+2], 
@@ -238,6 +295,26 @@ void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
     if(visualization) {  
         app.runVisualization();
     }
+    else if(!sweep.empty()) {
+        if(*double_precision == 1)
+            app.m_mesh.setDouble(true);
+        std::vector< std::vector<double> > responses = app.runSweep(sweep);
+
+        // One receivers x steps matrix per run
+        plhs[0] = mxCreateCellMatrix(1, (mwSize)responses.size());
+        for(unsigned int r = 0; r < responses.size(); r++) {
+            unsigned int n_rec = (unsigned int)sweep.at(r).receivers.size();
+            unsigned int n_steps = n_rec > 0 ? (unsigned int)responses.at(r).size()/n_rec : 0;
+            mxArray* run = mxCreateNumericMatrix(n_rec, n_steps, mxDOUBLE_CLASS, mxREAL);
+            double* run_ptr = (double*)mxGetData(run);
+            for(unsigned int i = 0; i < n_steps; i++)
+                for(unsigned int j = 0; j < n_rec; j++)
+                    run_ptr[i*n_rec+j] = responses.at(r).at(j*n_steps+i);
+            mxSetCell(plhs[0], r, run);
+        }
+        app.close();
+        return;
+    }
     else {
         if(number_of_captures == 0 && number_of_mesh_captures == 0){
             if(*double_precision == 1)
@@ -260,7 +337,7 @@ void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
     mexPrintf("Parsing Output Arguments\n");
     
     if (nlhs == 1 && app.getResponseSize() != 0) {
-        unsigned int n_steps = app.m_parameters.getNumSteps();
+        unsigned int n_steps = app.getResponseLength();
         plhs[0] = mxCreateNumericMatrix(number_of_receivers, n_steps, mxSINGLE_CLASS, mxREAL);
         ret_ptr1 = (float*)mxGetData(plhs[0]);
         
@@ -274,7 +351,7 @@ void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
     
      if (nlhs == 3 && app.getResponseSize() != 0) {
         printf("3 arguments\n");
-        unsigned int n_steps = app.m_parameters.getNumSteps();
+        unsigned int n_steps = app.getResponseLength();
         plhs[0] = mxCreateNumericMatrix(number_of_receivers, n_steps, mxSINGLE_CLASS, mxREAL);
         plhs[1] = mxCreateNumericMatrix(1, 1, mxSINGLE_CLASS, mxREAL);
         plhs[2] = mxCreateNumericMatrix(1, 1, mxSINGLE_CLASS, mxREAL);
@@ -294,7 +371,7 @@ void mexFunction(int nlhs, mxArray *plhs[], int nrhs, const mxArray *prhs[])
     }
      // If 4 arguments, 4th is the captured meshes
      if (nlhs == 8) {
-        unsigned int n_steps = app.m_parameters.getNumSteps();
+        unsigned int n_steps = app.getResponseLength();
         unsigned int n_mesh_captures = app.getNumberOfMeshCaptures();
         unsigned int n_elements = app.m_mesh.getNumberOfElements();
         
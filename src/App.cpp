@@ -26,19 +26,32 @@
 #include "./kernels/visualizationUtils.h"
 #include "./kernels/voxelizationUtils.h"
 #include "./kernels/cudaMesh.h"
+#include "./ism/ImageSourceEngine.h"
+#include "./ism/HybridCombiner.h"
+#include "./host/hostKernels3d.h"
+#include "./host/hostNuma.h"
+#include "./host/hostStreamKernels3d.h"
+#include "./base/PartitionPlanner.h"
+#include "./base/StateHash.h"
+#include "./base/ThreadPool.h"
+#ifndef WIN32
+#include "./dist/distKernels3d.h"
+#include "./dist/RankLauncher.h"
+#endif
 
 #include <stdlib.h>
 #include <stdio.h>
 #include <iostream>
 #include <ctime>
+#include <algorithm>
+#include <boost/thread.hpp>
+#include <boost/bind.hpp>
 #include <cuda.h>
 #include <cuda_runtime.h>
 #include <cuda_runtime_api.h>
 #include <cuda_gl_interop.h>
 
 namespace GLOBAL {
-  static FDTD::App* currentApp;
-
   // Global pointers for rendering
   // Slight hack to keep AppWindow class clean of CUDA
   struct cudaGraphicsResource* vertex = NULL;
@@ -48,25 +61,13 @@ namespace GLOBAL {
   struct cudaGraphicsResource* pbo_xy = NULL;
   struct cudaGraphicsResource* pbo_xz = NULL;
   struct cudaGraphicsResource* pbo_yz = NULL;
-  static volatile bool interrupt = false;
-
 }
 
 using namespace FDTD;
 
-extern "C" {
-  void captureBitmap(float* data, unsigned char* position_data, unsigned int dim_x, unsigned int dim_y,
-                     unsigned int slice, unsigned int orientation, unsigned int step) {
-    GLOBAL::currentApp->saveBitmap(data, position_data, dim_x, dim_y, slice, orientation, step);
-  }
-}
-
 extern "C" {
   bool interruptCallback(){
-    if(GLOBAL::interrupt)
-      log_msg<LOG_INFO>(L"main: Execution interrupted");
-
-    return GLOBAL::interrupt;
+    return false;
   }
 }
 
@@ -85,6 +86,99 @@ void App::setupDefaultCallbacks() {
   this->m_progress = (ProgressCallback)progressCallback;
 }
 
+///////////////////////////////////////////////////////////////////////////////
+// Per instance callbacks
+///////////////////////////////////////////////////////////////////////////////
+App::RunScope::RunScope(App* app)
+: app_(app),
+  outer_(!app->callbacks_),
+  previous_sink_((LogSink*)NULL)
+{
+  if(!this->outer_)
+    return;
+  this->app_->callbacks_.reset(new CallbackSlot(this->app_,
+                                                App::interruptHandler,
+                                                App::progressHandler,
+                                                App::captureHandler));
+  this->previous_sink_ = setThreadLogSink(this->app_->log_sink_.get());
+}
+
+App::RunScope::~RunScope() {
+  if(!this->outer_)
+    return;
+  setThreadLogSink(this->previous_sink_);
+  this->app_->callbacks_.reset();
+  this->app_->interrupt_ = false;
+}
+
+InterruptCallback App::getInterruptHook() const {
+  return this->callbacks_ ? this->callbacks_->getInterrupt() : this->m_interrupt;
+}
+
+ProgressCallback App::getProgressHook() const {
+  return this->callbacks_ ? this->callbacks_->getProgress() : this->m_progress;
+}
+
+CaptureCallback App::getCaptureHook() const {
+  return this->callbacks_ ? this->callbacks_->getCapture() : (CaptureCallback)NULL;
+}
+
+bool App::interruptHandler(void* context) {
+  App* app = (App*)context;
+  bool interrupted = app->interrupt_ || (app->m_interrupt && app->m_interrupt());
+  if(interrupted) {
+    // Marks the run incomplete until the end of the run
+    app->interrupt_ = true;
+    log_msg<LOG_INFO>(L"App::interruptHandler - Execution interrupted");
+  }
+  return interrupted;
+}
+
+void App::progressHandler(void* context, int step, int max_step, float t_per_step) {
+  App* app = (App*)context;
+  app->progress_step_ = step;
+  app->progress_max_step_ = max_step;
+  if(app->m_progress)
+    app->m_progress(step, max_step, t_per_step);
+}
+
+void App::captureHandler(void* context, float* data, unsigned char* position_data,
+                         unsigned int dim_x, unsigned int dim_y,
+                         unsigned int slice, unsigned int orientation,
+                         unsigned int step) {
+  ((App*)context)->saveBitmap(data, position_data, dim_x, dim_y, slice, orientation, step);
+}
+
+void App::setLogFile(std::string path) {
+  if(path.empty()) {
+    this->log_sink_.reset();
+    return;
+  }
+  this->log_sink_.reset(new LogSink(path));
+  if(!this->log_sink_->isOpen()) {
+    log_msg<LOG_WARNING>(L"App::setLogFile - can not open %s, using the default log") %path.c_str();
+    this->log_sink_.reset();
+  }
+}
+
+namespace {
+  void runHostTask(FDTD::App* app, unsigned int threads_per_app) {
+    app->runSimulationHost(1, threads_per_app);
+  }
+}
+
+unsigned int App::runConcurrently(const std::vector<App*>& apps,
+                                  unsigned int threads_per_app) {
+  ThreadPool& pool = ThreadPool::process();
+  log_msg<LOG_INFO>(L"App::runConcurrently - %u apps, %u threads each, %u workers")
+                    %apps.size() %threads_per_app %pool.getNumThreads();
+
+  std::vector<ThreadPool::Task> tasks;
+  for(unsigned int i = 0; i < apps.size(); i++)
+    tasks.push_back(boost::bind(&runHostTask, apps.at(i), std::max(threads_per_app, 1u)));
+  return pool.runAll(tasks);
+}
+
 ///////////////////////////////////////////////////////////////////////////////
 // Device reset
 ///////////////////////////////////////////////////////////////////////////////
@@ -98,6 +192,8 @@ void App::queryDevices() {
   log_msg<LOG_INFO>(L"App::queryDevices - best device %s") %best_device_;
   
   this->best_device_ = best_device;
+  this->device_throughputs_.clear();
+  this->measured_throughputs_.resize(number_of_devices, 0.f);
 
   for(int i = 0; i < this->number_of_devices_; i++) {
     cudaSetDevice(i);
@@ -107,10 +203,25 @@ void App::queryDevices() {
     this->device_mem_sizes_.push_back((int)(free_mem/1e6f));
     log_msg<LOG_INFO>(L"App::queryDevices - memory size dev %d: %d MB")
                       %i %(int)(free_mem/1e6f);
+
+    // The update is memory bound, the throughput is estimated from the
+    // memory bandwidth with 12 bytes moved per node until measured
+    cudaDeviceProp prop;
+    cudaGetDeviceProperties(&prop, i);
+    float bandwidth = 2.f*(float)prop.memoryClockRate*1e3f*(float)prop.memoryBusWidth/8.f;
+    float throughput = bandwidth > 0.f ? bandwidth/12.f/1e6f : 1.f;
+    this->device_throughputs_.push_back(throughput);
+    log_msg<LOG_INFO>(L"App::queryDevices - estimated throughput dev %d: %f Mvox/s")
+                      %i %throughput;
   }
 
 }
 
+std::vector<float> App::getDeviceThroughputs() {
+  return PartitionPlanner::calibrateThroughputs(this->device_throughputs_,
+                                                this->measured_throughputs_);
+}
+
 void App::resetDevices() {
   for(int i = 0; i < this->number_of_devices_; i++) {
     log_msg<LOG_INFO>(L"App::resetDevices - reseting device %d") %i;
@@ -122,12 +233,15 @@ void App::resetDevices() {
 ///////////////////////////////////////////////////////////////////////////////
 // Initialization functions
 ///////////////////////////////////////////////////////////////////////////////
-void App::initializeDevices() {
+void App::initializeDevices(bool reset_devices) {
   this->queryDevices();
-  this->resetDevices();
+  // A reset would free the memory of the instances running on the devices
+  if(reset_devices && CallbackSlot::getNumBound() == 0)
+    this->resetDevices();
+  else if(reset_devices)
+    log_msg<LOG_WARNING>(L"App::initializeDevices - other instances are running, the devices are not reset");
   cudaSetDevice(this->best_device_);
   cudasafe(cudaPeekAtLastError(), "App::initialize - peek error after initalization");
-  GLOBAL::currentApp = this;
 }
 
 void App::initializeGeometryFromFile(std::string geometry_fp) {
@@ -136,15 +250,18 @@ void App::initializeGeometryFromFile(std::string geometry_fp) {
     log_msg<LOG_ERROR>(L"App::initializeGeometryFromFile - invalid file: %d") % geometry_fp.c_str();
     throw(-1);
    }
+  this->closeSession();
 }
 
 void App::initializeGeometry(unsigned int* indices, float* vertices,
                              unsigned int number_of_indices,
                              unsigned int number_of_vertices) {
   m_geometry.initialize(indices, vertices, number_of_indices, number_of_vertices);
+  this->closeSession();
 }
 
 void App::initializeMesh(unsigned int number_of_partitions) {
+  this->session_ = false;
   float dx = this->m_parameters.getDx();
   unsigned int estimated_nodes = (unsigned int)((this->m_geometry.getBoundingBox()).x/dx*
                                  (this->m_geometry.getBoundingBox()).y/dx*
@@ -214,23 +331,48 @@ void App::initializeMesh(unsigned int number_of_partitions) {
   }
 
   this->num_elements_ = this->m_mesh.getNumberOfElements();
-  unsigned int element_limit = (unsigned int)90e6;
-
-  if(this->m_mesh.isDouble())
-    element_limit /= 2;
 
+  // Count the air and boundary nodes of each slice
+  unsigned int dim_x = this->m_mesh.getDimX();
+  unsigned int dim_y = this->m_mesh.getDimY();
+  unsigned int dim_z = this->m_mesh.getDimZ();
+  unsigned char* h_position_idx = fromDevice<unsigned char>(dim_x*dim_y*dim_z,
+                                                            this->m_mesh.getPositionIdxPtrAt(0),
+                                                            0);
+  unsigned char air_value = this->m_parameters.getUpdateType() == SRL ? 0x80 : 0x86;
+  PartitionPlanner planner;
+  planner.setBytesPerNode(this->m_mesh.isDouble() ? 18 : 10);
+  planner.countSlices(h_position_idx, dim_x, dim_y, dim_z, air_value);
+  free(h_position_idx);
+
+  std::vector<float> throughputs = this->getDeviceThroughputs();
+  for(int i = 0; i < this->number_of_devices_; i++)
+    planner.addTarget(throughputs.at(i), (float)this->device_mem_sizes_.at(i));
+
+  unsigned int num_partitions = 1;
   if(this->force_partition_to_ != -1 && this->force_partition_to_ <= this->number_of_devices_) {
-    this->m_mesh.makePartition(this->force_partition_to_);
+    num_partitions = (unsigned int)this->force_partition_to_;
     log_msg<LOG_DEBUG>(L"App::initializeMesh - force partition to %d") %this->force_partition_to_;
   }
-  else if(this->num_elements_ < element_limit) {
-    this->m_mesh.makePartition(1);
-    log_msg<LOG_DEBUG>(L"App::initializeMesh - num elements below element limit, 1 partition");
-  }
   else {
-    log_msg<LOG_DEBUG>(L"App::initializeMesh - num elements above element limit, 2 partition");
-    this->m_mesh.makePartition(number_of_partitions);
+    unsigned int min_partitions = planner.getMinimumNumberOfTargets();
+    if(min_partitions == 0) {
+      log_msg<LOG_ERROR>(L"App::initializeMesh - the mesh does not fit the devices, exiting");
+      this->close();
+      throw(-1);
+    }
+    num_partitions = min_partitions;
+    if(min_partitions > 1)
+      num_partitions = std::max(min_partitions,
+                                std::min(number_of_partitions, (unsigned int)this->number_of_devices_));
+    log_msg<LOG_DEBUG>(L"App::initializeMesh - %u partitions, at least %u needed")
+                       %num_partitions %min_partitions;
   }
+
+  if(num_partitions == 1)
+    this->m_mesh.makePartition(1);
+  else
+    this->m_mesh.makePartition(planner.plan(num_partitions));
 }
 
 void App::initializeWindow(int argc, char** argv) {
@@ -306,11 +448,16 @@ void App::runVisualization() {
 }
 
 void App::runSimulation() {
+  RunScope scope(this);
   clock_t start_t;
   clock_t end_t;
   start_t = clock();
 
-  this->initializeMesh(2);
+  std::string cache_key = this->result_cache_ ? this->getResultKey("cuda") : "";
+  if(this->loadCachedResult(cache_key))
+    return;
+
+  this->prepareMesh();
 
   unsigned int oct = this->m_parameters.getOctave();
   log_msg<LOG_INFO>(L"App::runSimulation - Volume: %f") %this->getVolume();
@@ -319,25 +466,40 @@ void App::runSimulation() {
   log_msg<LOG_INFO>(L"App::runSimulation - Sabine RT: %f") %this->getSabine(oct);
   log_msg<LOG_INFO>(L"App::runSimulation - Eyrting RT: %f") %this->getEyring(oct);
 
-  // Execute simulation
-  if(this->m_mesh.isDouble()) {
-    this->responses_double_.assign(m_parameters.getNumSteps()*m_parameters.getNumReceivers(), 0);
-    this->time_per_step_ = launchFDTD3dDouble(&this->m_mesh, 
-                                              &(this->m_parameters), 
-                                              &this->responses_double_[0], 
-                                              this->m_interrupt, 
-                                              this->m_progress);
+  this->pair_plan_.reset();
+  bool pairs = this->reciprocity_ && ReciprocityPlan::isSupported(this->m_parameters);
+  if(this->reciprocity_ && !pairs)
+    log_msg<LOG_WARNING>(L"App::runSimulation - the sources and receivers can not be run as pairs, running all at once");
 
+  // Execute simulation
+  if(pairs) {
+    this->runReciprocal();
   }
   else {
-    this->responses_.assign(m_parameters.getNumSteps()*m_parameters.getNumReceivers(), 0.f);
-    this->time_per_step_ = launchFDTD3d(&this->m_mesh, 
-                                        &(this->m_parameters), 
-                                        &this->responses_[0],
-                                        this->m_interrupt, 
-                                        this->m_progress);
+    this->beginResponses(true, true);
+    if(this->m_mesh.isDouble()) {
+      this->time_per_step_ = launchFDTD3dDouble(&this->m_mesh, 
+                                                &(this->m_parameters), 
+                                                this->getResponseTargetDouble(), 
+                                                this->getInterruptHook(), 
+                                                this->getProgressHook());
+
+    }
+    else {
+      this->time_per_step_ = launchFDTD3d(&this->m_mesh, 
+                                          &(this->m_parameters), 
+                                          this->getResponseTarget(),
+                                          this->getInterruptHook(), 
+                                          this->getProgressHook());
 
+    }
+    this->endResponses(true);
   }
+  this->storeCachedResult(cache_key);
+
+  // A single device run measures the throughput of that device
+  if(this->m_mesh.getNumberOfPartitions() == 1 && this->time_per_step_ > 0.f)
+    this->setDeviceThroughput(this->m_mesh.getDeviceAt(0), this->getMvoxPerSec());
 
   end_t = clock()-start_t;
   log_msg<LOG_INFO>(L"App::runMex - time: %f seconds") 
@@ -347,13 +509,863 @@ void App::runSimulation() {
 
 }
 
+void App::prepareSession() {
+  RunScope scope(this);
+  this->initializeMesh(2);
+  this->session_ = true;
+  this->session_fs_ = this->m_parameters.getSpatialFs();
+  this->session_update_type_ = this->m_parameters.getUpdateType();
+  this->session_double_ = this->m_mesh.isDouble();
+  log_msg<LOG_INFO>(L"App::prepareSession - mesh of %u nodes, fs %u")
+                    %this->m_mesh.getNumberOfElements() %this->session_fs_;
+}
+
+void App::prepareMesh() {
+  if(!this->session_) {
+    this->initializeMesh(2);
+    return;
+  }
+
+  if(this->session_fs_ != this->m_parameters.getSpatialFs() ||
+     this->session_update_type_ != this->m_parameters.getUpdateType() ||
+     this->session_double_ != this->m_mesh.isDouble()) {
+    log_msg<LOG_WARNING>(L"App::prepareMesh - the fs, update type or precision "
+                         L"of the session changed, building the mesh again");
+    this->prepareSession();
+    return;
+  }
+
+  this->m_mesh.resetPressures();
+  this->current_step_ = 0;
+}
+
+std::vector< std::vector<double> > App::runSweep(const std::vector<SweepConfig>& configs) {
+  RunScope scope(this);
+  bool opened = !this->session_;
+  if(opened)
+    this->prepareSession();
+
+  SimulationParameters original = this->m_parameters;
+  std::vector< std::vector<double> > ret(configs.size());
+  for(unsigned int i = 0; i < configs.size(); i++) {
+    log_msg<LOG_INFO>(L"App::runSweep - run %u of %u, %u sources, %u receivers")
+                      %(i+1) %configs.size() %configs.at(i).sources.size()
+                      %configs.at(i).receivers.size();
+    configs.at(i).applyTo(this->m_parameters);
+    this->runSimulation();
+
+    std::vector<double>& responses = ret.at(i);
+    if(this->m_mesh.isDouble())
+      responses.assign(this->responses_double_.begin(), this->responses_double_.end());
+    else
+      responses.assign(this->responses_.begin(), this->responses_.end());
+
+    if(this->getInterruptHook()())
+      break;
+  }
+
+  this->m_parameters = original;
+  if(opened)
+    this->closeSession();
+  return ret;
+}
+
+void App::runReciprocal() {
+  this->pair_plan_.reset(new ReciprocityPlan(this->m_parameters));
+  ReciprocityPlan* plan = this->pair_plan_.get();
+  log_msg<LOG_INFO>(L"App::runReciprocal - %u sources, %u receivers, %u runs, reciprocal %d")
+                    %plan->getNumSources() %plan->getNumReceivers()
+                    %plan->getNumRuns() %plan->isReciprocal();
+
+  // The launchers take the parameters of the app, the original ones are
+  // restored after the runs
+  SimulationParameters original = this->m_parameters;
+  bool is_double = this->m_mesh.isDouble();
+  float time_per_step = 0.f;
+  for(unsigned int run = 0; run < plan->getNumRuns(); run++) {
+    this->m_parameters = plan->getRunParameters(run);
+    size_t size = (size_t)this->m_parameters.getNumSteps()*this->m_parameters.getNumReceivers();
+    if(run > 0)
+      this->m_mesh.resetPressures();
+
+    if(is_double) {
+      std::vector<double> ret(size, 0.0);
+      time_per_step += launchFDTD3dDouble(&this->m_mesh, &(this->m_parameters), &ret[0],
+                                          this->getInterruptHook(), this->getProgressHook());
+      plan->addRunResponses(run, &ret[0]);
+    }
+    else {
+      std::vector<float> ret(size, 0.f);
+      time_per_step += launchFDTD3d(&this->m_mesh, &(this->m_parameters), &ret[0],
+                                    this->getInterruptHook(), this->getProgressHook());
+      plan->addRunResponses(run, &ret[0]);
+    }
+  }
+  this->m_parameters = original;
+  this->time_per_step_ = time_per_step/(float)plan->getNumRuns();
+
+  this->beginResponses(false, true);
+  if(!this->responses_double_.empty())
+    plan->sumResponses(&this->responses_double_[0]);
+  if(!this->responses_.empty())
+    plan->sumResponses(&this->responses_[0]);
+  this->endResponses(false);
+}
+
+void App::beginResponses(bool streamed, bool resampled) {
+  unsigned int length = resampled ? this->m_parameters.getNumOutputSamples()
+                                  : this->m_parameters.getNumSteps();
+  size_t size = (size_t)length*this->m_parameters.getNumReceivers();
+  bool keep = true;
+  this->m_parameters.setResponseWriter((ResponseWriter*)NULL);
+  if(!this->response_path_.empty()) {
+    if(!this->response_writer_)
+      this->response_writer_.reset(new ResponseWriter());
+    if(this->response_writer_->open(this->response_path_,
+                                    (enum ResponseFormat)this->response_format_,
+                                    this->m_parameters.getNumReceivers(),
+                                    resampled ? this->m_parameters.getResponseFs()
+                                              : this->m_parameters.getSpatialFs())) {
+      keep = this->keep_responses_ || !streamed;
+      if(streamed)
+        this->m_parameters.setResponseWriter(this->response_writer_.get());
+    }
+  }
+
+  if(!streamed && this->m_parameters.getNumReceiverGrids() > 0)
+    log_msg<LOG_WARNING>(L"App::beginResponses - receiver grids are not recorded by this solver");
+
+  this->responses_.clear();
+  this->responses_double_.clear();
+  if(keep && this->m_mesh.isDouble())
+    this->responses_double_.assign(size, 0);
+  else if(keep)
+    this->responses_.assign(size, 0.f);
+}
+
+void App::requireStaticRun(const char* solver) {
+  bool supported = true;
+  if(this->m_parameters.getNumArraySources() > 0) {
+    log_msg<LOG_ERROR>(L"App::%s - array sources are not supported") %solver;
+    supported = false;
+  }
+  if(this->m_parameters.hasMovingPositions()) {
+    log_msg<LOG_ERROR>(L"App::%s - moving sources and receivers are not supported") %solver;
+    supported = false;
+  }
+  if(this->m_parameters.hasBFormatReceivers()) {
+    log_msg<LOG_ERROR>(L"App::%s - B-format receivers are not supported") %solver;
+    supported = false;
+  }
+  if(this->m_parameters.getOutputFs() > 0) {
+    log_msg<LOG_ERROR>(L"App::%s - the responses can not be resampled to an output fs") %solver;
+    supported = false;
+  }
+  if(!supported)
+    throw(-1);
+}
+
+void App::endResponses(bool streamed) {
+  this->m_parameters.setResponseWriter((ResponseWriter*)NULL);
+  if(!this->response_writer_ || !this->response_writer_->isOpen())
+    return;
+
+  // The solver filled the responses in memory, they are written a chunk
+  // at a time
+  if(!streamed) {
+    unsigned int num_steps = this->getResponseLength();
+    unsigned int num_receivers = this->m_parameters.getNumReceivers();
+    unsigned int chunk = 512;
+    std::vector<unsigned int> channels(num_receivers);
+    for(unsigned int i = 0; i < num_receivers; i++)
+      channels.at(i) = i;
+    this->response_writer_->begin(num_steps, chunk, num_receivers);
+    for(unsigned int first = 0; num_receivers > 0 && first < num_steps; first += chunk) {
+      unsigned int count = std::min(chunk, num_steps-first);
+      if(this->m_mesh.isDouble())
+        this->response_writer_->write(first, count, &channels[0], num_receivers,
+                                      &this->responses_double_[first], 1, num_steps);
+      else
+        this->response_writer_->write(first, count, &channels[0], num_receivers,
+                                      &this->responses_[first], 1, num_steps);
+    }
+  }
+  if(!this->response_writer_->close()) {
+    log_msg<LOG_ERROR>(L"App::endResponses - the responses could not be written to %s")
+                       %this->response_path_.c_str();
+    throw(-1);
+  }
+}
+
+void App::setResultCache(std::string dir, double max_megabytes) {
+  if(dir.empty()) {
+    this->result_cache_.reset();
+    return;
+  }
+  this->result_cache_.reset(new ResultCache(dir, (unsigned long long)(max_megabytes*1024.0*1024.0)));
+}
+
+std::string App::getResultKey(std::string solver) {
+  // The responses of the grids and the pairs are not kept in the cache
+  if(this->m_parameters.getNumReceiverGrids() > 0 || this->reciprocity_)
+    return "";
+
+  StateHash hash;
+  hash.addString(solver);
+  hash.addValue(this->m_mesh.isDouble());
+  this->m_geometry.hashState(hash);
+  this->m_materials.hashState(hash);
+  this->m_parameters.hashState(hash);
+  return hash.getDigest();
+}
+
+bool App::loadCachedResult(const std::string& key) {
+  this->last_run_cached_ = false;
+  if(key.empty() || !this->result_cache_)
+    return false;
+
+  CachedResult result;
+  if(!this->result_cache_->load(key, result))
+    return false;
+  if(result.num_receivers != this->m_parameters.getNumReceivers() ||
+     result.length != this->m_parameters.getNumOutputSamples() ||
+     result.responses_double.empty() != !this->m_mesh.isDouble()) {
+    log_msg<LOG_WARNING>(L"App::loadCachedResult - the result %s does not match the run")
+                         %key.c_str();
+    return false;
+  }
+
+  this->beginResponses(false, true);
+  if(this->m_mesh.isDouble())
+    this->responses_double_.swap(result.responses_double);
+  else
+    this->responses_.swap(result.responses);
+  this->endResponses(false);
+
+  this->last_run_cached_ = true;
+  this->time_per_step_ = 0.f;
+  log_msg<LOG_INFO>(L"App::loadCachedResult - responses read from the cache, %s") %key.c_str();
+  return true;
+}
+
+void App::storeCachedResult(const std::string& key) {
+  // An interrupted run has partial responses
+  if(key.empty() || !this->result_cache_ || this->interrupt_)
+    return;
+
+  CachedResult result;
+  result.num_receivers = this->m_parameters.getNumReceivers();
+  result.length = this->m_parameters.getNumOutputSamples();
+  result.fs = this->m_parameters.getResponseFs();
+  size_t size = (size_t)result.num_receivers*result.length;
+  if(this->m_mesh.isDouble() && this->responses_double_.size() == size)
+    result.responses_double = this->responses_double_;
+  else if(!this->m_mesh.isDouble() && this->responses_.size() == size)
+    result.responses = this->responses_;
+  else
+    return;
+
+  if(size > 0 && this->result_cache_->store(key, result))
+    log_msg<LOG_DEBUG>(L"App::storeCachedResult - stored %s") %key.c_str();
+}
+
+void App::runSimulationHost(unsigned int number_of_partitions,
+                            unsigned int threads_per_partition,
+                            unsigned int halo_depth) {
+  RunScope scope(this);
+  clock_t start_t;
+  clock_t end_t;
+  start_t = clock();
+
+  std::string cache_key = this->result_cache_ ? this->getResultKey("host") : "";
+  if(this->loadCachedResult(cache_key))
+    return;
+
+  // Voxelize on the device to a single partition, the domain is then
+  // copied to the host
+  int force_partition_to = this->force_partition_to_;
+  this->force_partition_to_ = 1;
+  this->initializeMesh(1);
+  this->force_partition_to_ = force_partition_to;
+
+  unsigned int dim_x = this->m_mesh.getDimX();
+  unsigned int dim_y = this->m_mesh.getDimY();
+  unsigned int dim_z = this->m_mesh.getDimZ();
+  unsigned int num_elements = dim_x*dim_y*dim_z;
+
+  unsigned char* h_position_idx = fromDevice<unsigned char>(num_elements,
+                                                            this->m_mesh.getPositionIdxPtrAt(0),
+                                                            this->m_mesh.getDeviceAt(0));
+  unsigned char* h_material_idx = fromDevice<unsigned char>(num_elements,
+                                                            this->m_mesh.getMaterialIdxPtrAt(0),
+                                                            this->m_mesh.getDeviceAt(0));
+  unsigned int update_type = (unsigned int)this->m_parameters.getUpdateType();
+  unsigned int num_materials = this->m_materials.getNumberOfUniqueMaterials();
+
+  log_msg<LOG_INFO>(L"App::runSimulationHost - %u partitions, %u threads per partition, "
+                    L"halo depth %u") %number_of_partitions %threads_per_partition %halo_depth;
+
+  if(this->m_mesh.isDouble()) {
+    HostMesh<double> host_mesh;
+    host_mesh.setupMesh(h_position_idx, h_material_idx, dim_x, dim_y, dim_z,
+                        this->m_materials.getMaterialCoefficientPtrDouble(),
+                        num_materials,
+                        this->m_parameters.getParameterPtrDouble(),
+                        update_type);
+    free(h_position_idx);
+    free(h_material_idx);
+    host_mesh.makePartition(number_of_partitions, halo_depth);
+
+    this->beginResponses(true, true);
+    this->time_per_step_ = launchFDTD3dHostDouble(&host_mesh,
+                                                  &(this->m_parameters),
+                                                  this->getResponseTargetDouble(),
+                                                  this->getInterruptHook(),
+                                                  this->getProgressHook(),
+                                                  threads_per_partition);
+  }
+  else {
+    HostMesh<float> host_mesh;
+    host_mesh.setupMesh(h_position_idx, h_material_idx, dim_x, dim_y, dim_z,
+                        this->m_materials.getMaterialCoefficientPtr(),
+                        num_materials,
+                        this->m_parameters.getParameterPtr(),
+                        update_type);
+    free(h_position_idx);
+    free(h_material_idx);
+    host_mesh.makePartition(number_of_partitions, halo_depth);
+
+    this->beginResponses(true, true);
+    this->time_per_step_ = launchFDTD3dHost(&host_mesh,
+                                            &(this->m_parameters),
+                                            this->getResponseTarget(),
+                                            this->getInterruptHook(),
+                                            this->getProgressHook(),
+                                            threads_per_partition);
+  }
+  this->endResponses(true);
+  this->storeCachedResult(cache_key);
+
+  end_t = clock()-start_t;
+  log_msg<LOG_INFO>(L"App::runSimulationHost - time: %f seconds")
+                    % ((float)end_t/CLOCKS_PER_SEC);
+  log_msg<LOG_INFO>(L"App::runSimulationHost - Performance Mvox/sec: %f ")
+                    % ((1.f/this->time_per_step_*num_elements)/1e6);
+}
+
+void App::runSimulationHostBlocks(unsigned int number_of_blocks) {
+  RunScope scope(this);
+  this->requireStaticRun("runSimulationHostBlocks");
+  clock_t start_t;
+  clock_t end_t;
+  start_t = clock();
+
+  int force_partition_to = this->force_partition_to_;
+  this->force_partition_to_ = 1;
+  this->initializeMesh(1);
+  this->force_partition_to_ = force_partition_to;
+
+  unsigned int dim_x = this->m_mesh.getDimX();
+  unsigned int dim_y = this->m_mesh.getDimY();
+  unsigned int dim_z = this->m_mesh.getDimZ();
+  unsigned int num_elements = dim_x*dim_y*dim_z;
+
+  unsigned char* h_position_idx = fromDevice<unsigned char>(num_elements,
+                                                            this->m_mesh.getPositionIdxPtrAt(0),
+                                                            this->m_mesh.getDeviceAt(0));
+  unsigned char* h_material_idx = fromDevice<unsigned char>(num_elements,
+                                                            this->m_mesh.getMaterialIdxPtrAt(0),
+                                                            this->m_mesh.getDeviceAt(0));
+  unsigned int update_type = (unsigned int)this->m_parameters.getUpdateType();
+  unsigned int num_materials = this->m_materials.getNumberOfUniqueMaterials();
+
+  log_msg<LOG_INFO>(L"App::runSimulationHostBlocks - %u blocks") %number_of_blocks;
+
+  if(this->m_mesh.isDouble()) {
+    HostBlockMesh<double> host_mesh;
+    host_mesh.setupMesh(h_position_idx, h_material_idx, dim_x, dim_y, dim_z,
+                        this->m_materials.getMaterialCoefficientPtrDouble(),
+                        num_materials,
+                        this->m_parameters.getParameterPtrDouble(),
+                        update_type);
+    free(h_position_idx);
+    free(h_material_idx);
+    host_mesh.makeBlocks(number_of_blocks);
+
+    this->beginResponses(false, false);
+    this->time_per_step_ = launchFDTD3dHostBlocksDouble(&host_mesh,
+                                                        &(this->m_parameters),
+                                                        this->getResponseTargetDouble(),
+                                                        this->getInterruptHook(),
+                                                        this->getProgressHook());
+  }
+  else {
+    HostBlockMesh<float> host_mesh;
+    host_mesh.setupMesh(h_position_idx, h_material_idx, dim_x, dim_y, dim_z,
+                        this->m_materials.getMaterialCoefficientPtr(),
+                        num_materials,
+                        this->m_parameters.getParameterPtr(),
+                        update_type);
+    free(h_position_idx);
+    free(h_material_idx);
+    host_mesh.makeBlocks(number_of_blocks);
+
+    this->beginResponses(false, false);
+    this->time_per_step_ = launchFDTD3dHostBlocks(&host_mesh,
+                                                  &(this->m_parameters),
+                                                  this->getResponseTarget(),
+                                                  this->getInterruptHook(),
+                                                  this->getProgressHook());
+  }
+  this->endResponses(false);
+
+  end_t = clock()-start_t;
+  log_msg<LOG_INFO>(L"App::runSimulationHostBlocks - time: %f seconds")
+                    % ((float)end_t/CLOCKS_PER_SEC);
+  log_msg<LOG_INFO>(L"App::runSimulationHostBlocks - Performance Mvox/sec: %f ")
+                    % ((1.f/this->time_per_step_*num_elements)/1e6);
+}
+
+void App::runSimulationTargets(unsigned int halo_depth) {
+  this->runTargets(this->targets_, halo_depth, false);
+}
+
+void App::runSimulationHostNuma(unsigned int partitions_per_node,
+                                bool huge_pages,
+                                unsigned int halo_depth) {
+  if(partitions_per_node == 0)
+    partitions_per_node = 1;
+
+  // Partitions are weighted by the CPUs they get
+  NumaTopology topology;
+  std::vector<ExecutionTarget> targets;
+  for(unsigned int n = 0; n < topology.getNumberOfNodes(); n++) {
+    unsigned int cpus = (unsigned int)topology.getCpus(n).size();
+    for(unsigned int i = 0; i < partitions_per_node; i++) {
+      unsigned int threads = (cpus*(i+1))/partitions_per_node-(cpus*i)/partitions_per_node;
+      threads = std::max(threads, 1u);
+      targets.push_back(makeHostTarget(threads, (float)threads, 1e9f, (int)n));
+    }
+  }
+
+  log_msg<LOG_INFO>(L"App::runSimulationHostNuma - %u nodes, %u partitions per node, "
+                    L"huge pages %d") %topology.getNumberOfNodes() %partitions_per_node
+                    %(int)huge_pages;
+  this->runTargets(targets, halo_depth, huge_pages);
+}
+
+void App::runTargets(std::vector<ExecutionTarget> targets,
+                     unsigned int halo_depth,
+                     bool huge_pages) {
+  RunScope scope(this);
+  clock_t start_t;
+  clock_t end_t;
+  start_t = clock();
+
+  if(targets.empty()) {
+    log_msg<LOG_ERROR>(L"App::runSimulationTargets - no targets, see addHostTarget()");
+    throw(-1);
+  }
+
+  int force_partition_to = this->force_partition_to_;
+  this->force_partition_to_ = 1;
+  this->initializeMesh(1);
+  this->force_partition_to_ = force_partition_to;
+
+  unsigned int dim_x = this->m_mesh.getDimX();
+  unsigned int dim_y = this->m_mesh.getDimY();
+  unsigned int dim_z = this->m_mesh.getDimZ();
+  unsigned int num_elements = dim_x*dim_y*dim_z;
+
+  unsigned char* h_position_idx = fromDevice<unsigned char>(num_elements,
+                                                            this->m_mesh.getPositionIdxPtrAt(0),
+                                                            this->m_mesh.getDeviceAt(0));
+  unsigned char* h_material_idx = fromDevice<unsigned char>(num_elements,
+                                                            this->m_mesh.getMaterialIdxPtrAt(0),
+                                                            this->m_mesh.getDeviceAt(0));
+  unsigned int update_type = (unsigned int)this->m_parameters.getUpdateType();
+  unsigned int num_materials = this->m_materials.getNumberOfUniqueMaterials();
+
+  // Complete the weights and the memory of the targets
+  for(unsigned int i = 0; i < targets.size(); i++) {
+    ExecutionTarget& target = targets.at(i);
+    if(target.type == TARGET_DEVICE) {
+      if(target.device < 0 || target.device >= this->number_of_devices_) {
+        log_msg<LOG_ERROR>(L"App::runSimulationTargets - no device %d") %target.device;
+        free(h_position_idx);
+        free(h_material_idx);
+        throw(-1);
+      }
+      if(target.throughput <= 0.f)
+        target.throughput = this->getDeviceThroughputs().at(target.device);
+      target.memory_in_MB = (float)this->device_mem_sizes_.at(target.device);
+      target.block_x = this->m_mesh.getBlockX();
+      target.block_y = this->m_mesh.getBlockY();
+    }
+    else if(target.throughput <= 0.f) {
+      target.throughput = estimateHostThroughput(target.threads);
+    }
+    log_msg<LOG_INFO>(L"App::runSimulationTargets - target %u: %s %d, %u threads, %f Mvox/s")
+                      %i %(target.type == TARGET_DEVICE ? "device" : "host")
+                      %target.device %target.threads %target.throughput;
+  }
+
+  unsigned char air_value = this->m_parameters.getUpdateType() == SRL ? 0x80 : 0x86;
+  PartitionPlanner planner;
+  planner.setBytesPerNode(this->m_mesh.isDouble() ? 18 : 10);
+  planner.setMinSlices(std::max(2u, halo_depth));
+  planner.countSlices(h_position_idx, dim_x, dim_y, dim_z, air_value);
+  for(unsigned int i = 0; i < targets.size(); i++)
+    planner.addTarget(targets.at(i).throughput, targets.at(i).memory_in_MB);
+
+  std::vector< std::vector<unsigned int> > indexing;
+  try {
+    indexing = planner.plan((unsigned int)targets.size());
+  }
+  catch(...) {
+    free(h_position_idx);
+    free(h_material_idx);
+    throw;
+  }
+
+  // Pinned targets get their partitions on their own node
+  NumaTopology topology;
+  std::vector<int> nodes(targets.size(), -1);
+  bool placed = false;
+  for(unsigned int i = 0; i < targets.size(); i++) {
+    int node = targets.at(i).numa_node;
+    if(targets.at(i).type != TARGET_HOST || node < 0 ||
+       node >= (int)topology.getNumberOfNodes())
+      continue;
+    nodes.at(i) = topology.getNodeId(node);
+    placed = true;
+  }
+
+  std::vector<NodeBandwidth> report;
+  if(this->m_mesh.isDouble()) {
+    HostMesh<double> host_mesh;
+    host_mesh.setupMesh(h_position_idx, h_material_idx, dim_x, dim_y, dim_z,
+                        this->m_materials.getMaterialCoefficientPtrDouble(),
+                        num_materials,
+                        this->m_parameters.getParameterPtrDouble(),
+                        update_type);
+    free(h_position_idx);
+    free(h_material_idx);
+    if(placed)
+      host_mesh.setPlacement(nodes, huge_pages);
+    host_mesh.makePartition(indexing, halo_depth);
+
+    this->beginResponses(true, true);
+    this->time_per_step_ = launchFDTD3dHostTargetsDouble(&host_mesh,
+                                                         &(this->m_parameters),
+                                                         this->getResponseTargetDouble(),
+                                                         this->getInterruptHook(),
+                                                         this->getProgressHook(),
+                                                         targets,
+                                                         &report);
+  }
+  else {
+    HostMesh<float> host_mesh;
+    host_mesh.setupMesh(h_position_idx, h_material_idx, dim_x, dim_y, dim_z,
+                        this->m_materials.getMaterialCoefficientPtr(),
+                        num_materials,
+                        this->m_parameters.getParameterPtr(),
+                        update_type);
+    free(h_position_idx);
+    free(h_material_idx);
+    if(placed)
+      host_mesh.setPlacement(nodes, huge_pages);
+    host_mesh.makePartition(indexing, halo_depth);
+
+    this->beginResponses(true, true);
+    this->time_per_step_ = launchFDTD3dHostTargets(&host_mesh,
+                                                   &(this->m_parameters),
+                                                   this->getResponseTarget(),
+                                                   this->getInterruptHook(),
+                                                   this->getProgressHook(),
+                                                   targets,
+                                                   &report);
+  }
+  this->endResponses(true);
+
+  this->node_bandwidths_.assign(topology.getNumberOfNodes(), 0.f);
+  for(unsigned int i = 0; i < report.size(); i++)
+    if(report.at(i).node >= 0 && report.at(i).node < (int)topology.getNumberOfNodes())
+      this->node_bandwidths_.at(report.at(i).node) = report.at(i).gb_per_s;
+
+  end_t = clock()-start_t;
+  log_msg<LOG_INFO>(L"App::runSimulationTargets - time: %f seconds")
+                    % ((float)end_t/CLOCKS_PER_SEC);
+  log_msg<LOG_INFO>(L"App::runSimulationTargets - Performance Mvox/sec: %f ")
+                    % ((1.f/this->time_per_step_*num_elements)/1e6);
+}
+
+namespace {
+  // Voxelize the domain straight to the files of the mesh a slab at a time,
+  // the whole domain is never held in host or device memory
+  template <typename T>
+  void voxelizeSlabs(HostStreamMesh<T>* mesh, GeometryHandler* geometry,
+                     MaterialHandler* materials, double dx, unsigned int slab_slices) {
+    unsigned int dim_xy = mesh->getDimXY();
+    for(unsigned int z = 0; z < mesh->getDimZ(); z += slab_slices) {
+      unsigned int count = std::min(slab_slices, mesh->getDimZ()-z);
+      size_t offset = (size_t)z*dim_xy;
+      voxelizeGeometrySlab(geometry->getVerticePtr(),
+                           geometry->getIndexPtr(),
+                           materials->getMaterialIdxPtr(),
+                           geometry->getNumberOfTriangles(),
+                           geometry->getNumberOfVertices(),
+                           materials->getNumberOfUniqueMaterials(),
+                           dx, z, count,
+                           mesh->getPositionIdxPtr()+offset,
+                           mesh->getMaterialIdxPtr()+offset);
+      mesh->getPositionFile().release(offset, (size_t)count*dim_xy);
+      mesh->getMaterialFile().release(offset, (size_t)count*dim_xy);
+    }
+  }
+}
+
+void App::runSimulationOutOfCore(const std::string& path_prefix,
+                                 unsigned int slab_slices,
+                                 unsigned int time_block,
+                                 unsigned int threads) {
+  RunScope scope(this);
+  this->requireStaticRun("runSimulationOutOfCore");
+  clock_t start_t;
+  clock_t end_t;
+  start_t = clock();
+
+  if(threads == 0)
+    threads = std::max(boost::thread::hardware_concurrency(), 1u);
+
+  double dx = (double)this->m_parameters.getDx();
+  uint3 dim = getVoxelizationDim(this->m_geometry.getVerticePtr(),
+                                 this->m_geometry.getIndexPtr(),
+                                 this->m_geometry.getNumberOfTriangles(),
+                                 this->m_geometry.getNumberOfVertices(),
+                                 dx);
+  unsigned int dim_x = dim.x;
+  unsigned int dim_y = dim.y;
+  unsigned int dim_z = dim.z;
+  this->num_elements_ = dim_x*dim_y*dim_z;
+  unsigned int update_type = (unsigned int)this->m_parameters.getUpdateType();
+  unsigned int num_materials = this->m_materials.getNumberOfUniqueMaterials();
+
+  log_msg<LOG_INFO>(L"App::runSimulationOutOfCore - %s, slabs of %u slices, time block %u, "
+                    L"%u threads") %path_prefix.c_str() %slab_slices %time_block %threads;
+
+  if(this->m_mesh.isDouble()) {
+    HostStreamMesh<double> stream_mesh;
+    stream_mesh.setupMesh(path_prefix, dim_x, dim_y, dim_z,
+                          this->m_materials.getMaterialCoefficientPtrDouble(),
+                          num_materials,
+                          this->m_parameters.getParameterPtrDouble(),
+                          update_type);
+    voxelizeSlabs(&stream_mesh, &this->m_geometry, &this->m_materials, dx, slab_slices);
+
+    this->beginResponses(false, false);
+    this->time_per_step_ = launchFDTD3dHostStreamDouble(&stream_mesh,
+                                                        &(this->m_parameters),
+                                                        this->getResponseTargetDouble(),
+                                                        this->getInterruptHook(),
+                                                        this->getProgressHook(),
+                                                        slab_slices,
+                                                        time_block,
+                                                        threads);
+  }
+  else {
+    HostStreamMesh<float> stream_mesh;
+    stream_mesh.setupMesh(path_prefix, dim_x, dim_y, dim_z,
+                          this->m_materials.getMaterialCoefficientPtr(),
+                          num_materials,
+                          this->m_parameters.getParameterPtr(),
+                          update_type);
+    voxelizeSlabs(&stream_mesh, &this->m_geometry, &this->m_materials, dx, slab_slices);
+
+    this->beginResponses(false, false);
+    this->time_per_step_ = launchFDTD3dHostStream(&stream_mesh,
+                                                  &(this->m_parameters),
+                                                  this->getResponseTarget(),
+                                                  this->getInterruptHook(),
+                                                  this->getProgressHook(),
+                                                  slab_slices,
+                                                  time_block,
+                                                  threads);
+  }
+  this->endResponses(false);
+
+  end_t = clock()-start_t;
+  log_msg<LOG_INFO>(L"App::runSimulationOutOfCore - time: %f seconds")
+                    % ((float)end_t/CLOCKS_PER_SEC);
+  log_msg<LOG_INFO>(L"App::runSimulationOutOfCore - Performance Mvox/sec: %f ")
+                    % ((1.f/this->time_per_step_*dim_x*dim_y*dim_z)/1e6);
+}
+
+#ifndef WIN32
+namespace {
+  // The domain shared by the ranks of runSimulationDistributed
+  struct DistributedRun {
+    std::vector< std::vector<unsigned char> > position_slabs; ///< The slices of each rank
+    std::vector< std::vector<unsigned char> > material_slabs;
+    std::vector<unsigned int> first_slices;
+    unsigned int dim_x, dim_y, dim_z;
+    unsigned int halo_depth;
+    unsigned int num_materials;
+    unsigned int update_type;
+    bool is_double;
+    SimulationParameters* parameters;
+    MaterialHandler* materials;
+    std::vector<float>* responses;
+    std::vector<double>* responses_double;
+    bool (*interruptCallback)(void);
+    void (*progressCallback)(int, int, float);
+    float time_per_step;
+  };
+
+  float launchRank(HostMesh<float>* mesh, DistributedRun* run,
+                   float* h_return_ptr, HaloTransport* transport) {
+    return launchFDTD3dDistributed(mesh, run->parameters, h_return_ptr, transport,
+                                   run->interruptCallback, run->progressCallback);
+  }
+
+  float launchRank(HostMesh<double>* mesh, DistributedRun* run,
+                   double* h_return_ptr, HaloTransport* transport) {
+    return launchFDTD3dDistributedDouble(mesh, run->parameters, h_return_ptr, transport,
+                                         run->interruptCallback, run->progressCallback);
+  }
+
+  // Each rank sets up only the slices of its own partition, the slabs of
+  // the other ranks are dropped from this process
+  template <typename T>
+  float runRank(DistributedRun* run, HaloTransport* transport,
+                const T* material_coefs, const T* parameters, T* h_return_ptr) {
+    unsigned int rank = transport->getRank();
+    HostMesh<T> host_mesh;
+    host_mesh.setupSlices(&run->position_slabs.at(rank)[0], &run->material_slabs.at(rank)[0],
+                          run->first_slices.at(rank),
+                          (unsigned int)(run->position_slabs.at(rank).size()/(run->dim_x*run->dim_y)),
+                          run->dim_x, run->dim_y, run->dim_z,
+                          material_coefs, run->num_materials, parameters,
+                          run->update_type);
+    std::vector< std::vector<unsigned char> >().swap(run->position_slabs);
+    std::vector< std::vector<unsigned char> >().swap(run->material_slabs);
+    host_mesh.makePartition(transport->getSize(), run->halo_depth, (int)rank);
+    return launchRank(&host_mesh, run, h_return_ptr, transport);
+  }
+
+  int distributedRankMain(HaloTransport* transport, void* arg) {
+    DistributedRun* run = (DistributedRun*)arg;
+    bool root = (transport->getRank() == 0);
+    if(run->is_double)
+      run->time_per_step = runRank<double>(run, transport,
+                                           run->materials->getMaterialCoefficientPtrDouble(),
+                                           run->parameters->getParameterPtrDouble(),
+                                           root ? &(*run->responses_double)[0] : (double*)NULL);
+    else
+      run->time_per_step = runRank<float>(run, transport,
+                                          run->materials->getMaterialCoefficientPtr(),
+                                          run->parameters->getParameterPtr(),
+                                          root ? &(*run->responses)[0] : (float*)NULL);
+    return 0;
+  }
+}
+#endif
+
+void App::runSimulationDistributed(unsigned int number_of_ranks,
+                                   unsigned int transport,
+                                   unsigned int halo_depth,
+                                   double timeout) {
+  RunScope scope(this);
+#ifdef WIN32
+  log_msg<LOG_ERROR>(L"App::runSimulationDistributed - not available on Windows");
+  throw(-1);
+#else
+  this->requireStaticRun("runSimulationDistributed");
+  clock_t start_t;
+  clock_t end_t;
+  start_t = clock();
+
+  double dx = (double)this->m_parameters.getDx();
+  uint3 dim = getVoxelizationDim(this->m_geometry.getVerticePtr(),
+                                 this->m_geometry.getIndexPtr(),
+                                 this->m_geometry.getNumberOfTriangles(),
+                                 this->m_geometry.getNumberOfVertices(),
+                                 dx);
+  unsigned int num_elements = dim.x*dim.y*dim.z;
+  this->num_elements_ = num_elements;
+
+  DistributedRun run;
+  run.dim_x = dim.x;
+  run.dim_y = dim.y;
+  run.dim_z = dim.z;
+  run.halo_depth = halo_depth;
+  run.num_materials = this->m_materials.getNumberOfUniqueMaterials();
+  run.update_type = (unsigned int)this->m_parameters.getUpdateType();
+  run.is_double = this->m_mesh.isDouble();
+  run.parameters = &(this->m_parameters);
+  run.materials = &(this->m_materials);
+  run.responses = &(this->responses_);
+  run.responses_double = &(this->responses_double_);
+  run.interruptCallback = this->getInterruptHook();
+  run.progressCallback = this->getProgressHook();
+  run.time_per_step = 0.f;
+
+  // Voxelize the slices of each rank with its halos before the ranks are
+  // forked, the whole domain is never held on the device
+  std::vector< std::vector<unsigned int> > indexing =
+    HostMesh<float>::getHaloIndexing(CudaMesh::getPartitionIndexing(number_of_ranks, dim.z),
+                                     halo_depth);
+  run.position_slabs.resize(number_of_ranks);
+  run.material_slabs.resize(number_of_ranks);
+  for(unsigned int i = 0; i < number_of_ranks; i++) {
+    unsigned int first = indexing.at(i).front();
+    unsigned int count = (unsigned int)indexing.at(i).size();
+    run.first_slices.push_back(first);
+    run.position_slabs.at(i).assign((size_t)count*dim.x*dim.y, 0);
+    run.material_slabs.at(i).assign((size_t)count*dim.x*dim.y, 0);
+    voxelizeGeometrySlab(this->m_geometry.getVerticePtr(),
+                         this->m_geometry.getIndexPtr(),
+                         this->m_materials.getMaterialIdxPtr(),
+                         this->m_geometry.getNumberOfTriangles(),
+                         this->m_geometry.getNumberOfVertices(),
+                         this->m_materials.getNumberOfUniqueMaterials(),
+                         dx, first, count,
+                         &run.position_slabs.at(i)[0],
+                         &run.material_slabs.at(i)[0]);
+  }
+
+  this->beginResponses(false, false);
+
+  log_msg<LOG_INFO>(L"App::runSimulationDistributed - %u ranks, transport %u, halo depth %u")
+                    %number_of_ranks %transport %halo_depth;
+
+  int ret = launchRanks(number_of_ranks,
+                        transport == 1 ? TRANSPORT_TCP : TRANSPORT_SHM,
+                        distributedRankMain, &run, timeout);
+
+  if(ret != 0) {
+    log_msg<LOG_ERROR>(L"App::runSimulationDistributed - a rank failed");
+    throw(-1);
+  }
+  this->endResponses(false);
+
+  this->time_per_step_ = run.time_per_step;
+  end_t = clock()-start_t;
+  log_msg<LOG_INFO>(L"App::runSimulationDistributed - time: %f seconds")
+                    % ((float)end_t/CLOCKS_PER_SEC);
+  log_msg<LOG_INFO>(L"App::runSimulationDistributed - Performance Mvox/sec: %f ")
+                    % ((1.f/this->time_per_step_*num_elements)/1e6);
+#endif
+}
+
 void App::runCapture() {
+  RunScope scope(this);
   clock_t start_t;
   clock_t end_t;
   start_t = clock();
   m_mesh.setDouble(false);
   
-  this->initializeMesh(2);
+  this->prepareMesh();
 
   unsigned int step = this->m_parameters.getNumSteps();
   this->responses_.assign(m_parameters.getNumSteps()*m_parameters.getNumReceivers(), 0.f);
@@ -361,7 +1373,7 @@ void App::runCapture() {
   // Run steps
   for(unsigned int i = 0; i < step; i++) {
     this->executeStep();
-    if(this->m_interrupt())
+    if(this->getInterruptHook()())
       break;
   }
 
@@ -378,6 +1390,82 @@ void App::runCapture() {
 
 }
 
+void App::runHybrid(unsigned int output_fs, float crossover, unsigned int max_order) {
+  RunScope scope(this);
+  clock_t start_t;
+  clock_t end_t;
+  start_t = clock();
+
+  unsigned int fdtd_fs = this->m_parameters.getSpatialFs();
+  unsigned int num_steps = this->m_parameters.getNumSteps();
+  unsigned int num_receivers = this->m_parameters.getNumReceivers();
+  unsigned int num_sources = this->m_parameters.getNumSources();
+
+  // The low band is combined from the responses kept in memory
+  if(!this->response_path_.empty() && !this->keep_responses_) {
+    log_msg<LOG_ERROR>(L"App::runHybrid - the responses streamed to %s have to be kept "
+                       L"in memory, see setResponseStream()") %this->response_path_.c_str();
+    throw(-1);
+  }
+
+  for(unsigned int i = 0; i < num_sources; i++) {
+    if(this->m_parameters.getSource(i).getSourceType() == SRC_HARD)
+      log_msg<LOG_WARNING>(L"App::runHybrid - source %u is hard, "
+                           L"the level of the low band is not calibrated") %i;
+  }
+
+  // Low band
+  this->runSimulation();
+
+  // Early reflections
+  float length_in_s = (float)num_steps/(float)fdtd_fs;
+  this->hybrid_response_length_ = (unsigned int)(length_in_s*(float)output_fs);
+  unsigned int len = this->hybrid_response_length_;
+
+  ImageSourceEngine ism;
+  ism.setMaxOrder(max_order);
+  ism.setMaxTime(length_in_s);
+  ism.setC(this->m_parameters.getC());
+  ism.setCoefIdx(this->m_parameters.getOctave());
+  ism.initialize(&this->m_geometry, &this->m_materials);
+
+  std::vector< std::vector<float> > ism_responses(num_receivers, std::vector<float>(len, 0.f));
+  for(unsigned int i = 0; i < num_sources; i++) {
+    ism.computeImageSources(this->m_parameters.getSource(i).getP());
+    for(unsigned int j = 0; j < num_receivers; j++)
+      ism.getResponse(this->m_parameters.getReceiver(j).getP(), output_fs, ism_responses.at(j));
+  }
+
+  // Combine
+  HybridCombiner combiner;
+  combiner.setCrossover(crossover);
+  combiner.setOutputFs(output_fs);
+  combiner.setFdtdGain(HybridCombiner::getSoftSourceGain(this->m_parameters.getDx(),
+                                                         this->m_parameters.getC(),
+                                                         fdtd_fs, output_fs));
+
+  // The responses are at the output fs of the FDTD if one is set
+  unsigned int response_fs = this->m_parameters.getResponseFs();
+  unsigned int response_length = this->getResponseLength();
+
+  this->hybrid_responses_.assign(len*num_receivers, 0.f);
+  for(unsigned int j = 0; j < num_receivers; j++) {
+    std::vector<float> fdtd(response_length, 0.f);
+    for(unsigned int k = 0; k < response_length; k++) {
+      if(this->m_mesh.isDouble())
+        fdtd.at(k) = (float)this->getResponseDoubleSampleAt(k, j);
+      else
+        fdtd.at(k) = this->getResponseSampleAt(k, j);
+    }
+    std::vector<float> combined = combiner.combine(fdtd, response_fs, ism_responses.at(j));
+    std::copy(combined.begin(), combined.end(), this->hybrid_responses_.begin()+j*len);
+  }
+
+  end_t = clock()-start_t;
+  log_msg<LOG_INFO>(L"App::runHybrid - time: %f seconds, fdtd fs %u, output fs %u, crossover %f")
+                    % ((float)end_t/CLOCKS_PER_SEC) %fdtd_fs %output_fs %crossover;
+}
+
 ////////////////////////////////////////////////
 // Visualization controls
 ///////////////////////////////////////////////////////////////////////////////
@@ -405,6 +1493,7 @@ void App::invertTime() {
 }
 
 void App::executeStep() {
+  RunScope scope(this);
   clock_t start_t;
   clock_t end_t;
   start_t = clock();
@@ -414,7 +1503,8 @@ void App::executeStep() {
                    &this->responses_[0],  
                    this->current_step_,
                    this->step_direction_,
-                   this->m_progress);
+                   &this->past_step_direction_,
+                   this->getProgressHook());
 
   this->current_step_ += this->step_direction_;
 
@@ -423,7 +1513,7 @@ void App::executeStep() {
                    this->slice_to_capture_,
                    this->slice_orientation_,
                    this->current_step_,
-                   captureBitmap);
+                   this->getCaptureHook());
 
   captureMesh(&(this->m_mesh),
               this->mesh_to_capture_,
@@ -438,7 +1528,8 @@ void App::executeStep() {
 void App::close() {
   log_msg<LOG_INFO>(L"App::close");
   cudaSetDevice(0);
-  this->resetDevices();
+  if(CallbackSlot::getNumBound() == 0)
+    this->resetDevices();
   delete this->m_window;
 }
 
@@ -562,7 +1653,7 @@ void App::saveBitmap(float* data,
   }
 
   std::stringstream ss;
-  ss << "capture_"<<orientation<<"_"<<step<<"_"<<slice<<".tga";
+  ss << this->capture_prefix_<<"capture_"<<orientation<<"_"<<step<<"_"<<slice<<".tga";
   img->WriteImage(ss.str());
 }
 
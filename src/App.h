@@ -27,12 +27,15 @@
 #include "base/SimulationParameters.h"
 #include "base/MaterialHandler.h"
 #include "base/GeometryHandler.h"
+#include "base/ExecutionTarget.h"
+#include "base/Reciprocity.h"
+#include "base/SweepConfig.h"
+#include "base/CallbackSlot.h"
 #include "io/FileReader.h"
+#include "io/ResponseWriter.h"
+#include "io/ResultCache.h"
 #include "./kernels/cudaMesh.h"
 
-typedef bool (*InterruptCallback)(void);
-typedef void (*ProgressCallback)(int, int, float);
-
 // forward declaration
 namespace boost {
   namespace python {
@@ -55,16 +58,28 @@ public:
     m_parameters(SimulationParameters()),
     m_geometry(GeometryHandler()),
     m_materials(MaterialHandler()),
+    current_step_(0),
+    step_direction_(1),
+    past_step_direction_(1),
+    session_(false),
+    session_fs_(0),
+    session_update_type_(SRL_FORWARD),
+    session_double_(false),
     number_of_devices_(0),
     best_device_(0),
     force_partition_to_(-1),
     capture_db_(60),
     interrupt_(false),
+    progress_step_(0),
+    progress_max_step_(0),
+    response_format_(RESPONSE_RAW_FLOAT),
+    keep_responses_(true),
+    last_run_cached_(false),
+    reciprocity_(false),
     time_per_step_(0.f),
     num_elements_(0),
-    current_step_(0),
-    step_direction_(1)
-  {loggerInit();
+    hybrid_response_length_(0)
+  {loggerInitOnce();
    this->setupDefaultCallbacks();};
 
   ~App() {
@@ -87,7 +102,10 @@ public:
   
   void queryDevices();
   void resetDevices();
-  void initializeDevices();
+
+  /// Query the devices and select the best one. The devices are reset
+  /// unless reset_devices is false or other instances are running
+  void initializeDevices(bool reset_devices = true);
   void initializeMaterials(std::string material_fp);
   void initializeGeometryFromFile(std::string geometry_fp);
   
@@ -111,10 +129,79 @@ public:
   void setupDefaultCallbacks();
 
   ///////////////////////////////////////////////////////////////////////////////
-  /// Initializes the CudaMesh m_mesh field of the app class
+  /// The solvers get callbacks bound to this instance during a run, which
+  /// check interrupt() and record the progress before calling m_interrupt
+  /// and m_progress. The instances can run concurrently in one process,
+  /// see runConcurrently().
+
+  /// Stop the current run of this instance, or the next one if it is not
+  /// running. Can be called from any thread
+  void interrupt() {this->interrupt_ = true;}
+  bool isInterrupted() const {return this->interrupt_;}
+
+  /// The step and the number of steps reported by the current or the last run
+  int getProgressStep() const {return this->progress_step_;}
+  int getProgressMaxStep() const {return this->progress_max_step_;}
+
+  ///////////////////////////////////////////////////////////////////////////////
+  /// \brief Log the messages of the runs of this instance to a file of its
+  /// own instead of solver_log.txt. The messages of the worker threads of
+  /// the host solvers still go to solver_log.txt.
+  /// \param path The log file, truncated. Empty for solver_log.txt
+  ///////////////////////////////////////////////////////////////////////////////
+  void setLogFile(std::string path);
+
+  /// Prefix of the images written by the slice captures of this instance
+  void setCapturePrefix(std::string prefix) {this->capture_prefix_ = prefix;}
+
+  ///////////////////////////////////////////////////////////////////////////////
+  /// \brief Run runSimulationHost() of several instances at once on the
+  /// thread pool of the process. Each instance needs its geometry and
+  /// parameters set, initializeDevices() must not be called while the
+  /// instances run.
+  /// \param apps The instances
+  /// \param threads_per_app The threads updating each instance, with the
+  ///  default of 1 the pool runs as many instances at once as the machine
+  ///  has hardware threads
+  /// \return The number of instances whose run failed
+  ///////////////////////////////////////////////////////////////////////////////
+  static unsigned int runConcurrently(const std::vector<App*>& apps,
+                                      unsigned int threads_per_app = 1);
+
+  ///////////////////////////////////////////////////////////////////////////////
+  /// Initializes the CudaMesh m_mesh field of the app class. The mesh is
+  /// divided on as few devices as its memory allows, the slices are
+  /// balanced between the devices with PartitionPlanner according to the
+  /// air and boundary nodes of each slice and the throughput of each device
   /// \param[in] number_of_partitions On how many devices the mesh is divided
+  /// if it does not fit a single device
   ///////////////////////////////////////////////////////////////////////////////
   void initializeMesh(unsigned int number_of_partitions);
+
+  ///////////////////////////////////////////////////////////////////////////////
+  /// \brief Voxelize and partition the mesh once for a series of runs.
+  /// While the session is open runSimulation() and runCapture() reset the
+  /// pressures of the mesh instead of building it again, so only the
+  /// sources, receivers and the number of steps should change between the
+  /// runs. A change of the spatial fs, the update type or the precision
+  /// builds the mesh again. The other solvers, initializeMesh() and the
+  /// geometry and material setters close the session, so do call
+  /// closeSession() after changing m_geometry or m_materials directly.
+  ///////////////////////////////////////////////////////////////////////////////
+  void prepareSession();
+  void closeSession() {this->session_ = false;}
+  bool isSessionPrepared() const {return this->session_;}
+
+  ///////////////////////////////////////////////////////////////////////////////
+  /// \brief Run a set of source and receiver configurations against one
+  /// mesh with runSimulation(). The session is prepared if it is not open,
+  /// and closed after the sweep in that case. The parameters are restored
+  /// after the sweep.
+  /// \param configs The runs
+  /// \return The responses of each run, receiver-major as in
+  /// getResponseSampleAt()
+  ///////////////////////////////////////////////////////////////////////////////
+  std::vector< std::vector<double> > runSweep(const std::vector<SweepConfig>& configs);
   
   ///////////////////////////////////////////////////////////////////////////////
   /// Initializes an Open GL window for visualization
@@ -129,7 +216,8 @@ public:
   ///////////////////////////////////////////////////////////////////////////////
   /// Run the simulation without visualization and without captures.
   /// Simulation is run for predetermined number of steps. No captures are made
-  /// even if assigned
+  /// even if assigned. In the reciprocity mode the response of each
+  /// source-receiver pair is run separately, see setReciprocity()
   ///////////////////////////////////////////////////////////////////////////////
   void runSimulation();
   
@@ -145,9 +233,118 @@ public:
   /// if assigned
   ///////////////////////////////////////////////////////////////////////////
   void runCapture();
+
+  ///////////////////////////////////////////////////////////////////////////
+  /// Run a hybrid simulation. The FDTD is run at the current spatial fs for
+  /// the low frequencies and the image source method gives the early
+  /// reflections above the crossover. The two are combined for each receiver
+  /// with a Linkwitz-Riley crossover. The level of the FDTD part assumes
+  /// soft or transparent impulse sources. With setOutputFs() the FDTD part
+  /// is taken from the resampled responses. Throws if the responses are
+  /// streamed to a file and not kept, see setResponseStream().
+  /// \param output_fs The sampling frequency of the combined responses
+  /// \param crossover The crossover frequency in Hz, should be well below
+  ///  the valid band of the FDTD scheme
+  /// \param max_order The maximum reflection order of the image sources
+  ///////////////////////////////////////////////////////////////////////////
+  void runHybrid(unsigned int output_fs, float crossover, unsigned int max_order);
+
+  ///////////////////////////////////////////////////////////////////////////
+  /// Run the simulation on the CPU. The geometry is voxelized as in
+  /// runSimulation(), after which the domain is copied to the host and split
+  /// into partitions along z. Each partition is stepped by its own group of
+  /// threads, the neighbouring partitions exchange their border slices
+  /// without a global barrier between the steps.
+  /// \param number_of_partitions The number of partitions along z
+  /// \param threads_per_partition The number of threads updating each partition
+  /// \param halo_depth The number of ghost slices of each partition. The
+  ///  ghost slices are updated redundantly and the partitions exchange them
+  ///  only every halo_depth steps
+  ///////////////////////////////////////////////////////////////////////////
+  void runSimulationHost(unsigned int number_of_partitions,
+                         unsigned int threads_per_partition,
+                         unsigned int halo_depth = 1);
+
+  ///////////////////////////////////////////////////////////////////////////
+  /// Run the simulation on the CPU with the domain split into blocks along
+  /// x, y and z. Unlike the slabs of runSimulationHost(), the blocks suit
+  /// wide and low domains and are not limited to dim_z workers. The grid
+  /// of blocks is chosen to minimize the halo traffic, see
+  /// HostBlockMesh::chooseShape(). Throws on the features listed in
+  /// requireStaticRun().
+  /// \param number_of_blocks The number of blocks, each updated by one thread
+  ///////////////////////////////////////////////////////////////////////////
+  void runSimulationHostBlocks(unsigned int number_of_blocks);
+
+  ///////////////////////////////////////////////////////////////////////////
+  /// Run the simulation with the partitions spread over a mix of CUDA
+  /// devices and groups of CPU threads, see addHostTarget() and
+  /// addDeviceTarget(). The domain is voxelized and copied to the host as in
+  /// runSimulationHost(), and the slices are split between the targets with
+  /// PartitionPlanner according to their throughput. The device targets
+  /// exchange their halos with the neighbours through host memory.
+  /// \param halo_depth The number of ghost slices of each partition
+  ///////////////////////////////////////////////////////////////////////////
+  void runSimulationTargets(unsigned int halo_depth = 1);
+
+  ///////////////////////////////////////////////////////////////////////////
+  /// Run the simulation on the CPU with the domain spread over the NUMA
+  /// nodes of the machine. Each node gets partitions_per_node partitions
+  /// sized by its number of CPUs, the workers of a partition are pinned to
+  /// its node and the partition memory is bound to the node and first
+  /// written by those workers. The bandwidth used on each node is
+  /// available from getNodeBandwidth() after the run.
+  /// \param partitions_per_node The number of partitions on each node, the
+  ///  CPUs of the node are split between them
+  /// \param huge_pages Back the partitions with transparent huge pages
+  /// \param halo_depth The number of ghost slices of each partition
+  ///////////////////////////////////////////////////////////////////////////
+  void runSimulationHostNuma(unsigned int partitions_per_node = 1,
+                             bool huge_pages = false,
+                             unsigned int halo_depth = 1);
+
+  ///////////////////////////////////////////////////////////////////////////
+  /// Run the simulation on the CPU with the domain kept in memory mapped
+  /// files, for domains which do not fit in the main memory. The geometry
+  /// is voxelized straight to the files a slab at a time, neither the host
+  /// nor the device holds the whole domain. The solver then sweeps the
+  /// domain in z-slabs, taking time_block steps on each slab before it is
+  /// written back, see launchFDTD3dHostStream(). Throws on the features
+  /// listed in requireStaticRun().
+  /// \param path_prefix The path and the beginning of the names of the
+  ///  files, the files are removed after the run
+  /// \param slab_slices The number of slices in a slab
+  /// \param time_block The number of steps taken on a slab at a time
+  /// \param threads The number of threads updating a slab, 0 for all cores
+  ///////////////////////////////////////////////////////////////////////////
+  void runSimulationOutOfCore(const std::string& path_prefix,
+                              unsigned int slab_slices = 64,
+                              unsigned int time_block = 4,
+                              unsigned int threads = 0);
+
+  ///////////////////////////////////////////////////////////////////////////
+  /// Run the simulation on the CPU in several processes. The slices of each
+  /// partition along z are voxelized to the host a slice at a time, after
+  /// which ranks 1..N-1 are forked and each rank sets up and steps only its
+  /// own partition. The ranks exchange their halos through shared memory
+  /// or TCP sockets on the local machine, rank 0 runs in this process and
+  /// collects the responses. Not available on Windows. Throws on the
+  /// features listed in requireStaticRun().
+  /// \param number_of_ranks The number of processes and partitions
+  /// \param transport 0 for shared memory, 1 for TCP
+  /// \param halo_depth The number of ghost slices of each partition, the
+  ///  ranks exchange them every halo_depth steps
+  /// \param timeout Seconds a rank waits for its neighbours before the run
+  ///  fails
+  ///////////////////////////////////////////////////////////////////////////
+  void runSimulationDistributed(unsigned int number_of_ranks,
+                                unsigned int transport,
+                                unsigned int halo_depth = 1,
+                                double timeout = 60.0);
   
   ///////////////////////////////////////////////////////////////////////////
-  /// \brief Cleanup function for App clas
+  /// \brief Cleanup function for App clas. The devices are not reset
+  /// while other instances are running
   ///////////////////////////////////////////////////////////////////////////
   void close();
 
@@ -202,6 +399,17 @@ public:
   ///////////////////////////////////////////////////////////////////////////
   unsigned int getNumElements() {return this->num_elements_;}
   
+  ///////////////////////////////////////////////////////////////////////////
+  /// \return The number of samples in the response of a receiver, fewer
+  /// than the steps if the responses are resampled, see setOutputFs()
+  ///////////////////////////////////////////////////////////////////////////
+  unsigned int getResponseLength() {
+    unsigned int num_receivers = this->m_parameters.getNumReceivers();
+    if(num_receivers == 0)
+      return 0;
+    return this->getResponseSize()/num_receivers;
+  }
+
   ///////////////////////////////////////////////////////////////////////////
   /// Get the number of samples in the response
   ///////////////////////////////////////////////////////////////////////////
@@ -227,15 +435,26 @@ public:
   /// \return A single precision pressure sample of receiver rec at time index step
   ///////////////////////////////////////////////////////////////////////////
   float getResponseSampleAt(unsigned int step, unsigned int rec) {
-    return this->responses_.at(this->m_parameters.getNumSteps()*rec+step);}
+    return this->responses_.at((size_t)this->getResponseLength()*rec+step);}
 
   ///////////////////////////////////////////////////////////////////////////
   /// \return A double precision pressure sample of receiver rec at time index step. 
   ///////////////////////////////////////////////////////////////////////////
   double getResponseDoubleSampleAt(unsigned int step, unsigned int rec) {
-    return this->responses_double_.at(this->m_parameters.getNumSteps()*rec+step);
+    return this->responses_double_.at((size_t)this->getResponseLength()*rec+step);
   }
 
+  ///////////////////////////////////////////////////////////////////////////
+  /// \return The number of samples in each response of runHybrid()
+  ///////////////////////////////////////////////////////////////////////////
+  unsigned int getHybridResponseLength() {return this->hybrid_response_length_;}
+
+  ///////////////////////////////////////////////////////////////////////////
+  /// \return A sample of the combined response of receiver rec at index step
+  ///////////////////////////////////////////////////////////////////////////
+  float getHybridResponseSampleAt(unsigned int step, unsigned int rec) {
+    return this->hybrid_responses_.at(this->hybrid_response_length_*rec+step);}
+
   ///////////////////////////////////////////////////////////////////////////    
   /// \return A pointer to a mesh capture at index i
   ///////////////////////////////////////////////////////////////////////////
@@ -313,8 +532,17 @@ public:
   
   unsigned int current_step_;                  ///< Current step of the simulation
   int step_direction_;                        ///< Direction of step 1 forward, -1 backward
+  int past_step_direction_;                   ///< Direction of the previous step
 
 private:
+  /// Build the mesh for a run, or reset the pressures of the session mesh
+  void prepareMesh();
+
+  bool session_;                                ///< The mesh is kept between runs
+  unsigned int session_fs_;                     ///< The spatial fs of the session mesh
+  enum UpdateType session_update_type_;
+  bool session_double_;
+
   std::vector<unsigned int> step_to_capture_;   ///< List of step numbers when a capture is executed
   std::vector<unsigned int> slice_to_capture_;  ///< List of slice indices which is captured
   std::vector<unsigned int> slice_orientation_;  ///< List of orientation indicating which plane is capture
@@ -323,24 +551,137 @@ private:
   int number_of_devices_;                     ///< Number of devices available, set in initializeDevices() 
   int best_device_;                            ///< Device index of the most suitable device, set in initializeDevices()
   std::vector<int> device_mem_sizes_;         ///< Amount of memory in MB in the available devices
+  std::vector<float> device_throughputs_;     ///< Estimated throughput of the available devices in Mvox/s
+  std::vector<float> measured_throughputs_;   ///< Measured throughput of the devices in Mvox/s, 0 until run
+  std::vector<ExecutionTarget> targets_;      ///< Targets of runSimulationTargets()
+  std::vector<float> node_bandwidths_;        ///< GB/s used on each NUMA node on the last run
   int force_partition_to_;                    ///< Force the solver to use specific number of partitions
   float capture_db_;                          ///< The dynamic range of the captured image
-  bool interrupt_;                             ///< Indicating if interrupt has been called
+  volatile bool interrupt_;                    ///< Indicating if interrupt has been called
+  volatile int progress_step_;                 ///< Last step reported by the solver
+  volatile int progress_max_step_;
+
+  std::string capture_prefix_;                 ///< Prefix of the captured images
+  boost::shared_ptr<LogSink> log_sink_;        ///< Log of the instance, NULL for the default
+  boost::shared_ptr<CallbackSlot> callbacks_;  ///< Callbacks of the current run
+
+  ///////////////////////////////////////////////////////////////////////////
+  /// \brief Binds the callbacks and the log of the instance for the
+  /// duration of a run on the calling thread. A nested scope keeps the
+  /// binding of the outer one.
+  ///////////////////////////////////////////////////////////////////////////
+  class RunScope {
+  public:
+    RunScope(App* app);
+    ~RunScope();
+  private:
+    App* app_;
+    bool outer_;
+    LogSink* previous_sink_;
+  };
+  friend class RunScope;
+
+  InterruptCallback getInterruptHook() const;
+  ProgressCallback getProgressHook() const;
+  CaptureCallback getCaptureHook() const;
+
+  static bool interruptHandler(void* context);
+  static void progressHandler(void* context, int step, int max_step, float t_per_step);
+  static void captureHandler(void* context, float* data, unsigned char* position_data,
+                             unsigned int dim_x, unsigned int dim_y,
+                             unsigned int slice, unsigned int orientation,
+                             unsigned int step);
   
   // Result variables
   std::vector< float > responses_;            ///< Response values at receivers
   std::vector< double > responses_double_;    ///< Response values when using double precision
+  std::vector< float > hybrid_responses_;     ///< Combined responses of runHybrid()
   std::vector< float* > mesh_captures_;        ///< Captures of the whole mesh that have been done
+
+  ///////////////////////////////////////////////////////////////////////////
+  /// \brief Run the partitions of the domain on a set of targets, see
+  /// runSimulationTargets()
+  /// \param huge_pages Back the host partitions with huge pages when
+  ///  the targets are pinned to NUMA nodes
+  ///////////////////////////////////////////////////////////////////////////
+  void runTargets(std::vector<ExecutionTarget> targets,
+                  unsigned int halo_depth,
+                  bool huge_pages);
+
+  ///////////////////////////////////////////////////////////////////////////
+  /// \brief Open the response file of a run and size the responses in
+  /// memory, which are left empty when they are only streamed
+  /// \param streamed True if the solver streams to the writer, otherwise the
+  /// responses are kept and written by endResponses()
+  /// \param resampled True if the responses are at the output fs of the
+  /// parameters, otherwise at the spatial fs
+  ///////////////////////////////////////////////////////////////////////////
+  void beginResponses(bool streamed, bool resampled);
+
+  ///////////////////////////////////////////////////////////////////////////
+  /// \brief Throw before the mesh is built if the run needs a feature which
+  /// the solver does not have: array sources, moving sources and receivers,
+  /// B-format receivers or responses resampled to an output fs
+  /// \param solver The name of the solver in the log
+  ///////////////////////////////////////////////////////////////////////////
+  void requireStaticRun(const char* solver);
+
+  /// Write the kept responses if the solver did not stream them and close
+  /// the response file, throws if the file could not be written
+  void endResponses(bool streamed);
+  float* getResponseTarget()
+    {return this->responses_.empty() ? (float*)NULL : &this->responses_[0];}
+  double* getResponseTargetDouble()
+    {return this->responses_double_.empty() ? (double*)NULL : &this->responses_double_[0];}
+
+  std::string response_path_;                  ///< File of setResponseStream(), empty for none
+  int response_format_;                        ///< ResponseFormat of the file
+  bool keep_responses_;                        ///< Keep the streamed responses in memory
+  boost::shared_ptr<ResponseWriter> response_writer_;
+
+  ///////////////////////////////////////////////////////////////////////////
+  /// \brief Return the cached responses of a run: fill the responses and
+  /// write the response file as the run would have
+  /// \param key The key of the run, empty when the run is not cached
+  /// \return false if the result is not in the cache
+  ///////////////////////////////////////////////////////////////////////////
+  bool loadCachedResult(const std::string& key);
+
+  /// Store the responses of a completed run
+  void storeCachedResult(const std::string& key);
+
+  boost::shared_ptr<ResultCache> result_cache_; ///< Cache of setResultCache(), NULL for none
+  bool last_run_cached_;                       ///< The last run was read from the cache
+
+  ///////////////////////////////////////////////////////////////////////////
+  /// \brief The runs of runSimulation() in the reciprocity mode, the
+  /// responses are the sum over the sources as in a regular run
+  ///////////////////////////////////////////////////////////////////////////
+  void runReciprocal();
+
+  bool reciprocity_;                           ///< Run the pairs in runSimulation()
+  boost::shared_ptr<ReciprocityPlan> pair_plan_; ///< Pair responses of the last run
   
   // Return values to Matlab
   float time_per_step_;                        ///< Average time taken for a simulation step
   unsigned int num_elements_;                  ///< Number of elements
+  unsigned int hybrid_response_length_;        ///< Length of each hybrid response
 
   
 public:
   ///////////////////////////////////////////////////////////////////////////////
   // Functions used to bind the FDTD::App class with python via Boost Python
   
+  // Each config is a dict with the keys "sources", a list of
+  // [x, y, z, type, input_type, input_data_idx], "receivers", a list of
+  // [x, y, z], and optionally "steps". Returns a list of the responses of
+  // each run, a list per receiver
+  boost::python::list runSweepPy(boost::python::list configs);
+
+  // The apps are FDTD::App objects
+  static unsigned int runConcurrentlyPy(boost::python::list apps,
+                                        unsigned int threads_per_app);
+
   void initializeGeometryPy(boost::python::list indices,
                             boost::python::list vertices);
 
@@ -351,38 +692,231 @@ public:
     this->m_parameters.addSource(Source(x, y, z, (enum SrcType)type, (enum  InputType)signal, input_signal_idx));
   };
 
+  // Returns the index of the array, the nodes are added to the index
+  unsigned int addArraySource(int signal, int input_signal_idx) {
+    this->m_parameters.addArraySource(ArraySource((enum InputType)signal, input_signal_idx));
+    return this->m_parameters.getNumArraySources()-1;
+  };
+
+  void addArraySourceNode(unsigned int array_idx, float x, float y, float z,
+                          float gain, float delay) {
+    this->m_parameters.addArraySourceNode(array_idx, x, y, z, gain, delay);
+  };
+
+  // Signal files for DATA_STREAM sources, format is an InputStreamFormat.
+  // Returns false if the file can not be read
+  bool addInputStream(std::string path, int format, unsigned int channel = 0) {
+    return this->m_parameters.addInputStream(path, (enum InputStreamFormat)format, channel);
+  };
+
+  ///////////////////////////////////////////////////////////////////////////
+  /// \brief Write the receiver responses of the following runs to a file,
+  /// one channel per receiver. runSimulation(), runSimulationHost(),
+  /// runSimulationTargets() and runSimulationHostNuma() stream the responses
+  /// while they run. runSimulationHostBlocks(), runSimulationOutOfCore(),
+  /// runSimulationDistributed() and the pairs of setReciprocity() write them
+  /// at the end of the run. runHybrid() writes the responses of its FDTD
+  /// run, not the combined ones
+  /// \param path The path of the file, rewritten by each run. An empty path
+  /// stops the writing
+  /// \param format A ResponseFormat, 0: raw float32, 1: raw float64,
+  /// 2: 32 bit float WAV
+  /// \param keep_responses Keep the responses in memory as well, without
+  /// them getResponseSampleAt() is not available after a streamed run
+  ///////////////////////////////////////////////////////////////////////////
+  void setResponseStream(std::string path, int format, bool keep_responses = true) {
+    this->response_path_ = path;
+    this->response_format_ = format;
+    this->keep_responses_ = keep_responses;
+  };
+
+  ///////////////////////////////////////////////////////////////////////////
+  /// \brief Keep the responses of runSimulation() and runSimulationHost()
+  /// in a cache on the local disk. A run with the same geometry, materials,
+  /// precision and parameters as a cached run returns the cached responses
+  /// without voxelizing or running the solver. The least recently used
+  /// results are removed when the cache grows over its size.
+  ///
+  /// Runs with receiver grids, in the reciprocity mode or with responses
+  /// which are only streamed are not cached.
+  /// \param dir The directory of the cache, an empty path disables the cache
+  /// \param max_megabytes The size of the cache
+  ///////////////////////////////////////////////////////////////////////////
+  void setResultCache(std::string dir, double max_megabytes = 1024.0);
+
+  ///////////////////////////////////////////////////////////////////////////
+  /// \brief The key of the current state in the result cache, a digest of
+  /// the geometry, the materials, the precision and the simulation
+  /// parameters
+  /// \param solver The solver of the run, "cuda" or "host"
+  /// \return The key, empty if the state can not be cached
+  ///////////////////////////////////////////////////////////////////////////
+  std::string getResultKey(std::string solver);
+
+  /// True if the last runSimulation() or runSimulationHost() returned
+  /// cached responses
+  bool isLastRunCached() const {return this->last_run_cached_;}
+
+  ///////////////////////////////////////////////////////////////////////////
+  /// \brief Record the response of each source-receiver pair in
+  /// runSimulation(). With more sources than receivers the receivers are
+  /// run as impulse sources and recorded at the source positions, so the
+  /// pairs take one run per receiver instead of one per source. The
+  /// responses are convolved with the input signals of the sources and
+  /// returned in the original indexing by getPairResponse().
+  ///
+  /// Runs with hard or array sources, moving positions, B-format receivers
+  /// or receiver grids can not be split and are run as usual.
+  ///////////////////////////////////////////////////////////////////////////
+  void setReciprocity(bool reciprocity) {this->reciprocity_ = reciprocity;};
+
+  ///////////////////////////////////////////////////////////////////////////
+  /// \return The response of a source-receiver pair of the last run in the
+  /// reciprocity mode, empty if there is none
+  ///////////////////////////////////////////////////////////////////////////
+  std::vector<double> getPairResponse(unsigned int source, unsigned int receiver) {
+    if(!this->pair_plan_)
+      return std::vector<double>();
+    return this->pair_plan_->getPairResponse(source, receiver);
+  };
+
   void addReceiver(float x, float y, float z) {
     this->m_parameters.addReceiver(x, y, z);
   };
 
+  // A first order B-format receiver, recorded as the receivers W, X, Y and
+  // Z by runSimulation(), runSimulationHost() and runSimulationTargets().
+  // Returns the index of W
+  unsigned int addBFormatReceiver(float x, float y, float z) {
+    return this->m_parameters.addBFormatReceiver(x, y, z);
+  };
+
+  ///////////////////////////////////////////////////////////////////////////
+  /// \brief Add receivers on a regular sub-grid of a region, recorded by
+  /// runSimulation(), runSimulationHost() and runSimulationTargets()
+  /// \param min_x, min_y, min_z, max_x, max_y, max_z The region in meters
+  /// \param stride The distance of the points in meters
+  /// \param encoding A GridEncoding, 0: float32, 1: float16, 2: lossless
+  /// delta coded float32
+  /// \param decimation The number of steps averaged to a sample
+  /// \return The index of the grid
+  ///////////////////////////////////////////////////////////////////////////
+  unsigned int addReceiverGrid(float min_x, float min_y, float min_z,
+                               float max_x, float max_y, float max_z,
+                               float stride, int encoding = GRID_FLOAT16,
+                               unsigned int decimation = 1) {
+    this->m_parameters.addReceiverGrid(ReceiverGrid(min_x, min_y, min_z, max_x, max_y, max_z,
+                                                    stride, (enum GridEncoding)encoding,
+                                                    decimation));
+    return this->m_parameters.getNumReceiverGrids()-1;
+  };
+
+  void clearReceiverGrids() {this->m_parameters.clearReceiverGrids();};
+
+  // The points of a grid are known after a run
+  unsigned int getReceiverGridNumPoints(unsigned int grid) {
+    return this->m_parameters.getReceiverGrid(grid).getNumPoints();
+  };
+
+  std::vector<float> getReceiverGridResponse(unsigned int grid, unsigned int point) {
+    return this->m_parameters.getReceiverGrid(grid).getResponse(point);
+  };
+
+  // Moving sources and receivers, the time of a waypoint is in steps
+  void addSourceWaypoint(unsigned int source_idx, float step, float x, float y, float z) {
+    this->m_parameters.addSourceWaypoint(source_idx, step, x, y, z);
+  };
+
+  void addReceiverWaypoint(unsigned int receiver_idx, float step, float x, float y, float z) {
+    this->m_parameters.addReceiverWaypoint(receiver_idx, step, x, y, z);
+  };
+
   void setSpatialFs(unsigned int fs) {this->m_parameters.setSpatialFs(fs);};
   void setNumSteps(unsigned int num) {this->m_parameters.setNumSteps(num);};
+
+  // Resample the responses of runSimulation(), runSimulationHost() and
+  // runSimulationTargets() to output_fs while they are recorded, 0 keeps
+  // the spatial fs. The band limit is relative to the spatial fs, 0 for
+  // the valid band of the update type
+  void setOutputFs(unsigned int output_fs, double band_limit = 0.0) {
+    this->m_parameters.setOutputFs(output_fs, band_limit);
+  };
   void setUpdateType(int i) {this->m_parameters.setUpdateType((enum UpdateType)i);};
+  void generateGridIr(unsigned int length, bool double_precision = false,
+                      std::string cache_dir = "./Data") {
+    this->m_parameters.generateGridIr(length, double_precision, cache_dir);
+  };
   void setUniformMaterial(float R) {
     this->m_materials.setGlobalMaterial(this->m_geometry.getNumberOfTriangles(), 
                                         reflection2Admitance(R));
+    this->closeSession();
   }
 
   std::vector<float> getResponse(unsigned int rec) {
-    std::vector<float> ret(this->m_parameters.getNumSteps(), 0.f); 
-    for(unsigned int i = 0; i < this->m_parameters.getNumSteps(); i++) {
+    std::vector<float> ret(this->getResponseLength(), 0.f); 
+    for(unsigned int i = 0; i < this->getResponseLength(); i++) {
       ret.at(i) = this->getResponseSampleAt(i, rec);
     }
     return ret;
   }
 
   std::vector<double> getResponseDouble(unsigned int rec) {
-    std::vector<double> ret(this->m_parameters.getNumSteps(), 0.f); 
-    for(unsigned int i = 0; i < this->m_parameters.getNumSteps(); i++) {
+    std::vector<double> ret(this->getResponseLength(), 0.f); 
+    for(unsigned int i = 0; i < this->getResponseLength(); i++) {
       ret.at(i) = this->getResponseDoubleSampleAt(i, rec);
     }
     return ret;
   }
 
+  std::vector<float> getHybridResponse(unsigned int rec) {
+    std::vector<float> ret(this->hybrid_response_length_, 0.f);
+    for(unsigned int i = 0; i < this->hybrid_response_length_; i++) {
+      ret.at(i) = this->getHybridResponseSampleAt(i, rec);
+    }
+    return ret;
+  }
+
   void setDouble(bool set_to) {this->m_mesh.setDouble(set_to);}
 
   void setForcePartitionTo(int num_partitions) {this->force_partition_to_ = num_partitions;}  
 
+  /// \brief Set the measured throughput of a device in Mvox/s, used to
+  /// balance the partitions between the devices. The estimates of the
+  /// devices not measured are scaled to match, see getDeviceThroughputs()
+  void setDeviceThroughput(int device, float mvox_per_sec) {
+    if(device >= 0 && device < (int)this->measured_throughputs_.size())
+      this->measured_throughputs_.at(device) = mvox_per_sec;
+  }
+
+  /// \return The throughput of each device in Mvox/s, measured or the
+  /// estimate calibrated with the measurements
+  std::vector<float> getDeviceThroughputs();
+
+  /// \brief Add a group of CPU threads as a target of runSimulationTargets()
+  /// \param throughput The weight of the target in Mvox/s, measured with
+  /// estimateHostThroughput() if 0
+  void addHostTarget(unsigned int threads, float throughput = 0.f) {
+    this->targets_.push_back(makeHostTarget(threads, throughput));
+  }
+
+  /// \brief Add a CUDA device as a target of runSimulationTargets()
+  /// \param throughput The weight of the target in Mvox/s, the estimate of
+  /// the device if 0
+  void addDeviceTarget(int device, float throughput = 0.f) {
+    this->targets_.push_back(makeDeviceTarget(device, throughput, 0.f));
+  }
+
+  void clearTargets() {this->targets_.clear();}
+
+  /// \return The number of NUMA nodes reported by the last host run
+  unsigned int getNumberOfNodeBandwidths() {return (unsigned int)this->node_bandwidths_.size();}
+
+  /// \return The estimated memory bandwidth in GB/s used by the pinned
+  /// workers of a NUMA node on the last host run
+  float getNodeBandwidth(unsigned int node) {
+    return node < this->node_bandwidths_.size() ? this->node_bandwidths_.at(node) : 0.f;
+  }
+
   void addSurfaceMaterials(boost::python::list material_coefficients,
                            unsigned int number_of_surfaces,
                            unsigned int number_of_coefficients);
@@ -41,6 +41,7 @@ void FDTD::App::initializeGeometryPy(boost::python::list indices,
     std_indices.at(i) = boost::python::extract<unsigned int>(indices[i]);
 
   this->m_geometry.initialize(std_indices, std_vertices);
+  this->closeSession();
 }
 
 void FDTD::App::setLayerIndicesPy(boost::python::list indices,
@@ -51,6 +52,7 @@ void FDTD::App::setLayerIndicesPy(boost::python::list indices,
     std_indices.at(i) = boost::python::extract<int>(indices[i]);
 
   this->m_geometry.setLayerIndices(std_indices, name);
+  this->closeSession();
 }
 
 void FDTD::App::addSurfaceMaterials(boost::python::list material_coefficients,
@@ -64,6 +66,7 @@ void FDTD::App::addSurfaceMaterials(boost::python::list material_coefficients,
   this->m_materials.addMaterials(&std_mat[0], 
                                  number_of_surfaces, 
                                  number_of_coefficients);
+  this->closeSession();
 }
 
 void FDTD::App::addSourceDataFloat(boost::python::list src_data,
@@ -92,6 +95,83 @@ void FDTD::App::addSourceDataDouble(boost::python::list src_data,
   this->m_parameters.addInputDataDouble(std_src_data);
 }
 
+boost::python::list FDTD::App::runSweepPy(boost::python::list configs) {
+  int c_len = (int)boost::python::len(configs);
+  std::vector<SweepConfig> std_configs(c_len);
+  for(int i = 0; i < c_len; i++) {
+    boost::python::dict config = boost::python::extract<boost::python::dict>(configs[i]);
+    SweepConfig& c = std_configs.at(i);
+
+    boost::python::list sources = boost::python::extract<boost::python::list>(config.get("sources", boost::python::list()));
+    for(int j = 0; j < (int)boost::python::len(sources); j++) {
+      boost::python::object s = sources[j];
+      c.addSource(Source(boost::python::extract<float>(s[0]),
+                         boost::python::extract<float>(s[1]),
+                         boost::python::extract<float>(s[2]),
+                         (enum SrcType)(int)boost::python::extract<int>(s[3]),
+                         (enum InputType)(int)boost::python::extract<int>(s[4]),
+                         boost::python::extract<int>(s[5])));
+    }
+
+    boost::python::list receivers = boost::python::extract<boost::python::list>(config.get("receivers", boost::python::list()));
+    for(int j = 0; j < (int)boost::python::len(receivers); j++) {
+      boost::python::object r = receivers[j];
+      c.addReceiver(boost::python::extract<float>(r[0]),
+                    boost::python::extract<float>(r[1]),
+                    boost::python::extract<float>(r[2]));
+    }
+
+    c.num_steps = boost::python::extract<unsigned int>(config.get("steps", 0));
+  }
+
+  std::vector< std::vector<double> > responses = this->runSweep(std_configs);
+
+  boost::python::list ret;
+  for(unsigned int i = 0; i < responses.size(); i++) {
+    unsigned int num_receivers = (unsigned int)std_configs.at(i).receivers.size();
+    unsigned int len = num_receivers > 0 ? (unsigned int)responses.at(i).size()/num_receivers : 0;
+    boost::python::list run;
+    for(unsigned int j = 0; j < num_receivers; j++) {
+      boost::python::list response;
+      for(unsigned int k = 0; k < len; k++)
+        response.append(responses.at(i).at(j*len+k));
+      run.append(response);
+    }
+    ret.append(run);
+  }
+  return ret;
+}
+
+unsigned int FDTD::App::runConcurrentlyPy(boost::python::list apps,
+                                          unsigned int threads_per_app) {
+  int a_len = (int)boost::python::len(apps);
+  std::vector<FDTD::App*> std_apps(a_len, (FDTD::App*)NULL);
+  for(int i = 0; i < a_len; i++)
+    std_apps.at(i) = &boost::python::extract<FDTD::App&>(apps[i])();
+
+  // The runs do not call Python, other Python threads can run meanwhile,
+  // for example to interrupt the apps
+  PyThreadState* state = PyEval_SaveThread();
+  unsigned int failed = FDTD::App::runConcurrently(std_apps, threads_per_app);
+  PyEval_RestoreThread(state);
+  return failed;
+}
+
+
+BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(initializeDevices_overloads, initializeDevices, 0, 1)
+BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(generateGridIr_overloads, generateGridIr, 1, 3)
+BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(addInputStream_overloads, addInputStream, 2, 3)
+BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(setResponseStream_overloads, setResponseStream, 2, 3)
+BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(setResultCache_overloads, setResultCache, 1, 2)
+BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(addReceiverGrid_overloads, addReceiverGrid, 7, 9)
+BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(setOutputFs_overloads, setOutputFs, 1, 2)
+BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(runSimulationHost_overloads, runSimulationHost, 2, 3)
+BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(runSimulationDistributed_overloads, runSimulationDistributed, 2, 4)
+BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(runSimulationTargets_overloads, runSimulationTargets, 0, 1)
+BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(addHostTarget_overloads, addHostTarget, 1, 2)
+BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(addDeviceTarget_overloads, addDeviceTarget, 1, 2)
+BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(runSimulationHostNuma_overloads, runSimulationHostNuma, 0, 3)
+BOOST_PYTHON_MEMBER_FUNCTION_OVERLOADS(runSimulationOutOfCore_overloads, runSimulationOutOfCore, 1, 4)
 
 BOOST_PYTHON_MODULE(libPyFDTD) {
 
@@ -104,25 +184,69 @@ BOOST_PYTHON_MODULE(libPyFDTD) {
     ;
 
   class_<FDTD::App>("App") 
-    .def("initializeDevices", &FDTD::App::initializeDevices)  
+    .def("initializeDevices", &FDTD::App::initializeDevices, initializeDevices_overloads())  
     .def("initializeGeometryFromFile", &FDTD::App::initializeGeometryFromFile)
     .def("initializeGeometryPy", &FDTD::App::initializeGeometryPy)
     .def("setLayerIndices", &FDTD::App::setLayerIndicesPy)
     .def("addSource", &FDTD::App::addSource)
     .def("addSourceDataFloat", &FDTD::App::addSourceDataFloat)
     .def("addSourceDataDouble", &FDTD::App::addSourceDataDouble)
+    .def("addInputStream", &FDTD::App::addInputStream, addInputStream_overloads())
+    .def("setResponseStream", &FDTD::App::setResponseStream, setResponseStream_overloads())
+    .def("setResultCache", &FDTD::App::setResultCache, setResultCache_overloads())
+    .def("getResultKey", &FDTD::App::getResultKey)
+    .def("isLastRunCached", &FDTD::App::isLastRunCached)
+    .def("setReciprocity", &FDTD::App::setReciprocity)
+    .def("getPairResponse", &FDTD::App::getPairResponse)
+    .def("addArraySource", &FDTD::App::addArraySource)
+    .def("addArraySourceNode", &FDTD::App::addArraySourceNode)
     .def("addReceiver", &FDTD::App::addReceiver)
+    .def("addBFormatReceiver", &FDTD::App::addBFormatReceiver)
+    .def("addReceiverGrid", &FDTD::App::addReceiverGrid, addReceiverGrid_overloads())
+    .def("clearReceiverGrids", &FDTD::App::clearReceiverGrids)
+    .def("getReceiverGridNumPoints", &FDTD::App::getReceiverGridNumPoints)
+    .def("getReceiverGridResponse", &FDTD::App::getReceiverGridResponse)
+    .def("addSourceWaypoint", &FDTD::App::addSourceWaypoint)
+    .def("addReceiverWaypoint", &FDTD::App::addReceiverWaypoint)
     .def("addSurfaceMaterials", &FDTD::App::addSurfaceMaterials)
     .def("setSpatialFs", &FDTD::App::setSpatialFs)
     .def("setNumSteps", &FDTD::App::setNumSteps )
+    .def("setOutputFs", &FDTD::App::setOutputFs, setOutputFs_overloads())
+    .def("getResponseLength", &FDTD::App::getResponseLength)
     .def("setUpdateType", &FDTD::App::setUpdateType)
+    .def("generateGridIr", &FDTD::App::generateGridIr, generateGridIr_overloads())
     .def("setUniform", &FDTD::App::setUniformMaterial)
     .def("runVisualization", &FDTD::App::runVisualization)
     .def("runSimulation", &FDTD::App::runSimulation)
     .def("runCapture", &FDTD::App::runCapture)
+    .def("prepareSession", &FDTD::App::prepareSession)
+    .def("closeSession", &FDTD::App::closeSession)
+    .def("isSessionPrepared", &FDTD::App::isSessionPrepared)
+    .def("runSweep", &FDTD::App::runSweepPy)
+    .def("runConcurrently", &FDTD::App::runConcurrentlyPy)
+    .staticmethod("runConcurrently")
+    .def("interrupt", &FDTD::App::interrupt)
+    .def("isInterrupted", &FDTD::App::isInterrupted)
+    .def("getProgressStep", &FDTD::App::getProgressStep)
+    .def("getProgressMaxStep", &FDTD::App::getProgressMaxStep)
+    .def("setLogFile", &FDTD::App::setLogFile)
+    .def("setCapturePrefix", &FDTD::App::setCapturePrefix)
+    .def("runHybrid", &FDTD::App::runHybrid)
+    .def("runSimulationHost", &FDTD::App::runSimulationHost, runSimulationHost_overloads())
+    .def("runSimulationHostBlocks", &FDTD::App::runSimulationHostBlocks)
+    .def("runSimulationTargets", &FDTD::App::runSimulationTargets, runSimulationTargets_overloads())
+    .def("addHostTarget", &FDTD::App::addHostTarget, addHostTarget_overloads())
+    .def("addDeviceTarget", &FDTD::App::addDeviceTarget, addDeviceTarget_overloads())
+    .def("clearTargets", &FDTD::App::clearTargets)
+    .def("runSimulationHostNuma", &FDTD::App::runSimulationHostNuma, runSimulationHostNuma_overloads())
+    .def("getNumberOfNodeBandwidths", &FDTD::App::getNumberOfNodeBandwidths)
+    .def("getNodeBandwidth", &FDTD::App::getNodeBandwidth)
+    .def("runSimulationOutOfCore", &FDTD::App::runSimulationOutOfCore, runSimulationOutOfCore_overloads())
+    .def("runSimulationDistributed", &FDTD::App::runSimulationDistributed, runSimulationDistributed_overloads())
     .def("setUniformMaterial", &FDTD::App::setUniformMaterial)
     .def("getResponse", &FDTD::App::getResponse)
     .def("getResponseDouble", &FDTD::App::getResponseDouble)
+    .def("getHybridResponse", &FDTD::App::getHybridResponse)
     .def("forcePartitionTo", &FDTD::App::setForcePartitionTo)
     .def("addSliceToCapture", &FDTD::App::addSliceToCapture)
     .def("setDouble", &FDTD::App::setDouble)
@@ -0,0 +1,156 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// This file is a part of the PadallelFDTD Finite-Difference Time-Domain
+// simulation library. It is released under the MIT License. You should have
+// received a copy of the MIT License along with ParallelFDTD.  If not, see
+// http://www.opensource.org/licenses/mit-license.php
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// For details, see the LICENSE file
+//
+// (C) 2013-2014 Jukka Saarelma
+// Aalto University School of Science
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "CallbackSlot.h"
+
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <stddef.h>
+
+namespace {
+  const unsigned int num_slots = 64;
+
+  struct Binding {
+    void* context;
+    CallbackSlot::InterruptHandler interrupt;
+    CallbackSlot::ProgressHandler progress;
+    CallbackSlot::CaptureHandler capture;
+    bool bound;
+  };
+
+  Binding bindings[num_slots];
+  unsigned int num_bound = 0;
+  boost::mutex slot_mutex;
+  boost::condition_variable slot_freed;
+
+  // The binding of a slot does not change while its callbacks are in use,
+  // the trampolines read it without the lock
+  template <unsigned int K>
+  bool interruptTrampoline() {
+    const Binding& b = bindings[K];
+    return b.interrupt ? b.interrupt(b.context) : false;
+  }
+
+  template <unsigned int K>
+  void progressTrampoline(int step, int max_step, float t_per_step) {
+    const Binding& b = bindings[K];
+    if(b.progress)
+      b.progress(b.context, step, max_step, t_per_step);
+  }
+
+  template <unsigned int K>
+  void captureTrampoline(float* data, unsigned char* position_data,
+                         unsigned int dim_x, unsigned int dim_y,
+                         unsigned int slice, unsigned int orientation,
+                         unsigned int step) {
+    const Binding& b = bindings[K];
+    if(b.capture)
+      b.capture(b.context, data, position_data, dim_x, dim_y, slice, orientation, step);
+  }
+
+  struct Trampolines {
+    InterruptCallback interrupt[num_slots];
+    ProgressCallback progress[num_slots];
+    CaptureCallback capture[num_slots];
+  };
+
+  template <unsigned int K>
+  struct FillTrampolines {
+    static void fill(Trampolines& t) {
+      t.interrupt[K-1] = interruptTrampoline<K-1>;
+      t.progress[K-1] = progressTrampoline<K-1>;
+      t.capture[K-1] = captureTrampoline<K-1>;
+      FillTrampolines<K-1>::fill(t);
+    }
+  };
+
+  template <>
+  struct FillTrampolines<0> {
+    static void fill(Trampolines&) {}
+  };
+
+  const Trampolines& getTrampolines() {
+    static Trampolines t;
+    static bool filled = false;
+    if(!filled) {
+      FillTrampolines<num_slots>::fill(t);
+      filled = true;
+    }
+    return t;
+  }
+}
+
+CallbackSlot::CallbackSlot(void* context,
+                           InterruptHandler interrupt,
+                           ProgressHandler progress,
+                           CaptureHandler capture)
+: index_(0)
+{
+  boost::mutex::scoped_lock lock(slot_mutex);
+  getTrampolines();
+  while(num_bound == num_slots)
+    slot_freed.wait(lock);
+
+  while(bindings[this->index_].bound)
+    this->index_++;
+
+  Binding& b = bindings[this->index_];
+  b.context = context;
+  b.interrupt = interrupt;
+  b.progress = progress;
+  b.capture = capture;
+  b.bound = true;
+  num_bound++;
+}
+
+CallbackSlot::~CallbackSlot() {
+  boost::mutex::scoped_lock lock(slot_mutex);
+  Binding& b = bindings[this->index_];
+  b.context = NULL;
+  b.interrupt = NULL;
+  b.progress = NULL;
+  b.capture = NULL;
+  b.bound = false;
+  num_bound--;
+  slot_freed.notify_one();
+}
+
+InterruptCallback CallbackSlot::getInterrupt() const {
+  return getTrampolines().interrupt[this->index_];
+}
+
+ProgressCallback CallbackSlot::getProgress() const {
+  return getTrampolines().progress[this->index_];
+}
+
+CaptureCallback CallbackSlot::getCapture() const {
+  return getTrampolines().capture[this->index_];
+}
+
+unsigned int CallbackSlot::getNumSlots() {
+  return num_slots;
+}
+
+unsigned int CallbackSlot::getNumBound() {
+  boost::mutex::scoped_lock lock(slot_mutex);
+  return num_bound;
+}
@@ -0,0 +1,76 @@
+#ifndef CALLBACK_SLOT_H
+#define CALLBACK_SLOT_H
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// This file is a part of the PadallelFDTD Finite-Difference Time-Domain
+// simulation library. It is released under the MIT License. You should have
+// received a copy of the MIT License along with ParallelFDTD.  If not, see
+// http://www.opensource.org/licenses/mit-license.php
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// For details, see the LICENSE file
+//
+// (C) 2013-2014 Jukka Saarelma
+// Aalto University School of Science
+//
+///////////////////////////////////////////////////////////////////////////////
+
+typedef bool (*InterruptCallback)(void);
+typedef void (*ProgressCallback)(int, int, float);
+typedef void (*CaptureCallback)(float*, unsigned char*, unsigned int, unsigned int,
+                                unsigned int, unsigned int, unsigned int);
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief Plain function callbacks bound to an object.
+///
+/// The launchers take the interrupt, progress and capture callbacks as
+/// plain function pointers without a context. A slot binds a context to a
+/// set of trampolines from a process wide table, so that each concurrent
+/// run gets callbacks of its own. The callbacks of a slot are valid until
+/// the slot is destroyed. A slot blocks while all the slots of the table
+/// are in use.
+///////////////////////////////////////////////////////////////////////////////
+class CallbackSlot {
+public:
+  typedef bool (*InterruptHandler)(void* context);
+  typedef void (*ProgressHandler)(void* context, int step, int max_step, float t_per_step);
+  typedef void (*CaptureHandler)(void* context, float* data, unsigned char* position_data,
+                                 unsigned int dim_x, unsigned int dim_y,
+                                 unsigned int slice, unsigned int orientation,
+                                 unsigned int step);
+
+  CallbackSlot(void* context,
+               InterruptHandler interrupt,
+               ProgressHandler progress,
+               CaptureHandler capture);
+  ~CallbackSlot();
+
+  InterruptCallback getInterrupt() const;
+  ProgressCallback getProgress() const;
+  CaptureCallback getCapture() const;
+
+  unsigned int getIndex() const {return this->index_;}
+
+  /// The number of slots in the table
+  static unsigned int getNumSlots();
+
+  /// The number of slots bound at the moment
+  static unsigned int getNumBound();
+
+private:
+  // Not copyable, the slot has a single owner
+  CallbackSlot(const CallbackSlot&);
+  CallbackSlot& operator=(const CallbackSlot&);
+
+  unsigned int index_;
+};
+
+#endif
@@ -0,0 +1,102 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// This file is a part of the PadallelFDTD Finite-Difference Time-Domain
+// simulation library. It is released under the MIT License. You should have
+// received a copy of the MIT License along with ParallelFDTD.  If not, see
+// http://www.opensource.org/licenses/mit-license.php
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// For details, see the LICENSE file
+//
+// (C) 2013-2014 Jukka Saarelma
+// Aalto University School of Science
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "Convolution.h"
+#include <math.h>
+#include <algorithm>
+
+#ifndef PI
+#define PI 3.14159265358979323846
+#endif
+
+void fft(std::vector< std::complex<double> >& data, bool inverse) {
+  size_t n = data.size();
+  if(n < 2)
+    return;
+
+  // Bit reversal permutation
+  for(size_t i = 1, j = 0; i < n; i++) {
+    size_t bit = n>>1;
+    for(; j&bit; bit >>= 1)
+      j ^= bit;
+    j ^= bit;
+    if(i < j)
+      std::swap(data[i], data[j]);
+  }
+
+  // The twiddles are computed directly for each stage, a recurrence loses
+  // precision on long transforms
+  double sign = inverse ? 1.0 : -1.0;
+  std::vector< std::complex<double> > twiddles(n/2);
+  for(size_t len = 2; len <= n; len <<= 1) {
+    size_t half = len/2;
+    for(size_t k = 0; k < half; k++) {
+      double angle = sign*2.0*PI*(double)k/(double)len;
+      twiddles[k] = std::complex<double>(cos(angle), sin(angle));
+    }
+    for(size_t i = 0; i < n; i += len) {
+      for(size_t k = 0; k < half; k++) {
+        std::complex<double> u = data[i+k];
+        std::complex<double> v = data[i+k+half]*twiddles[k];
+        data[i+k] = u+v;
+        data[i+k+half] = u-v;
+      }
+    }
+  }
+
+  if(inverse)
+    for(size_t i = 0; i < n; i++)
+      data[i] /= (double)n;
+}
+
+std::vector<double> fftConvolve(const std::vector<double>& a,
+                                const std::vector<double>& b,
+                                size_t length) {
+  std::vector<double> ret(length, 0.0);
+  if(a.empty() || b.empty() || length == 0)
+    return ret;
+
+  // Samples of the inputs past the output length do not contribute
+  size_t size_a = std::min(a.size(), length);
+  size_t size_b = std::min(b.size(), length);
+  size_t full = size_a+size_b-1;
+  size_t n = 1;
+  while(n < full)
+    n <<= 1;
+
+  std::vector< std::complex<double> > fa(n), fb(n);
+  for(size_t i = 0; i < size_a; i++)
+    fa[i] = a[i];
+  for(size_t i = 0; i < size_b; i++)
+    fb[i] = b[i];
+
+  fft(fa, false);
+  fft(fb, false);
+  for(size_t i = 0; i < n; i++)
+    fa[i] *= fb[i];
+  fft(fa, true);
+
+  size_t count = std::min(length, full);
+  for(size_t i = 0; i < count; i++)
+    ret[i] = fa[i].real();
+  return ret;
+}
@@ -0,0 +1,48 @@
+#ifndef CONVOLUTION_H
+#define CONVOLUTION_H
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// This file is a part of the PadallelFDTD Finite-Difference Time-Domain
+// simulation library. It is released under the MIT License. You should have
+// received a copy of the MIT License along with ParallelFDTD.  If not, see
+// http://www.opensource.org/licenses/mit-license.php
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// For details, see the LICENSE file
+//
+// (C) 2013-2014 Jukka Saarelma
+// Aalto University School of Science
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include <vector>
+#include <complex>
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief In-place radix-2 FFT
+/// \param data The sequence, the size has to be a power of two
+/// \param inverse Compute the inverse transform, scaled by 1/size
+///////////////////////////////////////////////////////////////////////////////
+void fft(std::vector< std::complex<double> >& data, bool inverse);
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief Linear convolution of two sequences through the FFT, truncated
+/// to the given length
+/// \param a, b The sequences
+/// \param length The number of output samples, the samples past the full
+/// convolution are zero
+/// \return The first length samples of a*b
+///////////////////////////////////////////////////////////////////////////////
+std::vector<double> fftConvolve(const std::vector<double>& a,
+                                const std::vector<double>& b,
+                                size_t length);
+
+#endif
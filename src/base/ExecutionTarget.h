@@ -0,0 +1,78 @@
+#ifndef EXECUTION_TARGET_H
+#define EXECUTION_TARGET_H
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// This file is a part of the PadallelFDTD Finite-Difference Time-Domain
+// simulation library. It is released under the MIT License. You should have
+// received a copy of the MIT License along with ParallelFDTD.  If not, see
+// http://www.opensource.org/licenses/mit-license.php
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// For details, see the LICENSE file
+//
+// (C) 2013-2014 Jukka Saarelma
+// Aalto University School of Science
+//
+///////////////////////////////////////////////////////////////////////////////
+
+enum TargetType {TARGET_HOST, TARGET_DEVICE};
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief A worker of a heterogeneous run which steps one partition, either
+/// a group of CPU threads or a CUDA device. The throughput weighs the
+/// share of the domain given to the target by PartitionPlanner.
+///////////////////////////////////////////////////////////////////////////////
+struct ExecutionTarget {
+  ExecutionTarget()
+  : type(TARGET_HOST),
+    device(-1),
+    threads(1),
+    throughput(0.f),
+    memory_in_MB(0.f),
+    block_x(32),
+    block_y(4),
+    numa_node(-1)
+  {};
+
+  enum TargetType type;
+  int device;               ///< CUDA device of a device target
+  unsigned int threads;     ///< Worker threads of a host target
+  float throughput;         ///< Mvox/s, 0 if not known
+  float memory_in_MB;       ///< Memory available for the partition
+  unsigned int block_x;     ///< Thread block of a device target, as in CudaMesh
+  unsigned int block_y;
+  int numa_node;            ///< NumaTopology node of a host target, -1 if not pinned
+};
+
+inline ExecutionTarget makeHostTarget(unsigned int threads, float throughput,
+                                      float memory_in_MB = 1e9f, int numa_node = -1) {
+  ExecutionTarget target;
+  target.type = TARGET_HOST;
+  target.threads = threads > 0 ? threads : 1;
+  target.throughput = throughput;
+  target.memory_in_MB = memory_in_MB;
+  target.numa_node = numa_node;
+  return target;
+}
+
+inline ExecutionTarget makeDeviceTarget(int device, float throughput, float memory_in_MB,
+                                        unsigned int block_x = 32, unsigned int block_y = 4) {
+  ExecutionTarget target;
+  target.type = TARGET_DEVICE;
+  target.device = device;
+  target.throughput = throughput;
+  target.memory_in_MB = memory_in_MB;
+  target.block_x = block_x;
+  target.block_y = block_y;
+  return target;
+}
+
+#endif
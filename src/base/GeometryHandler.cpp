@@ -21,6 +21,7 @@
 ///////////////////////////////////////////////////////////////////////////////
 
 #include "GeometryHandler.h"
+#include "StateHash.h"
 #include "../global_includes.h"
 
 void GeometryHandler::initialize(std::vector<unsigned int> indices, std::vector<float> vertices) {
@@ -200,3 +201,7 @@ void GeometryHandler::setLayerIndices(std::vector<int> indices, std::string name
   this->layers_[name] = indices;
 }
 
+void GeometryHandler::hashState(StateHash& hash) const {
+  hash.addVector(this->indices_);
+  hash.addVector(this->vertices_);
+}
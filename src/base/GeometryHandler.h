@@ -28,6 +28,8 @@
 #include <map>
 #include <string>
 
+class StateHash;
+
 ///////////////////////////////////////////////////////////////////////////////
 /// \brief Class that manages the geometry of the model
 ///////////////////////////////////////////////////////////////////////////////
@@ -127,6 +129,9 @@ public:
   
   void setLayerIndices(std::vector<int> indices, std::string name); 
 
+  /// \brief Add the triangles and vertices of the model to a hash
+  void hashState(StateHash& hash) const;
+
 private:
   std::vector<unsigned int> indices_;              ///< Triangle indices of the model
   std::vector<float> vertices_;                    ///< Vertex coordinates of the model
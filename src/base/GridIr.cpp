@@ -0,0 +1,196 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// This file is a part of the PadallelFDTD Finite-Difference Time-Domain
+// simulation library. It is released under the MIT License. You should have
+// received a copy of the MIT License along with ParallelFDTD.  If not, see
+// http://www.opensource.org/licenses/mit-license.php
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// For details, see the LICENSE file
+//
+// (C) 2013-2014 Jukka Saarelma
+// Aalto University School of Science
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "GridIr.h"
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+
+namespace {
+  const char cache_magic[8] = {'P', 'F', 'G', 'R', 'I', 'D', 'I', 'R'};
+
+  // The nodes of the wedge x >= y >= z >= 0, x+y+z <= radius, are stored
+  // z-contiguously for each (x, y)
+  class Wedge {
+  public:
+    Wedge(unsigned int radius)
+    : radius_(radius),
+      offsets_((size_t)(radius+1)*(radius+1), 0),
+      size_(0)
+    {
+      for(unsigned int x = 0; x <= radius; x++) {
+        for(unsigned int y = 0; y <= std::min(x, radius-x); y++) {
+          this->offsets_[(size_t)x*(radius+1)+y] = this->size_;
+          this->size_ += std::min(y, radius-x-y)+1;
+        }
+      }
+    }
+
+    size_t size() const {return this->size_;}
+
+    // Index of the node (x, y, 0), x >= y
+    size_t offset(unsigned int x, unsigned int y) const
+      {return this->offsets_[(size_t)x*(this->radius_+1)+y];}
+
+    // Index of any node, -1 outside the domain
+    long long index(int x, int y, int z) const {
+      x = x < 0 ? -x : x;
+      y = y < 0 ? -y : y;
+      z = z < 0 ? -z : z;
+      if(x < y) std::swap(x, y);
+      if(y < z) std::swap(y, z);
+      if(x < y) std::swap(x, y);
+      if((unsigned int)(x+y+z) > this->radius_)
+        return -1;
+      return (long long)(this->offsets_[(size_t)x*(this->radius_+1)+y]+z);
+    }
+
+  private:
+    unsigned int radius_;
+    std::vector<size_t> offsets_;
+    size_t size_;
+  };
+}
+
+std::vector<double> computeGridIr(double lambda, unsigned int length) {
+  std::vector<double> ret(length, 0.0);
+  if(length < 2)
+    return ret;
+
+  // A node at distance r+1 is reached at step r+1, anything reflected from
+  // it returns to the origin at step 2r+2 at the earliest
+  unsigned int radius = length/2;
+  Wedge wedge(radius);
+  std::vector<double> p(wedge.size(), 0.0);
+  std::vector<double> p_past(wedge.size(), 0.0);
+
+  double l2 = lambda*lambda;
+  double a = 2.0-6.0*l2;
+  p[0] = 1.0;
+
+  for(unsigned int n = 1; n < length; n++) {
+    // Nodes outside both cones are zero or do not affect the response
+    unsigned int reach = std::min(std::min(n, length-1-n), radius);
+    for(unsigned int x = 0; x <= reach; x++) {
+      for(unsigned int y = 0; y <= std::min(x, reach-x); y++) {
+        unsigned int z_end = std::min(y, reach-x-y);
+        // Inside the wedge the neighbours are stored as such
+        unsigned int fast_end = 0;
+        if(x > y && y > 1 && x+y < radius)
+          fast_end = std::min(std::min(y-1, radius-x-y-1), z_end);
+
+        if(fast_end >= 1) {
+          size_t base = wedge.offset(x, y);
+          size_t xp = wedge.offset(x+1, y);
+          size_t xm = wedge.offset(x-1, y);
+          size_t yp = wedge.offset(x, y+1);
+          size_t ym = wedge.offset(x, y-1);
+          for(unsigned int z = 1; z <= fast_end; z++) {
+            double S = p[xp+z]+p[xm+z]+p[yp+z]+p[ym+z]+p[base+z+1]+p[base+z-1];
+            p_past[base+z] = a*p[base+z]+l2*S-p_past[base+z];
+          }
+        }
+
+        for(unsigned int z = 0; z <= z_end; z++) {
+          if(z == 1 && fast_end >= 1)
+            z = fast_end+1;
+          if(z > z_end)
+            break;
+          int xi = (int)x, yi = (int)y, zi = (int)z;
+          long long idx = wedge.index(xi, yi, zi);
+          long long nb;
+          double S = 0.0;
+          if((nb = wedge.index(xi+1, yi, zi)) >= 0) S += p[nb];
+          if((nb = wedge.index(xi-1, yi, zi)) >= 0) S += p[nb];
+          if((nb = wedge.index(xi, yi+1, zi)) >= 0) S += p[nb];
+          if((nb = wedge.index(xi, yi-1, zi)) >= 0) S += p[nb];
+          if((nb = wedge.index(xi, yi, zi+1)) >= 0) S += p[nb];
+          if((nb = wedge.index(xi, yi, zi-1)) >= 0) S += p[nb];
+          p_past[idx] = a*p[idx]+l2*S-p_past[idx];
+        }
+      }
+    }
+    p.swap(p_past);
+    ret[n] = p[0];
+  }
+
+  return ret;
+}
+
+bool readGridIrCache(const std::string& fp, double lambda, unsigned int length,
+                     std::vector<double>& ret) {
+  FILE* f = fopen(fp.c_str(), "rb");
+  if(!f)
+    return false;
+
+  char magic[8];
+  double file_lambda = 0.0;
+  unsigned int file_length = 0;
+  unsigned int sample_size = 0;
+  bool ok = fread(magic, 1, 8, f) == 8 &&
+            fread(&file_lambda, sizeof(double), 1, f) == 1 &&
+            fread(&file_length, sizeof(unsigned int), 1, f) == 1 &&
+            fread(&sample_size, sizeof(unsigned int), 1, f) == 1 &&
+            memcmp(magic, cache_magic, 8) == 0 &&
+            file_lambda == lambda && file_length == length &&
+            (sample_size == sizeof(float) || sample_size == sizeof(double));
+
+  if(ok) {
+    ret.assign(length, 0.0);
+    if(sample_size == sizeof(double)) {
+      ok = length == 0 || fread(&ret[0], sizeof(double), length, f) == length;
+    }
+    else {
+      std::vector<float> samples(length, 0.f);
+      ok = length == 0 || fread(&samples[0], sizeof(float), length, f) == length;
+      std::copy(samples.begin(), samples.end(), ret.begin());
+    }
+  }
+  fclose(f);
+  return ok;
+}
+
+bool writeGridIrCache(const std::string& fp, double lambda,
+                      const std::vector<double>& grid_ir, bool double_precision) {
+  FILE* f = fopen(fp.c_str(), "wb");
+  if(!f)
+    return false;
+
+  unsigned int length = (unsigned int)grid_ir.size();
+  unsigned int sample_size = double_precision ? sizeof(double) : sizeof(float);
+  bool ok = fwrite(cache_magic, 1, 8, f) == 8 &&
+            fwrite(&lambda, sizeof(double), 1, f) == 1 &&
+            fwrite(&length, sizeof(unsigned int), 1, f) == 1 &&
+            fwrite(&sample_size, sizeof(unsigned int), 1, f) == 1;
+
+  if(ok && length > 0) {
+    if(double_precision) {
+      ok = fwrite(&grid_ir[0], sizeof(double), length, f) == length;
+    }
+    else {
+      std::vector<float> samples(grid_ir.begin(), grid_ir.end());
+      ok = fwrite(&samples[0], sizeof(float), length, f) == length;
+    }
+  }
+  ok = (fclose(f) == 0) && ok;
+  return ok;
+}
@@ -0,0 +1,71 @@
+#ifndef GRID_IR_H
+#define GRID_IR_H
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// This file is a part of the PadallelFDTD Finite-Difference Time-Domain
+// simulation library. It is released under the MIT License. You should have
+// received a copy of the MIT License along with ParallelFDTD.  If not, see
+// http://www.opensource.org/licenses/mit-license.php
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// For details, see the LICENSE file
+//
+// (C) 2013-2014 Jukka Saarelma
+// Aalto University School of Science
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include <vector>
+#include <string>
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief Compute the free-field impulse response of the standard leapfrog
+/// grid at the excited node.
+///
+/// All the update schemes share the standard rectilinear stencil away from
+/// the boundaries, only the Courant number changes the response. The
+/// response is simulated in double precision in a domain which is just
+/// large enough that nothing reflected from its edge reaches the excited
+/// node within length steps. The domain is reduced to the 1/48 wedge
+/// x >= y >= z >= 0 by the symmetry of the excitation, and each step only
+/// updates the nodes inside the light cones of the excitation and of the
+/// last sample.
+///
+/// \param lambda The Courant number
+/// \param length The number of samples
+/// \return The pressure at the excited node after each step of an unit
+/// impulse, the first sample set to zero as in the measured grid IR files
+///////////////////////////////////////////////////////////////////////////////
+std::vector<double> computeGridIr(double lambda, unsigned int length);
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief Read a grid IR cached by writeGridIrCache
+/// \param fp The path of the cache file
+/// \param lambda The Courant number the IR has to be computed with
+/// \param length The number of samples the IR has to have
+/// \param[out] ret The impulse response
+/// \return true if the file exists and matches lambda and length
+///////////////////////////////////////////////////////////////////////////////
+bool readGridIrCache(const std::string& fp, double lambda, unsigned int length,
+                     std::vector<double>& ret);
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief Write a grid IR to a binary cache file
+/// \param fp The path of the cache file
+/// \param lambda The Courant number the IR is computed with
+/// \param grid_ir The impulse response
+/// \param double_precision Store the samples as double, float otherwise
+/// \return true on success
+///////////////////////////////////////////////////////////////////////////////
+bool writeGridIrCache(const std::string& fp, double lambda,
+                      const std::vector<double>& grid_ir, bool double_precision);
+
+#endif
@@ -21,6 +21,7 @@
 ///////////////////////////////////////////////////////////////////////////////
 
 #include "MaterialHandler.h"
+#include "StateHash.h"
 #include "../global_includes.h"
 
 
@@ -224,3 +225,9 @@ void MaterialHandler::setMaterialIndexAt(unsigned int surface_idx, unsigned char
   this->material_indices_.at(surface_idx) = material_idx;
 }
 
+void MaterialHandler::hashState(StateHash& hash) const {
+  hash.addValue(this->admitance_);
+  hash.addValue(this->number_of_coefficients_);
+  hash.addVector(this->material_indices_);
+  hash.addVector(this->unique_coefficients_);
+}
@@ -26,6 +26,8 @@
 #include <vector>
 #include <string>
 
+class StateHash;
+
 #define MATERIAL_COEF_NUM 20
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -70,7 +72,10 @@ public:
   /////////////////////////////////////////////////////////////////////////////
   void coefsAreReflectances() {this->admitance_ = false;};
   
-  unsigned int getNumberOfCoefficients() {return this->number_of_coefficients_;}; 
+  /// \return true if the material list holds admittance values
+  bool isAdmitance() {return this->admitance_;};
+
+  unsigned int getNumberOfCoefficients() {return this->number_of_coefficients_;};
   unsigned int getNumberOfSurfaces() {return this->number_of_surfaces_;};
   unsigned int getNumberOfUniqueMaterials() {return this->number_of_unique_materials_;}; 
   unsigned int getMaterialIdxAt(unsigned int idx) {return this->material_indices_.at(idx);};
@@ -134,6 +139,9 @@ public:
   /////////////////////////////////////////////////////////////////////////////
   void setMaterialIndexAt(unsigned int surface_idx, unsigned char material_idx);
 
+  /// \brief Add the materials and the material of each surface to a hash
+  void hashState(StateHash& hash) const;
+
   struct material_t {
     float coefs[MATERIAL_COEF_NUM];
   };
@@ -0,0 +1,213 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// This file is a part of the PadallelFDTD Finite-Difference Time-Domain
+// simulation library. It is released under the MIT License. You should have
+// received a copy of the MIT License along with ParallelFDTD.  If not, see
+// http://www.opensource.org/licenses/mit-license.php
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// For details, see the LICENSE file
+//
+// (C) 2013-2014 Jukka Saarelma
+// Aalto University School of Science
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "PartitionPlanner.h"
+#include "../logger.h"
+
+void PartitionPlanner::countSlices(const unsigned char* position_idx,
+                                   unsigned int dim_x, unsigned int dim_y,
+                                   unsigned int dim_z, unsigned char air_value) {
+  this->dim_x_ = dim_x;
+  this->dim_y_ = dim_y;
+  this->dim_z_ = dim_z;
+  this->air_nodes_.assign(dim_z, 0);
+  this->boundary_nodes_.assign(dim_z, 0);
+  this->cost_prefix_.assign(dim_z+1, 0.0);
+
+  unsigned int dim_xy = dim_x*dim_y;
+  for(unsigned int z = 0; z < dim_z; z++) {
+    const unsigned char* slice = position_idx+(size_t)z*dim_xy;
+    unsigned int air = 0;
+    unsigned int boundary = 0;
+    for(unsigned int i = 0; i < dim_xy; i++) {
+      if(slice[i] == air_value)
+        air++;
+      else if(slice[i]>>7)
+        boundary++;
+    }
+    this->air_nodes_.at(z) = air;
+    this->boundary_nodes_.at(z) = boundary;
+    this->cost_prefix_.at(z+1) = this->cost_prefix_.at(z)+(double)this->getSliceCost(z);
+  }
+
+  log_msg<LOG_DEBUG>(L"PartitionPlanner::countSlices - dim z %u, total cost %f")
+                     %dim_z %this->cost_prefix_.at(dim_z);
+}
+
+void PartitionPlanner::addTarget(float throughput, float memory_in_MB) {
+  target_t target;
+  target.throughput = throughput > 0.f ? throughput : 1.f;
+  target.memory = memory_in_MB;
+  this->targets_.push_back(target);
+}
+
+float PartitionPlanner::getSliceCost(unsigned int z) const {
+  unsigned int air = this->air_nodes_.at(z);
+  unsigned int boundary = this->boundary_nodes_.at(z);
+  unsigned int solid = this->dim_x_*this->dim_y_-air-boundary;
+  return this->air_cost_*(float)air+
+         this->boundary_cost_*(float)boundary+
+         this->solid_cost_*(float)solid;
+}
+
+float PartitionPlanner::getCost(unsigned int begin, unsigned int end) const {
+  return (float)(this->cost_prefix_.at(end)-this->cost_prefix_.at(begin));
+}
+
+unsigned int PartitionPlanner::getSliceCapacity(unsigned int target,
+                                                unsigned int number_of_targets) const {
+  double slice_bytes = (double)this->bytes_per_node_*this->dim_x_*this->dim_y_;
+  double slices = (double)this->targets_.at(target).memory*1e6/slice_bytes;
+  unsigned int halos = (target > 0)+(target < number_of_targets-1);
+  if(slices < (double)halos)
+    return 0;
+  slices -= halos;
+  if(slices > (double)this->dim_z_)
+    return this->dim_z_;
+  return (unsigned int)slices;
+}
+
+bool PartitionPlanner::fill(double time, unsigned int number_of_targets,
+                            std::vector<unsigned int>& slice_counts) const {
+  slice_counts.assign(number_of_targets, 0);
+  unsigned int z = 0;
+  for(unsigned int i = 0; i < number_of_targets; i++) {
+    unsigned int reserved = this->min_slices_*(number_of_targets-1-i);
+    if(z+reserved > this->dim_z_)
+      return false;
+    unsigned int max_end = this->dim_z_-reserved;
+    unsigned int cap = this->getSliceCapacity(i, number_of_targets);
+    if(z+cap < max_end)
+      max_end = z+cap;
+
+    double budget = time*(double)this->targets_.at(i).throughput;
+    unsigned int end = z;
+    while(end < max_end && this->cost_prefix_.at(end+1)-this->cost_prefix_.at(z) <= budget)
+      end++;
+
+    if(end-z < this->min_slices_)
+      return false;
+    slice_counts.at(i) = end-z;
+    z = end;
+  }
+  return z == this->dim_z_;
+}
+
+std::vector< std::vector<unsigned int> >
+PartitionPlanner::plan(unsigned int number_of_targets) {
+  if(number_of_targets == 0 || number_of_targets > this->getNumberOfTargets()) {
+    log_msg<LOG_ERROR>(L"PartitionPlanner::plan - %u targets requested, %u available")
+                       %number_of_targets %this->getNumberOfTargets();
+    throw(-1);
+  }
+  if(this->dim_z_ == 0) {
+    log_msg<LOG_ERROR>(L"PartitionPlanner::plan - slices not counted");
+    throw(-1);
+  }
+
+  // Binary search the smallest time in which the slowest partition is done
+  float min_throughput = this->targets_.at(0).throughput;
+  for(unsigned int i = 1; i < number_of_targets; i++)
+    if(this->targets_.at(i).throughput < min_throughput)
+      min_throughput = this->targets_.at(i).throughput;
+
+  double lo = 0.0;
+  double hi = (this->cost_prefix_.at(this->dim_z_)+1.0)/(double)min_throughput;
+  std::vector<unsigned int> slice_counts;
+
+  if(!this->fill(hi, number_of_targets, slice_counts)) {
+    log_msg<LOG_ERROR>(L"PartitionPlanner::plan - %u slices do not fit %u targets")
+                       %this->dim_z_ %number_of_targets;
+    throw(-1);
+  }
+
+  for(unsigned int i = 0; i < 64; i++) {
+    double mid = 0.5*(lo+hi);
+    if(this->fill(mid, number_of_targets, slice_counts))
+      hi = mid;
+    else
+      lo = mid;
+  }
+  this->fill(hi, number_of_targets, slice_counts);
+
+  std::vector< std::vector<unsigned int> > ret = countsToIndexing(slice_counts);
+  unsigned int z = 0;
+  for(unsigned int i = 0; i < number_of_targets; i++) {
+    log_msg<LOG_INFO>(L"PartitionPlanner::plan - partition %u: %u slices, cost %f, "
+                      L"throughput %f") %i %slice_counts.at(i)
+                      %this->getCost(z, z+slice_counts.at(i))
+                      %this->targets_.at(i).throughput;
+    z += slice_counts.at(i);
+  }
+  return ret;
+}
+
+unsigned int PartitionPlanner::getMinimumNumberOfTargets() {
+  for(unsigned int n = 1; n <= this->getNumberOfTargets(); n++) {
+    unsigned int capacity = 0;
+    for(unsigned int i = 0; i < n; i++)
+      capacity += this->getSliceCapacity(i, n);
+    if(capacity >= this->dim_z_ && this->min_slices_*n <= this->dim_z_)
+      return n;
+  }
+  return 0;
+}
+
+std::vector<float>
+PartitionPlanner::calibrateThroughputs(const std::vector<float>& estimates,
+                                       const std::vector<float>& measured) {
+  double ratio = 0.0;
+  unsigned int num_measured = 0;
+  for(unsigned int i = 0; i < estimates.size() && i < measured.size(); i++) {
+    if(measured.at(i) > 0.f && estimates.at(i) > 0.f) {
+      ratio += (double)measured.at(i)/(double)estimates.at(i);
+      num_measured++;
+    }
+  }
+  ratio = num_measured > 0 ? ratio/(double)num_measured : 1.0;
+
+  std::vector<float> ret(estimates.size());
+  for(unsigned int i = 0; i < estimates.size(); i++) {
+    if(i < measured.size() && measured.at(i) > 0.f)
+      ret.at(i) = measured.at(i);
+    else
+      ret.at(i) = (float)(estimates.at(i)*ratio);
+  }
+  return ret;
+}
+
+std::vector< std::vector<unsigned int> >
+PartitionPlanner::countsToIndexing(const std::vector<unsigned int>& slice_counts) {
+  std::vector< std::vector<unsigned int> > ret;
+  unsigned int num_parts = (unsigned int)slice_counts.size();
+  unsigned int first = 0;
+  for(unsigned int i = 0; i < num_parts; i++) {
+    unsigned int s_inc = (i == 0) ? 0 : 1;
+    unsigned int e_inc = (i == num_parts-1) ? 0 : 1;
+    std::vector<unsigned int> slices;
+    for(unsigned int j = first-s_inc; j < first+slice_counts.at(i)+e_inc; j++)
+      slices.push_back(j);
+    ret.push_back(slices);
+    first += slice_counts.at(i);
+  }
+  return ret;
+}
@@ -0,0 +1,156 @@
+#ifndef PARTITION_PLANNER_H
+#define PARTITION_PLANNER_H
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// This file is a part of the PadallelFDTD Finite-Difference Time-Domain
+// simulation library. It is released under the MIT License. You should have
+// received a copy of the MIT License along with ParallelFDTD.  If not, see
+// http://www.opensource.org/licenses/mit-license.php
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// For details, see the LICENSE file
+//
+// (C) 2013-2014 Jukka Saarelma
+// Aalto University School of Science
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief Plans the split of the domain along z with a cost model.
+///
+/// The cost of each slice is the weighted count of its air, boundary and
+/// solid nodes. Each target (device or worker) has a throughput and an
+/// amount of memory. The slices are divided to contiguous partitions so
+/// that the largest cost/throughput of a partition is minimized, without
+/// exceeding the memory of any target. The result uses the same format as
+/// CudaMesh::getPartitionIndexing(), halo slices included.
+///////////////////////////////////////////////////////////////////////////////
+class PartitionPlanner {
+public:
+  PartitionPlanner()
+  : dim_x_(0),
+    dim_y_(0),
+    dim_z_(0),
+    air_cost_(1.f),
+    boundary_cost_(1.5f),
+    solid_cost_(0.25f),
+    bytes_per_node_(10),
+    min_slices_(2)
+  {};
+
+  ~PartitionPlanner() {};
+
+  struct target_t {
+    float throughput;    ///< Relative speed of the target, e.g. Mvox/s
+    float memory;        ///< Available memory in MB
+  };
+
+  /////////////////////////////////////////////////////////////////////////////
+  /// \brief Count the air and boundary nodes of each slice
+  /// \param position_idx The position indices of the whole domain
+  /// \param dim_x, dim_y, dim_z The dimensions of the domain
+  /// \param air_value The position index of an air node, 0x86 for the
+  /// Bilbao schemes and 0x80 for the Kowalczyk scheme. Other nodes with
+  /// the inside bit set are boundary nodes
+  /////////////////////////////////////////////////////////////////////////////
+  void countSlices(const unsigned char* position_idx,
+                   unsigned int dim_x, unsigned int dim_y, unsigned int dim_z,
+                   unsigned char air_value);
+
+  /////////////////////////////////////////////////////////////////////////////
+  /// \brief Add a target to which a partition is assigned. Partitions are
+  /// assigned to the targets in the order they are added
+  /// \param throughput Relative throughput of the target
+  /// \param memory_in_MB The available memory of the target
+  /////////////////////////////////////////////////////////////////////////////
+  void addTarget(float throughput, float memory_in_MB);
+  void clearTargets() {this->targets_.clear();}
+
+  /////////////////////////////////////////////////////////////////////////////
+  /// \brief Split the domain to the first number_of_targets targets
+  /// \param number_of_targets The number of partitions
+  /// \return The global slice indices of each partition, halo slices
+  /// included. Throws -1 if the domain does not fit the targets
+  /////////////////////////////////////////////////////////////////////////////
+  std::vector< std::vector<unsigned int> > plan(unsigned int number_of_targets);
+
+  /// \return The smallest number of targets, taken in order, which can
+  /// hold the domain. 0 if all the targets are not enough
+  unsigned int getMinimumNumberOfTargets();
+
+  /////////////////////////////////////////////////////////////////////////////
+  /// \brief Convert the owned slice counts of each partition to a partition
+  /// indexing, adding the halo slices at the internal borders
+  /// \param slice_counts The number of slices updated by each partition
+  /////////////////////////////////////////////////////////////////////////////
+  static std::vector< std::vector<unsigned int> >
+    countsToIndexing(const std::vector<unsigned int>& slice_counts);
+
+  /////////////////////////////////////////////////////////////////////////////
+  /// \brief Bring the estimated and the measured throughputs of the
+  /// targets to the same scale. A measured target uses its measurement,
+  /// the estimates of the others are scaled with the mean ratio of the
+  /// measurements to the estimates
+  /// \param estimates The estimated throughput of each target
+  /// \param measured The measured throughput of each target, 0 if the
+  /// target has not been measured
+  /////////////////////////////////////////////////////////////////////////////
+  static std::vector<float> calibrateThroughputs(const std::vector<float>& estimates,
+                                                 const std::vector<float>& measured);
+
+  /// \brief Set the relative cost of updating an air, a boundary and a
+  /// solid node
+  void setNodeCosts(float air, float boundary, float solid) {
+    this->air_cost_ = air;
+    this->boundary_cost_ = boundary;
+    this->solid_cost_ = solid;
+  }
+  /// \brief Set the memory needed for a node, 10 bytes in single and
+  /// 18 in double precision
+  void setBytesPerNode(unsigned int bytes) {this->bytes_per_node_ = bytes;}
+  /// \brief Set the smallest number of slices updated by a partition
+  void setMinSlices(unsigned int min_slices) {this->min_slices_ = min_slices;}
+
+  unsigned int getNumberOfTargets() const {return (unsigned int)this->targets_.size();}
+  unsigned int getNumberOfAirNodesAt(unsigned int z) const {return this->air_nodes_.at(z);}
+  unsigned int getNumberOfBoundaryNodesAt(unsigned int z) const {return this->boundary_nodes_.at(z);}
+  float getSliceCost(unsigned int z) const;
+  /// \return The cost of the global slices [begin, end)
+  float getCost(unsigned int begin, unsigned int end) const;
+
+private:
+  unsigned int dim_x_;
+  unsigned int dim_y_;
+  unsigned int dim_z_;
+  float air_cost_;              ///< Relative cost of an air node
+  float boundary_cost_;         ///< Relative cost of a boundary node
+  float solid_cost_;            ///< Relative cost of a node outside
+  unsigned int bytes_per_node_; ///< Memory needed per node
+  unsigned int min_slices_;     ///< Smallest partition
+
+  std::vector<unsigned int> air_nodes_;       ///< Air nodes in each slice
+  std::vector<unsigned int> boundary_nodes_;  ///< Boundary nodes in each slice
+  std::vector<double> cost_prefix_;           ///< Cumulative cost of slices, dim_z+1
+  std::vector<target_t> targets_;
+
+  /// \return The number of slices the memory of a target can hold
+  unsigned int getSliceCapacity(unsigned int target, unsigned int number_of_targets) const;
+
+  /// \brief Fill the targets greedily so that no target exceeds the
+  /// given time
+  /// \return true if all slices were assigned
+  bool fill(double time, unsigned int number_of_targets,
+            std::vector<unsigned int>& slice_counts) const;
+};
+
+#endif
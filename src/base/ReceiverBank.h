@@ -0,0 +1,418 @@
+#ifndef RECEIVER_BANK_H
+#define RECEIVER_BANK_H
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// This file is a part of the PadallelFDTD Finite-Difference Time-Domain
+// simulation library. It is released under the MIT License. You should have
+// received a copy of the MIT License along with ParallelFDTD.  If not, see
+// http://www.opensource.org/licenses/mit-license.php
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// For details, see the LICENSE file
+//
+// (C) 2013-2014 Jukka Saarelma
+// Aalto University School of Science
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "../io/ResponseWriter.h"
+#include "ReceiverGrid.h"
+#include "Resampler.h"
+#include <vector>
+#include <algorithm>
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief The static receivers of a simulation compiled for a batched
+/// gather from a partitioned domain.
+///
+/// The receivers of each partition are sorted by their local element index,
+/// so one pass over the entries reads the pressures in address order. The
+/// samples of a step are written to a ring buffer holding a chunk of steps,
+/// step-major with the entries of one step contiguous. When a chunk is full
+/// it is flushed to the responses, receiver-major with num_steps samples
+/// per receiver as in App::responses_. A device target gathers to a ring of
+/// its own and copies it to getRing() before the flush. If a ResponseWriter
+/// is set, the flushed chunks are also passed to it, and the responses in
+/// memory are optional.
+///
+/// The points of receiver grids are gathered in the same pass. They are
+/// sorted after the receivers of the partition, and their samples are
+/// recorded to the grid instead of the responses.
+///
+/// The velocity channels of B-format receivers are sorted before the
+/// receivers. They are gathered with gatherGradients() before the update of
+/// a step, when the neighbours of the node hold the level the stencil
+/// reads, halos included. The gathered central differences are integrated
+/// to the velocity when the ring is flushed.
+///
+/// With a resampler the responses are resampled as they are flushed, each
+/// receiver keeping the state of its filter, and the responses and the
+/// writer hold getNumSamples() samples at the output rate. The grids are
+/// recorded at the spatial fs.
+///
+/// Each partition uses only its own entries and ring and the receivers of
+/// the partitions are distinct, so the partitions can be gathered and
+/// flushed from different threads.
+///
+/// \tparam T The precision of the samples, float / double
+///////////////////////////////////////////////////////////////////////////////
+template <typename T>
+class ReceiverBank {
+public:
+  ReceiverBank()
+  : num_steps_(0),
+    num_samples_(0),
+    chunk_steps_(1),
+    gradient_scale_((T)1),
+    writer_((ResponseWriter*)NULL)
+  {};
+
+  ~ReceiverBank() {};
+
+  /////////////////////////////////////////////////////////////////////////////
+  /// \brief Clear the bank
+  /// \param num_partitions The number of partitions of the domain
+  /// \param num_steps The number of steps of the responses
+  /// \param chunk_steps The number of steps in a ring buffer
+  /////////////////////////////////////////////////////////////////////////////
+  void setup(unsigned int num_partitions, unsigned int num_steps,
+             unsigned int chunk_steps = 512) {
+    this->num_steps_ = num_steps;
+    this->num_samples_ = num_steps;
+    this->resampler_ = Resampler();
+    this->chunk_steps_ = std::max(1u, std::min(chunk_steps, num_steps));
+    this->partitions_.assign(num_partitions, Partition());
+    this->grids_.clear();
+  }
+
+  /////////////////////////////////////////////////////////////////////////////
+  /// \brief Add a receiver read from a partition
+  /// \param partition The partition updating the node of the receiver
+  /// \param element The local element index of the node in the partition
+  /// \param receiver The index of the receiver in the responses
+  /////////////////////////////////////////////////////////////////////////////
+  void addReceiver(unsigned int partition, unsigned int element, unsigned int receiver) {
+    Entry entry;
+    entry.element = element;
+    entry.receiver = receiver;
+    entry.grid = 0;
+    entry.offset = 0;
+    this->partitions_.at(partition).entries.push_back(entry);
+  }
+
+  /////////////////////////////////////////////////////////////////////////////
+  /// \brief Add a velocity channel of a B-format receiver. The neighbours
+  /// of the node have to be in the memory of the partition
+  /// \param partition The partition updating the node of the receiver
+  /// \param element The local element index of the node in the partition
+  /// \param receiver The index of the receiver in the responses
+  /// \param offset The distance of the neighbours along the axis of the
+  /// channel in elements, 1, dim_x or dim_xy
+  /////////////////////////////////////////////////////////////////////////////
+  void addGradient(unsigned int partition, unsigned int element, unsigned int receiver,
+                   unsigned int offset) {
+    Entry entry;
+    entry.element = element;
+    entry.receiver = receiver;
+    entry.grid = 0;
+    entry.offset = offset;
+    this->partitions_.at(partition).entries.push_back(entry);
+  }
+
+  /// The velocity is integrated from the differences scaled with the
+  /// Courant number
+  void setGradientScale(T scale) {this->gradient_scale_ = scale;}
+
+  /////////////////////////////////////////////////////////////////////////////
+  /// \brief Add a receiver grid, its points are added with addGridPlane
+  /// \param grid A grid set up for the run, not owned
+  /// \return The index of the grid in the bank
+  /////////////////////////////////////////////////////////////////////////////
+  unsigned int addGrid(ReceiverGrid* grid) {
+    this->grids_.push_back(grid);
+    return (unsigned int)this->grids_.size()-1;
+  }
+
+  /////////////////////////////////////////////////////////////////////////////
+  /// \brief Add the points of an xy-plane of a grid. The plane lies in one
+  /// partition, so the node of its first point is looked up once and the
+  /// rest are offsets from it.
+  /// \param partition The partition updating the plane
+  /// \param element The local element index of the first point of the plane
+  /// \param grid The index of the grid in the bank
+  /// \param z The plane of points
+  /// \param dim_x The x dimension of the domain
+  /////////////////////////////////////////////////////////////////////////////
+  void addGridPlane(unsigned int partition, unsigned int element, unsigned int grid,
+                    unsigned int z, unsigned int dim_x) {
+    const ReceiverGrid* g = this->grids_.at(grid);
+    unsigned int stride = g->getStrideNodes();
+    unsigned int nx = g->getNumPointsX();
+    unsigned int ny = g->getNumPointsY();
+    std::vector<Entry>& entries = this->partitions_.at(partition).entries;
+    Entry entry;
+    entry.grid = grid+1;
+    entry.offset = 0;
+    for(unsigned int y = 0; y < ny; y++) {
+      for(unsigned int x = 0; x < nx; x++) {
+        entry.element = element+(y*dim_x+x)*stride;
+        entry.receiver = (z*ny+y)*nx+x;
+        entries.push_back(entry);
+      }
+    }
+  }
+
+  /////////////////////////////////////////////////////////////////////////////
+  /// \brief Resample the responses, called after setup()
+  /// \param resampler The resampler from the spatial fs to the output rate
+  /////////////////////////////////////////////////////////////////////////////
+  void setResampler(const Resampler& resampler) {
+    this->resampler_ = resampler;
+    this->num_samples_ = (unsigned int)resampler.getNumOutputSamples(this->num_steps_);
+  }
+
+  /////////////////////////////////////////////////////////////////////////////
+  /// \brief Set the writer the flushed chunks are streamed to
+  /// \param writer An open writer, NULL for none
+  /////////////////////////////////////////////////////////////////////////////
+  void setWriter(ResponseWriter* writer) {this->writer_ = writer;}
+
+  /////////////////////////////////////////////////////////////////////////////
+  /// \brief Sort the receivers of each partition by element and allocate
+  /// the ring buffers, called after the receivers are added
+  /////////////////////////////////////////////////////////////////////////////
+  void compile() {
+    unsigned int num_receivers = 0;
+    for(unsigned int p = 0; p < this->partitions_.size(); p++) {
+      Partition& part = this->partitions_.at(p);
+      std::stable_sort(part.entries.begin(), part.entries.end());
+      part.element_idx.resize(part.entries.size());
+      part.receiver_idx.resize(part.entries.size());
+      part.minus_idx.clear();
+      part.num_responses = 0;
+      for(unsigned int i = 0; i < part.entries.size(); i++) {
+        const Entry& entry = part.entries.at(i);
+        part.element_idx.at(i) = entry.element+entry.offset;
+        part.receiver_idx.at(i) = entry.receiver;
+        if(entry.offset)
+          part.minus_idx.push_back(entry.element-entry.offset);
+        if(entry.grid == 0)
+          part.num_responses++;
+      }
+      part.velocity.assign(part.minus_idx.size(), (T)0);
+      part.ring.assign((size_t)part.entries.size()*this->chunk_steps_, (T)0);
+      part.history.assign(this->resampler_.isEnabled()
+                          ? (size_t)part.num_responses*this->resampler_.getHistoryLength() : 0, 0.0);
+      num_receivers += part.num_responses;
+    }
+    // A flush writes at most two chunks of the writer, a partition does
+    // not wait for the flush of another one
+    unsigned int writer_chunk = this->chunk_steps_;
+    for(unsigned int first = 0; this->resampler_.isEnabled() && first < this->num_steps_;
+        first += this->chunk_steps_) {
+      unsigned int last = std::min(first+this->chunk_steps_, this->num_steps_);
+      writer_chunk = std::max(writer_chunk,
+                              (unsigned int)(this->resampler_.getNumAvailable(last, this->num_steps_)-
+                                             this->resampler_.getNumAvailable(first, this->num_steps_)));
+    }
+    if(this->writer_)
+      this->writer_->begin(this->num_samples_, writer_chunk, num_receivers);
+  }
+
+  unsigned int getNumberOfPartitions() const {return (unsigned int)this->partitions_.size();}
+  unsigned int getNumSteps() const {return this->num_steps_;}
+
+  /// The number of samples in a response, num_steps without a resampler
+  unsigned int getNumSamples() const {return this->num_samples_;}
+  unsigned int getChunkSteps() const {return this->chunk_steps_;}
+
+  /// The receivers and grid points gathered from a partition
+  unsigned int getNumberOfReceivers(unsigned int partition) const
+    {return (unsigned int)this->partitions_.at(partition).entries.size();}
+
+  /// The velocity channels of a partition, the first entries of the ring
+  unsigned int getNumberOfGradients(unsigned int partition) const
+    {return (unsigned int)this->partitions_.at(partition).minus_idx.size();}
+
+  /// Local element indices of a partition. The velocity channels first,
+  /// with the index of the neighbour in the positive direction, then the
+  /// rest in ascending order
+  const std::vector<unsigned int>& getElementIndices(unsigned int partition) const
+    {return this->partitions_.at(partition).element_idx;}
+
+  /// The neighbours in the negative direction of the velocity channels
+  const std::vector<unsigned int>& getMinusIndices(unsigned int partition) const
+    {return this->partitions_.at(partition).minus_idx;}
+
+  /// The ring buffer of a partition, chunk_steps*num_receivers
+  T* getRing(unsigned int partition)
+    {return this->partitions_.at(partition).ring.empty() ? (T*)NULL
+                                                         : &this->partitions_.at(partition).ring[0];}
+
+  /// The position of a step in the ring
+  unsigned int getSlot(unsigned int step) const {return step%this->chunk_steps_;}
+
+  /// True if the ring is flushed after the step
+  bool isChunkEnd(unsigned int step) const
+    {return (step+1)%this->chunk_steps_ == 0 || step+1 == this->num_steps_;}
+
+  /////////////////////////////////////////////////////////////////////////////
+  /// \brief Read the receivers and grid points of a partition to the ring
+  /// buffer, called after the update of a step
+  /// \param P The pressures of the partition
+  /// \param partition The partition
+  /// \param step The current step
+  /////////////////////////////////////////////////////////////////////////////
+  void gather(const T* P, unsigned int partition, unsigned int step) {
+    Partition& part = this->partitions_.at(partition);
+    size_t num = part.element_idx.size();
+    if(num == 0)
+      return;
+    const unsigned int* elements = &part.element_idx[0];
+    T* dest = &part.ring[(size_t)this->getSlot(step)*num];
+    for(size_t i = part.minus_idx.size(); i < num; i++)
+      dest[i] = P[elements[i]];
+  }
+
+  /////////////////////////////////////////////////////////////////////////////
+  /// \brief Read the central differences of the velocity channels of a
+  /// partition to the ring buffer, called before the update of a step
+  /// \param P The pressures of the partition, the level read by the update
+  /// \param partition The partition
+  /// \param step The current step
+  /////////////////////////////////////////////////////////////////////////////
+  void gatherGradients(const T* P, unsigned int partition, unsigned int step) {
+    Partition& part = this->partitions_.at(partition);
+    size_t num = part.minus_idx.size();
+    if(num == 0)
+      return;
+    const unsigned int* plus = &part.element_idx[0];
+    const unsigned int* minus = &part.minus_idx[0];
+    T* dest = &part.ring[(size_t)this->getSlot(step)*part.element_idx.size()];
+    for(size_t i = 0; i < num; i++)
+      dest[i] = (P[plus[i]]-P[minus[i]])*(T)0.5;
+  }
+
+  /////////////////////////////////////////////////////////////////////////////
+  /// \brief Copy the chunk of the ring ending at a step to the responses
+  /// \param partition The partition
+  /// \param step The last step gathered to the ring
+  /// \param h_return_ptr The responses, num_receivers*getNumSamples(), NULL
+  /// if the responses are only streamed to the writer
+  /////////////////////////////////////////////////////////////////////////////
+  void flush(unsigned int partition, unsigned int step, T* h_return_ptr) {
+    Partition& part = this->partitions_.at(partition);
+    size_t num = part.entries.size();
+    unsigned int first = step-this->getSlot(step);
+    unsigned int count = step-first+1;
+    for(size_t i = 0; i < part.minus_idx.size(); i++) {
+      T velocity = part.velocity[i];
+      for(unsigned int k = 0; k < count; k++) {
+        velocity += this->gradient_scale_*part.ring[(size_t)k*num+i];
+        part.ring[(size_t)k*num+i] = velocity;
+      }
+      part.velocity[i] = velocity;
+    }
+    for(size_t i = part.num_responses; i < num; i++) {
+      const Entry& entry = part.entries[i];
+      this->grids_[entry.grid-1]->record(entry.receiver, first, count, &part.ring[i], num);
+    }
+    if(part.num_responses == 0)
+      return;
+
+    // The resampled samples replace the chunk, channel by channel
+    const T* samples = &part.ring[0];
+    size_t step_stride = num;
+    size_t channel_stride = 1;
+    if(this->resampler_.isEnabled()) {
+      size_t k = this->resampler_.getHistoryLength();
+      size_t out_first = this->resampler_.getNumAvailable(first, this->num_steps_);
+      size_t out_count = this->resampler_.getNumAvailable(first+count, this->num_steps_)-out_first;
+      part.resampled.resize(std::max((size_t)1, part.num_responses*out_count));
+      for(size_t i = 0; i < part.num_responses; i++)
+        this->resampler_.process(&part.history[i*k], &part.ring[i], num, first, count,
+                                 this->num_steps_, &part.resampled[i*out_count]);
+      samples = &part.resampled[0];
+      step_stride = 1;
+      channel_stride = out_count;
+      first = (unsigned int)out_first;
+      count = (unsigned int)out_count;
+    }
+
+    if(this->writer_)
+      this->writer_->write(first, count, &part.receiver_idx[0], part.num_responses,
+                           samples, step_stride, channel_stride);
+    if(!h_return_ptr)
+      return;
+    for(size_t i = 0; i < part.num_responses; i++) {
+      T* dest = h_return_ptr+(size_t)part.entries[i].receiver*this->num_samples_+first;
+      const T* src = samples+i*channel_stride;
+      for(unsigned int k = 0; k < count; k++)
+        dest[k] = src[(size_t)k*step_stride];
+    }
+  }
+
+  /////////////////////////////////////////////////////////////////////////////
+  /// \brief Write the response of a receiver recorded outside the bank,
+  /// resampled as the responses of the bank
+  /// \param receiver The index of the receiver in the responses
+  /// \param samples The response at the spatial fs, num_steps samples
+  /// \param h_return_ptr The responses, num_receivers*getNumSamples()
+  /////////////////////////////////////////////////////////////////////////////
+  void writeResponse(unsigned int receiver, const T* samples, T* h_return_ptr) const {
+    T* dest = h_return_ptr+(size_t)receiver*this->num_samples_;
+    if(this->resampler_.isEnabled()) {
+      this->resampler_.resample(samples, this->num_steps_, dest);
+      return;
+    }
+    for(unsigned int k = 0; k < this->num_steps_; k++)
+      dest[k] = samples[k];
+  }
+
+private:
+  struct Entry {
+    unsigned int element;
+    unsigned int receiver;      ///< The receiver, or the point of a grid
+    unsigned int grid;          ///< 0 for a receiver, the grid+1 otherwise
+    unsigned int offset;        ///< The neighbour of a velocity channel, 0 otherwise
+    // Velocity channels, receivers, grid points
+    unsigned int getKind() const {return this->grid ? 2 : (this->offset ? 0 : 1);}
+    bool operator<(const Entry& other) const {
+      if(this->getKind() != other.getKind())
+        return this->getKind() < other.getKind();
+      return this->element < other.element;
+    }
+  };
+
+  struct Partition {
+    Partition() : num_responses(0) {};
+    std::vector<Entry> entries;
+    unsigned int num_responses;   ///< The velocity channels and receivers before the grid points
+    std::vector<unsigned int> element_idx;
+    std::vector<unsigned int> receiver_idx;
+    std::vector<unsigned int> minus_idx;
+    std::vector<T> velocity;      ///< The integrated velocity channels
+    std::vector<T> ring;
+    std::vector<double> history;  ///< The resampler states of the responses
+    std::vector<T> resampled;     ///< The resampled chunk, receiver-major
+  };
+
+  unsigned int num_steps_;
+  unsigned int num_samples_;    ///< Samples per response at the output rate
+  unsigned int chunk_steps_;
+  T gradient_scale_;
+  Resampler resampler_;
+  ResponseWriter* writer_;
+  std::vector<ReceiverGrid*> grids_;
+  std::vector<Partition> partitions_;
+};
+
+#endif
@@ -0,0 +1,242 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// This file is a part of the PadallelFDTD Finite-Difference Time-Domain
+// simulation library. It is released under the MIT License. You should have
+// received a copy of the MIT License along with ParallelFDTD.  If not, see
+// http://www.opensource.org/licenses/mit-license.php
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// For details, see the LICENSE file
+//
+// (C) 2013-2014 Jukka Saarelma
+// Aalto University School of Science
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "ReceiverGrid.h"
+#include "../logger.h"
+
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+
+namespace {
+  // IEEE half precision, rounded to the nearest even
+  unsigned short floatToHalf(float value) {
+    unsigned int bits;
+    memcpy(&bits, &value, sizeof(bits));
+    unsigned int sign = (bits>>16)&0x8000u;
+    int exponent = (int)((bits>>23)&0xFFu);
+    unsigned int mantissa = bits&0x7FFFFFu;
+    if(exponent == 0xFF)
+      return (unsigned short)(sign|0x7C00u|(mantissa ? 0x200u : 0u));
+    int e = exponent-127+15;
+    if(e >= 0x1F)
+      return (unsigned short)(sign|0x7C00u);
+    if(e <= 0) {
+      if(e < -10)
+        return (unsigned short)sign;
+      mantissa |= 0x800000u;
+      unsigned int shift = (unsigned int)(14-e);
+      unsigned int half = mantissa>>shift;
+      unsigned int rem = mantissa&((1u<<shift)-1u);
+      unsigned int mid = 1u<<(shift-1);
+      if(rem > mid || (rem == mid && (half&1u)))
+        half++;
+      return (unsigned short)(sign|half);
+    }
+    // A carry out of the mantissa rounds up the exponent
+    unsigned int half = ((unsigned int)e<<10)|(mantissa>>13);
+    unsigned int rem = mantissa&0x1FFFu;
+    if(rem > 0x1000u || (rem == 0x1000u && (half&1u)))
+      half++;
+    return (unsigned short)(sign|half);
+  }
+
+  float halfToFloat(unsigned short half) {
+    unsigned int sign = ((unsigned int)half&0x8000u)<<16;
+    unsigned int e = ((unsigned int)half>>10)&0x1Fu;
+    unsigned int m = (unsigned int)half&0x3FFu;
+    if(e == 0) {
+      float value = (float)ldexp((double)m, -24);
+      return sign ? -value : value;
+    }
+    unsigned int bits = (e == 0x1F) ? (sign|0x7F800000u|(m<<13))
+                                    : (sign|((e+112u)<<23)|(m<<13));
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+  }
+
+  // The bits of a float mapped to an unsigned integer in the order of the
+  // values, so close values have a small difference
+  unsigned int toOrdered(float value) {
+    unsigned int bits;
+    memcpy(&bits, &value, sizeof(bits));
+    return (bits&0x80000000u) ? ~bits : (bits|0x80000000u);
+  }
+
+  float fromOrdered(unsigned int ordered) {
+    unsigned int bits = (ordered&0x80000000u) ? (ordered&0x7FFFFFFFu) : ~ordered;
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+  }
+
+  const unsigned int ordered_zero = 0x80000000u;
+
+  // The zigzag coded difference as 7 bit groups, low group first
+  void putDelta(std::vector<unsigned char>& stream, unsigned int last, unsigned int ordered) {
+    int delta = (int)(ordered-last);
+    unsigned int code = ((unsigned int)delta<<1)^(unsigned int)(delta>>31);
+    while(code >= 0x80u) {
+      stream.push_back((unsigned char)(code|0x80u));
+      code >>= 7;
+    }
+    stream.push_back((unsigned char)code);
+  }
+
+  unsigned int getDelta(const std::vector<unsigned char>& stream, size_t& pos, unsigned int last) {
+    unsigned int code = 0;
+    unsigned int shift = 0;
+    while(pos < stream.size()) {
+      unsigned char byte = stream[pos++];
+      code |= (unsigned int)(byte&0x7Fu)<<shift;
+      shift += 7;
+      if(!(byte&0x80u))
+        break;
+    }
+    int delta = (int)(code>>1)^-(int)(code&1u);
+    return last+(unsigned int)delta;
+  }
+
+  // The first node and the number of points along an axis
+  void snapAxis(float min, float max, float dx, int pad, unsigned int stride,
+                unsigned int dim, int& origin, unsigned int& count) {
+    int first = (int)nv::ROUND(min/dx)+pad;
+    int last = (int)nv::ROUND(max/dx)+pad;
+    if(first < 0)
+      first += ((-first+(int)stride-1)/(int)stride)*(int)stride;
+    last = std::min(last, (int)dim-1);
+    origin = first;
+    count = (last >= first) ? (unsigned int)(last-first)/stride+1 : 0;
+  }
+}
+
+ReceiverGrid::ReceiverGrid(float min_x, float min_y, float min_z,
+                           float max_x, float max_y, float max_z,
+                           float stride, enum GridEncoding encoding,
+                           unsigned int decimation)
+: min_(std::min(min_x, max_x), std::min(min_y, max_y), std::min(min_z, max_z)),
+  max_(std::max(min_x, max_x), std::max(min_y, max_y), std::max(min_z, max_z)),
+  encoding_(encoding),
+  decimation_(std::max(1u, decimation)),
+  stride_(stride),
+  num_steps_(0),
+  num_samples_(0),
+  stride_nodes_(1)
+{
+  this->counts_[0] = this->counts_[1] = this->counts_[2] = 0;
+}
+
+void ReceiverGrid::setup(float dx, bool padding, unsigned int num_steps,
+                         unsigned int dim_x, unsigned int dim_y, unsigned int dim_z) {
+  int pad = padding ? 1 : 0;
+  this->stride_nodes_ = std::max(1u, (unsigned int)nv::ROUND(this->stride_/dx));
+  snapAxis(this->min_.x, this->max_.x, dx, pad, this->stride_nodes_, dim_x,
+           this->origin_.x, this->counts_[0]);
+  snapAxis(this->min_.y, this->max_.y, dx, pad, this->stride_nodes_, dim_y,
+           this->origin_.y, this->counts_[1]);
+  snapAxis(this->min_.z, this->max_.z, dx, pad, this->stride_nodes_, dim_z,
+           this->origin_.z, this->counts_[2]);
+
+  this->num_steps_ = num_steps;
+  this->num_samples_ = (num_steps+this->decimation_-1)/this->decimation_;
+  unsigned int num_points = this->getNumPoints();
+  size_t total = (size_t)num_points*this->num_samples_;
+  this->sums_.assign(num_points, 0.0);
+  this->float32_.clear();
+  this->float16_.clear();
+  this->delta_.clear();
+  this->last_.clear();
+  if(this->encoding_ == GRID_FLOAT32)
+    this->float32_.assign(total, 0.f);
+  else if(this->encoding_ == GRID_FLOAT16)
+    this->float16_.assign(total, (unsigned short)0);
+  else {
+    this->delta_.assign(num_points, std::vector<unsigned char>());
+    this->last_.assign(num_points, ordered_zero);
+  }
+
+  log_msg<LOG_INFO>(L"ReceiverGrid::setup - %u x %u x %u points, stride %u nodes")
+                    %this->counts_[0] %this->counts_[1] %this->counts_[2] %this->stride_nodes_;
+}
+
+nv::Vec3i ReceiverGrid::getPointElementCoordinates(unsigned int point) const {
+  unsigned int x = point%this->counts_[0];
+  unsigned int y = (point/this->counts_[0])%this->counts_[1];
+  unsigned int z = point/(this->counts_[0]*this->counts_[1]);
+  return nv::Vec3i(this->origin_.x+(int)(x*this->stride_nodes_),
+                   this->origin_.y+(int)(y*this->stride_nodes_),
+                   this->origin_.z+(int)(z*this->stride_nodes_));
+}
+
+void ReceiverGrid::store(unsigned int point, unsigned int sample, float value) {
+  if(sample >= this->num_samples_)
+    return;
+  size_t idx = (size_t)point*this->num_samples_+sample;
+  if(this->encoding_ == GRID_FLOAT32) {
+    this->float32_[idx] = value;
+  }
+  else if(this->encoding_ == GRID_FLOAT16) {
+    this->float16_[idx] = floatToHalf(value);
+  }
+  else {
+    unsigned int ordered = toOrdered(value);
+    putDelta(this->delta_[point], this->last_[point], ordered);
+    this->last_[point] = ordered;
+  }
+}
+
+std::vector<float> ReceiverGrid::getResponse(unsigned int point) const {
+  std::vector<float> ret(this->num_samples_, 0.f);
+  if(point >= this->getNumPoints()) {
+    log_msg<LOG_WARNING>(L"ReceiverGrid::getResponse - point %u out of range") %point;
+    return ret;
+  }
+  size_t first = (size_t)point*this->num_samples_;
+  if(this->encoding_ == GRID_FLOAT32) {
+    std::copy(this->float32_.begin()+first, this->float32_.begin()+first+this->num_samples_,
+              ret.begin());
+  }
+  else if(this->encoding_ == GRID_FLOAT16) {
+    for(unsigned int i = 0; i < this->num_samples_; i++)
+      ret[i] = halfToFloat(this->float16_[first+i]);
+  }
+  else {
+    // An interrupted run leaves the rest of the samples zero
+    const std::vector<unsigned char>& stream = this->delta_[point];
+    size_t pos = 0;
+    unsigned int ordered = ordered_zero;
+    for(unsigned int i = 0; i < this->num_samples_ && pos < stream.size(); i++) {
+      ordered = getDelta(stream, pos, ordered);
+      ret[i] = fromOrdered(ordered);
+    }
+  }
+  return ret;
+}
+
+size_t ReceiverGrid::getStorageBytes() const {
+  size_t bytes = this->float32_.size()*sizeof(float)+
+                 this->float16_.size()*sizeof(unsigned short);
+  for(unsigned int i = 0; i < this->delta_.size(); i++)
+    bytes += this->delta_[i].size();
+  return bytes;
+}
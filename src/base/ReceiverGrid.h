@@ -0,0 +1,168 @@
+#ifndef RECEIVER_GRID_H
+#define RECEIVER_GRID_H
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// This file is a part of the PadallelFDTD Finite-Difference Time-Domain
+// simulation library. It is released under the MIT License. You should have
+// received a copy of the MIT License along with ParallelFDTD.  If not, see
+// http://www.opensource.org/licenses/mit-license.php
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// For details, see the LICENSE file
+//
+// (C) 2013-2014 Jukka Saarelma
+// Aalto University School of Science
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "../math/geomMath.h"
+#include <vector>
+#include <stddef.h>
+
+enum GridEncoding {GRID_FLOAT32, GRID_FLOAT16, GRID_DELTA};
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief Receivers on a regular sub-grid of the domain, for spatial maps.
+///
+/// The grid is given by a region and a stride in meters. The region is
+/// snapped to the nodes of the domain when a run is set up and clipped to
+/// the domain. The points are numbered x fastest, then y, then z.
+///
+/// The responses are stored in a compact form while they are recorded:
+///  - GRID_FLOAT32 32 bit floats
+///  - GRID_FLOAT16 IEEE half precision floats, half the memory, ~3 decimal
+///    digits
+///  - GRID_DELTA the difference to the previous sample of the point as a
+///    variable length integer, lossless with respect to the float samples.
+///    Smooth responses and the silence before the direct sound take 1-2
+///    bytes per sample
+///
+/// With a decimation of N the response holds the mean of each N steps, so
+/// the map is low passed before it is decimated.
+///
+/// Each point is recorded by a single partition, different points can be
+/// recorded from different threads.
+///////////////////////////////////////////////////////////////////////////////
+class ReceiverGrid {
+public:
+  ReceiverGrid()
+  : encoding_(GRID_FLOAT16),
+    decimation_(1),
+    stride_(1.f),
+    num_steps_(0),
+    num_samples_(0),
+    stride_nodes_(1)
+  {
+    this->counts_[0] = this->counts_[1] = this->counts_[2] = 0;
+  };
+
+  /////////////////////////////////////////////////////////////////////////////
+  /// \param min_x, min_y, min_z The lower corner of the region in meters
+  /// \param max_x, max_y, max_z The upper corner of the region in meters
+  /// \param stride The distance of the points in meters, rounded to a
+  /// multiple of the grid spacing
+  /// \param encoding The storage of the responses
+  /// \param decimation The number of steps averaged to a sample, >= 1
+  /////////////////////////////////////////////////////////////////////////////
+  ReceiverGrid(float min_x, float min_y, float min_z,
+               float max_x, float max_y, float max_z,
+               float stride, enum GridEncoding encoding = GRID_FLOAT16,
+               unsigned int decimation = 1);
+
+  ~ReceiverGrid() {};
+
+  /////////////////////////////////////////////////////////////////////////////
+  /// \brief Snap the region to the domain and clear the responses
+  /// \param dx The grid spacing
+  /// \param padding Offset the nodes by the padding layer of the domain
+  /// \param num_steps The number of steps of the run
+  /// \param dim_x, dim_y, dim_z The dimensions of the domain
+  /////////////////////////////////////////////////////////////////////////////
+  void setup(float dx, bool padding, unsigned int num_steps,
+             unsigned int dim_x, unsigned int dim_y, unsigned int dim_z);
+
+  /////////////////////////////////////////////////////////////////////////////
+  /// \brief Record samples of a point, the steps of a point have to be
+  /// recorded in order
+  /// \param point The point
+  /// \param first_step The step of the first sample
+  /// \param num_steps The number of samples
+  /// \param samples The samples
+  /// \param stride The distance of consecutive samples
+  /////////////////////////////////////////////////////////////////////////////
+  template <typename T>
+  void record(unsigned int point, unsigned int first_step, unsigned int num_steps,
+              const T* samples, size_t stride) {
+    double& sum = this->sums_[point];
+    for(unsigned int k = 0; k < num_steps; k++) {
+      unsigned int step = first_step+k;
+      sum += (double)samples[k*stride];
+      if((step+1)%this->decimation_ != 0 && step+1 != this->num_steps_)
+        continue;
+      unsigned int count = step%this->decimation_+1;
+      this->store(point, step/this->decimation_, (float)(sum/count));
+      sum = 0.0;
+    }
+  }
+
+  enum GridEncoding getEncoding() const {return this->encoding_;}
+  unsigned int getDecimation() const {return this->decimation_;}
+
+  /// The number of points, 0 before setup or if the region is outside
+  /// the domain
+  unsigned int getNumPoints() const
+    {return this->counts_[0]*this->counts_[1]*this->counts_[2];}
+  unsigned int getNumPointsX() const {return this->counts_[0];}
+  unsigned int getNumPointsY() const {return this->counts_[1];}
+  unsigned int getNumPointsZ() const {return this->counts_[2];}
+  unsigned int getStrideNodes() const {return this->stride_nodes_;}
+
+  /// The node of the first point of an xy-plane of points
+  nv::Vec3i getPlaneOrigin(unsigned int z) const {
+    return nv::Vec3i(this->origin_.x, this->origin_.y,
+                     this->origin_.z+(int)(z*this->stride_nodes_));
+  }
+
+  /// The node of a point
+  nv::Vec3i getPointElementCoordinates(unsigned int point) const;
+
+  /// The number of samples in a response
+  unsigned int getNumSamples() const {return this->num_samples_;}
+
+  /// The decoded response of a point
+  std::vector<float> getResponse(unsigned int point) const;
+
+  /// The memory used by the responses in bytes
+  size_t getStorageBytes() const;
+
+private:
+  void store(unsigned int point, unsigned int sample, float value);
+
+  nv::Vec3f min_;
+  nv::Vec3f max_;
+  enum GridEncoding encoding_;
+  unsigned int decimation_;
+  float stride_;
+
+  unsigned int num_steps_;
+  unsigned int num_samples_;
+  nv::Vec3i origin_;                           ///< The node of the first point
+  unsigned int stride_nodes_;
+  unsigned int counts_[3];
+
+  std::vector<double> sums_;                   ///< Steps summed for the next sample
+  std::vector<float> float32_;                 ///< point*num_samples+sample
+  std::vector<unsigned short> float16_;        ///< point*num_samples+sample
+  std::vector< std::vector<unsigned char> > delta_; ///< The byte stream of each point
+  std::vector<unsigned int> last_;             ///< The last ordered sample of each point
+};
+
+#endif
@@ -0,0 +1,130 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// This file is a part of the PadallelFDTD Finite-Difference Time-Domain
+// simulation library. It is released under the MIT License. You should have
+// received a copy of the MIT License along with ParallelFDTD.  If not, see
+// http://www.opensource.org/licenses/mit-license.php
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// For details, see the LICENSE file
+//
+// (C) 2013-2014 Jukka Saarelma
+// Aalto University School of Science
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "Reciprocity.h"
+#include "Convolution.h"
+
+ReciprocityPlan::ReciprocityPlan(const SimulationParameters& sp)
+: parameters_(sp),
+  num_sources_(sp.getNumSources()),
+  num_receivers_(sp.getNumReceivers()),
+  num_steps_(sp.getNumSteps()),
+  num_samples_(sp.getNumOutputSamples()),
+  reciprocal_(sp.getNumSources() > sp.getNumReceivers()),
+  resampler_(sp.getResampler())
+{
+  this->parameters_.setResponseWriter((ResponseWriter*)NULL);
+  this->parameters_.setOutputFs(0);
+  this->pair_responses_.assign((size_t)this->num_sources_*this->num_receivers_*this->num_samples_, 0.0);
+
+  // The reciprocal runs give impulse responses, the input signals are
+  // applied afterwards. The IMPULSE input is one at step 1, the signals
+  // are read from step 0 so that the convolution is one sample late.
+  if(this->reciprocal_) {
+    this->inputs_.resize(this->num_sources_);
+    for(unsigned int s = 0; s < this->num_sources_; s++) {
+      this->inputs_.at(s).resize(this->num_steps_+1);
+      for(unsigned int i = 0; i <= this->num_steps_; i++)
+        this->inputs_.at(s).at(i) = this->parameters_.getSourceSampleDouble(s, i);
+    }
+  }
+}
+
+bool ReciprocityPlan::isSupported(const SimulationParameters& sp) {
+  if(sp.getNumSources() == 0 || sp.getNumReceivers() == 0)
+    return false;
+  if(sp.getNumArraySources() > 0 || sp.getNumReceiverGrids() > 0)
+    return false;
+
+  for(unsigned int i = 0; i < sp.getNumSources(); i++) {
+    if(sp.getSource(i).getSourceType() == SRC_HARD || sp.isSourceMoving(i))
+      return false;
+  }
+
+  for(unsigned int i = 0; i < sp.getNumReceivers(); i++) {
+    if(sp.getReceiverComponent(i) != RECEIVER_PRESSURE || sp.isReceiverMoving(i))
+      return false;
+  }
+  return true;
+}
+
+SimulationParameters ReciprocityPlan::getRunParameters(unsigned int run) const {
+  SimulationParameters sp = this->parameters_;
+
+  if(!this->reciprocal_) {
+    for(unsigned int i = this->num_sources_; i > 0; i--)
+      if(i-1 != run)
+        sp.removeSource(i-1);
+    return sp;
+  }
+
+  nv::Vec3f p = sp.getReceiver(run).getP();
+  for(unsigned int i = this->num_sources_; i > 0; i--)
+    sp.removeSource(i-1);
+  for(unsigned int i = this->num_receivers_; i > 0; i--)
+    sp.removeReceiver(i-1);
+
+  sp.addSource(Source(p.x, p.y, p.z, SRC_SOFT, IMPULSE, 0));
+  for(unsigned int i = 0; i < this->num_sources_; i++) {
+    nv::Vec3f q = this->parameters_.getSource(i).getP();
+    sp.addReceiver(q.x, q.y, q.z);
+  }
+  return sp;
+}
+
+void ReciprocityPlan::addRunResponses(unsigned int run, const std::vector<double>& responses) {
+  size_t n = this->num_steps_;
+
+  if(!this->reciprocal_) {
+    for(unsigned int r = 0; r < this->num_receivers_; r++)
+      this->setPairResponse(run, r, &responses.at(r*n));
+    return;
+  }
+
+  for(unsigned int s = 0; s < this->num_sources_; s++) {
+    std::vector<double> h(responses.begin()+s*n, responses.begin()+(s+1)*n);
+    std::vector<double> y = fftConvolve(h, this->inputs_.at(s), n+1);
+    this->setPairResponse(s, run, &y.at(1));
+  }
+}
+
+void ReciprocityPlan::setPairResponse(unsigned int source, unsigned int receiver,
+                                      const double* response) {
+  double* dest = &this->pair_responses_.at(((size_t)source*this->num_receivers_+receiver)*
+                                           this->num_samples_);
+  if(this->resampler_.isEnabled()) {
+    this->resampler_.resample(response, this->num_steps_, dest);
+    return;
+  }
+  for(size_t i = 0; i < this->num_steps_; i++)
+    dest[i] = response[i];
+}
+
+std::vector<double> ReciprocityPlan::getPairResponse(unsigned int source,
+                                                     unsigned int receiver) const {
+  if(source >= this->num_sources_ || receiver >= this->num_receivers_)
+    return std::vector<double>();
+  size_t n = this->num_samples_;
+  size_t first = ((size_t)source*this->num_receivers_+receiver)*n;
+  return std::vector<double>(this->pair_responses_.begin()+first,
+                             this->pair_responses_.begin()+first+n);
+}
@@ -0,0 +1,143 @@
+#ifndef RECIPROCITY_H
+#define RECIPROCITY_H
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// This file is a part of the PadallelFDTD Finite-Difference Time-Domain
+// simulation library. It is released under the MIT License. You should have
+// received a copy of the MIT License along with ParallelFDTD.  If not, see
+// http://www.opensource.org/licenses/mit-license.php
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// For details, see the LICENSE file
+//
+// (C) 2013-2014 Jukka Saarelma
+// Aalto University School of Science
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "SimulationParameters.h"
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief Splits a simulation with several sources into runs that give the
+/// response of each source-receiver pair, swapping the sources and the
+/// receivers when there are more sources.
+///
+/// The update is symmetric, so the response at B to a soft source at A
+/// equals the response at A to the same source at B. With S sources and
+/// R receivers the pairs take min(S, R) runs:
+///  - S <= R, each source is run alone and recorded at all the receivers
+///  - S > R, each receiver is an IMPULSE source and the receivers are
+///    at the source positions. The response of a pair is the recorded
+///    impulse response convolved with the input signal of the source
+///
+/// The sources have to be soft or transparent, and the positions static
+/// pressure receivers, see isSupported(). The runs record at the spatial
+/// fs, the pair responses are resampled to the output fs of the parameters.
+///////////////////////////////////////////////////////////////////////////////
+class ReciprocityPlan {
+public:
+  ReciprocityPlan()
+  : num_sources_(0),
+    num_receivers_(0),
+    num_steps_(0),
+    num_samples_(0),
+    reciprocal_(false)
+  {};
+
+  /////////////////////////////////////////////////////////////////////////////
+  /// \param sp The parameters of the simulation, copied
+  /////////////////////////////////////////////////////////////////////////////
+  ReciprocityPlan(const SimulationParameters& sp);
+
+  ~ReciprocityPlan() {};
+
+  /////////////////////////////////////////////////////////////////////////////
+  /// \brief Check if the runs of the parameters can be split to pairs
+  /// \return false with hard or array sources, moving positions, B-format
+  /// channels, receiver grids or no sources or receivers
+  /////////////////////////////////////////////////////////////////////////////
+  static bool isSupported(const SimulationParameters& sp);
+
+  /// \return true if the sources and the receivers are swapped
+  bool isReciprocal() const {return this->reciprocal_;}
+  unsigned int getNumRuns() const
+    {return this->reciprocal_ ? this->num_receivers_ : this->num_sources_;}
+
+  /////////////////////////////////////////////////////////////////////////////
+  /// \brief The parameters of a run, the response writer is not copied
+  /// \param run The index of the run
+  /////////////////////////////////////////////////////////////////////////////
+  SimulationParameters getRunParameters(unsigned int run) const;
+
+  /////////////////////////////////////////////////////////////////////////////
+  /// \brief Store the responses of a run
+  /// \param run The index of the run
+  /// \param responses The responses of the run receivers, num_steps each
+  /////////////////////////////////////////////////////////////////////////////
+  template <typename T>
+  void addRunResponses(unsigned int run, const T* responses) {
+    size_t n = this->num_steps_;
+    unsigned int num_run_receivers = this->reciprocal_ ? this->num_sources_
+                                                       : this->num_receivers_;
+    std::vector<double> run_responses(n*num_run_receivers);
+    for(size_t i = 0; i < run_responses.size(); i++)
+      run_responses.at(i) = (double)responses[i];
+    this->addRunResponses(run, run_responses);
+  }
+
+  void addRunResponses(unsigned int run, const std::vector<double>& responses);
+
+  /////////////////////////////////////////////////////////////////////////////
+  /// \brief The response of a source-receiver pair
+  /// \return getNumSamples() samples, empty if the indices are out of range
+  /////////////////////////////////////////////////////////////////////////////
+  std::vector<double> getPairResponse(unsigned int source, unsigned int receiver) const;
+
+  /////////////////////////////////////////////////////////////////////////////
+  /// \brief The responses of all the sources together, in the layout of a
+  /// regular run
+  /// \param responses getNumSamples()*num_receivers samples
+  /////////////////////////////////////////////////////////////////////////////
+  template <typename T>
+  void sumResponses(T* responses) const {
+    size_t n = this->num_samples_;
+    for(unsigned int r = 0; r < this->num_receivers_; r++) {
+      for(size_t i = 0; i < n; i++) {
+        double sample = 0.0;
+        for(unsigned int s = 0; s < this->num_sources_; s++)
+          sample += this->pair_responses_.at(((size_t)s*this->num_receivers_+r)*n+i);
+        responses[r*n+i] = (T)sample;
+      }
+    }
+  }
+
+  unsigned int getNumSources() const {return this->num_sources_;}
+  unsigned int getNumReceivers() const {return this->num_receivers_;}
+
+  /// The number of samples in a pair response, at the output fs
+  unsigned int getNumSamples() const {return this->num_samples_;}
+
+private:
+  void setPairResponse(unsigned int source, unsigned int receiver, const double* response);
+
+  SimulationParameters parameters_;
+  unsigned int num_sources_;
+  unsigned int num_receivers_;
+  unsigned int num_steps_;
+  unsigned int num_samples_;
+  bool reciprocal_;
+  Resampler resampler_;
+  std::vector< std::vector<double> > inputs_;  ///< Source signals, reciprocal runs
+  std::vector<double> pair_responses_;         ///< Source major, then receiver
+};
+
+#endif
@@ -0,0 +1,135 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// This file is a part of the PadallelFDTD Finite-Difference Time-Domain
+// simulation library. It is released under the MIT License. You should have
+// received a copy of the MIT License along with ParallelFDTD.  If not, see
+// http://www.opensource.org/licenses/mit-license.php
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// For details, see the LICENSE file
+//
+// (C) 2013-2014 Jukka Saarelma
+// Aalto University School of Science
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "Resampler.h"
+#include <math.h>
+#include <algorithm>
+
+#ifndef PI
+#define PI 3.14159265358979323846
+#endif
+
+namespace {
+  unsigned int gcd(unsigned int a, unsigned int b) {
+    while(b) {
+      unsigned int t = a%b;
+      a = b;
+      b = t;
+    }
+    return a;
+  }
+
+  // Modified Bessel function of the first kind, order zero
+  double besselI0(double x) {
+    double sum = 1.0;
+    double term = 1.0;
+    for(unsigned int k = 1; k < 64; k++) {
+      term *= (x/(2.0*k))*(x/(2.0*k));
+      sum += term;
+      if(term < sum*1e-16)
+        break;
+    }
+    return sum;
+  }
+
+  const double attenuation_db = 80.0;
+}
+
+Resampler::Resampler(unsigned int input_fs, unsigned int output_fs, double band_limit)
+: input_fs_(input_fs),
+  output_fs_(output_fs),
+  up_(1),
+  down_(1),
+  delay_(0),
+  history_(1)
+{
+  unsigned int g = gcd(input_fs, output_fs);
+  this->up_ = output_fs/g;
+  this->down_ = input_fs/g;
+
+  // The pass band ends at the band limit, the stop band begins at the
+  // Nyquist frequency of the lower rate
+  double fs_up = (double)input_fs*this->up_;
+  double stop = 0.5*(double)std::min(input_fs, output_fs);
+  double pass = std::min(band_limit, 0.9*stop);
+  double cutoff = 0.5*(pass+stop)/fs_up;
+  double transition = 2.0*PI*(stop-pass)/fs_up;
+
+  // The length of a Kaiser window design, rounded up so that the delay is
+  // a whole number of output samples
+  double length = (attenuation_db-8.0)/(2.285*transition);
+  this->delay_ = std::max((size_t)1, (size_t)ceil(length/(2.0*this->down_)));
+  size_t num_taps = 2*this->delay_*this->down_+1;
+  this->history_ = (unsigned int)((num_taps+this->up_-1)/this->up_);
+
+  double beta = 0.1102*(attenuation_db-8.7);
+  double centre = (double)(this->delay_*this->down_);
+  double norm = besselI0(beta);
+  double sum = 0.0;
+  this->filter_.assign((size_t)this->history_*this->up_, 0.0);
+  for(size_t j = 0; j < num_taps; j++) {
+    double t = (double)j-centre;
+    double r = t/centre;
+    double window = besselI0(beta*sqrt(std::max(0.0, 1.0-r*r)))/norm;
+    double x = 2.0*PI*cutoff*t;
+    double sinc = t == 0.0 ? 1.0 : sin(x)/x;
+    this->filter_.at(j) = 2.0*cutoff*sinc*window;
+    sum += this->filter_.at(j);
+  }
+
+  // The zeros between the upsampled input take 1/L of the gain
+  for(size_t j = 0; j < num_taps; j++)
+    this->filter_.at(j) *= (double)this->up_/sum;
+}
+
+size_t Resampler::getNumOutputSamples(size_t num_input) const {
+  if(!this->isEnabled())
+    return num_input;
+  return (num_input*this->up_+this->down_-1)/this->down_;
+}
+
+size_t Resampler::getNumAvailable(size_t num_read, size_t num_input) const {
+  if(!this->isEnabled())
+    return num_read;
+  size_t total = this->getNumOutputSamples(num_input);
+  if(num_read >= num_input)
+    return total;
+  // Output q needs the inputs up to floor((q+delay)*M/L)
+  size_t reach = (num_read*this->up_+this->down_-1)/this->down_;
+  if(reach <= this->delay_)
+    return 0;
+  return std::min(total, reach-this->delay_);
+}
+
+double Resampler::evaluate(const double* work, ptrdiff_t base, size_t end, size_t q) const {
+  size_t t = (q+this->delay_)*this->down_;
+  size_t n = t/this->up_;
+  const double* taps = &this->filter_[t%this->up_];
+  double sum = 0.0;
+  for(unsigned int j = 0; j < this->history_; j++, n--) {
+    if(n < end)
+      sum += taps[(size_t)j*this->up_]*work[(ptrdiff_t)n-base];
+    if(n == 0)
+      break;
+  }
+  return sum;
+}
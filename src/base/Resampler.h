@@ -0,0 +1,150 @@
+#ifndef RESAMPLER_H
+#define RESAMPLER_H
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// This file is a part of the PadallelFDTD Finite-Difference Time-Domain
+// simulation library. It is released under the MIT License. You should have
+// received a copy of the MIT License along with ParallelFDTD.  If not, see
+// http://www.opensource.org/licenses/mit-license.php
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// For details, see the LICENSE file
+//
+// (C) 2013-2014 Jukka Saarelma
+// Aalto University School of Science
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include <vector>
+#include <stddef.h>
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief Streaming polyphase resampler from the spatial fs of a run to an
+/// audio rate.
+///
+/// The rates give the ratio L/M reduced by their gcd. The input is
+/// upsampled by L, low passed and downsampled by M, evaluated only at the
+/// output samples with one of the L phases of the filter. The low pass is
+/// a Kaiser windowed sinc with 80 dB stop band attenuation, the pass band
+/// ends at the band limit and the stop band begins at the Nyquist frequency
+/// of the lower rate.
+///
+/// The filter is linear phase and its delay is a whole number of output
+/// samples, which is removed: output sample q is the signal at time
+/// q/output_fs. The signal is read in blocks, each channel keeps the last
+/// getHistoryLength() input samples between the blocks. The block ending
+/// the signal produces the remaining outputs, reading zeros past the end.
+///////////////////////////////////////////////////////////////////////////////
+class Resampler {
+public:
+  Resampler()
+  : input_fs_(0),
+    output_fs_(0),
+    up_(1),
+    down_(1),
+    delay_(0),
+    history_(1)
+  {};
+
+  /////////////////////////////////////////////////////////////////////////////
+  /// \param input_fs The rate of the input, the spatial fs
+  /// \param output_fs The rate of the output
+  /// \param band_limit The upper edge of the pass band in Hz, limited to
+  /// 90% of the Nyquist frequency of the lower rate
+  /////////////////////////////////////////////////////////////////////////////
+  Resampler(unsigned int input_fs, unsigned int output_fs, double band_limit);
+
+  ~Resampler() {};
+
+  /// False for the default resampler, which passes the input through
+  bool isEnabled() const {return this->output_fs_ > 0;}
+  unsigned int getInputFs() const {return this->input_fs_;}
+  unsigned int getOutputFs() const {return this->output_fs_;}
+  unsigned int getUp() const {return this->up_;}
+  unsigned int getDown() const {return this->down_;}
+  size_t getNumTaps() const {return this->filter_.size();}
+
+  /// The number of input samples kept by a channel between blocks
+  unsigned int getHistoryLength() const {return this->history_;}
+
+  /// The number of output samples of a signal
+  size_t getNumOutputSamples(size_t num_input) const;
+
+  /////////////////////////////////////////////////////////////////////////////
+  /// \brief The number of output samples which can be computed from the
+  /// first input samples of a signal
+  /// \param num_read The number of input samples read
+  /// \param num_input The length of the signal
+  /////////////////////////////////////////////////////////////////////////////
+  size_t getNumAvailable(size_t num_read, size_t num_input) const;
+
+  /////////////////////////////////////////////////////////////////////////////
+  /// \brief Resample a block of a channel. The outputs from
+  /// getNumAvailable(first, num_input) up to
+  /// getNumAvailable(first+count, num_input) are written
+  /// \param history The state of the channel, getHistoryLength() samples,
+  /// zero at the beginning of the signal
+  /// \param input The input samples of the block
+  /// \param input_stride The distance of consecutive input samples
+  /// \param first The index of the first sample of the block in the signal
+  /// \param count The number of samples in the block
+  /// \param num_input The length of the signal
+  /// \param output The output samples, contiguous
+  /// \return The number of output samples written
+  /////////////////////////////////////////////////////////////////////////////
+  template <typename T>
+  size_t process(double* history, const T* input, size_t input_stride,
+                 size_t first, size_t count, size_t num_input, T* output) const {
+    size_t k = this->history_;
+    std::vector<double> work(k+count);
+    for(size_t i = 0; i < k; i++)
+      work[i] = history[i];
+    for(size_t i = 0; i < count; i++)
+      work[k+i] = (double)input[i*input_stride];
+
+    size_t out_first = this->getNumAvailable(first, num_input);
+    size_t out_end = this->getNumAvailable(first+count, num_input);
+    // work[0] holds the input sample first-k
+    ptrdiff_t base = (ptrdiff_t)first-(ptrdiff_t)k;
+    for(size_t q = out_first; q < out_end; q++)
+      output[q-out_first] = (T)this->evaluate(&work[0], base, first+count, q);
+
+    for(size_t i = 0; i < k; i++)
+      history[i] = work[count+i];
+    return out_end-out_first;
+  }
+
+  /////////////////////////////////////////////////////////////////////////////
+  /// \brief Resample a whole signal
+  /// \param input num_input samples
+  /// \param output getNumOutputSamples(num_input) samples
+  /////////////////////////////////////////////////////////////////////////////
+  template <typename T>
+  void resample(const T* input, size_t num_input, T* output) const {
+    std::vector<double> history(this->history_, 0.0);
+    this->process(&history[0], input, 1, 0, num_input, num_input, output);
+  }
+
+private:
+  // The output sample q from the input samples base... in work, the
+  // samples from end on are zero
+  double evaluate(const double* work, ptrdiff_t base, size_t end, size_t q) const;
+
+  unsigned int input_fs_;
+  unsigned int output_fs_;
+  unsigned int up_;             ///< L
+  unsigned int down_;           ///< M
+  size_t delay_;                ///< The delay of the filter in output samples
+  unsigned int history_;        ///< Taps per phase
+  std::vector<double> filter_;  ///< history_*L taps, scaled by L, zero padded
+};
+
+#endif
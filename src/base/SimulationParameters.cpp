@@ -23,13 +23,99 @@
 #include "../global_includes.h"
 #include "../io/FileReader.h"
 #include "SimulationParameters.h"
+#include "Convolution.h"
+#include "GridIr.h"
+#include "StateHash.h"
+#include <boost/lexical_cast.hpp>
 #include <stdexcept>
 #include <iostream>
+#include <algorithm>
+
+namespace {
+  // Below this number of multiply-adds the convolution is computed
+  // directly, with the same summation as the per sample evaluation
+  const double direct_convolution_limit = 1<<20;
+
+  // The transparent source signal: the signal minus its convolution with
+  // the grid impulse response, excluding the first IR sample
+  template <typename T, typename U>
+  std::vector<T> transparentSignal(const std::vector<T>& signal,
+                                   const std::vector<U>& grid_ir) {
+    size_t length = signal.size();
+    size_t ir_length = std::min(grid_ir.size(), length);
+    std::vector<T> ret(signal);
+    if(ir_length < 2)
+      return ret;
+
+    if((double)length*(double)ir_length <= direct_convolution_limit) {
+      for(size_t step = 1; step < length; step++) {
+        T sample = 0;
+        size_t first = step >= ir_length ? step-ir_length+1 : 0;
+        for(size_t i = first; i < step; i++)
+          sample += grid_ir[step-i]*signal[i];
+        ret[step] = signal[step]-sample;
+      }
+      return ret;
+    }
+
+    std::vector<double> x(signal.begin(), signal.end());
+    std::vector<double> h(grid_ir.begin(), grid_ir.begin()+ir_length);
+    h[0] = 0.0;
+    std::vector<double> conv = fftConvolve(x, h, length);
+    for(size_t step = 0; step < length; step++)
+      ret[step] = signal[step]-(T)conv[step];
+    return ret;
+  }
+}
 
 
 void SimulationParameters::readGridIr(std::string ir_fp) {
   FileReader fr;
-  this->grid_ir_ = fr.readFloat(ir_fp);
+  this->setGridIr(fr.readFloat(ir_fp));
+}
+
+void SimulationParameters::setGridIr(const std::vector<float>& grid_ir) {
+  this->grid_ir_ = grid_ir;
+  this->grid_ir_double_.assign(grid_ir.begin(), grid_ir.end());
+  this->clearTransparentSignals();
+}
+
+void SimulationParameters::setGridIrDouble(const std::vector<double>& grid_ir) {
+  this->grid_ir_double_ = grid_ir;
+  this->grid_ir_.assign(grid_ir.begin(), grid_ir.end());
+  this->clearTransparentSignals();
+}
+
+void SimulationParameters::generateGridIr(unsigned int length, bool double_precision,
+                                          std::string cache_dir) {
+  std::string scheme = "srl_forward";
+  if(this->update_type_ == SRL) scheme = "srl";
+  if(this->update_type_ == SHARED) scheme = "shared";
+
+  std::string fp = cache_dir+"/grid_ir_"+scheme+(double_precision ? "_f64_" : "_f32_")+
+                   boost::lexical_cast<std::string>(length)+".bin";
+
+  std::vector<double> grid_ir;
+  if(readGridIrCache(fp, this->getLambda(), length, grid_ir)) {
+    log_msg<LOG_INFO>(L"SimulationParameters::generateGridIr - read %u samples from %s")
+                      %length %fp.c_str();
+  }
+  else {
+    log_msg<LOG_INFO>(L"SimulationParameters::generateGridIr - computing %u samples, lambda %f")
+                      %length %this->getLambda();
+    grid_ir = computeGridIr(this->getLambda(), length);
+    if(!writeGridIrCache(fp, this->getLambda(), grid_ir, double_precision))
+      log_msg<LOG_WARNING>(L"SimulationParameters::generateGridIr - can not write cache %s")
+                           %fp.c_str();
+  }
+
+  if(double_precision) {
+    this->setGridIrDouble(grid_ir);
+  }
+  else {
+    std::vector<float> grid_ir_float(grid_ir.begin(), grid_ir.end());
+    this->setGridIr(grid_ir_float);
+  }
 }
 
 void SimulationParameters::addSource(float x, float y, float z) {
@@ -57,6 +143,7 @@ void SimulationParameters::updateSourceAt(unsigned int i, Source src) {
     log_msg<LOG_ERROR>(L"SimulationParameters:updateSourceAt : index %d out of range : %d") %i %(vector_size-1);
 
   this->sources_.at(i) = src;
+  this->clearTransparentSignals();
 }
 
 void SimulationParameters::updateReceiverAt(unsigned int i, Receiver rec) {
@@ -69,6 +156,27 @@ void SimulationParameters::updateReceiverAt(unsigned int i, Receiver rec) {
   this->receivers_.at(i) = rec;
 }
 
+Resampler SimulationParameters::getResampler() const {
+  if(this->output_fs_ == 0)
+    return Resampler();
+  return Resampler(this->spatial_fs_, this->output_fs_,
+                   this->getBandLimit()*(double)this->spatial_fs_);
+}
+
+double SimulationParameters::getValidBandLimit() const {
+  // SRL, SRL_FORWARD and SHARED all step the standard rectilinear scheme,
+  // which does not propagate frequencies above the cutoff along the axes
+  double lambda = std::min(std::max(this->lambda_, 0.0), 1.0);
+  return asin(lambda)/PI;
+}
+
+unsigned int SimulationParameters::getNumOutputSamples() const {
+  if(this->output_fs_ == 0)
+    return this->num_steps_;
+  return (unsigned int)(((unsigned long long)this->num_steps_*this->output_fs_+this->spatial_fs_-1)/
+                        this->spatial_fs_);
+}
+
 void SimulationParameters::removeSource(unsigned int i) {
   unsigned int vector_size = (unsigned int)this->sources_.size();
 
@@ -78,6 +186,7 @@ void SimulationParameters::removeSource(unsigned int i) {
   }
 
   this->sources_.erase(sources_.begin()+i);
+  this->clearTransparentSignals();
 }
 
 void SimulationParameters::removeReceiver(unsigned int i) {
@@ -91,9 +200,42 @@ void SimulationParameters::removeReceiver(unsigned int i) {
   this->receivers_.erase(receivers_.begin()+i);
 }
 
+unsigned int SimulationParameters::addBFormatReceiver(float x, float y, float z) {
+  unsigned int first = (unsigned int)this->receivers_.size();
+  this->receivers_.push_back(Receiver(x, y, z, RECEIVER_PRESSURE));
+  this->receivers_.push_back(Receiver(x, y, z, RECEIVER_X));
+  this->receivers_.push_back(Receiver(x, y, z, RECEIVER_Y));
+  this->receivers_.push_back(Receiver(x, y, z, RECEIVER_Z));
+  return first;
+}
+
+void SimulationParameters::addReceiverWaypoint(unsigned int receiver_idx, float step,
+                                               float x, float y, float z) {
+  // A moving W would leave X, Y and Z behind
+  bool b_format = this->receivers_.at(receiver_idx).getComponent() != RECEIVER_PRESSURE ||
+                  (receiver_idx+1 < this->receivers_.size() &&
+                   this->receivers_.at(receiver_idx+1).getComponent() == RECEIVER_X);
+  if(b_format) {
+    log_msg<LOG_WARNING>(L"SimulationParameters::addReceiverWaypoint - receiver %u is a "
+                         L"B-format channel, it can not move") %receiver_idx;
+    return;
+  }
+  this->receivers_.at(receiver_idx).addWaypoint(step, x, y, z);
+}
+
 void SimulationParameters::resetSourcesAndReceivers() {
   this->receivers_.clear();
   this->sources_.clear();
+  this->array_sources_.clear();
+  this->receiver_grids_.clear();
+  this->clearTransparentSignals();
+}
+
+void SimulationParameters::setupReceiverGrids(unsigned int dim_x, unsigned int dim_y,
+                                              unsigned int dim_z) {
+  for(unsigned int i = 0; i < this->receiver_grids_.size(); i++)
+    this->receiver_grids_.at(i).setup(this->getDx(), this->add_padding_to_element_idx_,
+                                      this->num_steps_, dim_x, dim_y, dim_z);
 }
 
 void SimulationParameters::addInputData(float* data, unsigned int number_of_samples) {
@@ -112,6 +254,7 @@ void SimulationParameters::addInputData(float* data, unsigned int number_of_samp
   }
 
   this->source_input_data_.push_back(new_data);
+  this->clearTransparentSignals();
 }
 
 // Add device pointer which contain the source data
@@ -188,6 +331,31 @@ double SimulationParameters::getInputDataSampleDouble(unsigned int idx, unsigned
   return (this->source_input_data_double_.at(idx)).at(sample);
 }
 
+bool SimulationParameters::addInputStream(const std::string& path,
+                                          enum InputStreamFormat format,
+                                          unsigned int channel) {
+  boost::shared_ptr<InputStream> stream(new InputStream());
+  if(!stream->open(path, format, channel))
+    return false;
+  if(stream->getSampleRate() != 0 && stream->getSampleRate() != this->getSpatialFs())
+    log_msg<LOG_WARNING>(L"SimulationParameters::addInputStream - %s is sampled at %u Hz, "
+                         L"the samples are used at the simulation rate %u Hz")
+                         %path.c_str() %stream->getSampleRate() %this->getSpatialFs();
+  this->input_streams_.push_back(stream);
+  this->clearTransparentSignals();
+  return true;
+}
+
+double SimulationParameters::getInputStreamSample(unsigned int idx, unsigned int sample) {
+  if(idx >= this->input_streams_.size()) {
+    log_msg<LOG_ERROR>
+    (L"SimulationParameters::getInputStreamSample : invalid stream index: %d, number of streams %d ")
+    %idx %(unsigned int)this->input_streams_.size();
+    return 0.0;
+  }
+  return this->input_streams_.at(idx)->getSample(sample);
+}
+
 float SimulationParameters::getGridIrDataSample(unsigned int sample) {
   unsigned int sample_vector_size = (unsigned int)this->grid_ir_.size();
 
@@ -210,6 +378,20 @@ nv::Vec3i SimulationParameters::getSourceElementCoordinates(unsigned int source_
   return ret;
 }
 
+nv::Vec3i SimulationParameters::getArrayNodeElementCoordinates(unsigned int array_idx,
+                                                               unsigned int node) {
+  nv::Vec3i ret = this->array_sources_.at(array_idx).getNode(node).getElementIdx(this->getSpatialFs(), 
+                                  this->getC(),
+                                  (float)this->getLambda());
+  if(this->add_padding_to_element_idx_) {
+    ret.x = ret.x+1;
+    ret.y = ret.y+1;
+    ret.z = ret.z+1;
+  }
+
+  return ret;
+}
+
 nv::Vec3i SimulationParameters::getReceiverElementCoordinates(unsigned int receiver_idx) {
   nv::Vec3i ret = this->getReceiver(receiver_idx).getElementIdx(this->getSpatialFs(), 
                                     this->getC(),
@@ -223,6 +405,43 @@ nv::Vec3i SimulationParameters::getReceiverElementCoordinates(unsigned int recei
   return ret;
 }
 
+Trajectory SimulationParameters::getTrajectory(const Position& position) {
+  float dx = this->getDx();
+  float padding = this->add_padding_to_element_idx_ ? 1.f : 0.f;
+  Trajectory ret;
+  ret.setNumSteps(this->getNumSteps());
+  for(unsigned int step = 0; step < this->getNumSteps(); step++) {
+    nv::Vec3f p = position.getPositionAt((float)step);
+    ret.setPoint(step, nv::Vec3f(p.x/dx+padding, p.y/dx+padding, p.z/dx+padding));
+  }
+  return ret;
+}
+
+bool SimulationParameters::hasMovingPositions() const {
+  for(unsigned int i = 0; i < this->sources_.size(); i++)
+    if(this->sources_.at(i).isMoving())
+      return true;
+  for(unsigned int i = 0; i < this->receivers_.size(); i++)
+    if(this->receivers_.at(i).isMoving())
+      return true;
+  return false;
+}
+
+bool SimulationParameters::hasBFormatReceivers() const {
+  for(unsigned int i = 0; i < this->receivers_.size(); i++)
+    if(this->receivers_.at(i).getComponent() != RECEIVER_PRESSURE)
+      return true;
+  return false;
+}
+
+Trajectory SimulationParameters::getSourceTrajectory(unsigned int source_idx) {
+  return this->getTrajectory(this->sources_.at(source_idx));
+}
+
+Trajectory SimulationParameters::getReceiverTrajectory(unsigned int receiver_idx) {
+  return this->getTrajectory(this->receivers_.at(receiver_idx));
+}
+
 unsigned int SimulationParameters::getSourceElementIdx(unsigned int source_idx, 
                                                        unsigned int dim_x,
                                                        unsigned int dim_y) {
@@ -260,9 +479,20 @@ unsigned int SimulationParameters::getReceiverElementIdx(unsigned int receiver_i
 }
 
 float SimulationParameters::getRegularSourceSample(unsigned int source_idx, unsigned int step) {
+  const Source& src = this->sources_.at(source_idx);
+  return this->getSignalSample(src.getInputType(), src.getInputDataIdx(), step);
+}
+
+float SimulationParameters::getArraySourceSample(unsigned int array_idx, unsigned int step) {
+  const ArraySource& array = this->array_sources_.at(array_idx);
+  return this->getSignalSample(array.getInputType(), array.getInputDataIdx(), step);
+}
+
+float SimulationParameters::getSignalSample(enum InputType input_type, unsigned int data_idx,
+                                            unsigned int step) {
   float sample = 0.f;
   
-  switch(sources_.at(source_idx).getInputType()) {
+  switch(input_type) {
     case IMPULSE: 
       {
       if(step == 1)
@@ -282,8 +512,13 @@ float SimulationParameters::getRegularSourceSample(unsigned int source_idx, unsi
 
     case DATA:
       {
-      unsigned int data_index = sources_.at(source_idx).getInputDataIdx();
-      sample += this->getInputDataSample(data_index, step);
+      sample += this->getInputDataSample(data_idx, step);
+      break;
+      }
+
+    case DATA_STREAM:
+      {
+      sample += (float)this->getInputStreamSample(data_idx, step);
       break;
       }
 
@@ -299,20 +534,37 @@ float SimulationParameters::getRegularSourceSample(unsigned int source_idx, unsi
 
 float SimulationParameters::getTransparentSourceSample(unsigned int source_idx, 
                                                        unsigned int step) {
-  float sample = 0.f;
-
-  for(unsigned int i = 0; i < step; i++) {
-    //printf("step %u ir idx %d, data idx %d \n", step, (step-i), i);
-    sample += this->getGridIrDataSample(step-i)*this->getRegularSourceSample(source_idx, i);
+  if(this->transparent_signals_.size() < this->getNumSources())
+    this->transparent_signals_.resize(this->getNumSources());
+
+  std::vector<float>& signal = this->transparent_signals_.at(source_idx);
+  if(step >= signal.size()) {
+    unsigned int length = std::max(std::max(this->getNumSteps(), step+1),
+                                   2*(unsigned int)signal.size());
+    std::vector<float> regular(length, 0.f);
+    for(unsigned int i = 0; i < length; i++)
+      regular.at(i) = this->getRegularSourceSample(source_idx, i);
+    signal = transparentSignal(regular, this->grid_ir_);
   }
 
-  return (this->getRegularSourceSample(source_idx, step))-sample;
+  return signal[step];
 }
 
 double SimulationParameters::getRegularSourceSampleDouble(unsigned int source_idx, unsigned int step) {
+  const Source& src = this->sources_.at(source_idx);
+  return this->getSignalSampleDouble(src.getInputType(), src.getInputDataIdx(), step);
+}
+
+double SimulationParameters::getArraySourceSampleDouble(unsigned int array_idx, unsigned int step) {
+  const ArraySource& array = this->array_sources_.at(array_idx);
+  return this->getSignalSampleDouble(array.getInputType(), array.getInputDataIdx(), step);
+}
+
+double SimulationParameters::getSignalSampleDouble(enum InputType input_type, unsigned int data_idx,
+                                                   unsigned int step) {
   double sample = 0.0;
   
-  switch(sources_.at(source_idx).getInputType()) {
+  switch(input_type) {
     case IMPULSE: 
       {
       if(step == 1)
@@ -332,8 +584,13 @@ double SimulationParameters::getRegularSourceSampleDouble(unsigned int source_id
 
     case DATA:
       {
-      unsigned int data_index = sources_.at(source_idx).getInputDataIdx();
-      sample += this->getInputDataSampleDouble(data_index, step);
+      sample += this->getInputDataSampleDouble(data_idx, step);
+      break;
+      }
+
+    case DATA_STREAM:
+      {
+      sample += this->getInputStreamSample(data_idx, step);
       break;
       }
 
@@ -349,14 +606,20 @@ double SimulationParameters::getRegularSourceSampleDouble(unsigned int source_id
 
 double SimulationParameters::getTransparentSourceSampleDouble(unsigned int source_idx, 
                                                               unsigned int step) {
-  double sample = 0.f;
-
-  for(unsigned int i = 0; i < step; i++) {
-    //printf("step %u ir idx %d, data idx %d \n", step, (step-i), i);
-    sample += this->getGridIrDataSample(step-i)*this->getRegularSourceSampleDouble(source_idx, i);
+  if(this->transparent_signals_double_.size() < this->getNumSources())
+    this->transparent_signals_double_.resize(this->getNumSources());
+
+  std::vector<double>& signal = this->transparent_signals_double_.at(source_idx);
+  if(step >= signal.size()) {
+    unsigned int length = std::max(std::max(this->getNumSteps(), step+1),
+                                   2*(unsigned int)signal.size());
+    std::vector<double> regular(length, 0.0);
+    for(unsigned int i = 0; i < length; i++)
+      regular.at(i) = this->getRegularSourceSampleDouble(source_idx, i);
+    signal = transparentSignal(regular, this->grid_ir_double_);
   }
 
-  return (this->getRegularSourceSampleDouble(source_idx, step))-sample;
+  return signal[step];
 }
 
 float SimulationParameters::getDx() const {
@@ -394,3 +657,38 @@ double* SimulationParameters::getParameterPtrDouble()  {
   this->parameter_vec_double_.at(3) = (double)this->getOctave();
   return &(this->parameter_vec_double_[0]);
 }
+
+void SimulationParameters::hashState(StateHash& hash) const {
+  hash.addValue((int)this->update_type_);
+  hash.addValue(this->c_);
+  hash.addValue(this->lambda_);
+  hash.addValue(this->octave_);
+  hash.addValue(this->num_steps_);
+  hash.addValue(this->spatial_fs_);
+  hash.addValue(this->output_fs_);
+  hash.addValue(this->getBandLimit());
+  hash.addValue(this->add_padding_to_element_idx_);
+
+  hash.addValue((unsigned long long)this->sources_.size());
+  for(unsigned int i = 0; i < this->sources_.size(); i++)
+    this->sources_.at(i).hashState(hash);
+  hash.addValue((unsigned long long)this->receivers_.size());
+  for(unsigned int i = 0; i < this->receivers_.size(); i++)
+    this->receivers_.at(i).hashState(hash);
+  hash.addValue((unsigned long long)this->array_sources_.size());
+  for(unsigned int i = 0; i < this->array_sources_.size(); i++)
+    this->array_sources_.at(i).hashState(hash);
+
+  hash.addValue((unsigned long long)this->source_input_data_.size());
+  for(unsigned int i = 0; i < this->source_input_data_.size(); i++)
+    hash.addVector(this->source_input_data_.at(i));
+  hash.addValue((unsigned long long)this->source_input_data_double_.size());
+  for(unsigned int i = 0; i < this->source_input_data_double_.size(); i++)
+    hash.addVector(this->source_input_data_double_.at(i));
+  hash.addValue((unsigned long long)this->input_streams_.size());
+  for(unsigned int i = 0; i < this->input_streams_.size(); i++)
+    this->input_streams_.at(i)->hashState(hash);
+
+  hash.addVector(this->grid_ir_);
+  hash.addVector(this->grid_ir_double_);
+}
@@ -33,11 +33,19 @@ Inside App class
 #include "../kernels/cudaUtils.h"
 #include "../math/geomMath.h"
 #include "SrcRec.h"
+#include "Trajectory.h"
+#include "ReceiverGrid.h"
+#include "Resampler.h"
+#include "../io/InputStream.h"
+#include <boost/shared_ptr.hpp>
 #include <string>
 #include <vector>
 
 enum UpdateType {SRL_FORWARD, SHARED, SRL};
 
+class ResponseWriter;
+class StateHash;
+
 class SimulationParameters {
 public:
   SimulationParameters()
@@ -48,12 +56,15 @@ public:
     octave_(0),
     num_steps_(1),
     spatial_fs_(7000),
+    output_fs_(0),
+    band_limit_(0.0),
     bounding_box_min_(nv::Vec3f(0.f, 0.f, 0.f)),
     bounding_box_max_(nv::Vec3f(0.f, 0.f, 0.f)),
     add_padding_to_element_idx_(true),
     sources_(),
     receivers_(),
     source_input_data_(),
+    response_writer_((ResponseWriter*)NULL),
     parameter_vec_(),
     parameter_vec_double_(),
     grid_ir_()
@@ -69,6 +80,8 @@ private:
   unsigned int octave_;           ///< Ocateve band to simulate
   unsigned int num_steps_;        ///< Number of steps to simulate 
   unsigned int spatial_fs_;       ///< Spatial sampling frequency
+  unsigned int output_fs_;        ///< Sample rate of the responses, 0 for the spatial fs
+  double band_limit_;             ///< Pass band of the resampler relative to the spatial fs, 0 for the valid band
   
   nv::Vec3f bounding_box_min_;    ///< Bounding box min coordintae
   nv::Vec3f bounding_box_max_;    ///< Bounding box max coordinate
@@ -78,8 +91,12 @@ private:
 
   std::vector<Source> sources_;                           ///< List of sources
   std::vector<Receiver> receivers_;                       ///< List of receivers
+  std::vector<ArraySource> array_sources_;                ///< List of extended sources
+  std::vector<ReceiverGrid> receiver_grids_;              ///< Dense receivers, hold their responses
   std::vector< std::vector<float> > source_input_data_;   ///< input data for each source
   std::vector< std::vector<double> > source_input_data_double_;   ///< input data for each source
+  std::vector< boost::shared_ptr<InputStream> > input_streams_;  ///< Input data read from files
+  ResponseWriter* response_writer_;       ///< Receives the responses during a run, not owned
   std::vector< std::vector<float> > source_output_data_;  ///< 
   std::vector<float*> d_source_output_data_;              ///< Input data for each source
                                                           /// on the device
@@ -89,14 +106,36 @@ private:
   std::vector<float> parameter_vec_;
   std::vector<double> parameter_vec_double_;
   std::vector<float> grid_ir_;
+  std::vector<double> grid_ir_double_;
+
+  // Transparent source signals of each source, computed once and extended
+  // on demand
+  std::vector< std::vector<float> > transparent_signals_;
+  std::vector< std::vector<double> > transparent_signals_double_;
+
+  /// \brief Drop the cached transparent source signals, called when the
+  /// sources, their input data or the grid impulse response change
+  void clearTransparentSignals() 
+    {this->transparent_signals_.clear(); this->transparent_signals_double_.clear();}
   
+  /// \brief Tabulate the trajectory of a position for num_steps_ steps
+  Trajectory getTrajectory(const Position& position);
+
+  /// \brief Get a sample of an input signal
+  /// \param input_type The type of the signal
+  /// \param data_idx The input data used with DATA
+  /// \param step the time instance of the sample
+  float getSignalSample(enum InputType input_type, unsigned int data_idx, unsigned int step);
+  double getSignalSampleDouble(enum InputType input_type, unsigned int data_idx, unsigned int step);
   /// \brief Get a raw source sample
   /// \param source_idx source index
   /// \param step the time instance of the sample
   float getRegularSourceSample(unsigned int source_idx, unsigned int step);
   double getRegularSourceSampleDouble(unsigned int source_idx, unsigned int step);
   /// \brief Get a transparent source sample; a regular source sample convolved
-  /// the impulse response of the mesh
+  /// the impulse response of the mesh. The signal of the source is computed
+  /// on the first call for at least getNumSteps() samples and served from
+  /// a cache after that
   /// \param source_idx source index
   /// \param step the 
   float getTransparentSourceSample(unsigned int source_idx, unsigned int step);
@@ -104,16 +143,41 @@ private:
 public:
   // Setters
   void readGridIr(std::string ir_fp);
+  void setGridIr(const std::vector<float>& grid_ir);
+  void setGridIrDouble(const std::vector<double>& grid_ir);
+
+  /// \brief Compute the free-field grid impulse response of the current
+  /// update type and Courant number for the transparent sources. The
+  /// response is cached in cache_dir, keyed by the scheme, the precision
+  /// and the length, and read from there when it exists
+  /// \param length The number of samples of the response
+  /// \param double_precision The precision of the cached response
+  /// \param cache_dir An existing directory for the cache files, the
+  /// response is computed without caching if it can not be written
+  void generateGridIr(unsigned int length, bool double_precision,
+                      std::string cache_dir = "./Data");
   void setUpdateType(enum UpdateType update_type);
   void setC(float c) {this->c_ = c;}
   void setLambda(double lambda) {this->lambda_ = lambda;}
   void setOctave(unsigned int octave) {this->octave_ = octave;}
   void setNumSteps(unsigned int num_steps) {this->num_steps_ = num_steps;}
-  void setSpatialFs(unsigned int spatial_fs) {this->spatial_fs_ = spatial_fs;}
+  void setSpatialFs(unsigned int spatial_fs) 
+    {this->spatial_fs_ = spatial_fs; this->clearTransparentSignals();}
 
   void setBoundingBox(nv::Vec3f bounding_box_min, nv::Vec3f bounding_box_max)
     {bounding_box_min_ = bounding_box_min; bounding_box_max_ = bounding_box_max;}
   
+  ///////////////////////////////////////////////////////////////////////////
+  /// \brief Resample the responses to an audio rate while they are recorded
+  /// \param output_fs The sample rate of the responses, 0 records them at
+  /// the spatial fs
+  /// \param band_limit The end of the pass band relative to the spatial fs.
+  /// With the default of 0 the valid band of the update type and Courant
+  /// number at the time of the run is used, see getValidBandLimit()
+  ///////////////////////////////////////////////////////////////////////////
+  void setOutputFs(unsigned int output_fs, double band_limit = 0.0)
+    {this->output_fs_ = output_fs; this->band_limit_ = band_limit;}
+
   void setAddPaddingToElementIdx(bool add_padding_to_element_idx) 
     {this->add_padding_to_element_idx_ = add_padding_to_element_idx;}
   
@@ -126,6 +190,24 @@ public:
   unsigned int getOctave() const {return this->octave_;}
   unsigned int getNumSteps() const {return this->num_steps_;}
   unsigned int getSpatialFs() const {return this->spatial_fs_;}
+  unsigned int getOutputFs() const {return this->output_fs_;}
+  double getBandLimit() const
+    {return this->band_limit_ > 0.0 ? this->band_limit_ : this->getValidBandLimit();}
+
+  /// The valid band of the update scheme relative to the spatial fs, the
+  /// axial cutoff asin(lambda)/pi, about 0.196 at the Courant limit
+  double getValidBandLimit() const;
+
+  /// The resampler of the responses, disabled without an output fs
+  Resampler getResampler() const;
+
+  /// The number of samples in a resampled response, num_steps without an
+  /// output fs
+  unsigned int getNumOutputSamples() const;
+
+  /// The sample rate of a resampled response
+  unsigned int getResponseFs() const
+    {return this->output_fs_ ? this->output_fs_ : this->spatial_fs_;}
   // Returns the step number at the given time at current spatial sampling rate
   unsigned int getStepAtTime(float t) {return (unsigned int)(this->spatial_fs_*t);}
 
@@ -134,6 +216,18 @@ public:
   void addSource(Source src);
   void addReceiver(float x, float y, float z) {receivers_.push_back(Receiver(x,y,z));};
   void addReceiver(Receiver rec) {receivers_.push_back(rec);};
+
+  /////////////////////////////////////////////////////////////////////////////
+  /// \brief Add a first order B-format receiver as four receivers, W, X, Y
+  /// and Z. W is the pressure. X, Y and Z are the particle velocity times
+  /// -rho*c, integrated from the central difference of the pressure at the
+  /// node, so a plane wave arriving from the direction u gives
+  /// X, Y, Z = W*u (SN3D in the FuMa channel order). The velocity is
+  /// sampled half a step before the pressure, as on a staggered grid.
+  /// B-format receivers can not move.
+  /// \return The index of the W receiver, X, Y and Z follow it
+  /////////////////////////////////////////////////////////////////////////////
+  unsigned int addBFormatReceiver(float x, float y, float z);
   // Add device pointer which contain the source input data
   void addSourceDData(float* d_vector);
   void removeSource(unsigned int i);
@@ -143,8 +237,31 @@ public:
   void resetSourcesAndReceivers();
 
   void addInputData(float* data, unsigned int number_of_samples);
-  void addInputData(std::vector<float> data) {this->source_input_data_.push_back(data);}
-  void addInputDataDouble(std::vector<double> data) {this->source_input_data_double_.push_back(data);}
+  void addInputData(std::vector<float> data) 
+    {this->source_input_data_.push_back(data); this->clearTransparentSignals();}
+  void addInputDataDouble(std::vector<double> data) 
+    {this->source_input_data_double_.push_back(data); this->clearTransparentSignals();}
+
+  /////////////////////////////////////////////////////////////////////////////
+  /// \brief Add an input signal streamed from a file for DATA_STREAM
+  /// sources. The samples are read at the simulation rate in chunks, only
+  /// the lookahead buffer is kept in memory.
+  /// \param path The path of a WAV or raw sample file
+  /// \param format The format of the file
+  /// \param channel The channel read from a multichannel WAV file
+  /// \return false if the file can not be read, the stream is not added
+  /////////////////////////////////////////////////////////////////////////////
+  bool addInputStream(const std::string& path, enum InputStreamFormat format,
+                      unsigned int channel = 0);
+  unsigned int getNumInputStreams() const {return (unsigned int)input_streams_.size();};
+  void clearInputStreams() {this->input_streams_.clear(); this->clearTransparentSignals();};
+
+  /////////////////////////////////////////////////////////////////////////////
+  /// \brief Set a writer the solvers stream the receiver responses to while
+  /// they run. The writer is not owned, NULL removes it
+  /////////////////////////////////////////////////////////////////////////////
+  void setResponseWriter(ResponseWriter* writer) {this->response_writer_ = writer;};
+  ResponseWriter* getResponseWriter() const {return this->response_writer_;};
 
 
   float getSourceSample(unsigned int source_idx, unsigned int step);
@@ -152,11 +269,26 @@ public:
   float* getSourceDData(unsigned int source_idx) {return this->d_source_output_data_.at(source_idx);};
   float getInputDataSample(unsigned int idx, unsigned int sample);
   double getInputDataSampleDouble(unsigned int idx, unsigned int sample);
+  double getInputStreamSample(unsigned int idx, unsigned int sample);
   float getGridIrDataSample(unsigned int sample);
 
   nv::Vec3i getSourceElementCoordinates(unsigned int source_idx);
   nv::Vec3i getReceiverElementCoordinates(unsigned int receiver_idx);
 
+  // Moving sources and receivers, the trajectories are in element
+  // coordinates
+  bool isSourceMoving(unsigned int source_idx) const {return sources_.at(source_idx).isMoving();};
+  bool isReceiverMoving(unsigned int receiver_idx) const {return receivers_.at(receiver_idx).isMoving();};
+  bool hasMovingPositions() const;
+  void addSourceWaypoint(unsigned int source_idx, float step, float x, float y, float z)
+    {sources_.at(source_idx).addWaypoint(step, x, y, z);};
+  void addReceiverWaypoint(unsigned int receiver_idx, float step, float x, float y, float z);
+  enum ReceiverComponent getReceiverComponent(unsigned int receiver_idx) const
+    {return receivers_.at(receiver_idx).getComponent();};
+  bool hasBFormatReceivers() const;
+  Trajectory getSourceTrajectory(unsigned int source_idx);
+  Trajectory getReceiverTrajectory(unsigned int receiver_idx);
+
   unsigned int getSourceElementIdx(unsigned int source_idx, 
                                    unsigned int dim_x,
                                    unsigned int dim_y);
@@ -165,6 +297,34 @@ public:
                                      unsigned int dim_x,
                                      unsigned int dim_y);
 
+  // Extended sources, injected after the point sources
+  void addArraySource(ArraySource array) {array_sources_.push_back(array);};
+  void addArraySourceNode(unsigned int array_idx, float x, float y, float z,
+                          float gain, float delay) {
+    array_sources_.at(array_idx).addNode(x, y, z, gain, delay);
+  };
+  void clearArraySources() {array_sources_.clear();};
+  unsigned int getNumArraySources() const {return (unsigned int)array_sources_.size();};
+  const ArraySource& getArraySource(unsigned int i) const {return array_sources_.at(i);};
+  float getArraySourceSample(unsigned int array_idx, unsigned int step);
+  double getArraySourceSampleDouble(unsigned int array_idx, unsigned int step);
+  nv::Vec3i getArrayNodeElementCoordinates(unsigned int array_idx, unsigned int node);
+
+  // Receiver grids, recorded by the solvers which gather the receivers
+  // with a ReceiverBank
+  void addReceiverGrid(ReceiverGrid grid) {receiver_grids_.push_back(grid);};
+  void clearReceiverGrids() {receiver_grids_.clear();};
+  unsigned int getNumReceiverGrids() const {return (unsigned int)receiver_grids_.size();};
+  ReceiverGrid& getReceiverGrid(unsigned int i) {return receiver_grids_.at(i);};
+  const ReceiverGrid& getReceiverGrid(unsigned int i) const {return receiver_grids_.at(i);};
+
+  /////////////////////////////////////////////////////////////////////////////
+  /// \brief Snap the receiver grids to a domain and clear their responses,
+  /// called by the solvers before a run
+  /// \param dim_x, dim_y, dim_z The dimensions of the domain
+  /////////////////////////////////////////////////////////////////////////////
+  void setupReceiverGrids(unsigned int dim_x, unsigned int dim_y, unsigned int dim_z);
+
   unsigned int getNumSources() const {return (unsigned int)sources_.size();};
   unsigned int getNumReceivers() const {return (unsigned int)receivers_.size();};
   float* getSourceVectorAt(unsigned int source_idx);
@@ -174,6 +334,13 @@ public:
 
   float* getParameterPtr();
   double* getParameterPtrDouble();
+
+  /////////////////////////////////////////////////////////////////////////////
+  /// \brief Add the state which the responses depend on to a hash: the
+  /// scheme, rates, sources, receivers and input signals. The receiver
+  /// grids and the response writer are not included.
+  /////////////////////////////////////////////////////////////////////////////
+  void hashState(StateHash& hash) const;
 };
 
 #endif
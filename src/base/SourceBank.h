@@ -0,0 +1,484 @@
+#ifndef SOURCE_BANK_H
+#define SOURCE_BANK_H
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// This file is a part of the PadallelFDTD Finite-Difference Time-Domain
+// simulation library. It is released under the MIT License. You should have
+// received a copy of the MIT License along with ParallelFDTD.  If not, see
+// http://www.opensource.org/licenses/mit-license.php
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// For details, see the LICENSE file
+//
+// (C) 2013-2014 Jukka Saarelma
+// Aalto University School of Science
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "SimulationParameters.h"
+#include <vector>
+#include <map>
+#include <math.h>
+#include <algorithm>
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief The source signals of a simulation compiled for the injection of
+/// a partitioned domain.
+///
+/// For each partition the sources are mapped to local element indices, a
+/// source in a halo slice is included in every partition holding the
+/// slice. Sources sharing an element are merged to a single entry, which
+/// gives the same result as injecting them one by one in source order: a
+/// hard source discards the sources before it, the soft sources after it
+/// are added to its sample.
+///
+/// The samples are evaluated one chunk of steps at a time, see fill(), so
+/// the memory used does not grow with the number of steps and a streamed
+/// input is read through its lookahead buffer. The samples of a chunk are
+/// stored step-major, the entries of one step are contiguous, the step at
+/// getSlot().
+///
+/// The nodes of the array sources are compiled to a scatter list sorted by
+/// element. The nodes of an element form a segment, each node a tap
+/// reading the shared signal of its array with its gain and delay. The
+/// signals of the arrays are held in a window of the chunk and the
+/// getHistorySteps() steps before it, long enough for the longest delay.
+/// The array sources are added after the point sources.
+///
+/// Moving sources are soft and added last. On each step the sample of a
+/// moving source is scattered trilinearly to the eight nodes of the cell
+/// its trajectory is in, the weighted samples of each partition are
+/// compiled to a step-major table with eight corners per moving source. A
+/// corner outside the partition has the element index no_element.
+///
+/// \tparam T The precision of the samples, float / double
+///////////////////////////////////////////////////////////////////////////////
+template <typename T>
+class SourceBank {
+public:
+  SourceBank()
+  : sp_(NULL),
+    dim_x_(0),
+    dim_y_(0),
+    dim_z_(0),
+    num_steps_(0),
+    chunk_steps_(1),
+    history_steps_(1),
+    num_arrays_(0)
+  {};
+
+  static const unsigned int no_element = 0xFFFFFFFFu;
+
+  ~SourceBank() {};
+
+  /////////////////////////////////////////////////////////////////////////////
+  /// \brief Compile the sources of the simulation and fill the first chunk
+  /// of every partition
+  /// \param sp The simulation parameters, sources and the number of steps.
+  /// Read by fill() until the end of the run
+  /// \param dim_x, dim_y The dimensions of a slice of the domain
+  /// \param partition_indexing The slices of each partition, halos included,
+  /// in the format of CudaMesh::getPartitionIndexing()
+  /// \param chunk_steps The number of steps evaluated at once
+  /////////////////////////////////////////////////////////////////////////////
+  void compile(SimulationParameters* sp,
+               unsigned int dim_x, unsigned int dim_y,
+               const std::vector< std::vector<unsigned int> >& partition_indexing,
+               unsigned int chunk_steps = 512) {
+    unsigned int num_sources = sp->getNumSources();
+    this->sp_ = sp;
+    this->dim_x_ = dim_x;
+    this->dim_y_ = dim_y;
+    this->num_steps_ = sp->getNumSteps();
+    this->chunk_steps_ = std::max(1u, std::min(chunk_steps, this->num_steps_));
+    this->num_arrays_ = sp->getNumArraySources();
+    this->partitions_.assign(partition_indexing.size(), Partition());
+
+    this->moving_.clear();
+    this->trajectories_.clear();
+    for(unsigned int s = 0; s < num_sources; s++) {
+      if(sp->isSourceMoving(s)) {
+        this->moving_.push_back(s);
+        this->trajectories_.push_back(sp->getSourceTrajectory(s));
+      }
+    }
+
+    // The window of the arrays reaches one step past the longest delay
+    unsigned int max_delay = 0;
+    for(unsigned int a = 0; a < this->num_arrays_; a++) {
+      const ArraySource& array = sp->getArraySource(a);
+      for(unsigned int n = 0; n < array.getNumNodes(); n++)
+        max_delay = std::max(max_delay, (unsigned int)floor((double)array.getDelay(n)));
+    }
+    this->history_steps_ = max_delay+1;
+
+    this->dim_z_ = 0;
+    for(unsigned int p = 0; p < partition_indexing.size(); p++)
+      if(!partition_indexing.at(p).empty())
+        this->dim_z_ = std::max(this->dim_z_, partition_indexing.at(p).back()+1);
+
+    for(unsigned int p = 0; p < partition_indexing.size(); p++) {
+      const std::vector<unsigned int>& slices = partition_indexing.at(p);
+      Partition& part = this->partitions_.at(p);
+      part.entry_begin.push_back(0);
+      if(slices.empty())
+        continue;
+      part.first_slice = slices.front();
+      part.last_slice = slices.back();
+
+      this->compileArrays(sp, dim_x, dim_y, slices, part);
+
+      // The sources of each element in source order
+      std::map<unsigned int, std::vector<unsigned int> > elements;
+      for(unsigned int s = 0; s < num_sources; s++) {
+        nv::Vec3i pos = sp->getSourceElementCoordinates(s);
+        if(sp->isSourceMoving(s))
+          continue;
+        if(pos.x < 0 || pos.y < 0 || pos.z < 0 ||
+           pos.x >= (int)dim_x || pos.y >= (int)dim_y ||
+           (unsigned int)pos.z < slices.front() || (unsigned int)pos.z > slices.back())
+          continue;
+        unsigned int idx = ((unsigned int)pos.z-slices.front())*dim_x*dim_y+
+                           (unsigned int)pos.y*dim_x+(unsigned int)pos.x;
+        elements[idx].push_back(s);
+      }
+
+      std::map<unsigned int, std::vector<unsigned int> >::iterator it;
+      for(it = elements.begin(); it != elements.end(); it++) {
+        const std::vector<unsigned int>& srcs = it->second;
+        unsigned int first = 0;
+        for(unsigned int k = 0; k < srcs.size(); k++)
+          if(sp->getSource(srcs.at(k)).getSourceType() == SRC_HARD)
+            first = k;
+        bool hard = sp->getSource(srcs.at(first)).getSourceType() == SRC_HARD;
+
+        part.element_idx.push_back(it->first);
+        part.hard.push_back(hard ? 1 : 0);
+        part.entry_source.insert(part.entry_source.end(), srcs.begin()+first, srcs.end());
+        part.entry_begin.push_back((unsigned int)part.entry_source.size());
+      }
+
+      size_t num_corners = this->moving_.size()*8;
+      part.samples.assign(part.element_idx.size()*this->chunk_steps_, (T)0);
+      if(!part.segment_element.empty())
+        part.array_signals.assign((size_t)this->num_arrays_*this->getWindowSteps(), (T)0);
+      part.moving_element.assign(num_corners*this->chunk_steps_, no_element);
+      part.moving_value.assign(num_corners*this->chunk_steps_, (T)0);
+      this->fill(p, 0);
+    }
+  }
+
+  /////////////////////////////////////////////////////////////////////////////
+  /// \brief Evaluate the samples of the chunk holding a step in a
+  /// partition, nothing is done if the partition already holds it. The
+  /// chunks are read in order, a chunk following the one held keeps the
+  /// history of the arrays. Not thread safe, the sources of the parameters
+  /// are read
+  /// \param partition The index of the partition
+  /// \param step A step of the chunk
+  /////////////////////////////////////////////////////////////////////////////
+  void fill(unsigned int partition, unsigned int step) {
+    Partition& part = this->partitions_.at(partition);
+    unsigned int first = step-this->getSlot(step);
+    if(part.filled && part.chunk_first == first)
+      return;
+    bool next = part.filled && first == part.chunk_first+this->chunk_steps_;
+
+    unsigned int num_entries = (unsigned int)part.element_idx.size();
+    for(unsigned int e = 0; e < num_entries; e++) {
+      for(unsigned int i = 0; i < this->chunk_steps_; i++) {
+        T sample = (T)0;
+        for(unsigned int k = part.entry_begin[e]; k < part.entry_begin[e+1] &&
+            first+i < this->num_steps_; k++) {
+          T value;
+          evaluate(this->sp_, part.entry_source[k], first+i, &value);
+          sample += value;
+        }
+        part.samples[(size_t)i*num_entries+e] = sample;
+      }
+    }
+
+    // Column c of the window is the step first-history+c
+    unsigned int window = this->getWindowSteps();
+    for(unsigned int a = 0; a < this->num_arrays_ && !part.array_signals.empty(); a++) {
+      T* signal = &part.array_signals[(size_t)a*window];
+      for(unsigned int c = 0; c < window; c++) {
+        if(next && c < this->history_steps_)
+          signal[c] = signal[c+this->chunk_steps_];
+        else if(first+c < this->history_steps_ ||
+                first+c-this->history_steps_ >= this->num_steps_)
+          signal[c] = (T)0;
+        else
+          evaluateArray(this->sp_, a, first+c-this->history_steps_, &signal[c]);
+      }
+    }
+
+    size_t num_corners = this->moving_.size()*8;
+    for(unsigned int m = 0; m < this->moving_.size(); m++) {
+      for(unsigned int i = 0; i < this->chunk_steps_; i++) {
+        size_t idx = (size_t)i*num_corners+m*8;
+        std::fill(&part.moving_element[idx], &part.moving_element[idx]+8, no_element);
+        std::fill(&part.moving_value[idx], &part.moving_value[idx]+8, (T)0);
+        if(first+i >= this->num_steps_)
+          continue;
+        nv::Vec3i base;
+        nv::Vec3f frac;
+        this->trajectories_.at(m).getCell(first+i, this->dim_x_, this->dim_y_, this->dim_z_,
+                                          base, frac);
+        T sample;
+        evaluate(this->sp_, this->moving_.at(m), first+i, &sample);
+        for(unsigned int c = 0; c < 8; c++) {
+          nv::Vec3i pos = Trajectory::getCorner(base, c);
+          if((unsigned int)pos.z < part.first_slice || (unsigned int)pos.z > part.last_slice)
+            continue;
+          part.moving_element[idx+c] = ((unsigned int)pos.z-part.first_slice)*this->dim_x_*this->dim_y_+
+                                       (unsigned int)pos.y*this->dim_x_+(unsigned int)pos.x;
+          part.moving_value[idx+c] = Trajectory::getWeight<T>(frac, c)*sample;
+        }
+      }
+    }
+
+    part.chunk_first = first;
+    part.filled = true;
+  }
+
+  unsigned int getNumberOfPartitions() const {return (unsigned int)this->partitions_.size();}
+  unsigned int getNumberOfArraySources() const {return this->num_arrays_;}
+  unsigned int getNumSteps() const {return this->num_steps_;}
+  unsigned int getNumberOfMovingSources() const {return (unsigned int)this->moving_.size();}
+
+  unsigned int getChunkSteps() const {return this->chunk_steps_;}
+  /// The position of a step in its chunk
+  unsigned int getSlot(unsigned int step) const {return step%this->chunk_steps_;}
+  /// true if the step is the first one of a chunk
+  bool isChunkBegin(unsigned int step) const {return step%this->chunk_steps_ == 0;}
+  /// The steps of the array signals held before the chunk
+  unsigned int getHistorySteps() const {return this->history_steps_;}
+  /// The steps of the window of an array signal, history and chunk
+  unsigned int getWindowSteps() const {return this->history_steps_+this->chunk_steps_;}
+
+  /// The number of injected elements in the partition
+  unsigned int getNumberOfEntries(unsigned int partition) const
+    {return (unsigned int)this->partitions_.at(partition).element_idx.size();}
+
+  /// Local element indices of the entries of the partition
+  const std::vector<unsigned int>& getElementIndices(unsigned int partition) const
+    {return this->partitions_.at(partition).element_idx;}
+
+  /// 1 for a hard entry which sets the pressure, 0 for a soft entry which
+  /// is added to it
+  const std::vector<unsigned char>& getHardFlags(unsigned int partition) const
+    {return this->partitions_.at(partition).hard;}
+
+  /// The samples of the chunk held by the partition,
+  /// chunk_steps*number_of_entries, step-major
+  const std::vector<T>& getSamples(unsigned int partition) const
+    {return this->partitions_.at(partition).samples;}
+
+  /// The number of elements fed by array sources in the partition
+  unsigned int getNumberOfSegments(unsigned int partition) const
+    {return (unsigned int)this->partitions_.at(partition).segment_element.size();}
+
+  /// Local element index of each segment, ascending
+  const std::vector<unsigned int>& getSegmentElements(unsigned int partition) const
+    {return this->partitions_.at(partition).segment_element;}
+
+  /// The first tap of each segment, number_of_segments+1 values
+  const std::vector<unsigned int>& getSegmentTaps(unsigned int partition) const
+    {return this->partitions_.at(partition).segment_begin;}
+
+  /// The array of each tap
+  const std::vector<unsigned int>& getTapSignals(unsigned int partition) const
+    {return this->partitions_.at(partition).tap_signal;}
+
+  /// The integer part of the delay of each tap in steps
+  const std::vector<unsigned int>& getTapDelays(unsigned int partition) const
+    {return this->partitions_.at(partition).tap_delay;}
+
+  /// The gain of each tap, weighted with 1-fraction of the delay
+  const std::vector<T>& getTapGains(unsigned int partition) const
+    {return this->partitions_.at(partition).tap_gain;}
+
+  /// The gain of each tap, weighted with the fraction of the delay, applied
+  /// to the sample one step older
+  const std::vector<T>& getTapFractionGains(unsigned int partition) const
+    {return this->partitions_.at(partition).tap_gain_frac;}
+
+  /// The windows of the array signals of the partition,
+  /// num_arrays*window_steps, empty without segments
+  const std::vector<T>& getArraySignals(unsigned int partition) const
+    {return this->partitions_.at(partition).array_signals;}
+
+  /// Local element indices of the corners of the moving sources of the
+  /// chunk, chunk_steps*num_moving*8, step-major
+  const std::vector<unsigned int>& getMovingElements(unsigned int partition) const
+    {return this->partitions_.at(partition).moving_element;}
+
+  /// The weighted samples of the corners, in the layout of the elements
+  const std::vector<T>& getMovingValues(unsigned int partition) const
+    {return this->partitions_.at(partition).moving_value;}
+
+  /////////////////////////////////////////////////////////////////////////////
+  /// \brief The value the array sources add to a segment on a step of the
+  /// chunk held
+  /// \param partition The index of the partition
+  /// \param segment The index of the segment
+  /// \param step The step
+  /////////////////////////////////////////////////////////////////////////////
+  T getSegmentValue(unsigned int partition, unsigned int segment, unsigned int step) const {
+    const Partition& part = this->partitions_.at(partition);
+    unsigned int column = this->getSlot(step)+this->history_steps_;
+    T value = (T)0;
+    for(unsigned int t = part.segment_begin[segment]; t < part.segment_begin[segment+1]; t++) {
+      unsigned int delay = part.tap_delay[t];
+      if(step < delay)
+        continue;
+      const T* signal = &part.array_signals[(size_t)part.tap_signal[t]*this->getWindowSteps()];
+      value += part.tap_gain[t]*signal[column-delay];
+      if(step > delay)
+        value += part.tap_gain_frac[t]*signal[column-delay-1];
+    }
+    return value;
+  }
+
+  /////////////////////////////////////////////////////////////////////////////
+  /// \brief Inject the sources of a step to a pressure partition in host
+  /// memory. The chunk of the step is filled first, see fill()
+  /// \param P The pressure partition
+  /// \param partition The index of the partition
+  /// \param step The step to inject
+  /////////////////////////////////////////////////////////////////////////////
+  void inject(T* P, unsigned int partition, unsigned int step) const {
+    const Partition& part = this->partitions_.at(partition);
+    unsigned int slot = this->getSlot(step);
+    unsigned int num_entries = (unsigned int)part.element_idx.size();
+    const T* samples = num_entries ? &part.samples[(size_t)slot*num_entries] : NULL;
+    for(unsigned int e = 0; e < num_entries; e++) {
+      T* p = P+part.element_idx[e];
+      *p = part.hard[e] ? samples[e] : *p+samples[e];
+    }
+
+    unsigned int num_segments = (unsigned int)part.segment_element.size();
+    for(unsigned int g = 0; g < num_segments; g++)
+      P[part.segment_element[g]] += this->getSegmentValue(partition, g, step);
+
+    size_t num_corners = this->moving_.size()*8;
+    for(size_t c = (size_t)slot*num_corners; c < (size_t)(slot+1)*num_corners; c++)
+      if(part.moving_element[c] != no_element)
+        P[part.moving_element[c]] += part.moving_value[c];
+  }
+
+private:
+  struct Partition {
+    Partition()
+    : first_slice(0),
+      last_slice(0),
+      chunk_first(0),
+      filled(false)
+    {};
+
+    unsigned int first_slice;
+    unsigned int last_slice;
+    unsigned int chunk_first;  ///< The first step of the chunk held
+    bool filled;
+
+    std::vector<unsigned int> element_idx;
+    std::vector<unsigned char> hard;
+    std::vector<unsigned int> entry_begin;   ///< The first source of each entry, num_entries+1
+    std::vector<unsigned int> entry_source;  ///< The sources summed to each entry
+    std::vector<T> samples;
+
+    std::vector<unsigned int> segment_element;
+    std::vector<unsigned int> segment_begin;
+    std::vector<unsigned int> tap_signal;
+    std::vector<unsigned int> tap_delay;
+    std::vector<T> tap_gain;
+    std::vector<T> tap_gain_frac;
+    std::vector<T> array_signals;
+
+    std::vector<unsigned int> moving_element;
+    std::vector<T> moving_value;
+  };
+
+  struct Tap {
+    unsigned int element;
+    unsigned int signal;
+    unsigned int delay;
+    T gain;
+    T gain_frac;
+    bool operator<(const Tap& other) const {return this->element < other.element;}
+  };
+
+  void compileArrays(SimulationParameters* sp, unsigned int dim_x, unsigned int dim_y,
+                     const std::vector<unsigned int>& slices, Partition& part) {
+    std::vector<Tap> taps;
+    for(unsigned int a = 0; a < sp->getNumArraySources(); a++) {
+      const ArraySource& array = sp->getArraySource(a);
+      for(unsigned int n = 0; n < array.getNumNodes(); n++) {
+        nv::Vec3i pos = sp->getArrayNodeElementCoordinates(a, n);
+        if(pos.x < 0 || pos.y < 0 || pos.z < 0 ||
+           pos.x >= (int)dim_x || pos.y >= (int)dim_y ||
+           (unsigned int)pos.z < slices.front() || (unsigned int)pos.z > slices.back())
+          continue;
+        double delay = (double)array.getDelay(n);
+        double frac = delay-floor(delay);
+        Tap tap;
+        tap.element = ((unsigned int)pos.z-slices.front())*dim_x*dim_y+
+                      (unsigned int)pos.y*dim_x+(unsigned int)pos.x;
+        tap.signal = a;
+        tap.delay = (unsigned int)floor(delay);
+        tap.gain = (T)(array.getGain(n)*(1.0-frac));
+        tap.gain_frac = (T)(array.getGain(n)*frac);
+        taps.push_back(tap);
+      }
+    }
+
+    // Stable, the taps of an element stay in the order of the nodes
+    std::stable_sort(taps.begin(), taps.end());
+    for(unsigned int t = 0; t < taps.size(); t++) {
+      if(t == 0 || taps[t].element != taps[t-1].element) {
+        part.segment_element.push_back(taps[t].element);
+        part.segment_begin.push_back(t);
+      }
+      part.tap_signal.push_back(taps[t].signal);
+      part.tap_delay.push_back(taps[t].delay);
+      part.tap_gain.push_back(taps[t].gain);
+      part.tap_gain_frac.push_back(taps[t].gain_frac);
+    }
+    part.segment_begin.push_back((unsigned int)taps.size());
+  }
+
+  static void evaluate(SimulationParameters* sp, unsigned int s, unsigned int step, float* ret)
+    {*ret = sp->getSourceSample(s, step);}
+  static void evaluate(SimulationParameters* sp, unsigned int s, unsigned int step, double* ret)
+    {*ret = sp->getSourceSampleDouble(s, step);}
+  static void evaluateArray(SimulationParameters* sp, unsigned int a, unsigned int step, float* ret)
+    {*ret = sp->getArraySourceSample(a, step);}
+  static void evaluateArray(SimulationParameters* sp, unsigned int a, unsigned int step, double* ret)
+    {*ret = sp->getArraySourceSampleDouble(a, step);}
+
+  SimulationParameters* sp_;
+  unsigned int dim_x_;
+  unsigned int dim_y_;
+  unsigned int dim_z_;
+  unsigned int num_steps_;
+  unsigned int chunk_steps_;
+  unsigned int history_steps_;   ///< Steps of the array signals kept before a chunk
+  unsigned int num_arrays_;
+  std::vector<unsigned int> moving_;        ///< The moving sources
+  std::vector<Trajectory> trajectories_;    ///< Of each moving source
+  std::vector<Partition> partitions_;
+};
+
+template <typename T>
+const unsigned int SourceBank<T>::no_element;
+
+#endif
@@ -21,7 +21,9 @@
 ///////////////////////////////////////////////////////////////////////////////
 
 #include "SrcRec.h"
+#include "StateHash.h"
 #include <math.h>
+#include <algorithm>
 
 nv::Vec3i Position::getElementIdx(unsigned fs, float c, float lambda) {
   nv::Vec3i ret = nv::Vec3i();
@@ -32,3 +34,68 @@ nv::Vec3i Position::getElementIdx(unsigned fs, float c, float lambda) {
   // Add the padding node
   return ret;
 }
+
+void Position::addWaypoint(float step, float x, float y, float z) {
+  // Keep the points ordered by time
+  std::vector<float>::iterator it = std::upper_bound(this->waypoint_steps_.begin(),
+                                                     this->waypoint_steps_.end(), step);
+  size_t i = it-this->waypoint_steps_.begin();
+  this->waypoint_steps_.insert(it, step);
+  this->waypoints_.insert(this->waypoints_.begin()+i, nv::Vec3f(x, y, z));
+}
+
+nv::Vec3f Position::getPositionAt(float step) const {
+  if(this->waypoints_.empty())
+    return this->p_;
+  if(step <= this->waypoint_steps_.front())
+    return this->waypoints_.front();
+  if(step >= this->waypoint_steps_.back())
+    return this->waypoints_.back();
+
+  size_t i = std::upper_bound(this->waypoint_steps_.begin(),
+                              this->waypoint_steps_.end(), step)-this->waypoint_steps_.begin();
+  float t0 = this->waypoint_steps_.at(i-1);
+  float t1 = this->waypoint_steps_.at(i);
+  float a = (step-t0)/(t1-t0);
+  const nv::Vec3f& p0 = this->waypoints_.at(i-1);
+  const nv::Vec3f& p1 = this->waypoints_.at(i);
+  return nv::Vec3f(p0.x+a*(p1.x-p0.x), p0.y+a*(p1.y-p0.y), p0.z+a*(p1.z-p0.z));
+}
+
+namespace {
+  void hashVec3(StateHash& hash, const nv::Vec3f& v) {
+    hash.addValue(v.x);
+    hash.addValue(v.y);
+    hash.addValue(v.z);
+  }
+}
+
+void Position::hashState(StateHash& hash) const {
+  hashVec3(hash, this->p_);
+  hash.addVector(this->waypoint_steps_);
+  hash.addValue((unsigned long long)this->waypoints_.size());
+  for(unsigned int i = 0; i < this->waypoints_.size(); i++)
+    hashVec3(hash, this->waypoints_.at(i));
+}
+
+void Source::hashState(StateHash& hash) const {
+  Position::hashState(hash);
+  hash.addValue((int)this->source_type_);
+  hash.addValue((int)this->input_type_);
+  hash.addValue(this->input_data_idx_);
+}
+
+void ArraySource::hashState(StateHash& hash) const {
+  hash.addValue((int)this->input_type_);
+  hash.addValue(this->input_data_idx_);
+  hash.addValue((unsigned long long)this->nodes_.size());
+  for(unsigned int i = 0; i < this->nodes_.size(); i++)
+    this->nodes_.at(i).hashState(hash);
+  hash.addVector(this->gains_);
+  hash.addVector(this->delays_);
+}
+
+void Receiver::hashState(StateHash& hash) const {
+  Position::hashState(hash);
+  hash.addValue((int)this->component_);
+}
@@ -30,8 +30,13 @@
 #include "../math/geomMath.h"
 #include "../global_includes.h"
 
+class StateHash;
+
 enum SrcType {SRC_HARD, SRC_SOFT, SRC_TRANSPARENT};
-enum InputType {IMPULSE, GAUSSIAN, SINE, DATA};
+enum InputType {IMPULSE, GAUSSIAN, SINE, DATA, DATA_STREAM};
+// The quantity recorded by a receiver, the velocity components are the
+// X, Y and Z channels of a B-format receiver
+enum ReceiverComponent {RECEIVER_PRESSURE, RECEIVER_X, RECEIVER_Y, RECEIVER_Z};
 
 ///////////////////////////////////////////////////////////////////////////////
 /// A base class for source and receiver positions
@@ -55,10 +60,32 @@ public:
 
 protected:
   nv::Vec3f p_; ///< The position of in 3-D 
+  std::vector<float> waypoint_steps_;     ///< Times of the trajectory points in steps
+  std::vector<nv::Vec3f> waypoints_;      ///< Trajectory of a moving position
 
 public:
 
   nv::Vec3f getP() {return this->p_;};
+
+  ///////////////////////////////////////////////////////////////////////////////
+  /// \brief Add a point to the trajectory of a moving position. Between the
+  /// points the position is interpolated linearly, before the first and
+  /// after the last point it stays at the end point.
+  /// \param step The time of the point in steps
+  /// \param x, y, z The position at the time
+  ///////////////////////////////////////////////////////////////////////////////
+  void addWaypoint(float step, float x, float y, float z);
+
+  bool isMoving() const {return !this->waypoints_.empty();};
+  unsigned int getNumWaypoints() const {return (unsigned int)this->waypoints_.size();};
+
+  ///////////////////////////////////////////////////////////////////////////////
+  /// \brief Returns the position at a time
+  /// \param step The time in steps
+  /// \return The interpolated trajectory, the static position if the
+  ///         position does not move
+  ///////////////////////////////////////////////////////////////////////////////
+  nv::Vec3f getPositionAt(float step) const;
   
   ///////////////////////////////////////////////////////////////////////////////
   /// \brief Returns the element index in a finite difference grid
@@ -67,6 +94,9 @@ public:
   /// \param lambda The Courant number of the scheme used
   ///////////////////////////////////////////////////////////////////////////////
   nv::Vec3i getElementIdx(unsigned spatial_fs, float c, float lambda);
+
+  /// \brief Add the position and the trajectory to a hash
+  virtual void hashState(StateHash& hash) const;
 };
 
 ///////////////////////////////////////////////////////////////////////////////
@@ -140,6 +170,8 @@ public:
   enum InputType getInputType() const {return this->input_type_;};
   unsigned int getGroup() const {return this->group_;};
 
+  void hashState(StateHash& hash) const;
+
 private:
   SrcType source_type_;
   InputType input_type_;
@@ -147,24 +179,90 @@ private:
   unsigned int input_data_idx_; ///< Which custom data is used
 };
 
+///////////////////////////////////////////////////////////////////////////////
+/// An extended source, e.g. a loudspeaker array or a vibrating surface,
+/// made of nodes which share one input signal. Each node adds the signal
+/// scaled with its gain and delayed by its delay to the pressure, as a soft
+/// source. The delay is given in steps and can be fractional, a fractional
+/// delay is linearly interpolated.
+///////////////////////////////////////////////////////////////////////////////
+class ArraySource {
+public:
+  ArraySource() 
+  : input_type_(IMPULSE),
+    input_data_idx_(0)
+  {};
+
+  ArraySource(enum InputType input_type, unsigned int input_data_idx) 
+  : input_type_(input_type),
+    input_data_idx_(input_data_idx)
+  {};
+
+  /// \brief Add a node to the array
+  /// \param x, y, z The position of the node
+  /// \param gain The gain of the signal at the node
+  /// \param delay The delay of the signal at the node in steps, >= 0
+  void addNode(float x, float y, float z, float gain, float delay) {
+    this->nodes_.push_back(Position(x, y, z));
+    this->gains_.push_back(gain);
+    this->delays_.push_back(delay < 0.f ? 0.f : delay);
+  };
+
+  // Setters
+  void setInputType(enum InputType input_type) {this->input_type_ = input_type;};
+  void setInputDataIdx(unsigned int input_data_idx) 
+    {this->input_data_idx_ = input_data_idx;};
+
+  // Getters
+  enum InputType getInputType() const {return this->input_type_;};
+  unsigned int getInputDataIdx() const {return this->input_data_idx_;};
+  unsigned int getNumNodes() const {return (unsigned int)this->nodes_.size();};
+  Position getNode(unsigned int i) const {return this->nodes_.at(i);};
+  float getGain(unsigned int i) const {return this->gains_.at(i);};
+  float getDelay(unsigned int i) const {return this->delays_.at(i);};
+
+  /// \brief Add the nodes and the input to a hash
+  void hashState(StateHash& hash) const;
+
+private:
+  InputType input_type_;
+  unsigned int input_data_idx_; ///< Which custom data is used
+  std::vector<Position> nodes_;
+  std::vector<float> gains_;
+  std::vector<float> delays_;   ///< Delay of each node in steps
+};
+
 class Receiver : public Position {
 public:
   Receiver() 
-  : Position()
+  : Position(),
+    component_(RECEIVER_PRESSURE)
   {};
 
   Receiver(float x, float y, float z) 
-  : Position(x, y, z)
+  : Position(x, y, z),
+    component_(RECEIVER_PRESSURE)
   {};
 
   Receiver(float x, float y) 
-  : Position(x, y)
+  : Position(x, y),
+    component_(RECEIVER_PRESSURE)
+  {};
+
+  Receiver(float x, float y, float z, enum ReceiverComponent component) 
+  : Position(x, y, z),
+    component_(component)
   {};
 
   void setOutputFp(std::string fp);
 
+  enum ReceiverComponent getComponent() const {return this->component_;};
+
+  void hashState(StateHash& hash) const;
+
 private:
   std::string output_fp;
+  enum ReceiverComponent component_;
 };
 
 #endif
@@ -0,0 +1,78 @@
+#ifndef STATE_HASH_H
+#define STATE_HASH_H
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// This file is a part of the PadallelFDTD Finite-Difference Time-Domain
+// simulation library. It is released under the MIT License. You should have
+// received a copy of the MIT License along with ParallelFDTD.  If not, see
+// http://www.opensource.org/licenses/mit-license.php
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// For details, see the LICENSE file
+//
+// (C) 2013-2014 Jukka Saarelma
+// Aalto University School of Science
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include <boost/uuid/detail/sha1.hpp>
+#include <string>
+#include <vector>
+#include <stdio.h>
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief A SHA-1 digest of the state of a simulation. The classes holding
+/// the inputs add their state with hashState(), two simulations with the
+/// same digest give the same responses.
+///
+/// The values are hashed as their bytes, so the digest is only valid on
+/// machines of the same endianness. Each vector and string is prefixed with
+/// its length so adjacent values can not alias.
+///////////////////////////////////////////////////////////////////////////////
+class StateHash {
+public:
+  StateHash() {};
+
+  void add(const void* data, size_t bytes) {
+    if(bytes > 0)
+      this->sha1_.process_bytes(data, bytes);
+  }
+
+  template<typename T>
+  void addValue(const T& value) {this->add(&value, sizeof(T));}
+
+  void addString(const std::string& value) {
+    this->addValue((unsigned long long)value.size());
+    this->add(value.data(), value.size());
+  }
+
+  template<typename T>
+  void addVector(const std::vector<T>& values) {
+    this->addValue((unsigned long long)values.size());
+    if(!values.empty())
+      this->add(&values[0], values.size()*sizeof(T));
+  }
+
+  /// \return The digest as 40 hexadecimal characters, ends the hash
+  std::string getDigest() {
+    boost::uuids::detail::sha1::digest_type digest;
+    this->sha1_.get_digest(digest);
+    char ret[41];
+    for(unsigned int i = 0; i < 5; i++)
+      sprintf(ret+i*8, "%08x", digest[i]);
+    return std::string(ret, 40);
+  }
+
+private:
+  boost::uuids::detail::sha1 sha1_;
+};
+
+#endif
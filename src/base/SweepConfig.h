@@ -0,0 +1,63 @@
+#ifndef SWEEP_CONFIG_H
+#define SWEEP_CONFIG_H
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// This file is a part of the PadallelFDTD Finite-Difference Time-Domain
+// simulation library. It is released under the MIT License. You should have
+// received a copy of the MIT License along with ParallelFDTD.  If not, see
+// http://www.opensource.org/licenses/mit-license.php
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// For details, see the LICENSE file
+//
+// (C) 2013-2014 Jukka Saarelma
+// Aalto University School of Science
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "SimulationParameters.h"
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief One run of a sweep over a prepared mesh, see App::runSweep().
+/// The sources, receivers and the number of steps replace those of the
+/// parameters, everything else is shared by the runs: the geometry, the
+/// materials, the spatial fs, the input data, array sources and receiver
+/// grids.
+///////////////////////////////////////////////////////////////////////////////
+struct SweepConfig {
+  SweepConfig()
+  : num_steps(0)
+  {};
+
+  std::vector<Source> sources;
+  std::vector<Receiver> receivers;
+  unsigned int num_steps;       ///< 0 keeps the steps of the parameters
+
+  void addSource(const Source& source) {this->sources.push_back(source);}
+  void addReceiver(float x, float y, float z) {this->receivers.push_back(Receiver(x, y, z));}
+
+  /// Replace the sources, receivers and steps of the parameters
+  void applyTo(SimulationParameters& sp) const {
+    for(unsigned int i = sp.getNumSources(); i > 0; i--)
+      sp.removeSource(i-1);
+    for(unsigned int i = sp.getNumReceivers(); i > 0; i--)
+      sp.removeReceiver(i-1);
+    for(unsigned int i = 0; i < this->sources.size(); i++)
+      sp.addSource(this->sources.at(i));
+    for(unsigned int i = 0; i < this->receivers.size(); i++)
+      sp.addReceiver(this->receivers.at(i));
+    if(this->num_steps > 0)
+      sp.setNumSteps(this->num_steps);
+  }
+};
+
+#endif
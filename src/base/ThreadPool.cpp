@@ -0,0 +1,122 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// This file is a part of the PadallelFDTD Finite-Difference Time-Domain
+// simulation library. It is released under the MIT License. You should have
+// received a copy of the MIT License along with ParallelFDTD.  If not, see
+// http://www.opensource.org/licenses/mit-license.php
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// For details, see the LICENSE file
+//
+// (C) 2013-2014 Jukka Saarelma
+// Aalto University School of Science
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "ThreadPool.h"
+#include "../logger.h"
+
+#include <boost/bind.hpp>
+#include <boost/thread/once.hpp>
+#include <algorithm>
+
+struct ThreadPool::Batch {
+  unsigned int remaining;
+  unsigned int failed;
+  boost::condition_variable done;
+};
+
+namespace {
+  ThreadPool* process_pool = (ThreadPool*)NULL;
+  boost::once_flag process_once = BOOST_ONCE_INIT;
+
+  // Lives until the exit of the process
+  void createProcessPool() {
+    process_pool = new ThreadPool(0);
+  }
+}
+
+ThreadPool::ThreadPool(unsigned int num_threads)
+: num_threads_(num_threads),
+  stop_(false)
+{
+  if(this->num_threads_ == 0)
+    this->num_threads_ = std::max(boost::thread::hardware_concurrency(), 1u);
+
+  for(unsigned int i = 0; i < this->num_threads_; i++)
+    this->workers_.create_thread(boost::bind(&ThreadPool::work, this));
+
+  log_msg<LOG_DEBUG>(L"ThreadPool::ThreadPool - %u workers") %this->num_threads_;
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    boost::mutex::scoped_lock lock(this->mutex_);
+    this->stop_ = true;
+  }
+  this->queued_.notify_all();
+  this->workers_.join_all();
+}
+
+unsigned int ThreadPool::runAll(const std::vector<Task>& tasks) {
+  if(tasks.empty())
+    return 0;
+
+  Batch batch;
+  batch.remaining = (unsigned int)tasks.size();
+  batch.failed = 0;
+
+  boost::mutex::scoped_lock lock(this->mutex_);
+  for(unsigned int i = 0; i < tasks.size(); i++) {
+    Entry entry;
+    entry.task = tasks.at(i);
+    entry.batch = &batch;
+    this->queue_.push_back(entry);
+  }
+  this->queued_.notify_all();
+
+  while(batch.remaining > 0)
+    batch.done.wait(lock);
+
+  return batch.failed;
+}
+
+void ThreadPool::work() {
+  boost::mutex::scoped_lock lock(this->mutex_);
+  while(true) {
+    while(this->queue_.empty() && !this->stop_)
+      this->queued_.wait(lock);
+    if(this->queue_.empty())
+      return;
+
+    Entry entry = this->queue_.front();
+    this->queue_.pop_front();
+    lock.unlock();
+
+    bool failed = false;
+    try {
+      entry.task();
+    }
+    catch(...) {
+      log_msg<LOG_ERROR>(L"ThreadPool::work - a task failed");
+      failed = true;
+    }
+
+    lock.lock();
+    entry.batch->failed += failed ? 1 : 0;
+    if(--entry.batch->remaining == 0)
+      entry.batch->done.notify_all();
+  }
+}
+
+ThreadPool& ThreadPool::process() {
+  boost::call_once(process_once, createProcessPool);
+  return *process_pool;
+}
@@ -0,0 +1,85 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// This file is a part of the PadallelFDTD Finite-Difference Time-Domain
+// simulation library. It is released under the MIT License. You should have
+// received a copy of the MIT License along with ParallelFDTD.  If not, see
+// http://www.opensource.org/licenses/mit-license.php
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// For details, see the LICENSE file
+//
+// (C) 2013-2014 Jukka Saarelma
+// Aalto University School of Science
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include <boost/function.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <deque>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief A fixed set of worker threads running batches of tasks, used to
+/// run several independent simulations at once.
+///
+/// The batches of concurrent callers share the workers. runAll() must not
+/// be called from a task of the same pool, the calling task would hold a
+/// worker while waiting for the others.
+///////////////////////////////////////////////////////////////////////////////
+class ThreadPool {
+public:
+  typedef boost::function<void ()> Task;
+
+  /// \param num_threads The number of workers, 0 for one per hardware thread
+  explicit ThreadPool(unsigned int num_threads = 0);
+
+  /// Finishes the queued tasks and joins the workers
+  ~ThreadPool();
+
+  /////////////////////////////////////////////////////////////////////////////
+  /// \brief Run a batch of tasks on the workers and wait for them
+  /// \param tasks The tasks, run in order as the workers become free
+  /// \return The number of tasks that threw
+  /////////////////////////////////////////////////////////////////////////////
+  unsigned int runAll(const std::vector<Task>& tasks);
+
+  unsigned int getNumThreads() const {return this->num_threads_;}
+
+  /// The pool of the process, one worker per hardware thread, created on
+  /// the first call
+  static ThreadPool& process();
+
+private:
+  // Not copyable, the workers belong to the pool
+  ThreadPool(const ThreadPool&);
+  ThreadPool& operator=(const ThreadPool&);
+
+  struct Batch;
+  struct Entry {
+    Task task;
+    Batch* batch;
+  };
+
+  void work();
+
+  unsigned int num_threads_;
+  std::deque<Entry> queue_;
+  bool stop_;
+  boost::mutex mutex_;
+  boost::condition_variable queued_;
+  boost::thread_group workers_;
+};
+
+#endif
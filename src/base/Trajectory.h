@@ -0,0 +1,97 @@
+#ifndef TRAJECTORY_H
+#define TRAJECTORY_H
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// This file is a part of the PadallelFDTD Finite-Difference Time-Domain
+// simulation library. It is released under the MIT License. You should have
+// received a copy of the MIT License along with ParallelFDTD.  If not, see
+// http://www.opensource.org/licenses/mit-license.php
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// For details, see the LICENSE file
+//
+// (C) 2013-2014 Jukka Saarelma
+// Aalto University School of Science
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "../math/geomMath.h"
+#include <vector>
+#include <math.h>
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief The trajectory of a moving source or receiver tabulated for each
+/// step of a run. The points are in element coordinates, the padding
+/// included, so that the node (x, y, z) is at (x, y, z).
+///
+/// A point between the nodes is represented by the eight nodes of the cell
+/// containing it, weighted trilinearly. Sources scatter their sample to the
+/// corners, receivers gather the corners.
+///////////////////////////////////////////////////////////////////////////////
+class Trajectory {
+public:
+  Trajectory() {};
+
+  void setNumSteps(unsigned int num_steps) {this->points_.assign(num_steps, nv::Vec3f());};
+  void setPoint(unsigned int step, const nv::Vec3f& point) {this->points_.at(step) = point;};
+
+  unsigned int getNumSteps() const {return (unsigned int)this->points_.size();};
+  const nv::Vec3f& getPoint(unsigned int step) const {return this->points_.at(step);};
+
+  /////////////////////////////////////////////////////////////////////////////
+  /// \brief Returns the cell of the point at a step. The cell is clamped
+  /// inside the domain, a point outside is moved to the closest face.
+  /// \param step The step
+  /// \param dim_x, dim_y, dim_z The dimensions of the domain
+  /// \param base Returns the lower corner of the cell
+  /// \param frac Returns the offsets of the point in the cell, in [0, 1]
+  /////////////////////////////////////////////////////////////////////////////
+  void getCell(unsigned int step,
+               unsigned int dim_x, unsigned int dim_y, unsigned int dim_z,
+               nv::Vec3i& base, nv::Vec3f& frac) const {
+    const nv::Vec3f& p = this->points_.at(step);
+    unsigned int dims[3] = {dim_x, dim_y, dim_z};
+    for(int i = 0; i < 3; i++) {
+      float max = (float)(dims[i] > 1 ? dims[i]-2 : 0);
+      float c = p[i] < 0.f ? 0.f : p[i];
+      int b = (int)floorf(c);
+      if((float)b > max)
+        b = (int)max;
+      base[i] = b;
+      frac[i] = c-(float)b;
+      if(frac[i] > 1.f)
+        frac[i] = 1.f;
+    }
+  };
+
+  /////////////////////////////////////////////////////////////////////////////
+  /// \brief Trilinear weight of a corner of a cell
+  /// \param frac The offsets of the point in the cell
+  /// \param corner The corner, bit 0 selects x+1, bit 1 y+1 and bit 2 z+1
+  /////////////////////////////////////////////////////////////////////////////
+  template <typename T>
+  static T getWeight(const nv::Vec3f& frac, unsigned int corner) {
+    T wx = (corner&1) ? (T)frac.x : (T)1-(T)frac.x;
+    T wy = (corner&2) ? (T)frac.y : (T)1-(T)frac.y;
+    T wz = (corner&4) ? (T)frac.z : (T)1-(T)frac.z;
+    return wx*wy*wz;
+  };
+
+  static nv::Vec3i getCorner(const nv::Vec3i& base, unsigned int corner) {
+    return nv::Vec3i(base.x+(int)(corner&1), base.y+(int)((corner>>1)&1),
+                     base.z+(int)((corner>>2)&1));
+  };
+
+private:
+  std::vector<nv::Vec3f> points_;
+};
+
+#endif
@@ -0,0 +1,237 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// This file is a part of the PadallelFDTD Finite-Difference Time-Domain
+// simulation library. It is released under the MIT License. You should have
+// received a copy of the MIT License along with ParallelFDTD.  If not, see
+// http://www.opensource.org/licenses/mit-license.php
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// For details, see the LICENSE file
+//
+// (C) 2013-2014 Jukka Saarelma
+// Aalto University School of Science
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "BatchRunner.h"
+#include "../App.h"
+#include "../base/ThreadPool.h"
+#include "../logger.h"
+
+#include <boost/bind.hpp>
+#include <boost/property_tree/json_parser.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+
+using boost::property_tree::ptree;
+
+namespace {
+  const char* const format_names[] = {"raw_float", "raw_double", "wav"};
+
+  // The geometry, materials and scheme shared by the jobs of a group,
+  // throws as the app does on an error
+  void setupMesh(FDTD::App& app, const JobSpec& job) {
+    app.initializeGeometryFromFile(job.geometry);
+
+    unsigned int num_triangles = app.m_geometry.getNumberOfTriangles();
+    std::vector<float> coefficients((size_t)num_triangles*MATERIAL_COEF_NUM, 0.f);
+    for(unsigned int i = 0; i < num_triangles; i++)
+      std::copy(job.coefficients.begin(), job.coefficients.end(),
+                coefficients.begin()+(size_t)i*MATERIAL_COEF_NUM);
+
+    for(unsigned int l = 0; l < job.layers.size(); l++) {
+      const LayerMaterial& layer = job.layers.at(l);
+      for(unsigned int i = 0; i < layer.triangles.size(); i++) {
+        int t = layer.triangles.at(i);
+        if(t < 0 || (unsigned int)t >= num_triangles) {
+          log_msg<LOG_ERROR>(L"BatchRunner - job %s: triangle %d of layer %u out of range")
+                             %job.name.c_str() %t %l;
+          throw(-1);
+        }
+        std::copy(layer.coefficients.begin(), layer.coefficients.end(),
+                  coefficients.begin()+(size_t)t*MATERIAL_COEF_NUM);
+      }
+    }
+    app.m_materials.addMaterials(&coefficients[0], num_triangles, MATERIAL_COEF_NUM);
+
+    app.m_parameters.setSpatialFs(job.fs);
+    app.m_parameters.setNumSteps(job.num_steps);
+    app.m_parameters.setUpdateType((enum UpdateType)job.update_type);
+    app.m_parameters.setOctave(job.octave);
+    if(!job.grid_ir.empty())
+      app.m_parameters.readGridIr(job.grid_ir);
+    app.setDouble(job.is_double);
+
+    for(unsigned int i = 0; i < job.inputs.size(); i++) {
+      const JobInput& input = job.inputs.at(i);
+      if(!app.addInputStream(input.path, input.format, input.channel)) {
+        log_msg<LOG_ERROR>(L"BatchRunner - job %s: can not read input %s")
+                           %job.name.c_str() %input.path.c_str();
+        throw(-1);
+      }
+    }
+  }
+
+  void runJob(FDTD::App& app, const JobSpec& job, JobResult& result) {
+    SweepConfig config;
+    config.sources = job.sources;
+    config.receivers = job.receivers;
+    config.num_steps = job.num_steps;
+    config.applyTo(app.m_parameters);
+    app.m_parameters.setOutputFs(job.output_fs);
+    app.setResponseStream(job.output_path, job.output_format, false);
+
+    if(job.solver == JOB_SOLVER_HOST) {
+      app.runSimulationHost(1, job.threads);
+    }
+    else {
+      if(!app.isSessionPrepared())
+        app.prepareSession();
+      app.runSimulation();
+    }
+
+    result.num_receivers = app.m_parameters.getNumReceivers();
+    result.num_samples = app.m_parameters.getNumOutputSamples();
+    result.fs = app.m_parameters.getResponseFs();
+    result.cached = app.isLastRunCached();
+    result.ok = true;
+  }
+
+  // The jobs of a lane run one after the other on the mesh of their group
+  void runGroup(const std::vector<JobSpec>* jobs,
+                const std::vector<unsigned int>* group,
+                unsigned int group_idx,
+                const std::string* cache_dir,
+                double cache_megabytes,
+                std::vector<JobResult>* results) {
+    FDTD::App app;
+    // The progress of concurrent groups would interleave on the console
+    app.m_progress = (ProgressCallback)NULL;
+    app.setResultCache(*cache_dir, cache_megabytes);
+    const JobSpec& first = jobs->at(group->at(0));
+    log_msg<LOG_INFO>(L"BatchRunner - group %u: %u jobs on %s, fs %u")
+                      %group_idx %group->size() %first.geometry.c_str() %first.fs;
+
+    bool ready = true;
+    try {
+      app.initializeDevices(false);
+      setupMesh(app, first);
+    }
+    catch(...) {
+      ready = false;
+    }
+
+    for(unsigned int i = 0; i < group->size(); i++) {
+      const JobSpec& job = jobs->at(group->at(i));
+      JobResult& result = results->at(group->at(i));
+      result.group = group_idx;
+      if(!ready)
+        continue;
+
+      boost::posix_time::ptime start = boost::posix_time::microsec_clock::local_time();
+      try {
+        runJob(app, job, result);
+      }
+      catch(...) {
+        // The next job builds the mesh again
+        app.closeSession();
+        result.ok = false;
+      }
+      boost::posix_time::time_duration d = boost::posix_time::microsec_clock::local_time()-start;
+      result.seconds = (double)d.total_microseconds()/1e6;
+      log_msg<LOG_INFO>(L"BatchRunner - job %s %s, %f s")
+                        %job.name.c_str()
+                        %(result.ok ? (result.cached ? "cached" : "done") : "failed")
+                        %result.seconds;
+    }
+
+    app.closeSession();
+    if(app.m_mesh.getNumberOfPartitions() > 0)
+      app.m_mesh.destroyPartitions();
+  }
+}
+
+std::vector<JobResult> BatchRunner::run(const std::vector<JobSpec>& jobs) {
+  std::vector<JobResult> results(jobs.size());
+  std::vector< std::vector<unsigned int> > groups = groupByMesh(jobs);
+  log_msg<LOG_INFO>(L"BatchRunner::run - %u jobs in %u meshes, concurrency %u")
+                    %jobs.size() %groups.size() %this->concurrency_;
+
+  // The devices are reset once, before any of the groups allocates. A
+  // failure is reported by the groups.
+  try {
+    FDTD::App devices;
+    devices.initializeDevices();
+  }
+  catch(...) {}
+
+  // The spare workers split the largest groups into lanes, each lane
+  // builds the mesh of its group on an app of its own
+  std::vector<unsigned int> lanes_per_group = getLanesPerGroup(groups, this->concurrency_);
+  std::vector< std::vector<unsigned int> > lanes;
+  std::vector<unsigned int> lane_groups;
+  for(unsigned int g = 0; g < groups.size(); g++) {
+    unsigned int num_lanes = lanes_per_group.at(g);
+    if(num_lanes > 1)
+      log_msg<LOG_INFO>(L"BatchRunner::run - group %u runs in %u lanes, the mesh is voxelized %u times")
+                        %g %num_lanes %num_lanes;
+    for(unsigned int l = 0; l < num_lanes; l++) {
+      lanes.push_back(std::vector<unsigned int>());
+      lane_groups.push_back(g);
+      for(unsigned int i = l; i < groups.at(g).size(); i += num_lanes)
+        lanes.back().push_back(groups.at(g).at(i));
+    }
+  }
+
+  std::vector<ThreadPool::Task> tasks;
+  for(unsigned int l = 0; l < lanes.size(); l++)
+    tasks.push_back(boost::bind(&runGroup, &jobs, &lanes.at(l), lane_groups.at(l),
+                                &this->cache_dir_, this->cache_megabytes_, &results));
+
+  ThreadPool pool(std::min(this->concurrency_, (unsigned int)std::max(lanes.size(), (size_t)1)));
+  pool.runAll(tasks);
+  return results;
+}
+
+bool BatchRunner::writeReport(const std::string& path,
+                              const std::vector<JobSpec>& jobs,
+                              const std::vector<JobResult>& results) {
+  ptree root;
+  ptree list;
+  unsigned int failed = 0;
+  for(unsigned int i = 0; i < jobs.size() && i < results.size(); i++) {
+    const JobSpec& job = jobs.at(i);
+    const JobResult& result = results.at(i);
+    ptree entry;
+    entry.put("name", job.name);
+    entry.put("status", result.ok ? "done" : "failed");
+    entry.put("group", result.group);
+    entry.put("cached", result.cached);
+    entry.put("output.path", job.output_path);
+    entry.put("output.format", format_names[job.output_format]);
+    entry.put("output.channels", result.num_receivers);
+    entry.put("output.samples", result.num_samples);
+    entry.put("output.fs", result.fs);
+    entry.put("seconds", result.seconds);
+    list.push_back(std::make_pair("", entry));
+    failed += result.ok ? 0 : 1;
+  }
+  root.put("jobs_done", (unsigned int)jobs.size()-failed);
+  root.put("jobs_failed", failed);
+  root.add_child("jobs", list);
+
+  try {
+    boost::property_tree::write_json(path, root);
+  }
+  catch(boost::property_tree::json_parser_error& e) {
+    log_msg<LOG_ERROR>(L"BatchRunner::writeReport - %s") %e.what();
+    return false;
+  }
+  return true;
+}
@@ -0,0 +1,97 @@
+#ifndef BATCH_RUNNER_H
+#define BATCH_RUNNER_H
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// This file is a part of the PadallelFDTD Finite-Difference Time-Domain
+// simulation library. It is released under the MIT License. You should have
+// received a copy of the MIT License along with ParallelFDTD.  If not, see
+// http://www.opensource.org/licenses/mit-license.php
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// For details, see the LICENSE file
+//
+// (C) 2013-2014 Jukka Saarelma
+// Aalto University School of Science
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "JobSpec.h"
+#include <string>
+#include <vector>
+
+/// The outcome of a job
+struct JobResult {
+  JobResult()
+  : ok(false),
+    cached(false),
+    group(0),
+    num_receivers(0),
+    num_samples(0),
+    fs(0),
+    seconds(0.0)
+  {};
+
+  bool ok;
+  bool cached;                       ///< The responses were read from the cache
+  unsigned int group;                ///< Jobs of a group share a mesh
+  unsigned int num_receivers;        ///< Channels of the output
+  unsigned int num_samples;          ///< Samples of each channel
+  unsigned int fs;                   ///< Rate of the output
+  double seconds;                    ///< Wall time of the run
+};
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief Runs the jobs of a batch without an interpreter.
+///
+/// The jobs are grouped by their mesh, see JobSpec::getMeshKey(). Each
+/// group runs on an FDTD::App of its own: the mesh of the group is
+/// voxelized once and its jobs run one after the other on it, see
+/// App::runSweep(). The groups run concurrently on a thread pool. When
+/// there are fewer groups than workers, the largest groups are split into
+/// lanes which run concurrently, each lane voxelizing the mesh of the
+/// group again, see getLanesPerGroup(). The responses of each job are
+/// streamed to its output file, one channel per receiver.
+///////////////////////////////////////////////////////////////////////////////
+class BatchRunner {
+public:
+  /// \param concurrency The number of groups, or lanes of a group, run at once
+  BatchRunner(unsigned int concurrency)
+  : concurrency_(concurrency > 0 ? concurrency : 1),
+    cache_megabytes_(0.0)
+  {};
+
+  /// Keep the results of the jobs in a cache, see App::setResultCache()
+  void setResultCache(const std::string& dir, double max_megabytes)
+    {this->cache_dir_ = dir; this->cache_megabytes_ = max_megabytes;}
+
+  /////////////////////////////////////////////////////////////////////////////
+  /// \brief Run the jobs. A failed job does not stop the others.
+  /// \param jobs The jobs
+  /// \return The result of each job
+  /////////////////////////////////////////////////////////////////////////////
+  std::vector<JobResult> run(const std::vector<JobSpec>& jobs);
+
+  /////////////////////////////////////////////////////////////////////////////
+  /// \brief Write a JSON summary of the runs, which also describes the
+  /// layout of the output files
+  /// \return false if the file can not be written
+  /////////////////////////////////////////////////////////////////////////////
+  static bool writeReport(const std::string& path,
+                          const std::vector<JobSpec>& jobs,
+                          const std::vector<JobResult>& results);
+
+private:
+  unsigned int concurrency_;
+  std::string cache_dir_;
+  double cache_megabytes_;
+};
+
+#endif
@@ -0,0 +1,349 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// This file is a part of the PadallelFDTD Finite-Difference Time-Domain
+// simulation library. It is released under the MIT License. You should have
+// received a copy of the MIT License along with ParallelFDTD.  If not, see
+// http://www.opensource.org/licenses/mit-license.php
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// For details, see the LICENSE file
+//
+// (C) 2013-2014 Jukka Saarelma
+// Aalto University School of Science
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "JobSpec.h"
+#include "../base/MaterialHandler.h"
+#include "../base/SimulationParameters.h"
+#include "../io/InputStream.h"
+#include "../io/ResponseWriter.h"
+#include "../global_includes.h"
+#include "../logger.h"
+
+#include <boost/property_tree/json_parser.hpp>
+#include <boost/lexical_cast.hpp>
+#include <iomanip>
+#include <map>
+#include <sstream>
+
+using boost::property_tree::ptree;
+
+namespace {
+  const ptree empty_node;
+
+  const char* const update_type_names[] = {"srl_forward", "shared", "srl"};
+  const char* const precision_names[] = {"single", "double"};
+  const char* const solver_names[] = {"cuda", "host"};
+  const char* const src_type_names[] = {"hard", "soft", "transparent"};
+  const char* const input_type_names[] = {"impulse", "gaussian", "sine", "data", "stream"};
+  const char* const response_format_names[] = {"raw_float", "raw_double", "wav"};
+  const char* const stream_format_names[] = {"wav", "raw_float", "raw_double"};
+
+  // An enumeration given by its name or its integer value
+  bool parseEnum(const std::string& value, const char* const names[],
+                 int count, int& ret) {
+    for(int i = 0; i < count; i++) {
+      if(value == names[i]) {
+        ret = i;
+        return true;
+      }
+    }
+    try {
+      ret = boost::lexical_cast<int>(value);
+    }
+    catch(boost::bad_lexical_cast&) {
+      return false;
+    }
+    return ret >= 0 && ret < count;
+  }
+
+  bool readEnum(const ptree& node, const char* key, const char* const names[],
+                int count, int& ret) {
+    boost::optional<std::string> value = node.get_optional<std::string>(key);
+    if(!value)
+      return true;
+    if(parseEnum(*value, names, count, ret))
+      return true;
+    log_msg<LOG_ERROR>(L"JobSpec::parse - invalid %s: %s") %key %value->c_str();
+    return false;
+  }
+
+  // The children of an array node
+  template <typename T>
+  bool readArray(const ptree& node, std::vector<T>& ret) {
+    ret.clear();
+    try {
+      for(ptree::const_iterator it = node.begin(); it != node.end(); it++)
+        ret.push_back(it->second.get_value<T>());
+    }
+    catch(boost::property_tree::ptree_error&) {
+      return false;
+    }
+    return true;
+  }
+
+  bool readPosition(const ptree& node, float& x, float& y, float& z) {
+    std::vector<float> p;
+    if(!readArray(node, p) || p.size() != 3)
+      return false;
+    x = p.at(0); y = p.at(1); z = p.at(2);
+    return true;
+  }
+
+  // The admittances of a material given as a reflection coefficient or
+  // a list of admittances
+  bool readCoefficients(const ptree& node, std::vector<float>& coefficients) {
+    boost::optional<float> reflection = node.get_optional<float>("reflection");
+    boost::optional<const ptree&> admittance = node.get_child_optional("admittance");
+    if(reflection) {
+      coefficients.assign(MATERIAL_COEF_NUM, reflection2Admitance(*reflection));
+      return true;
+    }
+    if(admittance) {
+      std::vector<float> values;
+      if(!readArray(*admittance, values) || values.empty() || values.size() > MATERIAL_COEF_NUM)
+        return false;
+      coefficients.assign(MATERIAL_COEF_NUM, 0.f);
+      std::copy(values.begin(), values.end(), coefficients.begin());
+      return true;
+    }
+    return false;
+  }
+
+  // The keys of the job override those of the defaults
+  ptree mergeDefaults(const ptree& defaults, const ptree& job) {
+    ptree merged = defaults;
+    for(ptree::const_iterator it = job.begin(); it != job.end(); it++)
+      merged.put_child(it->first, it->second);
+    return merged;
+  }
+}
+
+JobSpec::JobSpec()
+: coefficients(MATERIAL_COEF_NUM, reflection2Admitance(0.9f)),
+  fs(0),
+  num_steps(0),
+  update_type(SRL_FORWARD),
+  is_double(false),
+  solver(JOB_SOLVER_CUDA),
+  threads(1),
+  octave(0),
+  output_fs(0),
+  output_format(RESPONSE_RAW_FLOAT)
+{}
+
+bool JobSpec::parse(const ptree& job, unsigned int index) {
+  this->name = job.get<std::string>("name", "job_"+boost::lexical_cast<std::string>(index));
+  try {
+    this->geometry = job.get<std::string>("geometry");
+    this->fs = job.get<unsigned int>("fs");
+    this->num_steps = job.get<unsigned int>("steps");
+    this->threads = job.get<unsigned int>("threads", 1);
+    this->octave = job.get<unsigned int>("octave", 0);
+    this->output_fs = job.get<unsigned int>("output_fs", 0);
+    this->grid_ir = job.get<std::string>("grid_ir", "");
+  }
+  catch(boost::property_tree::ptree_error& e) {
+    log_msg<LOG_ERROR>(L"JobSpec::parse - job %s: %s") %this->name.c_str() %e.what();
+    return false;
+  }
+
+  int precision = 0;
+  int solver_idx = JOB_SOLVER_CUDA;
+  if(!readEnum(job, "update_type", update_type_names, 3, this->update_type) ||
+     !readEnum(job, "precision", precision_names, 2, precision) ||
+     !readEnum(job, "solver", solver_names, 2, solver_idx))
+    return false;
+  this->is_double = precision == 1;
+  this->solver = (enum JobSolver)solver_idx;
+
+  // Materials
+  boost::optional<const ptree&> materials = job.get_child_optional("materials");
+  if(materials) {
+    if((materials->count("reflection") || materials->count("admittance")) &&
+       !readCoefficients(*materials, this->coefficients)) {
+      log_msg<LOG_ERROR>(L"JobSpec::parse - job %s: invalid materials") %this->name.c_str();
+      return false;
+    }
+    const ptree& layers = materials->get_child("layers", empty_node);
+    for(ptree::const_iterator it = layers.begin(); it != layers.end(); it++) {
+      LayerMaterial layer;
+      boost::optional<const ptree&> triangles = it->second.get_child_optional("triangles");
+      if(!triangles || !readArray(*triangles, layer.triangles) ||
+         !readCoefficients(it->second, layer.coefficients)) {
+        log_msg<LOG_ERROR>(L"JobSpec::parse - job %s: invalid layer %u")
+                           %this->name.c_str() %this->layers.size();
+        return false;
+      }
+      this->layers.push_back(layer);
+    }
+  }
+
+  // Input signals
+  const ptree& inputs = job.get_child("inputs", empty_node);
+  for(ptree::const_iterator it = inputs.begin(); it != inputs.end(); it++) {
+    JobInput input;
+    input.path = it->second.get<std::string>("path", "");
+    input.format = STREAM_WAV;
+    input.channel = it->second.get<unsigned int>("channel", 0);
+    if(input.path.empty() ||
+       !readEnum(it->second, "format", stream_format_names, 3, input.format)) {
+      log_msg<LOG_ERROR>(L"JobSpec::parse - job %s: invalid input %u")
+                         %this->name.c_str() %this->inputs.size();
+      return false;
+    }
+    this->inputs.push_back(input);
+  }
+
+  // Sources and receivers
+  const ptree& sources = job.get_child("sources", empty_node);
+  for(ptree::const_iterator it = sources.begin(); it != sources.end(); it++) {
+    float x, y, z;
+    int type = SRC_SOFT;
+    int input = IMPULSE;
+    boost::optional<const ptree&> position = it->second.get_child_optional("position");
+    if(!position || !readPosition(*position, x, y, z) ||
+       !readEnum(it->second, "type", src_type_names, 3, type) ||
+       !readEnum(it->second, "input", input_type_names, 5, input)) {
+      log_msg<LOG_ERROR>(L"JobSpec::parse - job %s: invalid source %u")
+                         %this->name.c_str() %this->sources.size();
+      return false;
+    }
+    this->sources.push_back(Source(x, y, z, (enum SrcType)type, (enum InputType)input,
+                                   it->second.get<unsigned int>("data", 0)));
+  }
+
+  const ptree& receivers = job.get_child("receivers", empty_node);
+  for(ptree::const_iterator it = receivers.begin(); it != receivers.end(); it++) {
+    float x, y, z;
+    if(!readPosition(it->second, x, y, z)) {
+      log_msg<LOG_ERROR>(L"JobSpec::parse - job %s: invalid receiver %u")
+                         %this->name.c_str() %this->receivers.size();
+      return false;
+    }
+    this->receivers.push_back(Receiver(x, y, z));
+  }
+
+  if(this->sources.empty() || this->receivers.empty()) {
+    log_msg<LOG_ERROR>(L"JobSpec::parse - job %s has no sources or receivers") %this->name.c_str();
+    return false;
+  }
+
+  // Output
+  this->output_path = job.get<std::string>("output.path", "");
+  if(this->output_path.empty()) {
+    log_msg<LOG_ERROR>(L"JobSpec::parse - job %s has no output path") %this->name.c_str();
+    return false;
+  }
+  if(!readEnum(job, "output.format", response_format_names, 3, this->output_format))
+    return false;
+
+  return true;
+}
+
+std::string JobSpec::getMeshKey() const {
+  std::stringstream ss;
+  // Coefficients which differ in the last digits make different meshes
+  ss<<std::setprecision(17);
+  ss<<this->geometry<<"|"<<this->fs<<"|"<<this->update_type<<"|"<<this->is_double
+    <<"|"<<this->grid_ir<<"|"<<this->octave<<"|";
+  if(this->solver == JOB_SOLVER_HOST)
+    ss<<"host:"<<this->name<<"|";
+  for(unsigned int i = 0; i < this->coefficients.size(); i++)
+    ss<<this->coefficients.at(i)<<",";
+  for(unsigned int i = 0; i < this->layers.size(); i++) {
+    ss<<"|";
+    for(unsigned int j = 0; j < this->layers.at(i).triangles.size(); j++)
+      ss<<this->layers.at(i).triangles.at(j)<<",";
+    ss<<":";
+    for(unsigned int j = 0; j < this->layers.at(i).coefficients.size(); j++)
+      ss<<this->layers.at(i).coefficients.at(j)<<",";
+  }
+  for(unsigned int i = 0; i < this->inputs.size(); i++)
+    ss<<"|"<<this->inputs.at(i).path<<":"<<this->inputs.at(i).format
+      <<":"<<this->inputs.at(i).channel;
+  return ss.str();
+}
+
+std::vector< std::vector<unsigned int> > groupByMesh(const std::vector<JobSpec>& jobs) {
+  std::vector< std::vector<unsigned int> > groups;
+  std::map<std::string, unsigned int> group_of_key;
+  for(unsigned int i = 0; i < jobs.size(); i++) {
+    std::string key = jobs.at(i).getMeshKey();
+    std::map<std::string, unsigned int>::iterator it = group_of_key.find(key);
+    if(it == group_of_key.end()) {
+      group_of_key[key] = (unsigned int)groups.size();
+      groups.push_back(std::vector<unsigned int>(1, i));
+    }
+    else {
+      groups.at(it->second).push_back(i);
+    }
+  }
+  return groups;
+}
+
+std::vector<unsigned int> getLanesPerGroup(const std::vector< std::vector<unsigned int> >& groups,
+                                           unsigned int concurrency) {
+  std::vector<unsigned int> lanes(groups.size(), 1);
+  for(unsigned int spare = (unsigned int)groups.size(); spare < concurrency; spare++) {
+    unsigned int best = 0;
+    double best_load = 1.0;
+    for(unsigned int g = 0; g < groups.size(); g++) {
+      double load = (double)groups.at(g).size()/(double)lanes.at(g);
+      if(lanes.at(g) < groups.at(g).size() && load > best_load) {
+        best = g;
+        best_load = load;
+      }
+    }
+    if(best_load <= 1.0)
+      break;
+    lanes.at(best)++;
+  }
+  return lanes;
+}
+
+bool BatchSpec::parse(const ptree& root) {
+  this->concurrency = root.get<unsigned int>("concurrency", this->concurrency);
+  this->report = root.get<std::string>("report", this->report);
+  this->cache_dir = root.get<std::string>("cache.path", this->cache_dir);
+  this->cache_megabytes = root.get<double>("cache.megabytes", this->cache_megabytes);
+  this->jobs.clear();
+
+  ptree defaults = root.get_child("defaults", ptree());
+  boost::optional<const ptree&> jobs = root.get_child_optional("jobs");
+  if(!jobs) {
+    log_msg<LOG_ERROR>(L"BatchSpec::parse - no jobs");
+    return false;
+  }
+
+  unsigned int index = 0;
+  for(ptree::const_iterator it = jobs->begin(); it != jobs->end(); it++, index++) {
+    JobSpec job;
+    if(!job.parse(mergeDefaults(defaults, it->second), index))
+      return false;
+    this->jobs.push_back(job);
+  }
+  log_msg<LOG_INFO>(L"BatchSpec::parse - %u jobs, concurrency %u")
+                    %this->jobs.size() %this->concurrency;
+  return true;
+}
+
+bool BatchSpec::read(const std::string& path) {
+  ptree root;
+  try {
+    boost::property_tree::read_json(path, root);
+  }
+  catch(boost::property_tree::json_parser_error& e) {
+    log_msg<LOG_ERROR>(L"BatchSpec::read - %s") %e.what();
+    return false;
+  }
+  return this->parse(root);
+}
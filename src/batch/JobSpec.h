@@ -0,0 +1,151 @@
+#ifndef JOB_SPEC_H
+#define JOB_SPEC_H
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// This file is a part of the PadallelFDTD Finite-Difference Time-Domain
+// simulation library. It is released under the MIT License. You should have
+// received a copy of the MIT License along with ParallelFDTD.  If not, see
+// http://www.opensource.org/licenses/mit-license.php
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// For details, see the LICENSE file
+//
+// (C) 2013-2014 Jukka Saarelma
+// Aalto University School of Science
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "../base/SrcRec.h"
+#include <boost/property_tree/ptree.hpp>
+#include <string>
+#include <vector>
+
+enum JobSolver {JOB_SOLVER_CUDA, JOB_SOLVER_HOST};
+
+/// The material of a set of triangles of the geometry
+struct LayerMaterial {
+  std::vector<int> triangles;
+  std::vector<float> coefficients;   ///< Admittances, MATERIAL_COEF_NUM of them
+};
+
+/// A signal file read by the DATA_STREAM sources
+struct JobInput {
+  std::string path;
+  int format;                        ///< InputStreamFormat
+  unsigned int channel;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief One simulation of a batch, read from a JSON job file.
+///
+/// A job file is an object with the optional keys "concurrency", "report",
+/// "cache" and "defaults", and an array "jobs". "cache" is {"path": dir,
+/// "megabytes": size}, a result cache shared by the jobs, see
+/// App::setResultCache(). The keys of "defaults" apply to each job which
+/// does not set them. A job has the keys
+///
+///   "name"        string, default job_<index>
+///   "geometry"    path of a VTK file
+///   "materials"   {"reflection": r} or {"admittance": [...]} for all the
+///                 surfaces, and "layers": [{"triangles": [...],
+///                 "reflection": r}, ...] for sets of triangles
+///   "fs"          spatial sample rate
+///   "steps"       number of steps
+///   "update_type" "srl_forward", "shared" or "srl", default srl_forward
+///   "precision"   "single" or "double", default single
+///   "solver"      "cuda" or "host", default cuda
+///   "threads"     threads of the host solver, default 1
+///   "octave"      material coefficient used, default 0
+///   "output_fs"   rate of the responses, default the spatial fs
+///   "grid_ir"     grid impulse response file
+///   "inputs"      [{"path": p, "format": "wav"|"raw_float"|"raw_double",
+///                 "channel": c}, ...], the signals of the DATA_STREAM
+///                 sources in order
+///   "sources"     [{"position": [x, y, z], "type": "hard"|"soft"|
+///                 "transparent", "input": "impulse"|"gaussian"|"sine"|
+///                 "data"|"stream", "data": index}, ...]
+///   "receivers"   [[x, y, z], ...]
+///   "output"      {"path": p, "format": "raw_float"|"raw_double"|"wav"},
+///                 required, the format defaults to raw_float
+///
+/// The enumerations can also be given as their integer values.
+///////////////////////////////////////////////////////////////////////////////
+struct JobSpec {
+  JobSpec();
+
+  std::string name;
+  std::string geometry;
+  std::vector<float> coefficients;   ///< Admittances of the surfaces outside the layers
+  std::vector<LayerMaterial> layers;
+  unsigned int fs;
+  unsigned int num_steps;
+  int update_type;                   ///< UpdateType
+  bool is_double;
+  enum JobSolver solver;
+  unsigned int threads;
+  unsigned int octave;
+  unsigned int output_fs;
+  std::string grid_ir;
+  std::vector<JobInput> inputs;
+  std::vector<Source> sources;
+  std::vector<Receiver> receivers;
+  std::string output_path;
+  int output_format;                 ///< ResponseFormat
+
+  /////////////////////////////////////////////////////////////////////////////
+  /// \brief Read a job
+  /// \param job The job object
+  /// \param index The index of the job in the batch, names unnamed jobs
+  /// \return false if a key is invalid or a required key is missing
+  /////////////////////////////////////////////////////////////////////////////
+  bool parse(const boost::property_tree::ptree& job, unsigned int index);
+
+  /////////////////////////////////////////////////////////////////////////////
+  /// \brief The jobs with the same key can run on the same mesh: they have
+  /// the same geometry, materials, spatial fs, scheme, precision and input
+  /// signals. The host solver does not keep its mesh, each of its jobs has
+  /// a key of its own.
+  /////////////////////////////////////////////////////////////////////////////
+  std::string getMeshKey() const;
+};
+
+/// Group the jobs by their mesh key, the groups and the jobs of a group
+/// keep the order of the batch
+std::vector< std::vector<unsigned int> > groupByMesh(const std::vector<JobSpec>& jobs);
+
+/// The number of lanes of each group when concurrency lanes run at once.
+/// Each group has a lane, the spare lanes go one at a time to the group
+/// with the most jobs per lane. A lane voxelizes the mesh of its group
+/// again, so the spare lanes trade device memory for concurrency.
+std::vector<unsigned int> getLanesPerGroup(const std::vector< std::vector<unsigned int> >& groups,
+                                           unsigned int concurrency);
+
+/// The jobs of a job file
+struct BatchSpec {
+  BatchSpec()
+  : concurrency(1),
+    cache_megabytes(1024.0)
+  {};
+
+  unsigned int concurrency;          ///< Meshes run at once
+  std::string report;                ///< Summary of the runs, empty for none
+  std::string cache_dir;             ///< Directory of the result cache, empty for none
+  double cache_megabytes;            ///< Size of the result cache
+  std::vector<JobSpec> jobs;
+
+  /// Read the batch from a parsed job file, false if a job is invalid
+  bool parse(const boost::property_tree::ptree& root);
+
+  /// Read a job file, false if it is not valid JSON or a job is invalid
+  bool read(const std::string& path);
+};
+
+#endif
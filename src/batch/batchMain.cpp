@@ -0,0 +1,87 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// This file is a part of the PadallelFDTD Finite-Difference Time-Domain
+// simulation library. It is released under the MIT License. You should have
+// received a copy of the MIT License along with ParallelFDTD.  If not, see
+// http://www.opensource.org/licenses/mit-license.php
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// For details, see the LICENSE file
+//
+// (C) 2013-2014 Jukka Saarelma
+// Aalto University School of Science
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include <stdlib.h>
+#include <string.h>
+#include <iostream>
+#include "BatchRunner.h"
+#include "../logger.h"
+
+// Runs the jobs of a JSON job file without visualization or an
+// interpreter, see JobSpec.h for the format of the file.
+//
+// parallelFDTDBatch jobs.json [--concurrency N] [--report path]
+//
+// The options override the keys of the job file. Returns 0 if all the
+// jobs were run, 1 otherwise.
+
+namespace {
+  void usage() {
+    std::cerr<<"usage: parallelFDTDBatch jobs.json [--concurrency N] [--report path]"<<std::endl;
+  }
+}
+
+int main(int argc, char** argv){
+  if(argc < 2) {
+    usage();
+    return 1;
+  }
+
+  std::string job_file = argv[1];
+  int concurrency = -1;
+  std::string report;
+  for(int i = 2; i < argc; i++) {
+    if(!strcmp(argv[i], "--concurrency") && i+1 < argc) {
+      concurrency = atoi(argv[++i]);
+    }
+    else if(!strcmp(argv[i], "--report") && i+1 < argc) {
+      report = argv[++i];
+    }
+    else {
+      usage();
+      return 1;
+    }
+  }
+
+  loggerInit();
+  BatchSpec batch;
+  if(!batch.read(job_file))
+    return 1;
+  if(concurrency > 0)
+    batch.concurrency = (unsigned int)concurrency;
+  if(!report.empty())
+    batch.report = report;
+
+  BatchRunner runner(batch.concurrency);
+  runner.setResultCache(batch.cache_dir, batch.cache_megabytes);
+  std::vector<JobResult> results = runner.run(batch.jobs);
+
+  unsigned int failed = 0;
+  for(unsigned int i = 0; i < results.size(); i++)
+    failed += results.at(i).ok ? 0 : 1;
+  log_msg<LOG_INFO>(L"parallelFDTDBatch - %u of %u jobs done")
+                    %(results.size()-failed) %results.size();
+
+  if(!batch.report.empty() && !BatchRunner::writeReport(batch.report, batch.jobs, results))
+    return 1;
+  return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,73 @@
+#ifndef HALO_TRANSPORT_H
+#define HALO_TRANSPORT_H
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// This file is a part of the PadallelFDTD Finite-Difference Time-Domain
+// simulation library. It is released under the MIT License. You should have
+// received a copy of the MIT License along with ParallelFDTD.  If not, see
+// http://www.opensource.org/licenses/mit-license.php
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// For details, see the LICENSE file
+//
+// (C) 2013-2014 Jukka Saarelma
+// Aalto University School of Science
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include <cstddef>
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief Interface for moving halos and results between the ranks of a
+/// distributed run. Each rank runs in its own process. The messages between
+/// two ranks arrive in the order they were sent. Send and receive block
+/// until the whole message is transferred, errors throw -1.
+///////////////////////////////////////////////////////////////////////////////
+class HaloTransport {
+public:
+  HaloTransport(unsigned int rank, unsigned int size)
+  : rank_(rank),
+    size_(size)
+  {};
+
+  virtual ~HaloTransport() {};
+
+  /// \brief Send a message to a rank
+  virtual void send(unsigned int peer, const void* data, size_t bytes) = 0;
+
+  /// \brief Receive a message of a known size from a rank
+  virtual void receive(unsigned int peer, void* data, size_t bytes) = 0;
+
+  /////////////////////////////////////////////////////////////////////////////
+  /// \brief Swap equally sized messages with a rank. The lower rank sends
+  /// first, which keeps a chain of exchanges free of deadlocks even when
+  /// the transport cannot buffer a whole message
+  /////////////////////////////////////////////////////////////////////////////
+  void exchange(unsigned int peer, const void* send_data, void* recv_data, size_t bytes) {
+    if(this->rank_ < peer) {
+      this->send(peer, send_data, bytes);
+      this->receive(peer, recv_data, bytes);
+    }
+    else {
+      this->receive(peer, recv_data, bytes);
+      this->send(peer, send_data, bytes);
+    }
+  }
+
+  unsigned int getRank() const {return this->rank_;}
+  unsigned int getSize() const {return this->size_;}
+
+protected:
+  unsigned int rank_;   ///< Index of this rank
+  unsigned int size_;   ///< Number of ranks
+};
+
+#endif
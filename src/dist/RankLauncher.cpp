@@ -0,0 +1,124 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// This file is a part of the PadallelFDTD Finite-Difference Time-Domain
+// simulation library. It is released under the MIT License. You should have
+// received a copy of the MIT License along with ParallelFDTD.  If not, see
+// http://www.opensource.org/licenses/mit-license.php
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// For details, see the LICENSE file
+//
+// (C) 2013-2014 Jukka Saarelma
+// Aalto University School of Science
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "RankLauncher.h"
+#include "ShmTransport.h"
+#include "TcpTransport.h"
+#include "../logger.h"
+
+#include <boost/lexical_cast.hpp>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <signal.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <vector>
+
+namespace {
+  const size_t shm_ring_size = 1<<20;
+
+  HaloTransport* makeTransport(enum TransportType type, const std::string& name,
+                               unsigned short base_port,
+                               unsigned int rank, unsigned int size, double timeout) {
+    if(type == TRANSPORT_SHM)
+      return new ShmTransport(name, rank, size, timeout);
+    return new TcpTransport("127.0.0.1", base_port, rank, size, timeout);
+  }
+
+  int runRank(enum TransportType type, const std::string& name,
+              unsigned short base_port, unsigned int rank, unsigned int size,
+              RankMain rank_main, void* arg, double timeout) {
+    int ret = -1;
+    HaloTransport* transport = NULL;
+    try {
+      transport = makeTransport(type, name, base_port, rank, size, timeout);
+      ret = rank_main(transport, arg);
+    }
+    catch(...) {
+      log_msg<LOG_ERROR>(L"launchRanks - rank %u failed") %rank;
+      ret = -1;
+    }
+    delete transport;
+    return ret;
+  }
+}
+
+int launchRanks(unsigned int number_of_ranks,
+                enum TransportType transport_type,
+                RankMain rank_main,
+                void* arg,
+                double timeout) {
+  pid_t parent = getpid();
+  std::string name = "/pfdtd_"+boost::lexical_cast<std::string>(parent);
+  unsigned short base_port = (unsigned short)(20000+parent%20000);
+  const char* port_env = getenv("PFDTD_BASE_PORT");
+  if(port_env)
+    base_port = (unsigned short)atoi(port_env);
+
+  log_msg<LOG_INFO>(L"launchRanks - %u ranks, transport %s")
+                    %number_of_ranks %(transport_type == TRANSPORT_SHM ? "shm" : "tcp");
+
+  if(transport_type == TRANSPORT_SHM &&
+     !ShmTransport::createSegment(name, number_of_ranks, shm_ring_size))
+    return -1;
+
+  std::vector<pid_t> children;
+  for(unsigned int rank = 1; rank < number_of_ranks; rank++) {
+    pid_t pid = fork();
+    if(pid == 0) {
+      int ret = runRank(transport_type, name, base_port, rank, number_of_ranks,
+                        rank_main, arg, timeout);
+      _exit(ret == 0 ? 0 : 1);
+    }
+    if(pid < 0) {
+      log_msg<LOG_ERROR>(L"launchRanks - fork failed for rank %u") %rank;
+      for(unsigned int i = 0; i < children.size(); i++)
+        kill(children.at(i), SIGTERM);
+      number_of_ranks = 0;
+      break;
+    }
+    children.push_back(pid);
+  }
+
+  int ret = -1;
+  if(number_of_ranks > 0)
+    ret = runRank(transport_type, name, base_port, 0, number_of_ranks, rank_main, arg, timeout);
+
+  // A failed rank 0 leaves the others waiting on it
+  if(ret != 0)
+    for(unsigned int i = 0; i < children.size(); i++)
+      kill(children.at(i), SIGTERM);
+
+  for(unsigned int i = 0; i < children.size(); i++) {
+    int status = 0;
+    waitpid(children.at(i), &status, 0);
+    if(!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+      log_msg<LOG_ERROR>(L"launchRanks - rank %u exited with an error") %(i+1);
+      ret = -1;
+    }
+  }
+
+  if(transport_type == TRANSPORT_SHM)
+    ShmTransport::removeSegment(name);
+
+  return ret;
+}
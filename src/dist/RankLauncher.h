@@ -0,0 +1,56 @@
+#ifndef RANK_LAUNCHER_H
+#define RANK_LAUNCHER_H
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// This file is a part of the PadallelFDTD Finite-Difference Time-Domain
+// simulation library. It is released under the MIT License. You should have
+// received a copy of the MIT License along with ParallelFDTD.  If not, see
+// http://www.opensource.org/licenses/mit-license.php
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// For details, see the LICENSE file
+//
+// (C) 2013-2014 Jukka Saarelma
+// Aalto University School of Science
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "HaloTransport.h"
+#include <string>
+
+enum TransportType {TRANSPORT_SHM, TRANSPORT_TCP};
+
+/// The function run by each rank, returns 0 on success
+typedef int (*RankMain)(HaloTransport* transport, void* arg);
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief Run a function in number_of_ranks processes on this machine.
+/// Ranks 1..N-1 are forked from the calling process, rank 0 runs in the
+/// calling process so its results stay in its memory. Each rank gets a
+/// connected transport.
+///
+/// The child processes must not use a CUDA context created before the
+/// launch.
+///
+/// \param number_of_ranks The number of processes
+/// \param transport_type TRANSPORT_SHM or TRANSPORT_TCP on localhost
+/// \param rank_main The function run by each rank
+/// \param arg Argument passed to rank_main
+/// \param timeout Seconds a rank waits for its peers before failing
+/// \return 0 if all the ranks returned 0, -1 otherwise
+///////////////////////////////////////////////////////////////////////////////
+int launchRanks(unsigned int number_of_ranks,
+                enum TransportType transport_type,
+                RankMain rank_main,
+                void* arg,
+                double timeout = 60.0);
+
+#endif
@@ -0,0 +1,236 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// This file is a part of the PadallelFDTD Finite-Difference Time-Domain
+// simulation library. It is released under the MIT License. You should have
+// received a copy of the MIT License along with ParallelFDTD.  If not, see
+// http://www.opensource.org/licenses/mit-license.php
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// For details, see the LICENSE file
+//
+// (C) 2013-2014 Jukka Saarelma
+// Aalto University School of Science
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "ShmTransport.h"
+#include "../logger.h"
+
+#include <boost/atomic.hpp>
+#include <boost/thread.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+#include <new>
+#include <algorithm>
+
+namespace {
+  // Header of the segment
+  struct segment_t {
+    unsigned int size;
+    unsigned long long capacity;
+  };
+
+  // Header of each ring, the counters are on their own cache lines
+  struct channel_t {
+    boost::atomic<unsigned long long> head;   ///< Bytes written
+    char pad_0[64-sizeof(boost::atomic<unsigned long long>)];
+    boost::atomic<unsigned long long> tail;   ///< Bytes read
+    char pad_1[64-sizeof(boost::atomic<unsigned long long>)];
+  };
+
+  const size_t header_size = 64;
+
+  size_t getChannelSize(size_t capacity) {
+    return sizeof(channel_t)+((capacity+63)/64)*64;
+  }
+
+  size_t getSegmentSize(unsigned int size, size_t capacity) {
+    return header_size+(size_t)size*size*getChannelSize(capacity);
+  }
+
+  // Wait on the progress of the peer, false on timeout
+  class Waiter {
+  public:
+    Waiter(double timeout) : spins_(0), timeout_(timeout) {};
+    bool wait() {
+      if(++this->spins_ < 256)
+        return true;
+      if(this->spins_ == 256)
+        this->start_ = boost::posix_time::microsec_clock::local_time();
+      boost::this_thread::yield();
+      boost::posix_time::time_duration d =
+        boost::posix_time::microsec_clock::local_time()-this->start_;
+      return (double)d.total_milliseconds()/1e3 < this->timeout_;
+    }
+    void reset() {this->spins_ = 0;}
+  private:
+    unsigned int spins_;
+    double timeout_;
+    boost::posix_time::ptime start_;
+  };
+}
+
+ShmTransport::ShmTransport(const std::string& name, unsigned int rank, unsigned int size,
+                           double timeout)
+: HaloTransport(rank, size),
+  segment_(NULL),
+  segment_size_(0),
+  capacity_(0),
+  timeout_(timeout)
+{
+  int fd = shm_open(name.c_str(), O_RDWR, 0600);
+  if(fd == -1) {
+    log_msg<LOG_ERROR>(L"ShmTransport::ShmTransport - rank %u can not open segment %s")
+                       %rank %name.c_str();
+    throw(-1);
+  }
+
+  segment_t header;
+  if(pread(fd, &header, sizeof(segment_t), 0) != (ssize_t)sizeof(segment_t) ||
+     header.size != size) {
+    close(fd);
+    log_msg<LOG_ERROR>(L"ShmTransport::ShmTransport - segment %s is not for %u ranks")
+                       %name.c_str() %size;
+    throw(-1);
+  }
+
+  this->capacity_ = (size_t)header.capacity;
+  this->segment_size_ = getSegmentSize(size, this->capacity_);
+  this->segment_ = mmap(NULL, this->segment_size_, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+
+  if(this->segment_ == MAP_FAILED) {
+    this->segment_ = NULL;
+    log_msg<LOG_ERROR>(L"ShmTransport::ShmTransport - mmap failed, rank %u") %rank;
+    throw(-1);
+  }
+
+  log_msg<LOG_DEBUG>(L"ShmTransport::ShmTransport - rank %u of %u, ring %u bytes")
+                     %rank %size %(unsigned int)this->capacity_;
+}
+
+ShmTransport::~ShmTransport() {
+  if(this->segment_)
+    munmap(this->segment_, this->segment_size_);
+}
+
+bool ShmTransport::createSegment(const std::string& name, unsigned int size, size_t capacity) {
+  size_t segment_size = getSegmentSize(size, capacity);
+  shm_unlink(name.c_str());
+  int fd = shm_open(name.c_str(), O_RDWR|O_CREAT|O_EXCL, 0600);
+  if(fd == -1) {
+    log_msg<LOG_ERROR>(L"ShmTransport::createSegment - can not create %s") %name.c_str();
+    return false;
+  }
+  if(ftruncate(fd, (off_t)segment_size) != 0) {
+    close(fd);
+    shm_unlink(name.c_str());
+    log_msg<LOG_ERROR>(L"ShmTransport::createSegment - can not size %s to %u bytes")
+                       %name.c_str() %(unsigned int)segment_size;
+    return false;
+  }
+
+  void* segment = mmap(NULL, segment_size, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if(segment == MAP_FAILED) {
+    shm_unlink(name.c_str());
+    return false;
+  }
+
+  segment_t* header = (segment_t*)segment;
+  header->size = size;
+  header->capacity = (unsigned long long)capacity;
+  for(unsigned int i = 0; i < size*size; i++) {
+    char* channel = (char*)segment+header_size+i*getChannelSize(capacity);
+    channel_t* c = new (channel) channel_t;
+    c->head.store(0);
+    c->tail.store(0);
+  }
+  munmap(segment, segment_size);
+
+  log_msg<LOG_INFO>(L"ShmTransport::createSegment - %s, %u ranks, %u bytes")
+                    %name.c_str() %size %(unsigned int)segment_size;
+  return true;
+}
+
+void ShmTransport::removeSegment(const std::string& name) {
+  shm_unlink(name.c_str());
+}
+
+char* ShmTransport::getChannel(unsigned int src, unsigned int dst) {
+  return (char*)this->segment_+header_size+
+         ((size_t)src*this->size_+dst)*getChannelSize(this->capacity_);
+}
+
+void ShmTransport::send(unsigned int peer, const void* data, size_t bytes) {
+  char* channel = this->getChannel(this->rank_, peer);
+  channel_t* c = (channel_t*)channel;
+  char* ring = channel+sizeof(channel_t);
+  const char* src = (const char*)data;
+
+  unsigned long long head = c->head.load(boost::memory_order_relaxed);
+  size_t done = 0;
+  Waiter waiter(this->timeout_);
+  while(done < bytes) {
+    unsigned long long tail = c->tail.load(boost::memory_order_acquire);
+    size_t space = this->capacity_-(size_t)(head-tail);
+    if(space == 0) {
+      if(!waiter.wait()) {
+        log_msg<LOG_ERROR>(L"ShmTransport::send - rank %u timed out sending to %u")
+                           %this->rank_ %peer;
+        throw(-1);
+      }
+      continue;
+    }
+    waiter.reset();
+
+    size_t offset = (size_t)(head%this->capacity_);
+    size_t n = std::min(std::min(space, bytes-done), this->capacity_-offset);
+    memcpy(ring+offset, src+done, n);
+    head += n;
+    done += n;
+    c->head.store(head, boost::memory_order_release);
+  }
+}
+
+void ShmTransport::receive(unsigned int peer, void* data, size_t bytes) {
+  char* channel = this->getChannel(peer, this->rank_);
+  channel_t* c = (channel_t*)channel;
+  char* ring = channel+sizeof(channel_t);
+  char* dst = (char*)data;
+
+  unsigned long long tail = c->tail.load(boost::memory_order_relaxed);
+  size_t done = 0;
+  Waiter waiter(this->timeout_);
+  while(done < bytes) {
+    unsigned long long head = c->head.load(boost::memory_order_acquire);
+    size_t available = (size_t)(head-tail);
+    if(available == 0) {
+      if(!waiter.wait()) {
+        log_msg<LOG_ERROR>(L"ShmTransport::receive - rank %u timed out receiving from %u")
+                           %this->rank_ %peer;
+        throw(-1);
+      }
+      continue;
+    }
+    waiter.reset();
+
+    size_t offset = (size_t)(tail%this->capacity_);
+    size_t n = std::min(std::min(available, bytes-done), this->capacity_-offset);
+    memcpy(dst+done, ring+offset, n);
+    tail += n;
+    done += n;
+    c->tail.store(tail, boost::memory_order_release);
+  }
+}
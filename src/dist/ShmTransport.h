@@ -0,0 +1,75 @@
+#ifndef SHM_TRANSPORT_H
+#define SHM_TRANSPORT_H
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// This file is a part of the PadallelFDTD Finite-Difference Time-Domain
+// simulation library. It is released under the MIT License. You should have
+// received a copy of the MIT License along with ParallelFDTD.  If not, see
+// http://www.opensource.org/licenses/mit-license.php
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// For details, see the LICENSE file
+//
+// (C) 2013-2014 Jukka Saarelma
+// Aalto University School of Science
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "HaloTransport.h"
+#include <string>
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief HaloTransport through a POSIX shared memory segment. The segment
+/// holds a single producer, single consumer byte ring for each ordered pair
+/// of ranks. Messages larger than the ring are streamed through it.
+///
+/// The segment is created once with createSegment() before the ranks are
+/// started, each rank then attaches to it by name.
+///////////////////////////////////////////////////////////////////////////////
+class ShmTransport : public HaloTransport {
+public:
+  /////////////////////////////////////////////////////////////////////////////
+  /// \brief Attach to an existing segment
+  /// \param name The name of the segment, e.g. "/pfdtd_job"
+  /// \param rank The rank of this process
+  /// \param size The number of ranks
+  /// \param timeout Seconds a send or receive waits for the peer
+  /////////////////////////////////////////////////////////////////////////////
+  ShmTransport(const std::string& name, unsigned int rank, unsigned int size,
+               double timeout = 60.0);
+  ~ShmTransport();
+
+  void send(unsigned int peer, const void* data, size_t bytes);
+  void receive(unsigned int peer, void* data, size_t bytes);
+
+  /////////////////////////////////////////////////////////////////////////////
+  /// \brief Create and initialize a segment
+  /// \param name The name of the segment
+  /// \param size The number of ranks
+  /// \param capacity The size of each ring in bytes
+  /// \return false if the segment could not be created
+  /////////////////////////////////////////////////////////////////////////////
+  static bool createSegment(const std::string& name, unsigned int size, size_t capacity);
+
+  /// \brief Remove the name of a segment, the mappings stay valid
+  static void removeSegment(const std::string& name);
+
+private:
+  void* segment_;       ///< The mapping of the segment
+  size_t segment_size_; ///< Size of the mapping in bytes
+  size_t capacity_;     ///< Size of each ring
+  double timeout_;      ///< Seconds without progress before failing
+
+  /// \return The start of the ring from rank src to rank dst
+  char* getChannel(unsigned int src, unsigned int dst);
+};
+
+#endif
@@ -0,0 +1,165 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// This file is a part of the PadallelFDTD Finite-Difference Time-Domain
+// simulation library. It is released under the MIT License. You should have
+// received a copy of the MIT License along with ParallelFDTD.  If not, see
+// http://www.opensource.org/licenses/mit-license.php
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// For details, see the LICENSE file
+//
+// (C) 2013-2014 Jukka Saarelma
+// Aalto University School of Science
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "TcpTransport.h"
+#include "../logger.h"
+
+#include <boost/thread.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+
+namespace {
+  sockaddr_in makeAddress(const std::string& host, unsigned short port) {
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    inet_pton(AF_INET, host.c_str(), &addr.sin_addr);
+    return addr;
+  }
+
+  void setNoDelay(int fd) {
+    int flag = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(flag));
+  }
+
+  bool writeAll(int fd, const char* data, size_t bytes) {
+    while(bytes > 0) {
+      ssize_t n = ::send(fd, data, bytes, MSG_NOSIGNAL);
+      if(n < 0 && errno == EINTR)
+        continue;
+      if(n <= 0)
+        return false;
+      data += n;
+      bytes -= (size_t)n;
+    }
+    return true;
+  }
+
+  bool readAll(int fd, char* data, size_t bytes) {
+    while(bytes > 0) {
+      ssize_t n = ::recv(fd, data, bytes, 0);
+      if(n < 0 && errno == EINTR)
+        continue;
+      if(n <= 0)
+        return false;
+      data += n;
+      bytes -= (size_t)n;
+    }
+    return true;
+  }
+}
+
+TcpTransport::TcpTransport(const std::string& host, unsigned short base_port,
+                           unsigned int rank, unsigned int size, double timeout)
+: HaloTransport(rank, size),
+  sockets_(size, -1)
+{
+  // Listen for the higher ranks
+  int listener = socket(AF_INET, SOCK_STREAM, 0);
+  int reuse = 1;
+  setsockopt(listener, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+  sockaddr_in addr = makeAddress(host, (unsigned short)(base_port+rank));
+  if(listener == -1 ||
+     bind(listener, (sockaddr*)&addr, sizeof(addr)) != 0 ||
+     listen(listener, (int)size) != 0) {
+    log_msg<LOG_ERROR>(L"TcpTransport::TcpTransport - rank %u can not listen on port %u")
+                       %rank %(unsigned int)(base_port+rank);
+    if(listener != -1) close(listener);
+    throw(-1);
+  }
+
+  // Connect to the lower ranks, retry until they listen
+  boost::posix_time::ptime start = boost::posix_time::microsec_clock::local_time();
+  for(unsigned int peer = 0; peer < rank; peer++) {
+    sockaddr_in peer_addr = makeAddress(host, (unsigned short)(base_port+peer));
+    while(true) {
+      int fd = socket(AF_INET, SOCK_STREAM, 0);
+      if(connect(fd, (sockaddr*)&peer_addr, sizeof(peer_addr)) == 0) {
+        setNoDelay(fd);
+        unsigned int id = rank;
+        writeAll(fd, (const char*)&id, sizeof(id));
+        this->sockets_.at(peer) = fd;
+        break;
+      }
+      close(fd);
+      boost::posix_time::time_duration d = boost::posix_time::microsec_clock::local_time()-start;
+      if((double)d.total_milliseconds()/1e3 > timeout) {
+        close(listener);
+        log_msg<LOG_ERROR>(L"TcpTransport::TcpTransport - rank %u can not connect to %u")
+                           %rank %peer;
+        throw(-1);
+      }
+      boost::this_thread::sleep(boost::posix_time::milliseconds(10));
+    }
+  }
+
+  // Accept the higher ranks, they identify themselves
+  for(unsigned int i = rank+1; i < size; i++) {
+    pollfd pending;
+    pending.fd = listener;
+    pending.events = POLLIN;
+    int fd = -1;
+    if(poll(&pending, 1, (int)(timeout*1e3)) == 1)
+      fd = accept(listener, NULL, NULL);
+    unsigned int id = 0;
+    if(fd == -1 || !readAll(fd, (char*)&id, sizeof(id)) || id <= rank || id >= size) {
+      close(listener);
+      log_msg<LOG_ERROR>(L"TcpTransport::TcpTransport - rank %u failed to accept") %rank;
+      throw(-1);
+    }
+    setNoDelay(fd);
+    this->sockets_.at(id) = fd;
+  }
+  close(listener);
+
+  log_msg<LOG_DEBUG>(L"TcpTransport::TcpTransport - rank %u of %u connected") %rank %size;
+}
+
+TcpTransport::~TcpTransport() {
+  for(unsigned int i = 0; i < this->sockets_.size(); i++)
+    if(this->sockets_.at(i) != -1)
+      close(this->sockets_.at(i));
+}
+
+void TcpTransport::send(unsigned int peer, const void* data, size_t bytes) {
+  if(!writeAll(this->sockets_.at(peer), (const char*)data, bytes)) {
+    log_msg<LOG_ERROR>(L"TcpTransport::send - rank %u failed to send to %u")
+                       %this->rank_ %peer;
+    throw(-1);
+  }
+}
+
+void TcpTransport::receive(unsigned int peer, void* data, size_t bytes) {
+  if(!readAll(this->sockets_.at(peer), (char*)data, bytes)) {
+    log_msg<LOG_ERROR>(L"TcpTransport::receive - rank %u failed to receive from %u")
+                       %this->rank_ %peer;
+    throw(-1);
+  }
+}
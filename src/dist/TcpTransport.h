@@ -0,0 +1,56 @@
+#ifndef TCP_TRANSPORT_H
+#define TCP_TRANSPORT_H
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// This file is a part of the PadallelFDTD Finite-Difference Time-Domain
+// simulation library. It is released under the MIT License. You should have
+// received a copy of the MIT License along with ParallelFDTD.  If not, see
+// http://www.opensource.org/licenses/mit-license.php
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// For details, see the LICENSE file
+//
+// (C) 2013-2014 Jukka Saarelma
+// Aalto University School of Science
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "HaloTransport.h"
+#include <string>
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief HaloTransport over TCP sockets. Each rank listens on
+/// base_port+rank, connects to every lower rank and accepts a connection
+/// from every higher rank, giving one socket per pair of ranks.
+///////////////////////////////////////////////////////////////////////////////
+class TcpTransport : public HaloTransport {
+public:
+  /////////////////////////////////////////////////////////////////////////////
+  /// \brief Connect the rank to all other ranks, blocks until connected
+  /// \param host The address of the ranks, e.g. "127.0.0.1"
+  /// \param base_port The port of rank 0
+  /// \param rank The rank of this process
+  /// \param size The number of ranks
+  /// \param timeout Seconds to wait for the other ranks
+  /////////////////////////////////////////////////////////////////////////////
+  TcpTransport(const std::string& host, unsigned short base_port,
+               unsigned int rank, unsigned int size, double timeout = 60.0);
+  ~TcpTransport();
+
+  void send(unsigned int peer, const void* data, size_t bytes);
+  void receive(unsigned int peer, void* data, size_t bytes);
+
+private:
+  std::vector<int> sockets_;   ///< Socket to each rank, -1 for this rank
+};
+
+#endif
@@ -0,0 +1,268 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// This file is a part of the PadallelFDTD Finite-Difference Time-Domain
+// simulation library. It is released under the MIT License. You should have
+// received a copy of the MIT License along with ParallelFDTD.  If not, see
+// http://www.opensource.org/licenses/mit-license.php
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// For details, see the LICENSE file
+//
+// (C) 2013-2014 Jukka Saarelma
+// Aalto University School of Science
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "distKernels3d.h"
+#include "../kernels/kernels3d.h"
+#include "../host/hostKernels3d.h"
+#include "../logger.h"
+
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <string.h>
+#include <vector>
+
+namespace {
+
+template <typename T>
+struct RankReceivers {
+  std::vector<unsigned int> elements;   ///< Element index in the partition
+  std::vector<unsigned int> receivers;  ///< Receiver index
+  std::vector<T> samples;               ///< receivers.size()*num_steps
+};
+
+// Swap halo_depth slices of both time levels with a neighbouring rank.
+// The ghost slices of the rank are at recv_slice, the slices they mirror
+// on this rank at send_slice
+template <typename T>
+void exchangeHalo(HaloTransport* transport, unsigned int peer,
+                  T* P, T* P_past, unsigned int send_slice, unsigned int recv_slice,
+                  unsigned int halo_depth, unsigned int slice,
+                  std::vector<T>& send_buffer, std::vector<T>& recv_buffer) {
+  size_t size = (size_t)halo_depth*slice;
+  memcpy(&send_buffer[0], P+(size_t)send_slice*slice, size*sizeof(T));
+  memcpy(&send_buffer[size], P_past+(size_t)send_slice*slice, size*sizeof(T));
+  transport->exchange(peer, &send_buffer[0], &recv_buffer[0], 2*size*sizeof(T));
+  memcpy(P+(size_t)recv_slice*slice, &recv_buffer[0], size*sizeof(T));
+  memcpy(P_past+(size_t)recv_slice*slice, &recv_buffer[size], size*sizeof(T));
+}
+
+template <typename T>
+float launchDistributed(HostMesh<T>* mesh,
+                        SimulationParameters* sp,
+                        T* h_return_ptr,
+                        const std::vector<T>& source_samples,
+                        HaloTransport* transport,
+                        bool (*interruptCallback)(void),
+                        void (*progressCallback)(int, int, float)) {
+  boost::posix_time::ptime start = boost::posix_time::microsec_clock::local_time();
+
+  unsigned int rank = transport->getRank();
+  unsigned int num_ranks = transport->getSize();
+  unsigned int num_steps = sp->getNumSteps();
+  unsigned int num_receivers = sp->getNumReceivers();
+  unsigned int k = mesh->getHaloDepth();
+  unsigned int slice = mesh->getDimXY();
+
+  if(mesh->getNumberOfPartitions() != num_ranks || !mesh->hasPartition(rank)) {
+    log_msg<LOG_ERROR>(L"launchFDTD3dDistributed - rank %u of %u, mesh has %u partitions")
+                       %rank %num_ranks %mesh->getNumberOfPartitions();
+    throw(-1);
+  }
+
+  unsigned int size = mesh->getPartitionSize(rank);
+  unsigned int first = mesh->getFirstSliceIdx(rank);
+  bool has_down = rank > 0;
+  bool has_up = rank+1 < num_ranks;
+
+  log_msg<LOG_INFO>(L"launchFDTD3dDistributed - rank %u of %u, slices %u - %u, "
+                    L"halo depth %u, %u steps")
+                    %rank %num_ranks %first %mesh->getLastSliceIdx(rank) %k %num_steps;
+
+  if(sp->getNumArraySources() > 0) {
+    log_msg<LOG_ERROR>(L"launchFDTD3dDistributed - array sources are not supported");
+    throw(-1);
+  }
+  if(sp->hasMovingPositions()) {
+    log_msg<LOG_ERROR>(L"launchFDTD3dDistributed - moving sources and receivers are not supported");
+    throw(-1);
+  }
+  if(sp->hasBFormatReceivers()) {
+    log_msg<LOG_ERROR>(L"launchFDTD3dDistributed - B-format receivers are not supported");
+    throw(-1);
+  }
+
+  // Sources go to every rank holding the node, halos included
+  std::vector<unsigned int> source_elements;
+  std::vector<unsigned int> source_indices;
+  std::vector<bool> source_hard;
+  for(unsigned int s = 0; s < sp->getNumSources(); s++) {
+    nv::Vec3i pos = sp->getSourceElementCoordinates(s);
+    if((unsigned int)pos.z < first || (unsigned int)pos.z > mesh->getLastSliceIdx(rank))
+      continue;
+    source_elements.push_back(mesh->getElementIndex(pos.x, pos.y, pos.z-first));
+    source_indices.push_back(s);
+    source_hard.push_back(sp->getSource(s).getSourceType() == SRC_HARD);
+  }
+
+  // Receivers are read from the rank which updates the node
+  RankReceivers<T> local;
+  for(unsigned int r = 0; r < num_receivers; r++) {
+    nv::Vec3i pos = sp->getReceiverElementCoordinates(r);
+    int partition, elem;
+    mesh->getElementIdxAndPartition(pos.x, pos.y, pos.z, &partition, &elem);
+    if(partition == -1 && rank == 0)
+      log_msg<LOG_WARNING>(L"launchFDTD3dDistributed - receiver %u outside of the domain") %r;
+    if(partition != (int)rank)
+      continue;
+    local.elements.push_back((unsigned int)elem);
+    local.receivers.push_back(r);
+  }
+  local.samples.assign(local.receivers.size()*num_steps, (T)0);
+
+  std::vector<T> send_buffer(2*(size_t)k*slice);
+  std::vector<T> recv_buffer(2*(size_t)k*slice);
+  boost::posix_time::ptime step_start;
+  unsigned int step = 0;
+
+  for(; step < num_steps; step++) {
+    step_start = boost::posix_time::microsec_clock::local_time();
+    T* P = mesh->getPressurePtrAt(rank);
+
+    for(unsigned int i = 0; i < source_elements.size(); i++) {
+      T sample = source_samples[source_indices[i]*num_steps+step];
+      if(source_hard[i])
+        P[source_elements[i]] = sample;
+      else
+        P[source_elements[i]] += sample;
+    }
+
+    // The valid region of the ghost slices shrinks by one slice each step
+    unsigned int m = step%k;
+    unsigned int begin = has_down ? 1+m : 1;
+    unsigned int end = has_up ? size-1-m : size-1;
+    if(begin < end)
+      fdtd3dHostSlices<T>(mesh->getPositionIdxPtrAt(rank), mesh->getMaterialIdxPtrAt(rank),
+                          P, mesh->getPastPressurePtrAt(rank),
+                          mesh->getParameterPtr(), mesh->getMaterialPtr(),
+                          slice, mesh->getDimX(), mesh->getDimY(),
+                          begin, end, mesh->getUpdateType());
+
+    mesh->flipPressurePointers(rank);
+    P = mesh->getPressurePtrAt(rank);
+    T* P_past = mesh->getPastPressurePtrAt(rank);
+
+    for(unsigned int i = 0; i < local.receivers.size(); i++)
+      local.samples[i*num_steps+step] = P[local.elements[i]];
+
+    if(rank == 0 && (step%PROGRESS_MOD) == 0) {
+      boost::posix_time::time_duration d =
+        boost::posix_time::microsec_clock::local_time()-step_start;
+      progressCallback(step, num_steps, (float)d.total_microseconds()/1e6f);
+    }
+
+    if((step+1)%k != 0 || step+1 == num_steps)
+      continue;
+
+    // Rank 0 decides on the interruption, the flag travels up the chain
+    // ahead of the halos so all ranks stop on the same step
+    unsigned char stop = (rank == 0 && interruptCallback()) ? 1 : 0;
+    unsigned char peer_stop = 0;
+    if(has_down) {
+      transport->exchange(rank-1, &stop, &peer_stop, 1);
+      stop |= peer_stop;
+    }
+    if(has_up) {
+      transport->exchange(rank+1, &stop, &peer_stop, 1);
+      stop |= peer_stop;
+    }
+    if(stop) {
+      if(rank == 0)
+        log_msg<LOG_INFO>(L"launchFDTD3dDistributed - interrupted at step %u") %step;
+      break;
+    }
+
+    if(has_down)
+      exchangeHalo(transport, rank-1, P, P_past, k, 0, k, slice, send_buffer, recv_buffer);
+    if(has_up)
+      exchangeHalo(transport, rank+1, P, P_past, size-2*k, size-k, k, slice,
+                   send_buffer, recv_buffer);
+  }
+
+  // Gather the receivers to rank 0
+  if(rank == 0) {
+    for(unsigned int i = 0; i < local.receivers.size(); i++)
+      memcpy(h_return_ptr+(size_t)local.receivers[i]*num_steps,
+             &local.samples[(size_t)i*num_steps], num_steps*sizeof(T));
+
+    for(unsigned int r = 1; r < num_ranks; r++) {
+      unsigned int count = 0;
+      transport->receive(r, &count, sizeof(unsigned int));
+      if(count == 0)
+        continue;
+      std::vector<unsigned int> receivers(count);
+      std::vector<T> samples((size_t)count*num_steps);
+      transport->receive(r, &receivers[0], count*sizeof(unsigned int));
+      transport->receive(r, &samples[0], samples.size()*sizeof(T));
+      for(unsigned int i = 0; i < count; i++)
+        memcpy(h_return_ptr+(size_t)receivers[i]*num_steps,
+               &samples[(size_t)i*num_steps], num_steps*sizeof(T));
+    }
+  }
+  else {
+    unsigned int count = (unsigned int)local.receivers.size();
+    transport->send(0, &count, sizeof(unsigned int));
+    if(count > 0) {
+      transport->send(0, &local.receivers[0], count*sizeof(unsigned int));
+      transport->send(0, &local.samples[0], local.samples.size()*sizeof(T));
+    }
+  }
+
+  boost::posix_time::time_duration d = boost::posix_time::microsec_clock::local_time()-start;
+  float seconds = (float)d.total_microseconds()/1e6f;
+  float per_step = step > 0 ? seconds/(float)step : 0.f;
+  log_msg<LOG_INFO>(L"launchFDTD3dDistributed - rank %u time: %f seconds, per step: %f")
+                    %rank %seconds %per_step;
+  return per_step;
+}
+
+} // namespace
+
+float launchFDTD3dDistributed(HostMesh<float>* mesh,
+                              SimulationParameters* sp,
+                              float* h_return_ptr,
+                              HaloTransport* transport,
+                              bool (*interruptCallback)(void),
+                              void (*progressCallback)(int, int, float)) {
+  unsigned int num_steps = sp->getNumSteps();
+  std::vector<float> samples(sp->getNumSources()*num_steps, 0.f);
+  for(unsigned int s = 0; s < sp->getNumSources(); s++)
+    for(unsigned int i = 0; i < num_steps; i++)
+      samples.at(s*num_steps+i) = sp->getSourceSample(s, i);
+
+  return launchDistributed<float>(mesh, sp, h_return_ptr, samples, transport,
+                                  interruptCallback, progressCallback);
+}
+
+float launchFDTD3dDistributedDouble(HostMesh<double>* mesh,
+                                    SimulationParameters* sp,
+                                    double* h_return_ptr,
+                                    HaloTransport* transport,
+                                    bool (*interruptCallback)(void),
+                                    void (*progressCallback)(int, int, float)) {
+  unsigned int num_steps = sp->getNumSteps();
+  std::vector<double> samples(sp->getNumSources()*num_steps, 0.0);
+  for(unsigned int s = 0; s < sp->getNumSources(); s++)
+    for(unsigned int i = 0; i < num_steps; i++)
+      samples.at(s*num_steps+i) = sp->getSourceSampleDouble(s, i);
+
+  return launchDistributed<double>(mesh, sp, h_return_ptr, samples, transport,
+                                   interruptCallback, progressCallback);
+}
@@ -0,0 +1,64 @@
+#ifndef DIST_KERNELS_3D_H
+#define DIST_KERNELS_3D_H
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// This file is a part of the PadallelFDTD Finite-Difference Time-Domain
+// simulation library. It is released under the MIT License. You should have
+// received a copy of the MIT License along with ParallelFDTD.  If not, see
+// http://www.opensource.org/licenses/mit-license.php
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// For details, see the LICENSE file
+//
+// (C) 2013-2014 Jukka Saarelma
+// Aalto University School of Science
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "HaloTransport.h"
+#include "../host/hostMesh.h"
+#include "../base/SimulationParameters.h"
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief Step the partition of this rank of a distributed run on the CPU
+/// in single precision. The mesh holds the partition given by the rank of
+/// the transport, see HostMesh::makePartition() with local_partition. The
+/// halos are exchanged with the neighbouring ranks every halo depth steps,
+/// the receivers of all ranks are gathered to rank 0 at the end.
+/// \param[in] mesh HostMesh with the local partition of the rank
+/// \param[in] sp The simulation parameters of the simulation
+/// \param[in, out] h_return_ptr Return values of the simulation,
+/// num_receivers*num_steps. Only used on rank 0, can be NULL on the others
+/// \param transport Connection to the other ranks
+/// \param interruptCallback Called on rank 0 on each halo exchange, the
+/// interruption reaches the other ranks with the halos
+/// \param progressCallback Called on rank 0 every PROGRESS_MOD steps
+/// \return The average time per step in seconds
+///////////////////////////////////////////////////////////////////////////////
+float launchFDTD3dDistributed(HostMesh<float>* mesh,
+                              SimulationParameters* sp,
+                              float* h_return_ptr,
+                              HaloTransport* transport,
+                              bool (*interruptCallback)(void),
+                              void (*progressCallback)(int, int, float));
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief Step the partition of this rank in double precision, see
+/// launchFDTD3dDistributed()
+///////////////////////////////////////////////////////////////////////////////
+float launchFDTD3dDistributedDouble(HostMesh<double>* mesh,
+                                    SimulationParameters* sp,
+                                    double* h_return_ptr,
+                                    HaloTransport* transport,
+                                    bool (*interruptCallback)(void),
+                                    void (*progressCallback)(int, int, float));
+
+#endif
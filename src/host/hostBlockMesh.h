@@ -0,0 +1,361 @@
+#ifndef HOST_BLOCK_MESH_H
+#define HOST_BLOCK_MESH_H
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// This file is a part of the PadallelFDTD Finite-Difference Time-Domain
+// simulation library. It is released under the MIT License. You should have
+// received a copy of the MIT License along with ParallelFDTD.  If not, see
+// http://www.opensource.org/licenses/mit-license.php
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// For details, see the LICENSE file
+//
+// (C) 2013-2014 Jukka Saarelma
+// Aalto University School of Science
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "../logger.h"
+#include "../global_includes.h"
+#include <vector>
+#include <algorithm>
+#include <string.h>
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief A block of a HostBlockMesh. The block owns the nodes
+/// begin..end-1 of each axis and stores them with one ghost layer on
+/// every side, the local dimensions are end-begin+2.
+///////////////////////////////////////////////////////////////////////////////
+struct HostBlock {
+  unsigned int begin[3];    ///< First owned node in x, y, z
+  unsigned int end[3];      ///< One past the last owned node
+  unsigned int dim[3];      ///< Local dimensions with the ghost layers
+  int neighbour[6];         ///< Block at -x, +x, -y, +y, -z, +z, -1 at the domain border
+};
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief Simulation domain in host memory split into a grid of blocks
+/// along x, y and z. Slabs along z (HostMesh) grow thin on wide and low
+/// domains, and their halos then outweigh the updated volume. Pencils and
+/// blocks keep the halos smaller for the same number of workers.
+///
+/// The outermost nodes of the domain are never updated, the blocks split
+/// the nodes 1..dim-2 of each axis and the ghost layers at the domain
+/// border hold the outermost nodes.
+///
+/// \tparam T The precision of the pressure values, float / double
+///////////////////////////////////////////////////////////////////////////////
+template <typename T>
+class HostBlockMesh {
+public:
+  HostBlockMesh()
+  : update_type_(0)
+  {
+    this->dim_[0] = this->dim_[1] = this->dim_[2] = 0;
+    this->shape_[0] = this->shape_[1] = this->shape_[2] = 0;
+  };
+
+  ~HostBlockMesh() {};
+
+  /////////////////////////////////////////////////////////////////////////////
+  /// \brief Copy the voxelized domain to the mesh, see HostMesh::setupMesh()
+  /////////////////////////////////////////////////////////////////////////////
+  void setupMesh(const unsigned char* position_idx,
+                 const unsigned char* material_idx,
+                 unsigned int dim_x, unsigned int dim_y, unsigned int dim_z,
+                 const T* material_coefs,
+                 unsigned int number_of_unique_materials,
+                 const T* params,
+                 unsigned int update_type) {
+    this->dim_[0] = dim_x;
+    this->dim_[1] = dim_y;
+    this->dim_[2] = dim_z;
+    this->update_type_ = update_type;
+
+    size_t num_elements = (size_t)dim_x*dim_y*dim_z;
+    this->position_idx_.assign(position_idx, position_idx+num_elements);
+    this->material_idx_.assign(material_idx, material_idx+num_elements);
+    this->materials_.assign(material_coefs,
+                            material_coefs+number_of_unique_materials*MATERIAL_COEF_NUM);
+    this->parameters_.assign(params, params+4);
+
+    log_msg<LOG_INFO>(L"HostBlockMesh::setupMesh - dim %u %u %u, %u materials, update type %u")
+                      %dim_x %dim_y %dim_z %number_of_unique_materials %update_type;
+  }
+
+  /////////////////////////////////////////////////////////////////////////////
+  /// \brief Choose the grid of blocks with the least halo traffic
+  /// \param dim_x, dim_y, dim_z The dimensions of the domain
+  /// \param number_of_blocks The number of blocks, px*py*pz
+  /// \param[out] shape The number of blocks along x, y and z
+  /// \param[out] halo_nodes If not NULL, the number of halo nodes exchanged
+  /// on each step with the chosen shape
+  /// \return false if the domain can not be split to the given number of blocks
+  /////////////////////////////////////////////////////////////////////////////
+  static bool chooseShape(unsigned int dim_x, unsigned int dim_y, unsigned int dim_z,
+                          unsigned int number_of_blocks, unsigned int* shape,
+                          size_t* halo_nodes = NULL) {
+    size_t n[3] = {dim_x > 2 ? dim_x-2 : 0, dim_y > 2 ? dim_y-2 : 0, dim_z > 2 ? dim_z-2 : 0};
+    size_t best = 0;
+    shape[0] = shape[1] = shape[2] = 0;
+
+    // Larger pz first, on a tie the contiguous z faces are cheaper to pack
+    for(unsigned int pz = number_of_blocks; pz >= 1; pz--) {
+      if(number_of_blocks%pz != 0 || pz > n[2])
+        continue;
+      unsigned int rest = number_of_blocks/pz;
+      for(unsigned int py = rest; py >= 1; py--) {
+        if(rest%py != 0 || py > n[1])
+          continue;
+        unsigned int px = rest/py;
+        if(px > n[0])
+          continue;
+        // Both directions of every internal face
+        size_t halo = 2*((px-1)*n[1]*n[2]+(py-1)*n[0]*n[2]+(pz-1)*n[0]*n[1]);
+        if(shape[0] == 0 || halo < best) {
+          best = halo;
+          shape[0] = px;
+          shape[1] = py;
+          shape[2] = pz;
+        }
+      }
+    }
+    if(halo_nodes)
+      *halo_nodes = best;
+    return shape[0] != 0;
+  }
+
+  /////////////////////////////////////////////////////////////////////////////
+  /// \brief Split the domain to the given number of blocks, with the shape
+  /// given by chooseShape()
+  /////////////////////////////////////////////////////////////////////////////
+  void makeBlocks(unsigned int number_of_blocks) {
+    unsigned int shape[3];
+    if(!chooseShape(this->dim_[0], this->dim_[1], this->dim_[2], number_of_blocks, shape)) {
+      log_msg<LOG_ERROR>(L"HostBlockMesh::makeBlocks - can not split dim %u %u %u to %u blocks")
+                         %this->dim_[0] %this->dim_[1] %this->dim_[2] %number_of_blocks;
+      throw(-1);
+    }
+    this->makeBlocks(shape[0], shape[1], shape[2]);
+  }
+
+  /////////////////////////////////////////////////////////////////////////////
+  /// \brief Split the domain to a grid of px*py*pz blocks of equal size.
+  /// The blocks are indexed x first, then y and z
+  /////////////////////////////////////////////////////////////////////////////
+  void makeBlocks(unsigned int px, unsigned int py, unsigned int pz) {
+    unsigned int shape[3] = {px, py, pz};
+    for(unsigned int a = 0; a < 3; a++) {
+      if(shape[a] == 0 || this->dim_[a] < 3 || shape[a] > this->dim_[a]-2) {
+        log_msg<LOG_ERROR>(L"HostBlockMesh::makeBlocks - %u blocks along axis %u of %u nodes")
+                           %shape[a] %a %this->dim_[a];
+        throw(-1);
+      }
+      this->shape_[a] = shape[a];
+    }
+
+    unsigned int number_of_blocks = px*py*pz;
+    this->blocks_.assign(number_of_blocks, HostBlock());
+    this->position_parts_.assign(number_of_blocks, std::vector<unsigned char>());
+    this->material_parts_.assign(number_of_blocks, std::vector<unsigned char>());
+    this->pressures_.assign(number_of_blocks, std::vector<T>());
+    this->pressures_past_.assign(number_of_blocks, std::vector<T>());
+
+    for(unsigned int i = 0; i < number_of_blocks; i++) {
+      HostBlock& block = this->blocks_.at(i);
+      unsigned int coord[3] = {i%px, (i/px)%py, i/(px*py)};
+      for(unsigned int a = 0; a < 3; a++) {
+        unsigned int n = this->dim_[a]-2;
+        block.begin[a] = 1+(n*coord[a])/shape[a];
+        block.end[a] = 1+(n*(coord[a]+1))/shape[a];
+        block.dim[a] = block.end[a]-block.begin[a]+2;
+        unsigned int stride = a == 0 ? 1 : (a == 1 ? px : px*py);
+        block.neighbour[2*a] = coord[a] > 0 ? (int)(i-stride) : -1;
+        block.neighbour[2*a+1] = coord[a]+1 < shape[a] ? (int)(i+stride) : -1;
+      }
+
+      // Copy the block with its ghost layers row by row
+      size_t size = (size_t)block.dim[0]*block.dim[1]*block.dim[2];
+      std::vector<unsigned char>& pos = this->position_parts_.at(i);
+      std::vector<unsigned char>& mat = this->material_parts_.at(i);
+      pos.resize(size);
+      mat.resize(size);
+      for(unsigned int z = 0; z < block.dim[2]; z++) {
+        for(unsigned int y = 0; y < block.dim[1]; y++) {
+          size_t src = this->getGlobalIndex(block.begin[0]-1, block.begin[1]-1+y,
+                                            block.begin[2]-1+z);
+          size_t dst = ((size_t)z*block.dim[1]+y)*block.dim[0];
+          memcpy(&pos[dst], &this->position_idx_[src], block.dim[0]);
+          memcpy(&mat[dst], &this->material_idx_[src], block.dim[0]);
+        }
+      }
+      this->pressures_.at(i).assign(size, (T)0);
+      this->pressures_past_.at(i).assign(size, (T)0);
+
+      log_msg<LOG_DEBUG>(L"HostBlockMesh::makeBlocks - block %u, x %u - %u, y %u - %u, z %u - %u")
+                         %i %block.begin[0] %block.end[0] %block.begin[1] %block.end[1]
+                         %block.begin[2] %block.end[2];
+    }
+
+    log_msg<LOG_INFO>(L"HostBlockMesh::makeBlocks - %u x %u x %u blocks") %px %py %pz;
+  }
+
+  /////////////////////////////////////////////////////////////////////////////
+  /// \brief The number of nodes of a face of the block normal to an axis,
+  /// ghost layers included
+  /////////////////////////////////////////////////////////////////////////////
+  static size_t getFaceSize(const HostBlock& block, unsigned int axis) {
+    return (size_t)block.dim[(axis+1)%3]*block.dim[(axis+2)%3];
+  }
+
+  /////////////////////////////////////////////////////////////////////////////
+  /// \brief Copy the plane of the block at a local index along an axis to a
+  /// contiguous buffer. The z faces are contiguous, the y faces are strided
+  /// by rows and the x faces by single nodes
+  /// \param data The block data, local dimensions
+  /// \param block The block
+  /// \param axis 0, 1, 2 for x, y, z
+  /// \param index The local index of the plane along the axis
+  /// \param[out] buffer getFaceSize() values
+  /////////////////////////////////////////////////////////////////////////////
+  static void packFace(const T* data, const HostBlock& block, unsigned int axis,
+                       unsigned int index, T* buffer) {
+    copyFace(const_cast<T*>(data), block, axis, index, buffer, true);
+  }
+
+  /// \brief Copy a buffer written by packFace() to a plane of the block
+  static void unpackFace(T* data, const HostBlock& block, unsigned int axis,
+                         unsigned int index, const T* buffer) {
+    copyFace(data, block, axis, index, const_cast<T*>(buffer), false);
+  }
+
+  void resetPressures() {
+    for(unsigned int i = 0; i < this->getNumberOfBlocks(); i++) {
+      std::fill(this->pressures_.at(i).begin(), this->pressures_.at(i).end(), (T)0);
+      std::fill(this->pressures_past_.at(i).begin(), this->pressures_past_.at(i).end(), (T)0);
+    }
+  }
+
+  /// \brief Swap the current and past pressures of a single block
+  void flipPressurePointers(unsigned int block) {
+    this->pressures_.at(block).swap(this->pressures_past_.at(block));
+  }
+
+  T* getPressurePtrAt(unsigned int block) {return &(this->pressures_.at(block)[0]);}
+  T* getPastPressurePtrAt(unsigned int block) {return &(this->pressures_past_.at(block)[0]);}
+  unsigned char* getPositionIdxPtrAt(unsigned int block) {return &(this->position_parts_.at(block)[0]);}
+  unsigned char* getMaterialIdxPtrAt(unsigned int block) {return &(this->material_parts_.at(block)[0]);}
+  const T* getMaterialPtr() const {return &(this->materials_[0]);}
+  const T* getParameterPtr() const {return &(this->parameters_[0]);}
+
+  unsigned int getNumberOfBlocks() const {return (unsigned int)this->blocks_.size();}
+  const HostBlock& getBlock(unsigned int block) const {return this->blocks_.at(block);}
+  unsigned int getShape(unsigned int axis) const {return this->shape_[axis];}
+
+  unsigned int getDimX() const {return this->dim_[0];}
+  unsigned int getDimY() const {return this->dim_[1];}
+  unsigned int getDimZ() const {return this->dim_[2];}
+  unsigned int getUpdateType() const {return this->update_type_;}
+
+  /////////////////////////////////////////////////////////////////////////////
+  /// \brief Check if the block holds the node, ghost layers included
+  /// \return The element index in the block, -1 if not held
+  /////////////////////////////////////////////////////////////////////////////
+  int getLocalIndex(unsigned int block, unsigned int x, unsigned int y, unsigned int z) const {
+    const HostBlock& b = this->blocks_.at(block);
+    unsigned int p[3] = {x, y, z};
+    for(unsigned int a = 0; a < 3; a++)
+      if(p[a]+1 < b.begin[a] || p[a] > b.end[a])
+        return -1;
+    return (int)((((size_t)(z+1-b.begin[2])*b.dim[1])+(y+1-b.begin[1]))*b.dim[0]+(x+1-b.begin[0]));
+  }
+
+  /////////////////////////////////////////////////////////////////////////////
+  /// \brief Find the block which updates the given node
+  /// \param x, y, z The element coordinates in the domain
+  /// \param[out] block The block index, -1 if not found
+  /// \param[out] elem The element index inside the block, -1 if not found
+  /////////////////////////////////////////////////////////////////////////////
+  void getElementIdxAndBlock(unsigned int x, unsigned int y, unsigned int z,
+                             int* block, int* elem) const {
+    *block = -1;
+    *elem = -1;
+    for(unsigned int i = 0; i < this->getNumberOfBlocks(); i++) {
+      const HostBlock& b = this->blocks_.at(i);
+      if(x < b.begin[0] || x >= b.end[0] || y < b.begin[1] || y >= b.end[1] ||
+         z < b.begin[2] || z >= b.end[2])
+        continue;
+      *block = (int)i;
+      *elem = this->getLocalIndex(i, x, y, z);
+      return;
+    }
+  }
+
+  /// \return The current pressure at the given node
+  T getSample(unsigned int x, unsigned int y, unsigned int z) const {
+    int block, elem;
+    this->getElementIdxAndBlock(x, y, z, &block, &elem);
+    if(block == -1)
+      return (T)0;
+    return this->pressures_.at(block).at(elem);
+  }
+
+private:
+  size_t getGlobalIndex(unsigned int x, unsigned int y, unsigned int z) const {
+    return ((size_t)z*this->dim_[1]+y)*this->dim_[0]+x;
+  }
+
+  static void copyFace(T* data, const HostBlock& block, unsigned int axis,
+                       unsigned int index, T* buffer, bool to_buffer) {
+    size_t dim_x = block.dim[0];
+    size_t dim_xy = dim_x*block.dim[1];
+    if(axis == 2) {
+      size_t size = dim_xy*sizeof(T);
+      if(to_buffer) memcpy(buffer, data+index*dim_xy, size);
+      else memcpy(data+index*dim_xy, buffer, size);
+      return;
+    }
+    if(axis == 1) {
+      for(unsigned int z = 0; z < block.dim[2]; z++) {
+        T* row = data+z*dim_xy+index*dim_x;
+        if(to_buffer) memcpy(buffer+z*dim_x, row, dim_x*sizeof(T));
+        else memcpy(row, buffer+z*dim_x, dim_x*sizeof(T));
+      }
+      return;
+    }
+    // The buffer of an x face is ordered y first, then z
+    size_t i = 0;
+    for(unsigned int z = 0; z < block.dim[2]; z++) {
+      for(unsigned int y = 0; y < block.dim[1]; y++, i++) {
+        T* node = data+z*dim_xy+y*dim_x+index;
+        if(to_buffer) buffer[i] = *node;
+        else *node = buffer[i];
+      }
+    }
+  }
+
+  unsigned int dim_[3];
+  unsigned int shape_[3];                     ///< Blocks along x, y, z
+  unsigned int update_type_;
+
+  std::vector<unsigned char> position_idx_;   ///< Position indices of the whole domain
+  std::vector<unsigned char> material_idx_;   ///< Material indices of the whole domain
+  std::vector<T> materials_;                  ///< Material coefficients
+  std::vector<T> parameters_;                 ///< Simulation parameters
+
+  std::vector<HostBlock> blocks_;
+  std::vector< std::vector<unsigned char> > position_parts_;
+  std::vector< std::vector<unsigned char> > material_parts_;
+  std::vector< std::vector<T> > pressures_;
+  std::vector< std::vector<T> > pressures_past_;
+};
+
+#endif
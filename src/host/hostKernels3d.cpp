@@ -0,0 +1,1231 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// This file is a part of the PadallelFDTD Finite-Difference Time-Domain
+// simulation library. It is released under the MIT License. You should have
+// received a copy of the MIT License along with ParallelFDTD.  If not, see
+// http://www.opensource.org/licenses/mit-license.php
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// For details, see the LICENSE file
+//
+// (C) 2013-2014 Jukka Saarelma
+// Aalto University School of Science
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "hostKernels3d.h"
+#include "hostNuma.h"
+#include "../kernels/kernels3d.h"
+#include "../kernels/cudaUtils.h"
+#include "../base/SourceBank.h"
+#include "../base/ReceiverBank.h"
+
+#include <boost/thread.hpp>
+#include <boost/atomic.hpp>
+#include <boost/bind.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <string.h>
+#include <algorithm>
+
+template <typename T>
+void fdtd3dHostSlices(const unsigned char* positions,
+                      const unsigned char* materials,
+                      const T* P, T* P_past,
+                      const T* params,
+                      const T* material_coefs,
+                      unsigned int dim_xy, unsigned int dim_x, unsigned int dim_y,
+                      unsigned int slice_begin, unsigned int slice_end,
+                      unsigned int update_type) {
+  const T lambda = params[0];
+  const T lambda_2 = params[1];
+  const unsigned int octave = (unsigned int)params[3];
+
+  for(unsigned int z = slice_begin; z < slice_end; z++) {
+    for(unsigned int y = 1; y < dim_y-1; y++) {
+      unsigned int row = z*dim_xy+y*dim_x;
+      for(unsigned int x = 1; x < dim_x-1; x++) {
+        unsigned int current = row+x;
+        unsigned char pos = positions[current];
+
+        if((pos>>INSIDE_SWITCH) == 0) {
+          P_past[current] = (T)0;
+          continue;
+        }
+
+        T coef = material_coefs[materials[current]*MATERIAL_COEF_NUM+octave];
+        T p = P[current];
+        T _p = P_past[current];
+
+        if(update_type != SRL) {
+          T position = (T)(pos&FORWARD_POSITION_MASK);
+          T beta = (T)0.5*coef*((T)6-position)*lambda;
+          T S = P[current+dim_xy]+P[current-dim_xy]+
+                P[current+dim_x]+P[current-dim_x]+
+                P[current+1]+P[current-1];
+          P_past[current] = ((T)1/((T)1+beta))*
+                            (((T)2-position*lambda_2)*p+lambda_2*S-((T)1-beta)*_p);
+        }
+        else {
+          T dir_x = (T)(pos&DIR_X);
+          T dir_y = (T)((pos&DIR_Y)>>1);
+          T dir_z = (T)((pos&DIR_Z)>>2);
+          T beta = coef*lambda*(dir_x+dir_y+dir_z);
+
+          T p_z[2], p_y[2], p_x[2];
+          p_z[1] = P[current-dim_xy]; // SIGN_Z is down
+          p_z[0] = P[current+dim_xy];
+          p_y[0] = P[current-dim_x];
+          p_y[1] = P[current+dim_x];
+          p_x[0] = P[current-1];
+          p_x[1] = P[current+1];
+
+          T S_boundary = p_x[(pos&SIGN_X)>>4]*dir_x+
+                         p_y[(pos&SIGN_Y)>>5]*dir_y+
+                         p_z[(pos&SIGN_Z)>>6]*dir_z;
+          T S = (p_x[0]+p_x[1]+p_y[0]+p_y[1]+p_z[0]+p_z[1]+S_boundary)*lambda_2;
+          P_past[current] = (S+((T)2-(T)6*lambda_2)*p+(beta-(T)1)*_p)*((T)1/((T)1+beta));
+        }
+      }
+    }
+  }
+}
+
+template void fdtd3dHostSlices<float>(const unsigned char*, const unsigned char*,
+                                      const float*, float*, const float*, const float*,
+                                      unsigned int, unsigned int, unsigned int,
+                                      unsigned int, unsigned int, unsigned int);
+
+template void fdtd3dHostSlices<double>(const unsigned char*, const unsigned char*,
+                                       const double*, double*, const double*, const double*,
+                                       unsigned int, unsigned int, unsigned int,
+                                       unsigned int, unsigned int, unsigned int);
+
+namespace {
+
+///////////////////////////////////////////////////////////////////////////////
+// Single producer, single consumer handoff of the halo of one partition
+// border. The halo holds halo_depth slices of the exchanged time level n
+// followed by the same slices of level n-1. The producer writes level n to
+// buffer (n/halo_depth)%2 and publishes n, the consumer copies it out and
+// acknowledges n. A buffer is reused only after the level written to it
+// two exchanges earlier has been acknowledged.
+///////////////////////////////////////////////////////////////////////////////
+template <typename T>
+struct HaloMailbox {
+  HaloMailbox(unsigned int halo_size)
+  : published(0),
+    consumed(0)
+  {
+    buffer[0].assign(2*halo_size, (T)0);
+    buffer[1].assign(2*halo_size, (T)0);
+  }
+
+  std::vector<T> buffer[2];
+  boost::atomic<unsigned int> published; ///< Last time level written
+  boost::atomic<unsigned int> consumed;  ///< Last time level read
+};
+
+// Spin until the counter reaches value, returns false if stopped
+inline bool waitFor(boost::atomic<unsigned int>& counter, unsigned int value,
+                    boost::atomic<bool>& stop) {
+  unsigned int spins = 0;
+  while(counter.load(boost::memory_order_acquire) < value) {
+    if(stop.load(boost::memory_order_relaxed))
+      return false;
+    if(++spins > 64)
+      boost::this_thread::yield();
+  }
+  return true;
+}
+
+struct SourceEntry {
+  unsigned int element;    ///< Element index in the partition
+  unsigned int source;     ///< Source index
+  bool hard;               ///< Hard sources overwrite the pressure
+};
+
+struct ReceiverEntry {
+  unsigned int element;    ///< Element index in the partition
+  unsigned int receiver;   ///< Receiver index
+};
+
+// A partition stepped by a device target, the layout is the same as in
+// the HostMesh
+template <typename T>
+struct DevicePartition {
+  int device;
+  unsigned int block_x, block_y;
+  unsigned char* positions;
+  unsigned char* materials;
+  T* P;
+  T* P_past;
+  T* params;
+  T* material_coefs;
+  unsigned int* receiver_idx;  ///< The sorted receivers of the ReceiverBank
+  unsigned int* receiver_minus; ///< The negative neighbours of the velocity channels
+  T* receiver_ring;            ///< The ring buffer of the receivers
+  unsigned int* source_idx;    ///< The entries of the SourceBank, then the segments
+  unsigned char* source_hard;  ///< The hard flags of source_idx, 0 for the segments
+  unsigned int* moving_idx;    ///< The corners of the moving sources of a chunk
+  T* source_samples;           ///< The samples of a chunk, for each step source_idx then the corners
+  T* halo;                     ///< Both time levels of a halo, one copy over the bus
+};
+
+template <typename T>
+struct PartitionContext {
+  HostMesh<T>* mesh;
+  DevicePartition<T>* device;  ///< NULL on a host target
+  unsigned int partition;
+  unsigned int num_steps;
+  unsigned int group_size;
+  unsigned int halo_depth;
+
+  HaloMailbox<T>* send_down;   ///< To partition-1, NULL at the bottom
+  HaloMailbox<T>* recv_down;   ///< From partition-1
+  HaloMailbox<T>* send_up;     ///< To partition+1, NULL at the top
+  HaloMailbox<T>* recv_up;     ///< From partition+1
+
+  boost::barrier* group_barrier;
+  boost::atomic<bool>* stop;
+  bool group_stop;             ///< Written by the group leader only
+
+  const std::vector<unsigned int>* cpus;  ///< CPUs the group is pinned to, NULL if not pinned
+  double updated_nodes;        ///< Nodes updated so far, written by the group leader
+
+  // Local slices updated on the current step
+  unsigned int bottom_begin, bottom_end;  ///< Bottom border
+  unsigned int top_begin, top_end;        ///< Top border
+  unsigned int interior_begin, interior_end;
+
+  SourceBank<T>* sources;
+  boost::mutex* source_lock;   ///< Held while a chunk of the sources is filled
+  std::vector<T> chunk_samples; ///< Staging of the source samples of a device target
+  ReceiverBank<T>* receivers;
+  T* h_return_ptr;
+
+  // Moving receivers, each partition sums the corners of the cells it owns
+  const std::vector<unsigned int>* moving_receivers;
+  const std::vector<Trajectory>* trajectories;  ///< Of each moving receiver
+  std::vector<T> moving_partials;               ///< num_moving*num_steps
+
+  bool (*interruptCallback)(void);
+  void (*progressCallback)(int, int, float);
+};
+
+// The pressures of the partition, in device memory on a device target
+template <typename T>
+T* getPressure(PartitionContext<T>* ctx) {
+  return ctx->device ? ctx->device->P : ctx->mesh->getPressurePtrAt(ctx->partition);
+}
+
+template <typename T>
+T* getPastPressure(PartitionContext<T>* ctx) {
+  return ctx->device ? ctx->device->P_past : ctx->mesh->getPastPressurePtrAt(ctx->partition);
+}
+
+// Copy halo_depth slices of both time levels between a mailbox and the
+// partition. The mailboxes are in host memory, the halos of a device
+// target are staged next to each other and cross the bus in one copy
+template <typename T>
+void copyHalo(PartitionContext<T>* ctx, std::vector<T>& buffer, T* P, T* P_past,
+              unsigned int first_slice, bool to_buffer) {
+  unsigned int slice = ctx->mesh->getDimXY();
+  size_t size = (size_t)ctx->halo_depth*slice;
+  size_t offset = (size_t)first_slice*slice;
+  if(ctx->device) {
+    int device = ctx->device->device;
+    T* halo = ctx->device->halo;
+    if(to_buffer) {
+      copyDeviceToDevice((unsigned int)size, halo, P+offset, device);
+      copyDeviceToDevice((unsigned int)size, halo+size, P_past+offset, device);
+      copyDeviceToHost((unsigned int)(2*size), &buffer[0], halo, device);
+    }
+    else {
+      copyHostToDevice((unsigned int)(2*size), halo, &buffer[0], device);
+      copyDeviceToDevice((unsigned int)size, P+offset, halo, device);
+      copyDeviceToDevice((unsigned int)size, P_past+offset, halo+size, device);
+    }
+    return;
+  }
+  if(to_buffer) {
+    memcpy(&buffer[0], P+offset, size*sizeof(T));
+    memcpy(&buffer[size], P_past+offset, size*sizeof(T));
+  }
+  else {
+    memcpy(P+offset, &buffer[0], size*sizeof(T));
+    memcpy(P_past+offset, &buffer[size], size*sizeof(T));
+  }
+}
+
+// Set the slices updated on a step. The valid region of the ghost slices
+// shrinks by one slice each step after an exchange
+template <typename T>
+void setUpdateRange(PartitionContext<T>* ctx, unsigned int step) {
+  unsigned int size = ctx->mesh->getPartitionSize(ctx->partition);
+  unsigned int k = ctx->halo_depth;
+  unsigned int m = step%k;
+
+  unsigned int begin = ctx->recv_down ? 1+m : 1;
+  unsigned int end = ctx->recv_up ? size-1-m : size-1;
+
+  ctx->bottom_begin = begin;
+  ctx->bottom_end = ctx->recv_down ? std::min(2*k, end) : begin;
+  ctx->top_end = end;
+  ctx->top_begin = ctx->recv_up ? std::max(size-2*k, ctx->bottom_end) : end;
+  ctx->interior_begin = ctx->bottom_end;
+  ctx->interior_end = std::max(ctx->top_begin, ctx->bottom_end);
+}
+
+// Gather the velocity channels of the B-format receivers from the level the
+// update reads
+template <typename T>
+void gatherGradientRing(PartitionContext<T>* ctx, const T* P, unsigned int step) {
+  ReceiverBank<T>* bank = ctx->receivers;
+  unsigned int num = bank->getNumberOfGradients(ctx->partition);
+  if(num == 0)
+    return;
+  if(ctx->device)
+    launchGatherGradients<T>(P, ctx->device->receiver_idx, ctx->device->receiver_minus,
+                             ctx->device->receiver_ring+(size_t)bank->getSlot(step)*
+                             bank->getNumberOfReceivers(ctx->partition), num);
+  else
+    bank->gatherGradients(P, ctx->partition, step);
+}
+
+// Fill the chunk of the sources holding a step. The partitions share the
+// sources of the parameters
+template <typename T>
+void fillSources(PartitionContext<T>* ctx, unsigned int step) {
+  boost::lock_guard<boost::mutex> lock(*ctx->source_lock);
+  ctx->sources->fill(ctx->partition, step);
+}
+
+// Inject the sources of a step to a device target. The samples of a chunk
+// cross the bus in one copy on its first step, the point sources, the array
+// sources and the moving sources are then launched in the order of
+// SourceBank::inject
+template <typename T>
+void injectDeviceSources(PartitionContext<T>* ctx, T* P, unsigned int step) {
+  SourceBank<T>& bank = *ctx->sources;
+  DevicePartition<T>* d = ctx->device;
+  unsigned int p = ctx->partition;
+  unsigned int num_entries = bank.getNumberOfEntries(p);
+  unsigned int num_segments = bank.getNumberOfSegments(p);
+  unsigned int num_corners = d->moving_idx ? bank.getNumberOfMovingSources()*8 : 0;
+  unsigned int stride = num_entries+num_segments+num_corners;
+  if(ctx->chunk_samples.empty())
+    return;
+
+  if(bank.isChunkBegin(step)) {
+    fillSources(ctx, step);
+    for(unsigned int i = 0; i < bank.getChunkSteps(); i++) {
+      T* samples = &ctx->chunk_samples[(size_t)i*stride];
+      if(num_entries > 0)
+        memcpy(samples, &bank.getSamples(p)[(size_t)i*num_entries], num_entries*sizeof(T));
+      for(unsigned int g = 0; g < num_segments; g++)
+        samples[num_entries+g] = bank.getSegmentValue(p, g, step+i);
+      if(num_corners > 0)
+        memcpy(samples+num_entries+num_segments, &bank.getMovingValues(p)[(size_t)i*num_corners],
+               num_corners*sizeof(T));
+    }
+    if(num_corners > 0)
+      copyHostToDevice((unsigned int)bank.getMovingElements(p).size(), d->moving_idx,
+                       (unsigned int*)&bank.getMovingElements(p)[0], d->device);
+    copyHostToDevice((unsigned int)ctx->chunk_samples.size(), d->source_samples,
+                     &ctx->chunk_samples[0], d->device);
+  }
+
+  unsigned int slot = bank.getSlot(step);
+  T* samples = d->source_samples+(size_t)slot*stride;
+  launchInjectSamples<T>(P, d->source_idx, d->source_hard, samples, num_entries);
+  launchInjectSamples<T>(P, d->source_idx+num_entries, d->source_hard+num_entries,
+                         samples+num_entries, num_segments);
+  if(num_corners > 0)
+    launchInjectMovingSamples<T>(P, d->moving_idx+(size_t)slot*num_corners,
+                                 samples+num_entries+num_segments, num_corners/8);
+}
+
+// Receive the ghost slices on an exchange step and inject the sources
+template <typename T>
+bool prepareStep(PartitionContext<T>* ctx, unsigned int step) {
+  unsigned int size = ctx->mesh->getPartitionSize(ctx->partition);
+  unsigned int k = ctx->halo_depth;
+  T* P = getPressure(ctx);
+  T* P_past = getPastPressure(ctx);
+
+  if(step > 0 && step%k == 0) {
+    unsigned int buffer = (step/k)%2;
+    if(ctx->recv_down) {
+      if(!waitFor(ctx->recv_down->published, step, *ctx->stop))
+        return false;
+      copyHalo(ctx, ctx->recv_down->buffer[buffer], P, P_past, 0, false);
+      ctx->recv_down->consumed.store(step, boost::memory_order_release);
+    }
+    if(ctx->recv_up) {
+      if(!waitFor(ctx->recv_up->published, step, *ctx->stop))
+        return false;
+      copyHalo(ctx, ctx->recv_up->buffer[buffer], P, P_past, size-k, false);
+      ctx->recv_up->consumed.store(step, boost::memory_order_release);
+    }
+  }
+  gatherGradientRing(ctx, (const T*)P, step);
+
+  if(ctx->device) {
+    injectDeviceSources(ctx, P, step);
+  }
+  else {
+    if(ctx->sources->isChunkBegin(step))
+      fillSources(ctx, step);
+    ctx->sources->inject(P, ctx->partition, step);
+  }
+
+  setUpdateRange(ctx, step);
+  return true;
+}
+
+template <typename T>
+void updateSlices(PartitionContext<T>* ctx, unsigned int begin, unsigned int end) {
+  if(begin >= end)
+    return;
+  HostMesh<T>* mesh = ctx->mesh;
+  unsigned int p = ctx->partition;
+  if(ctx->device) {
+    DevicePartition<T>* d = ctx->device;
+    cudasafe(cudaSetDevice(d->device), "hostKernels3d.cpp: updateSlices - set device");
+    launchFDTD3dSlices<T>(d->positions, d->materials, d->P, d->P_past,
+                          d->params, d->material_coefs,
+                          mesh->getDimXY(), mesh->getDimX(), mesh->getDimY(),
+                          begin, end, mesh->getUpdateType(), d->block_x, d->block_y);
+    cudasafe(cudaDeviceSynchronize(), "hostKernels3d.cpp: updateSlices - synchronize");
+    return;
+  }
+  fdtd3dHostSlices<T>(mesh->getPositionIdxPtrAt(p), mesh->getMaterialIdxPtrAt(p),
+                      mesh->getPressurePtrAt(p), mesh->getPastPressurePtrAt(p),
+                      mesh->getParameterPtr(), mesh->getMaterialPtr(),
+                      mesh->getDimXY(), mesh->getDimX(), mesh->getDimY(),
+                      begin, end, mesh->getUpdateType());
+}
+
+// Update the border slices, and on an exchange step hand the halos of the
+// new time level to the neighbours
+template <typename T>
+bool updateBorders(PartitionContext<T>* ctx, unsigned int step) {
+  updateSlices(ctx, ctx->bottom_begin, ctx->bottom_end);
+  updateSlices(ctx, ctx->top_begin, ctx->top_end);
+
+  unsigned int k = ctx->halo_depth;
+  unsigned int level = step+1;
+  if(level%k != 0)
+    return true;
+
+  unsigned int size = ctx->mesh->getPartitionSize(ctx->partition);
+  unsigned int buffer = (level/k)%2;
+  // The new level is in P_past until the pointers are flipped
+  T* P_new = getPastPressure(ctx);
+  T* P_old = getPressure(ctx);
+
+  if(ctx->send_down) {
+    if(level > 2*k && !waitFor(ctx->send_down->consumed, level-2*k, *ctx->stop))
+      return false;
+    copyHalo(ctx, ctx->send_down->buffer[buffer], P_new, P_old, k, true);
+    ctx->send_down->published.store(level, boost::memory_order_release);
+  }
+  if(ctx->send_up) {
+    if(level > 2*k && !waitFor(ctx->send_up->consumed, level-2*k, *ctx->stop))
+      return false;
+    copyHalo(ctx, ctx->send_up->buffer[buffer], P_new, P_old, size-2*k, true);
+    ctx->send_up->published.store(level, boost::memory_order_release);
+  }
+  return true;
+}
+
+// Update the share of interior slices of one member of the worker group
+template <typename T>
+void updateInterior(PartitionContext<T>* ctx, unsigned int rank) {
+  unsigned int first = ctx->interior_begin;
+  unsigned int count = ctx->interior_end-ctx->interior_begin;
+  unsigned int begin = first+(count*rank)/ctx->group_size;
+  unsigned int end = first+(count*(rank+1))/ctx->group_size;
+  updateSlices(ctx, begin, end);
+}
+
+// Pin the worker to the node of the partition, and on a placed mesh write
+// the first touch to the slices the worker updates
+template <typename T>
+void placeWorker(PartitionContext<T>* ctx, unsigned int rank) {
+  if(ctx->cpus && !NumaTopology::pinThread(*ctx->cpus))
+    log_msg<LOG_WARNING>(L"launchFDTD3dHost - can not pin a worker of partition %u")
+                         %ctx->partition;
+  if(ctx->device || !ctx->mesh->isPlaced())
+    return;
+  unsigned int size = ctx->mesh->getPartitionSize(ctx->partition);
+  ctx->mesh->initPartition(ctx->partition, (size*rank)/ctx->group_size,
+                           (size*(rank+1))/ctx->group_size);
+  if(ctx->group_size > 1)
+    ctx->group_barrier->wait();
+}
+
+// Add the owned corners of the moving receivers to the partial sums
+template <typename T>
+void gatherMovingReceivers(PartitionContext<T>* ctx, const T* P, unsigned int step) {
+  HostMesh<T>* mesh = ctx->mesh;
+  for(unsigned int m = 0; m < ctx->moving_receivers->size(); m++) {
+    nv::Vec3i base;
+    nv::Vec3f frac;
+    ctx->trajectories->at(m).getCell(step, mesh->getDimX(), mesh->getDimY(),
+                                     mesh->getDimZ(), base, frac);
+    T value = (T)0;
+    for(unsigned int c = 0; c < 8; c++) {
+      nv::Vec3i pos = Trajectory::getCorner(base, c);
+      int partition, elem;
+      mesh->getElementIdxAndPartition(pos.x, pos.y, pos.z, &partition, &elem);
+      if(partition != (int)ctx->partition)
+        continue;
+      T sample = ctx->device ? getSample<T>((unsigned int)elem, (T*)P) : P[elem];
+      value += Trajectory::getWeight<T>(frac, c)*sample;
+    }
+    ctx->moving_partials[(size_t)m*ctx->num_steps+step] = value;
+  }
+}
+
+// Copy the ring of the partition to the responses, a device target copies
+// its ring to the host first
+template <typename T>
+void flushReceiverRing(PartitionContext<T>* ctx, unsigned int step) {
+  ReceiverBank<T>* bank = ctx->receivers;
+  unsigned int num = bank->getNumberOfReceivers(ctx->partition);
+  if(num == 0)
+    return;
+  if(ctx->device)
+    copyDeviceToHost(num*(bank->getSlot(step)+1), bank->getRing(ctx->partition),
+                     ctx->device->receiver_ring, ctx->device->device);
+  bank->flush(ctx->partition, step, ctx->h_return_ptr);
+}
+
+// Gather the static receivers to the ring of the partition and flush the
+// ring to the responses at the end of a chunk
+template <typename T>
+void gatherReceiverRing(PartitionContext<T>* ctx, const T* P, unsigned int step) {
+  ReceiverBank<T>* bank = ctx->receivers;
+  unsigned int num = bank->getNumberOfReceivers(ctx->partition);
+  if(num == 0)
+    return;
+  unsigned int gradients = bank->getNumberOfGradients(ctx->partition);
+  if(ctx->device && num > gradients)
+    launchGatherReceivers<T>(P, ctx->device->receiver_idx+gradients,
+                             ctx->device->receiver_ring+(size_t)bank->getSlot(step)*num+gradients,
+                             num-gradients);
+  else if(!ctx->device)
+    bank->gather(P, ctx->partition, step);
+  if(bank->isChunkEnd(step))
+    flushReceiverRing(ctx, step);
+}
+
+template <typename T>
+void partitionWorker(PartitionContext<T>* ctx, unsigned int rank) {
+  bool leader = (rank == 0);
+  bool group = (ctx->group_size > 1);
+  boost::posix_time::ptime step_start;
+  unsigned int interior = (ctx->mesh->getDimX()-2)*(ctx->mesh->getDimY()-2);
+
+  placeWorker(ctx, rank);
+
+  unsigned int gathered = 0;
+  for(unsigned int step = 0; step < ctx->num_steps; step++) {
+    if(leader) {
+      step_start = boost::posix_time::microsec_clock::local_time();
+      if(ctx->partition == 0 && ctx->interruptCallback()) {
+        log_msg<LOG_INFO>(L"launchFDTD3dHost - interrupted at step %u") %step;
+        ctx->stop->store(true);
+      }
+      ctx->group_stop = ctx->stop->load() || !prepareStep(ctx, step);
+      ctx->updated_nodes += (double)(ctx->top_end-ctx->bottom_begin)*interior;
+    }
+
+    if(group) ctx->group_barrier->wait();
+    if(ctx->group_stop)
+      break;
+
+    if(leader && !updateBorders(ctx, step)) {
+      ctx->group_stop = true;
+    }
+
+    updateInterior(ctx, rank);
+
+    if(group) ctx->group_barrier->wait();
+    if(ctx->group_stop)
+      break;
+
+    if(leader && ctx->device) {
+      std::swap(ctx->device->P, ctx->device->P_past);
+      gatherReceiverRing(ctx, (const T*)ctx->device->P, step);
+      gatherMovingReceivers(ctx, ctx->device->P, step);
+      gathered = step+1;
+    }
+    else if(leader) {
+      ctx->mesh->flipPressurePointers(ctx->partition);
+      const T* P = ctx->mesh->getPressurePtrAt(ctx->partition);
+      gatherReceiverRing(ctx, P, step);
+      gatherMovingReceivers(ctx, P, step);
+      gathered = step+1;
+    }
+
+    if(leader && ctx->partition == 0 && (step%PROGRESS_MOD) == 0) {
+      boost::posix_time::time_duration d =
+        boost::posix_time::microsec_clock::local_time()-step_start;
+      ctx->progressCallback(step, ctx->num_steps, (float)d.total_microseconds()/1e6f);
+    }
+  }
+
+  // Release the neighbours if this worker stopped early
+  if(leader && ctx->group_stop)
+    ctx->stop->store(true);
+
+  // The samples of an interrupted chunk
+  if(leader && gathered > 0 && !ctx->receivers->isChunkEnd(gathered-1))
+    flushReceiverRing(ctx, gathered-1);
+}
+
+// Move a partition to the memory of a device target
+template <typename T>
+DevicePartition<T>* createDevicePartition(HostMesh<T>* mesh, unsigned int p,
+                                          const ExecutionTarget& target) {
+  if(mesh->getDimX()%target.block_x != 0 || mesh->getDimY()%target.block_y != 0) {
+    log_msg<LOG_ERROR>(L"launchFDTD3dHost - dim %u %u is not a multiple of the block %u %u")
+                       %mesh->getDimX() %mesh->getDimY() %target.block_x %target.block_y;
+    throw(-1);
+  }
+  unsigned int size = mesh->getPartitionSize(p)*mesh->getDimXY();
+  unsigned int num_coefs = mesh->getNumberOfUniqueMaterials()*MATERIAL_COEF_NUM;
+  if(mesh->isPlaced())
+    mesh->initPartition(p, 0, mesh->getPartitionSize(p));
+  DevicePartition<T>* d = new DevicePartition<T>();
+  d->device = target.device;
+  d->block_x = target.block_x;
+  d->block_y = target.block_y;
+  d->positions = toDevice<unsigned char>(size, mesh->getPositionIdxPtrAt(p), target.device);
+  d->materials = toDevice<unsigned char>(size, mesh->getMaterialIdxPtrAt(p), target.device);
+  d->P = toDevice<T>(size, mesh->getPressurePtrAt(p), target.device);
+  d->P_past = toDevice<T>(size, mesh->getPastPressurePtrAt(p), target.device);
+  d->params = toDevice<T>(4, mesh->getParameterPtr(), target.device);
+  d->material_coefs = toDevice<T>(num_coefs, mesh->getMaterialPtr(), target.device);
+  d->receiver_idx = (unsigned int*)NULL;
+  d->receiver_minus = (unsigned int*)NULL;
+  d->receiver_ring = (T*)NULL;
+  d->source_idx = (unsigned int*)NULL;
+  d->source_hard = (unsigned char*)NULL;
+  d->moving_idx = (unsigned int*)NULL;
+  d->source_samples = (T*)NULL;
+  d->halo = toDevice<T>(2*mesh->getHaloDepth()*mesh->getDimXY(), target.device);
+  return d;
+}
+
+// Upload the elements of the sources of a device target, the samples are
+// uploaded a chunk at a time by injectDeviceSources
+template <typename T>
+void setupDeviceSources(PartitionContext<T>* ctx) {
+  const SourceBank<T>& bank = *ctx->sources;
+  DevicePartition<T>* d = ctx->device;
+  unsigned int p = ctx->partition;
+  unsigned int num_segments = bank.getNumberOfSegments(p);
+  unsigned int num_corners = bank.getMovingElements(p).empty() ? 0
+                             : bank.getNumberOfMovingSources()*8;
+  unsigned int chunk_steps = bank.getChunkSteps();
+
+  std::vector<unsigned int> elements(bank.getElementIndices(p));
+  std::vector<unsigned char> hard(bank.getHardFlags(p));
+  for(unsigned int g = 0; g < num_segments; g++) {
+    elements.push_back(bank.getSegmentElements(p)[g]);
+    hard.push_back(0);
+  }
+  if(!elements.empty()) {
+    d->source_idx = toDevice<unsigned int>((unsigned int)elements.size(), &elements[0], d->device);
+    d->source_hard = toDevice<unsigned char>((unsigned int)hard.size(), &hard[0], d->device);
+  }
+  if(num_corners > 0)
+    d->moving_idx = toDevice<unsigned int>(num_corners*chunk_steps, d->device);
+  ctx->chunk_samples.assign((elements.size()+num_corners)*chunk_steps, (T)0);
+  if(!ctx->chunk_samples.empty())
+    d->source_samples = toDevice<T>((unsigned int)ctx->chunk_samples.size(), d->device);
+}
+
+// Copy the pressures of a device target back to the mesh and free the device
+template <typename T>
+void releaseDevicePartition(HostMesh<T>* mesh, unsigned int p, DevicePartition<T>* d) {
+  unsigned int size = mesh->getPartitionSize(p)*mesh->getDimXY();
+  copyDeviceToHost(size, mesh->getPressurePtrAt(p), d->P, d->device);
+  copyDeviceToHost(size, mesh->getPastPressurePtrAt(p), d->P_past, d->device);
+  destroyMem(d->positions, d->device);
+  destroyMem(d->materials, d->device);
+  destroyMem(d->P, d->device);
+  destroyMem(d->P_past, d->device);
+  destroyMem(d->params, d->device);
+  destroyMem(d->material_coefs, d->device);
+  destroyMem(d->halo, d->device);
+  if(d->receiver_ring != NULL) {
+    destroyMem(d->receiver_idx, d->device);
+    destroyMem(d->receiver_ring, d->device);
+  }
+  if(d->receiver_minus != NULL)
+    destroyMem(d->receiver_minus, d->device);
+  if(d->source_idx != NULL) {
+    destroyMem(d->source_idx, d->device);
+    destroyMem(d->source_hard, d->device);
+  }
+  if(d->moving_idx != NULL)
+    destroyMem(d->moving_idx, d->device);
+  if(d->source_samples != NULL)
+    destroyMem(d->source_samples, d->device);
+  delete d;
+}
+
+template <typename T>
+float launchHost(HostMesh<T>* mesh,
+                 SimulationParameters* sp,
+                 T* h_return_ptr,
+                 bool (*interruptCallback)(void),
+                 void (*progressCallback)(int, int, float),
+                 const std::vector<ExecutionTarget>& targets,
+                 std::vector<NodeBandwidth>* node_report) {
+  boost::posix_time::ptime start = boost::posix_time::microsec_clock::local_time();
+
+  unsigned int num_partitions = mesh->getNumberOfPartitions();
+  unsigned int num_steps = sp->getNumSteps();
+
+  if(targets.size() != num_partitions) {
+    log_msg<LOG_ERROR>(L"launchFDTD3dHost - %u targets for %u partitions")
+                       %(unsigned int)targets.size() %num_partitions;
+    throw(-1);
+  }
+
+  log_msg<LOG_INFO>(L"launchFDTD3dHost - begin, %u partitions, halo depth %u, %u steps")
+                    %num_partitions %mesh->getHaloDepth() %num_steps;
+
+  // Mailboxes between partitions i and i+1, up: i -> i+1, down: i+1 -> i
+  std::vector< HaloMailbox<T>* > up;
+  std::vector< HaloMailbox<T>* > down;
+  for(unsigned int i = 0; i+1 < num_partitions; i++) {
+    up.push_back(new HaloMailbox<T>(mesh->getDimXY()*mesh->getHaloDepth()));
+    down.push_back(new HaloMailbox<T>(mesh->getDimXY()*mesh->getHaloDepth()));
+  }
+
+  // Sources go to every partition holding the node, halos included
+  SourceBank<T> bank;
+  bank.compile(sp, mesh->getDimX(), mesh->getDimY(), mesh->getPartitionIndexing());
+  boost::mutex source_lock;
+
+  boost::atomic<bool> stop(false);
+  std::vector< PartitionContext<T> > contexts(num_partitions);
+  std::vector<boost::barrier*> barriers;
+  NumaTopology topology;
+
+  for(unsigned int i = 0; i < num_partitions; i++) {
+    PartitionContext<T>& ctx = contexts.at(i);
+    const ExecutionTarget& target = targets.at(i);
+    unsigned int group_size = target.threads > 0 ? target.threads : 1;
+    ctx.mesh = mesh;
+    ctx.device = (DevicePartition<T>*)NULL;
+    if(target.type == TARGET_DEVICE) {
+      ctx.device = createDevicePartition(mesh, i, target);
+      group_size = 1;
+    }
+    log_msg<LOG_DEBUG>(L"launchFDTD3dHost - partition %u on %s %d, %u threads")
+                       %i %(target.type == TARGET_DEVICE ? "device" : "host")
+                       %target.device %group_size;
+    ctx.partition = i;
+    ctx.num_steps = num_steps;
+    ctx.group_size = group_size;
+    ctx.halo_depth = mesh->getHaloDepth();
+    ctx.send_down = i > 0 ? down.at(i-1) : (HaloMailbox<T>*)NULL;
+    ctx.recv_down = i > 0 ? up.at(i-1) : (HaloMailbox<T>*)NULL;
+    ctx.send_up = i+1 < num_partitions ? up.at(i) : (HaloMailbox<T>*)NULL;
+    ctx.recv_up = i+1 < num_partitions ? down.at(i) : (HaloMailbox<T>*)NULL;
+    barriers.push_back(new boost::barrier(group_size));
+    ctx.group_barrier = barriers.back();
+    ctx.stop = &stop;
+    ctx.group_stop = false;
+    ctx.cpus = (const std::vector<unsigned int>*)NULL;
+    if(target.type == TARGET_HOST && target.numa_node >= 0) {
+      if((unsigned int)target.numa_node >= topology.getNumberOfNodes()) {
+        log_msg<LOG_ERROR>(L"launchFDTD3dHost - no NUMA node %d") %target.numa_node;
+        throw(-1);
+      }
+      ctx.cpus = &topology.getCpus(target.numa_node);
+    }
+    ctx.updated_nodes = 0.0;
+    ctx.sources = &bank;
+    ctx.source_lock = &source_lock;
+    if(ctx.device)
+      setupDeviceSources(&ctx);
+    ctx.h_return_ptr = h_return_ptr;
+    ctx.interruptCallback = interruptCallback;
+    ctx.progressCallback = progressCallback;
+  }
+
+  std::vector<unsigned int> moving_receivers;
+  std::vector<Trajectory> trajectories;
+  for(unsigned int r = 0; r < sp->getNumReceivers(); r++) {
+    if(!sp->isReceiverMoving(r))
+      continue;
+    moving_receivers.push_back(r);
+    trajectories.push_back(sp->getReceiverTrajectory(r));
+  }
+  for(unsigned int i = 0; i < num_partitions; i++) {
+    contexts.at(i).moving_receivers = &moving_receivers;
+    contexts.at(i).trajectories = &trajectories;
+    contexts.at(i).moving_partials.assign(moving_receivers.size()*num_steps, (T)0);
+  }
+
+  // Receivers are read from the partition which updates the node
+  ReceiverBank<T> receivers;
+  receivers.setup(num_partitions, num_steps);
+  receivers.setResampler(sp->getResampler());
+  receivers.setWriter(sp->getResponseWriter());
+  receivers.setGradientScale((T)sp->getLambda());
+  for(unsigned int r = 0; r < sp->getNumReceivers(); r++) {
+    if(sp->isReceiverMoving(r)) {
+      if(sp->getResponseWriter())
+        log_msg<LOG_WARNING>(L"launchFDTD3dHost - moving receiver %u is not streamed") %r;
+      continue;
+    }
+    nv::Vec3i pos = sp->getReceiverElementCoordinates(r);
+    int partition, elem;
+    mesh->getElementIdxAndPartition(pos.x, pos.y, pos.z, &partition, &elem);
+    if(partition == -1) {
+      log_msg<LOG_WARNING>(L"launchFDTD3dHost - receiver %u outside of the domain") %r;
+      continue;
+    }
+    enum ReceiverComponent component = sp->getReceiverComponent(r);
+    if(component == RECEIVER_PRESSURE) {
+      receivers.addReceiver((unsigned int)partition, (unsigned int)elem, r);
+      continue;
+    }
+    // The owned slices have both neighbours in memory, the ghost slices
+    // hold the level the update reads
+    if(pos.x < 1 || pos.y < 1 || pos.z < 1 || pos.x+1 >= (int)mesh->getDimX() ||
+       pos.y+1 >= (int)mesh->getDimY() || pos.z+1 >= (int)mesh->getDimZ()) {
+      log_msg<LOG_WARNING>(L"launchFDTD3dHost - B-format receiver %u on the edge of the domain") %r;
+      continue;
+    }
+    unsigned int offset = component == RECEIVER_X ? 1 :
+                          component == RECEIVER_Y ? mesh->getDimX() : mesh->getDimXY();
+    receivers.addGradient((unsigned int)partition, (unsigned int)elem, r, offset);
+  }
+
+  // A plane of grid points lies in one partition
+  sp->setupReceiverGrids(mesh->getDimX(), mesh->getDimY(), mesh->getDimZ());
+  for(unsigned int g = 0; g < sp->getNumReceiverGrids(); g++) {
+    ReceiverGrid* grid = &sp->getReceiverGrid(g);
+    unsigned int grid_idx = receivers.addGrid(grid);
+    for(unsigned int z = 0; z < grid->getNumPointsZ(); z++) {
+      nv::Vec3i pos = grid->getPlaneOrigin(z);
+      int partition, elem;
+      mesh->getElementIdxAndPartition(pos.x, pos.y, pos.z, &partition, &elem);
+      if(partition == -1)
+        continue;
+      receivers.addGridPlane((unsigned int)partition, (unsigned int)elem, grid_idx, z,
+                             mesh->getDimX());
+    }
+  }
+  receivers.compile();
+  for(unsigned int i = 0; i < num_partitions; i++) {
+    contexts.at(i).receivers = &receivers;
+    unsigned int num = receivers.getNumberOfReceivers(i);
+    DevicePartition<T>* d = contexts.at(i).device;
+    if(d == NULL || num == 0)
+      continue;
+    d->receiver_idx = toDevice<unsigned int>(num, &receivers.getElementIndices(i)[0], d->device);
+    d->receiver_ring = toDevice<T>(num*receivers.getChunkSteps(), d->device);
+    unsigned int gradients = receivers.getNumberOfGradients(i);
+    if(gradients > 0)
+      d->receiver_minus = toDevice<unsigned int>(gradients, &receivers.getMinusIndices(i)[0],
+                                                 d->device);
+  }
+
+  boost::posix_time::ptime run_start = boost::posix_time::microsec_clock::local_time();
+  boost::thread_group workers;
+  for(unsigned int i = 0; i < num_partitions; i++)
+    for(unsigned int r = 0; r < contexts.at(i).group_size; r++)
+      workers.create_thread(boost::bind(&partitionWorker<T>, &contexts.at(i), r));
+  workers.join_all();
+  boost::posix_time::time_duration run_time =
+    boost::posix_time::microsec_clock::local_time()-run_start;
+
+  std::vector<T> moving_response(num_steps);
+  for(unsigned int m = 0; h_return_ptr && m < moving_receivers.size(); m++) {
+    for(unsigned int k = 0; k < num_steps; k++) {
+      T value = (T)0;
+      for(unsigned int i = 0; i < num_partitions; i++)
+        value += contexts.at(i).moving_partials[(size_t)m*num_steps+k];
+      moving_response[k] = value;
+    }
+    receivers.writeResponse(moving_receivers.at(m), &moving_response[0], h_return_ptr);
+  }
+
+  // Each updated node streams its position and material index, reads P
+  // and reads and writes P_past, the neighbours of P hit the cache
+  double run_seconds = std::max((double)run_time.total_microseconds()/1e6, 1e-6);
+  std::vector<NodeBandwidth> report;
+  for(unsigned int i = 0; i < num_partitions; i++) {
+    if(contexts.at(i).device)
+      continue;
+    int node = targets.at(i).numa_node;
+    unsigned int j = 0;
+    while(j < report.size() && report.at(j).node != node)
+      j++;
+    if(j == report.size()) {
+      report.push_back(NodeBandwidth());
+      report.back().node = node;
+    }
+    report.at(j).partitions++;
+    report.at(j).threads += contexts.at(i).group_size;
+    report.at(j).bytes += contexts.at(i).updated_nodes*(2.0+3.0*sizeof(T));
+  }
+  for(unsigned int j = 0; j < report.size(); j++) {
+    report.at(j).gb_per_s = (float)(report.at(j).bytes/run_seconds/1e9);
+    log_msg<LOG_INFO>(L"launchFDTD3dHost - node %d: %u partitions, %u threads, %f GB/s")
+                      %report.at(j).node %report.at(j).partitions %report.at(j).threads
+                      %report.at(j).gb_per_s;
+  }
+  if(node_report)
+    *node_report = report;
+
+  for(unsigned int i = 0; i < num_partitions; i++)
+    if(contexts.at(i).device)
+      releaseDevicePartition(mesh, i, contexts.at(i).device);
+
+  for(unsigned int i = 0; i < up.size(); i++) {
+    delete up.at(i);
+    delete down.at(i);
+  }
+  for(unsigned int i = 0; i < barriers.size(); i++)
+    delete barriers.at(i);
+
+  boost::posix_time::time_duration d = boost::posix_time::microsec_clock::local_time()-start;
+  float seconds = (float)d.total_microseconds()/1e6f;
+  float per_step = num_steps > 0 ? seconds/(float)num_steps : 0.f;
+  log_msg<LOG_INFO>(L"launchFDTD3dHost - time: %f seconds, per step: %f") %seconds %per_step;
+  return per_step;
+}
+
+} // namespace
+
+float launchFDTD3dHost(HostMesh<float>* mesh,
+                       SimulationParameters* sp,
+                       float* h_return_ptr,
+                       bool (*interruptCallback)(void),
+                       void (*progressCallback)(int, int, float),
+                       unsigned int threads_per_partition) {
+  return launchHost<float>(mesh, sp, h_return_ptr, interruptCallback, progressCallback,
+                           std::vector<ExecutionTarget>(mesh->getNumberOfPartitions(),
+                                                        makeHostTarget(threads_per_partition, 0.f)),
+                           (std::vector<NodeBandwidth>*)NULL);
+}
+
+float launchFDTD3dHostTargets(HostMesh<float>* mesh,
+                              SimulationParameters* sp,
+                              float* h_return_ptr,
+                              bool (*interruptCallback)(void),
+                              void (*progressCallback)(int, int, float),
+                              const std::vector<ExecutionTarget>& targets,
+                              std::vector<NodeBandwidth>* node_report) {
+  return launchHost<float>(mesh, sp, h_return_ptr,
+                           interruptCallback, progressCallback, targets, node_report);
+}
+
+float launchFDTD3dHostDouble(HostMesh<double>* mesh,
+                             SimulationParameters* sp,
+                             double* h_return_ptr,
+                             bool (*interruptCallback)(void),
+                             void (*progressCallback)(int, int, float),
+                             unsigned int threads_per_partition) {
+  return launchHost<double>(mesh, sp, h_return_ptr, interruptCallback, progressCallback,
+                            std::vector<ExecutionTarget>(mesh->getNumberOfPartitions(),
+                                                         makeHostTarget(threads_per_partition, 0.f)),
+                            (std::vector<NodeBandwidth>*)NULL);
+}
+
+float launchFDTD3dHostTargetsDouble(HostMesh<double>* mesh,
+                                    SimulationParameters* sp,
+                                    double* h_return_ptr,
+                                    bool (*interruptCallback)(void),
+                                    void (*progressCallback)(int, int, float),
+                                    const std::vector<ExecutionTarget>& targets,
+                                    std::vector<NodeBandwidth>* node_report) {
+  return launchHost<double>(mesh, sp, h_return_ptr,
+                            interruptCallback, progressCallback, targets, node_report);
+}
+
+namespace {
+
+struct ThroughputRun {
+  std::vector<unsigned char> positions;
+  std::vector<unsigned char> materials;
+  std::vector<float> P;
+  std::vector<float> P_past;
+  std::vector<float> params;
+  std::vector<float> coefs;
+  unsigned int dim_x, dim_y;
+  unsigned int repeats;
+};
+
+void throughputWorker(ThroughputRun* run, unsigned int begin, unsigned int end) {
+  for(unsigned int r = 0; r < run->repeats; r++)
+    fdtd3dHostSlices<float>(&run->positions[0], &run->materials[0], &run->P[0], &run->P_past[0],
+                            &run->params[0], &run->coefs[0], run->dim_x*run->dim_y,
+                            run->dim_x, run->dim_y, begin, end, SRL_FORWARD);
+}
+
+} // namespace
+
+float estimateHostThroughput(unsigned int threads) {
+  if(threads == 0)
+    threads = 1;
+  const unsigned int slices = 8;
+  ThroughputRun run;
+  run.dim_x = 64;
+  run.dim_y = 64;
+  run.repeats = 4;
+  size_t size = (size_t)run.dim_x*run.dim_y*(threads*slices+2);
+  run.positions.assign(size, 0x86);
+  run.materials.assign(size, 0);
+  run.P.assign(size, 0.f);
+  run.P_past.assign(size, 0.f);
+  run.coefs.assign(MATERIAL_COEF_NUM, 0.f);
+  run.params.assign(4, 0.f);
+  run.params[0] = 0.57f;
+  run.params[1] = 0.33f;
+
+  boost::posix_time::ptime start = boost::posix_time::microsec_clock::local_time();
+  boost::thread_group workers;
+  for(unsigned int i = 0; i < threads; i++)
+    workers.create_thread(boost::bind(&throughputWorker, &run, 1+i*slices, 1+(i+1)*slices));
+  workers.join_all();
+  boost::posix_time::time_duration d = boost::posix_time::microsec_clock::local_time()-start;
+
+  double seconds = std::max((double)d.total_microseconds()/1e6, 1e-6);
+  float throughput = (float)((double)threads*slices*run.dim_x*run.dim_y*run.repeats/seconds/1e6);
+  log_msg<LOG_DEBUG>(L"estimateHostThroughput - %u threads, %f Mvox/s") %threads %throughput;
+  return throughput;
+}
+
+namespace {
+
+template <typename T>
+struct BlockContext {
+  HostBlockMesh<T>* mesh;
+  unsigned int block;
+  unsigned int num_steps;
+
+  std::vector< BlockContext<T> >* blocks;
+  std::vector<T> faces[6];     ///< Packed boundary faces, -x, +x, -y, +y, -z, +z
+
+  boost::barrier* barrier;
+  boost::atomic<bool>* stop;
+
+  std::vector<SourceEntry> sources;
+  std::vector<ReceiverEntry> receivers;
+  const std::vector<T>* source_samples;  ///< num_sources*num_steps
+  T* h_return_ptr;
+
+  bool (*interruptCallback)(void);
+  void (*progressCallback)(int, int, float);
+};
+
+template <typename T>
+void blockWorker(BlockContext<T>* ctx) {
+  HostBlockMesh<T>* mesh = ctx->mesh;
+  unsigned int b = ctx->block;
+  const HostBlock& block = mesh->getBlock(b);
+  unsigned int dim_xy = block.dim[0]*block.dim[1];
+  boost::posix_time::ptime step_start;
+
+  for(unsigned int step = 0; step < ctx->num_steps; step++) {
+    step_start = boost::posix_time::microsec_clock::local_time();
+    if(b == 0 && ctx->interruptCallback()) {
+      log_msg<LOG_INFO>(L"launchFDTD3dHostBlocks - interrupted at step %u") %step;
+      ctx->stop->store(true);
+    }
+
+    // The neighbours are done with the faces of the previous step
+    ctx->barrier->wait();
+    if(ctx->stop->load())
+      break;
+
+    T* P = mesh->getPressurePtrAt(b);
+    T* P_past = mesh->getPastPressurePtrAt(b);
+    for(unsigned int i = 0; i < ctx->sources.size(); i++) {
+      const SourceEntry& src = ctx->sources[i];
+      T sample = (*ctx->source_samples)[src.source*ctx->num_steps+step];
+      if(src.hard)
+        P[src.element] = sample;
+      else
+        P[src.element] += sample;
+    }
+
+    fdtd3dHostSlices<T>(mesh->getPositionIdxPtrAt(b), mesh->getMaterialIdxPtrAt(b),
+                        P, P_past, mesh->getParameterPtr(), mesh->getMaterialPtr(),
+                        dim_xy, block.dim[0], block.dim[1], 1, block.dim[2]-1,
+                        mesh->getUpdateType());
+
+    // Pack the owned boundary planes of the new time level
+    for(unsigned int f = 0; f < 6; f++)
+      if(block.neighbour[f] != -1)
+        HostBlockMesh<T>::packFace(P_past, block, f/2, f%2 ? block.dim[f/2]-2 : 1,
+                                   &ctx->faces[f][0]);
+
+    ctx->barrier->wait();
+
+    // The ghost plane at -x is the +x face of the neighbour and so on
+    for(unsigned int f = 0; f < 6; f++) {
+      if(block.neighbour[f] == -1)
+        continue;
+      const BlockContext<T>& other = ctx->blocks->at(block.neighbour[f]);
+      HostBlockMesh<T>::unpackFace(P_past, block, f/2, f%2 ? block.dim[f/2]-1 : 0,
+                                   &other.faces[f^1][0]);
+    }
+
+    mesh->flipPressurePointers(b);
+    P = mesh->getPressurePtrAt(b);
+    for(unsigned int i = 0; i < ctx->receivers.size(); i++) {
+      const ReceiverEntry& rec = ctx->receivers[i];
+      ctx->h_return_ptr[rec.receiver*ctx->num_steps+step] = P[rec.element];
+    }
+
+    if(b == 0 && (step%PROGRESS_MOD) == 0) {
+      boost::posix_time::time_duration d =
+        boost::posix_time::microsec_clock::local_time()-step_start;
+      ctx->progressCallback(step, ctx->num_steps, (float)d.total_microseconds()/1e6f);
+    }
+  }
+}
+
+template <typename T>
+float launchBlocks(HostBlockMesh<T>* mesh,
+                   SimulationParameters* sp,
+                   T* h_return_ptr,
+                   const std::vector<T>& source_samples,
+                   bool (*interruptCallback)(void),
+                   void (*progressCallback)(int, int, float)) {
+  boost::posix_time::ptime start = boost::posix_time::microsec_clock::local_time();
+
+  unsigned int num_blocks = mesh->getNumberOfBlocks();
+  unsigned int num_steps = sp->getNumSteps();
+
+  log_msg<LOG_INFO>(L"launchFDTD3dHostBlocks - begin, %u x %u x %u blocks, %u steps")
+                    %mesh->getShape(0) %mesh->getShape(1) %mesh->getShape(2) %num_steps;
+
+  boost::atomic<bool> stop(false);
+  boost::barrier barrier(num_blocks);
+  std::vector< BlockContext<T> > contexts(num_blocks);
+
+  for(unsigned int i = 0; i < num_blocks; i++) {
+    BlockContext<T>& ctx = contexts.at(i);
+    const HostBlock& block = mesh->getBlock(i);
+    ctx.mesh = mesh;
+    ctx.block = i;
+    ctx.num_steps = num_steps;
+    ctx.blocks = &contexts;
+    for(unsigned int f = 0; f < 6; f++)
+      if(block.neighbour[f] != -1)
+        ctx.faces[f].assign(HostBlockMesh<T>::getFaceSize(block, f/2), (T)0);
+    ctx.barrier = &barrier;
+    ctx.stop = &stop;
+    ctx.source_samples = &source_samples;
+    ctx.h_return_ptr = h_return_ptr;
+    ctx.interruptCallback = interruptCallback;
+    ctx.progressCallback = progressCallback;
+  }
+
+  if(sp->getNumArraySources() > 0) {
+    log_msg<LOG_ERROR>(L"launchFDTD3dHostBlocks - array sources are not supported");
+    throw(-1);
+  }
+  if(sp->hasMovingPositions()) {
+    log_msg<LOG_ERROR>(L"launchFDTD3dHostBlocks - moving sources and receivers are not supported");
+    throw(-1);
+  }
+  if(sp->hasBFormatReceivers()) {
+    log_msg<LOG_ERROR>(L"launchFDTD3dHostBlocks - B-format receivers are not supported");
+    throw(-1);
+  }
+
+  // Sources go to every block holding the node, ghost layers included
+  for(unsigned int s = 0; s < sp->getNumSources(); s++) {
+    nv::Vec3i pos = sp->getSourceElementCoordinates(s);
+    for(unsigned int i = 0; i < num_blocks; i++) {
+      int elem = mesh->getLocalIndex(i, pos.x, pos.y, pos.z);
+      if(elem == -1)
+        continue;
+      SourceEntry entry;
+      entry.element = (unsigned int)elem;
+      entry.source = s;
+      entry.hard = (sp->getSource(s).getSourceType() == SRC_HARD);
+      contexts.at(i).sources.push_back(entry);
+    }
+  }
+
+  for(unsigned int r = 0; r < sp->getNumReceivers(); r++) {
+    nv::Vec3i pos = sp->getReceiverElementCoordinates(r);
+    int block, elem;
+    mesh->getElementIdxAndBlock(pos.x, pos.y, pos.z, &block, &elem);
+    if(block == -1) {
+      log_msg<LOG_WARNING>(L"launchFDTD3dHostBlocks - receiver %u outside of the domain") %r;
+      continue;
+    }
+    ReceiverEntry entry;
+    entry.element = (unsigned int)elem;
+    entry.receiver = r;
+    contexts.at(block).receivers.push_back(entry);
+  }
+
+  boost::thread_group workers;
+  for(unsigned int i = 0; i < num_blocks; i++)
+    workers.create_thread(boost::bind(&blockWorker<T>, &contexts.at(i)));
+  workers.join_all();
+
+  boost::posix_time::time_duration d = boost::posix_time::microsec_clock::local_time()-start;
+  float seconds = (float)d.total_microseconds()/1e6f;
+  float per_step = num_steps > 0 ? seconds/(float)num_steps : 0.f;
+  log_msg<LOG_INFO>(L"launchFDTD3dHostBlocks - time: %f seconds, per step: %f") %seconds %per_step;
+  return per_step;
+}
+
+} // namespace
+
+float launchFDTD3dHostBlocks(HostBlockMesh<float>* mesh,
+                             SimulationParameters* sp,
+                             float* h_return_ptr,
+                             bool (*interruptCallback)(void),
+                             void (*progressCallback)(int, int, float)) {
+  unsigned int num_steps = sp->getNumSteps();
+  std::vector<float> samples(sp->getNumSources()*num_steps, 0.f);
+  for(unsigned int s = 0; s < sp->getNumSources(); s++)
+    for(unsigned int i = 0; i < num_steps; i++)
+      samples.at(s*num_steps+i) = sp->getSourceSample(s, i);
+
+  return launchBlocks<float>(mesh, sp, h_return_ptr, samples,
+                             interruptCallback, progressCallback);
+}
+
+float launchFDTD3dHostBlocksDouble(HostBlockMesh<double>* mesh,
+                                   SimulationParameters* sp,
+                                   double* h_return_ptr,
+                                   bool (*interruptCallback)(void),
+                                   void (*progressCallback)(int, int, float)) {
+  unsigned int num_steps = sp->getNumSteps();
+  std::vector<double> samples(sp->getNumSources()*num_steps, 0.0);
+  for(unsigned int s = 0; s < sp->getNumSources(); s++)
+    for(unsigned int i = 0; i < num_steps; i++)
+      samples.at(s*num_steps+i) = sp->getSourceSampleDouble(s, i);
+
+  return launchBlocks<double>(mesh, sp, h_return_ptr, samples,
+                              interruptCallback, progressCallback);
+}
@@ -0,0 +1,196 @@
+#ifndef HOST_KERNELS_3D_H
+#define HOST_KERNELS_3D_H
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// This file is a part of the PadallelFDTD Finite-Difference Time-Domain
+// simulation library. It is released under the MIT License. You should have
+// received a copy of the MIT License along with ParallelFDTD.  If not, see
+// http://www.opensource.org/licenses/mit-license.php
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// For details, see the LICENSE file
+//
+// (C) 2013-2014 Jukka Saarelma
+// Aalto University School of Science
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "hostMesh.h"
+#include "hostBlockMesh.h"
+#include "../base/ExecutionTarget.h"
+#include "../base/SimulationParameters.h"
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief Launch a predefined number of FDTD steps on the CPU in single
+/// precision. Each partition of the mesh is stepped by its own worker, or
+/// group of workers, without a global barrier. A worker first updates its
+/// border slices, hands them to the neighbours through a lock-free
+/// mailbox and updates the interior while the neighbours pick them up.
+/// With a halo depth k (HostMesh::makePartition()) the ghost slices are
+/// updated redundantly and the halos are exchanged only every k steps.
+/// \param[in] mesh HostMesh containing the partitioned simulation domain
+/// \param[in] sp The simulation parameters of the simulation
+/// \param[in, out] h_return_ptr Return values of the simulation,
+/// num_receivers*num_steps. May be NULL when the responses are streamed to
+/// the response writer of sp
+/// \param interruptCallback A callback function which is called between each
+/// step to check if the simulation is interrupted by the user
+/// \param progressCallback A callback function that is called between each
+/// PROGRESS_MOD number of steps to print progress information
+/// \param threads_per_partition The size of the worker group of a partition
+/// \return The average time per step in seconds
+///////////////////////////////////////////////////////////////////////////////
+float launchFDTD3dHost(HostMesh<float>* mesh,
+                       SimulationParameters* sp,
+                       float* h_return_ptr,
+                       bool (*interruptCallback)(void),
+                       void (*progressCallback)(int, int, float),
+                       unsigned int threads_per_partition);
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief Launch a predefined number of FDTD steps on the CPU in double
+/// precision, see launchFDTD3dHost()
+///////////////////////////////////////////////////////////////////////////////
+float launchFDTD3dHostDouble(HostMesh<double>* mesh,
+                             SimulationParameters* sp,
+                             double* h_return_ptr,
+                             bool (*interruptCallback)(void),
+                             void (*progressCallback)(int, int, float),
+                             unsigned int threads_per_partition);
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief The memory traffic of the host targets pinned to one NUMA node
+/// over a run. The traffic is estimated from the number of updated nodes,
+/// each streaming its indices and three pressure values.
+///////////////////////////////////////////////////////////////////////////////
+struct NodeBandwidth {
+  NodeBandwidth()
+  : node(-1),
+    partitions(0),
+    threads(0),
+    bytes(0.0),
+    gb_per_s(0.f)
+  {};
+
+  int node;                 ///< NumaTopology node, -1 for the unpinned targets
+  unsigned int partitions;
+  unsigned int threads;
+  double bytes;
+  float gb_per_s;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief Launch a predefined number of FDTD steps in single precision with
+/// each partition stepped by its own execution target. A host target steps
+/// its partition with a group of target.threads workers, a device target
+/// holds its partition in device memory and moves its halos over the bus
+/// to the same mailboxes the host targets use.
+///
+/// A host target with a numa_node pins its workers to the CPUs of the node.
+/// If the mesh is placed with HostMesh::setPlacement(), the workers also
+/// initialize the slices they update before the first step.
+/// \param targets One target per partition of the mesh, in partition order
+/// \param[out] node_report If not NULL, the bandwidth used on each node
+/// \return The average time per step in seconds
+/// \see launchFDTD3dHost()
+///////////////////////////////////////////////////////////////////////////////
+float launchFDTD3dHostTargets(HostMesh<float>* mesh,
+                              SimulationParameters* sp,
+                              float* h_return_ptr,
+                              bool (*interruptCallback)(void),
+                              void (*progressCallback)(int, int, float),
+                              const std::vector<ExecutionTarget>& targets,
+                              std::vector<NodeBandwidth>* node_report = NULL);
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief Launch a predefined number of FDTD steps in double precision with
+/// a target per partition, see launchFDTD3dHostTargets()
+///////////////////////////////////////////////////////////////////////////////
+float launchFDTD3dHostTargetsDouble(HostMesh<double>* mesh,
+                                    SimulationParameters* sp,
+                                    double* h_return_ptr,
+                                    bool (*interruptCallback)(void),
+                                    void (*progressCallback)(int, int, float),
+                                    const std::vector<ExecutionTarget>& targets,
+                                    std::vector<NodeBandwidth>* node_report = NULL);
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief Measure the throughput of a group of host worker threads on a
+/// small domain of air
+/// \param threads The number of threads
+/// \return The throughput in Mvox/s, comparable to the device estimates
+///////////////////////////////////////////////////////////////////////////////
+float estimateHostThroughput(unsigned int threads);
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief Launch a predefined number of FDTD steps on the CPU in single
+/// precision on a mesh split into blocks along x, y and z. Each block is
+/// updated by its own thread. After the update the blocks pack their
+/// boundary faces to buffers and the neighbours unpack them to their
+/// ghost layers.
+/// \param[in] mesh HostBlockMesh containing the simulation domain
+/// \param[in] sp The simulation parameters of the simulation
+/// \param[in, out] h_return_ptr Return values of the simulation,
+/// num_receivers*num_steps
+/// \param interruptCallback Called between each step to check if the
+/// simulation is interrupted by the user
+/// \param progressCallback Called every PROGRESS_MOD steps
+/// \return The average time per step in seconds
+///////////////////////////////////////////////////////////////////////////////
+float launchFDTD3dHostBlocks(HostBlockMesh<float>* mesh,
+                             SimulationParameters* sp,
+                             float* h_return_ptr,
+                             bool (*interruptCallback)(void),
+                             void (*progressCallback)(int, int, float));
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief Launch a predefined number of FDTD steps on the CPU in double
+/// precision on a mesh split into blocks, see launchFDTD3dHostBlocks()
+///////////////////////////////////////////////////////////////////////////////
+float launchFDTD3dHostBlocksDouble(HostBlockMesh<double>* mesh,
+                                   SimulationParameters* sp,
+                                   double* h_return_ptr,
+                                   bool (*interruptCallback)(void),
+                                   void (*progressCallback)(int, int, float));
+
+//// Kernels
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief Update a range of slices and rows of a partition on the CPU. The
+/// counterpart of the fdtd3dStdMaterials and fdtd3dStdKowalczykMaterials
+/// kernels. The outermost nodes of the x and y dimension are not updated,
+/// they are padding.
+/// \tparam T defines the precision used in the calculation (float / double)
+/// \param[in] positions Position indices of the partition
+/// \param[in] materials Material indices of the partition
+/// \param[in] P The current pressure values of the partition
+/// \param[out] P_past The pressure values of the past step, overwritten
+/// with the next step
+/// \param[in] params The simulation parameters
+/// \param[in] material_coefs The material coefficients
+/// \param[in] dim_xy The size of the xy slice of the mesh
+/// \param[in] dim_x The length of the x dimension of the mesh
+/// \param[in] dim_y The length of the y dimension of the mesh
+/// \param[in] slice_begin First local slice to update
+/// \param[in] slice_end One past the last local slice to update
+/// \param[in] update_type The update scheme, enum UpdateType
+///////////////////////////////////////////////////////////////////////////////
+template <typename T>
+void fdtd3dHostSlices(const unsigned char* positions,
+                      const unsigned char* materials,
+                      const T* P, T* P_past,
+                      const T* params,
+                      const T* material_coefs,
+                      unsigned int dim_xy, unsigned int dim_x, unsigned int dim_y,
+                      unsigned int slice_begin, unsigned int slice_end,
+                      unsigned int update_type);
+
+#endif
@@ -0,0 +1,374 @@
+#ifndef HOST_MESH_H
+#define HOST_MESH_H
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// This file is a part of the PadallelFDTD Finite-Difference Time-Domain
+// simulation library. It is released under the MIT License. You should have
+// received a copy of the MIT License along with ParallelFDTD.  If not, see
+// http://www.opensource.org/licenses/mit-license.php
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// For details, see the LICENSE file
+//
+// (C) 2013-2014 Jukka Saarelma
+// Aalto University School of Science
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "hostNuma.h"
+#include "../kernels/cudaMesh.h"
+#include "../base/MaterialHandler.h"
+#include "../global_includes.h"
+#include <vector>
+#include <algorithm>
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief Simulation domain in host memory. The counterpart of CudaMesh for
+/// the CPU solver. The domain is split along z into partitions with the same
+/// slice indexing as CudaMesh::getPartitionIndexing(), each partition holding
+/// halo_depth ghost slices at each internal partition border.
+///
+/// \tparam T The precision of the pressure values, float / double
+///////////////////////////////////////////////////////////////////////////////
+template <typename T>
+class HostMesh {
+public:
+  HostMesh()
+  : dim_x_(0),
+    dim_y_(0),
+    dim_z_(0),
+    dim_xy_(0),
+    update_type_(0),
+    number_of_unique_materials_(0),
+    halo_depth_(1),
+    first_slice_(0),
+    huge_pages_(false)
+  {};
+
+  ~HostMesh() {};
+
+  /////////////////////////////////////////////////////////////////////////////
+  /// \brief Copy the voxelized domain to the mesh
+  /// \param position_idx Position index of each node, dim_x*dim_y*dim_z
+  /// \param material_idx Material index of each node, dim_x*dim_y*dim_z
+  /// \param dim_x, dim_y, dim_z The dimensions of the domain
+  /// \param material_coefs Material coefficients, MATERIAL_COEF_NUM per material
+  /// \param number_of_unique_materials The number of materials
+  /// \param params The simulation parameters, see SimulationParameters::getParameterPtr()
+  /// \param update_type The update scheme, enum UpdateType
+  /////////////////////////////////////////////////////////////////////////////
+  void setupMesh(const unsigned char* position_idx,
+                 const unsigned char* material_idx,
+                 unsigned int dim_x, unsigned int dim_y, unsigned int dim_z,
+                 const T* material_coefs,
+                 unsigned int number_of_unique_materials,
+                 const T* params,
+                 unsigned int update_type) {
+    this->setupSlices(position_idx, material_idx, 0, dim_z, dim_x, dim_y, dim_z,
+                      material_coefs, number_of_unique_materials, params, update_type);
+  }
+
+  /////////////////////////////////////////////////////////////////////////////
+  /// \brief Copy a range of slices of the voxelized domain to the mesh. Only
+  /// the partitions inside the range can be made, used when each partition
+  /// is stepped by its own process
+  /// \param position_idx Position index of each node, number_of_slices*dim_x*dim_y
+  /// \param material_idx Material index of each node, number_of_slices*dim_x*dim_y
+  /// \param first_slice The first slice of the range in the domain
+  /// \param number_of_slices The number of slices in the range
+  /// \param dim_x, dim_y, dim_z The dimensions of the whole domain
+  /// \param material_coefs Material coefficients, MATERIAL_COEF_NUM per material
+  /// \param number_of_unique_materials The number of materials
+  /// \param params The simulation parameters, see SimulationParameters::getParameterPtr()
+  /// \param update_type The update scheme, enum UpdateType
+  /////////////////////////////////////////////////////////////////////////////
+  void setupSlices(const unsigned char* position_idx,
+                   const unsigned char* material_idx,
+                   unsigned int first_slice, unsigned int number_of_slices,
+                   unsigned int dim_x, unsigned int dim_y, unsigned int dim_z,
+                   const T* material_coefs,
+                   unsigned int number_of_unique_materials,
+                   const T* params,
+                   unsigned int update_type) {
+    this->dim_x_ = dim_x;
+    this->dim_y_ = dim_y;
+    this->dim_z_ = dim_z;
+    this->dim_xy_ = dim_x*dim_y;
+    this->first_slice_ = first_slice;
+    this->update_type_ = update_type;
+    this->number_of_unique_materials_ = number_of_unique_materials;
+
+    size_t num_elements = (size_t)this->dim_xy_*number_of_slices;
+    this->position_idx_.assign(position_idx, position_idx+num_elements);
+    this->material_idx_.assign(material_idx, material_idx+num_elements);
+    this->materials_.assign(material_coefs,
+                            material_coefs+number_of_unique_materials*MATERIAL_COEF_NUM);
+    this->parameters_.assign(params, params+4);
+
+    log_msg<LOG_INFO>(L"HostMesh::setupSlices - dim %u %u %u, slices %u - %u, %u materials, "
+                      L"update type %u") %dim_x %dim_y %dim_z %first_slice
+                      %(first_slice+number_of_slices-1) %number_of_unique_materials %update_type;
+  }
+
+  /////////////////////////////////////////////////////////////////////////////
+  /// \brief Split the domain to equal partitions along z
+  /// \param number_of_partitions The number of partitions
+  /// \param halo_depth The number of ghost slices at each internal border
+  /// \param local_partition If not -1, only this partition is stored, see
+  /// makePartition(std::vector< std::vector<unsigned int> >, unsigned int, int)
+  /////////////////////////////////////////////////////////////////////////////
+  void makePartition(unsigned int number_of_partitions, unsigned int halo_depth = 1,
+                     int local_partition = -1) {
+    this->makePartition(CudaMesh::getPartitionIndexing(number_of_partitions,
+                                                       this->dim_z_),
+                        halo_depth, local_partition);
+  }
+
+  /////////////////////////////////////////////////////////////////////////////
+  /// \brief Split the domain with a given slice indexing
+  /// \param partition_indexing The global slice indices of each partition
+  /// with one halo slice at each internal border, as given by
+  /// CudaMesh::getPartitionIndexing() and PartitionPlanner
+  /// \param halo_depth The number of ghost slices at each internal border.
+  /// Each partition has to update at least halo_depth slices
+  /// \param local_partition If not -1, only the data of this partition is
+  /// kept and the domain given to setupMesh() is released. Used when each
+  /// partition is stepped by its own process
+  /////////////////////////////////////////////////////////////////////////////
+  void makePartition(const std::vector< std::vector<unsigned int> >& partition_indexing,
+                     unsigned int halo_depth = 1,
+                     int local_partition = -1) {
+    unsigned int number_of_partitions = (unsigned int)partition_indexing.size();
+    if(halo_depth == 0)
+      halo_depth = 1;
+
+    this->halo_depth_ = halo_depth;
+    this->partition_indexing_ = getHaloIndexing(partition_indexing, halo_depth);
+    this->position_parts_.assign(number_of_partitions, HostArray<unsigned char>());
+    this->material_parts_.assign(number_of_partitions, HostArray<unsigned char>());
+    this->pressures_.assign(number_of_partitions, HostArray<T>());
+    this->pressures_past_.assign(number_of_partitions, HostArray<T>());
+
+    bool deferred = this->isPlaced() && local_partition == -1;
+    if(this->isPlaced() && this->partition_nodes_.size() != number_of_partitions) {
+      log_msg<LOG_ERROR>(L"HostMesh::makePartition - %u nodes for %u partitions")
+                         %(unsigned int)this->partition_nodes_.size() %number_of_partitions;
+      throw(-1);
+    }
+
+    unsigned int held_slices = (unsigned int)(this->position_idx_.size()/this->dim_xy_);
+    for(unsigned int i = 0; i < number_of_partitions; i++) {
+      if(local_partition != -1 && (int)i != local_partition)
+        continue;
+      if(this->getFirstSliceIdx(i) < this->first_slice_ ||
+         this->getLastSliceIdx(i) >= this->first_slice_+held_slices) {
+        log_msg<LOG_ERROR>(L"HostMesh::makePartition - partition %u, slices %u - %u are not "
+                           L"in the mesh") %i %this->getFirstSliceIdx(i) %this->getLastSliceIdx(i);
+        throw(-1);
+      }
+      size_t size = (size_t)this->getPartitionSize(i)*this->dim_xy_;
+      int node = this->isPlaced() ? this->partition_nodes_.at(i) : -1;
+
+      this->position_parts_.at(i).allocate(size, node, this->huge_pages_);
+      this->material_parts_.at(i).allocate(size, node, this->huge_pages_);
+      this->pressures_.at(i).allocate(size, node, this->huge_pages_);
+      this->pressures_past_.at(i).allocate(size, node, this->huge_pages_);
+      if(!deferred)
+        this->initPartition(i, 0, this->getPartitionSize(i));
+
+      log_msg<LOG_DEBUG>(L"HostMesh::makePartition - partition %u, slices %u - %u, halo depth %u, "
+                         L"node %d") %i %this->getFirstSliceIdx(i) %this->getLastSliceIdx(i)
+                         %halo_depth %node;
+    }
+
+    if(local_partition != -1) {
+      std::vector<unsigned char>().swap(this->position_idx_);
+      std::vector<unsigned char>().swap(this->material_idx_);
+    }
+  }
+
+  /////////////////////////////////////////////////////////////////////////////
+  /// \brief Widen the halos of a slice indexing from a single slice to the
+  /// given depth, throws if a partition updates fewer than halo_depth slices
+  /// \param partition_indexing The global slice indices of each partition
+  /// with one halo slice at each internal border
+  /// \param halo_depth The number of ghost slices at each internal border
+  /// \return The slice indices of each partition with the halos widened
+  /////////////////////////////////////////////////////////////////////////////
+  static std::vector< std::vector<unsigned int> > getHaloIndexing(
+      std::vector< std::vector<unsigned int> > partition_indexing,
+      unsigned int halo_depth) {
+    unsigned int number_of_partitions = (unsigned int)partition_indexing.size();
+    if(halo_depth == 0)
+      halo_depth = 1;
+
+    for(unsigned int i = 0; i < number_of_partitions; i++) {
+      std::vector<unsigned int>& slices = partition_indexing.at(i);
+      unsigned int owned = (unsigned int)slices.size()-(i > 0)-(i < number_of_partitions-1);
+      if(owned < halo_depth || slices.size() < 3) {
+        log_msg<LOG_ERROR>(L"HostMesh::getHaloIndexing - partition %u updates %u slices, "
+                           L"halo depth %u") %i %owned %halo_depth;
+        throw(-1);
+      }
+      for(unsigned int j = 1; j < halo_depth && i > 0; j++)
+        slices.insert(slices.begin(), slices.front()-1);
+      for(unsigned int j = 1; j < halo_depth && i < number_of_partitions-1; j++)
+        slices.push_back(slices.back()+1);
+    }
+    return partition_indexing;
+  }
+
+  /////////////////////////////////////////////////////////////////////////////
+  /// \brief Place the partitions on NUMA nodes, call before makePartition().
+  /// The partitions are then bound to their nodes and left untouched by
+  /// makePartition(), each worker group copies its share of the domain
+  /// with initPartition() so the pages land next to the threads updating
+  /// them.
+  /// \param nodes The node id of each partition, see NumaTopology::getNodeId()
+  /// \param huge_pages Back the partitions with transparent huge pages
+  /////////////////////////////////////////////////////////////////////////////
+  void setPlacement(const std::vector<int>& nodes, bool huge_pages) {
+    this->partition_nodes_ = nodes;
+    this->huge_pages_ = huge_pages;
+  }
+
+  /////////////////////////////////////////////////////////////////////////////
+  /// \brief Copy the position and material indices of a range of local
+  /// slices from the domain and zero their pressures. Done by makePartition()
+  /// unless the partitions are placed with setPlacement()
+  /// \param partition The partition index
+  /// \param slice_begin, slice_end The range of local slices
+  /////////////////////////////////////////////////////////////////////////////
+  void initPartition(unsigned int partition, unsigned int slice_begin, unsigned int slice_end) {
+    size_t offset = (size_t)(this->getFirstSliceIdx(partition)-this->first_slice_)*this->dim_xy_;
+    size_t begin = (size_t)slice_begin*this->dim_xy_;
+    size_t end = (size_t)slice_end*this->dim_xy_;
+    if(begin >= end)
+      return;
+    std::copy(this->position_idx_.begin()+offset+begin, this->position_idx_.begin()+offset+end,
+              this->position_parts_.at(partition).begin()+begin);
+    std::copy(this->material_idx_.begin()+offset+begin, this->material_idx_.begin()+offset+end,
+              this->material_parts_.at(partition).begin()+begin);
+    std::fill(this->pressures_.at(partition).begin()+begin,
+              this->pressures_.at(partition).begin()+end, (T)0);
+    std::fill(this->pressures_past_.at(partition).begin()+begin,
+              this->pressures_past_.at(partition).begin()+end, (T)0);
+  }
+
+  /// \return true if the partitions are placed on NUMA nodes
+  bool isPlaced() const {return !this->partition_nodes_.empty();}
+  /// \return The node id of a placed partition, -1 if not placed
+  int getPartitionNode(unsigned int partition) const {
+    return this->isPlaced() ? this->partition_nodes_.at(partition) : -1;}
+
+  void resetPressures() {
+    for(unsigned int i = 0; i < this->getNumberOfPartitions(); i++) {
+      std::fill(this->pressures_.at(i).begin(), this->pressures_.at(i).end(), (T)0);
+      std::fill(this->pressures_past_.at(i).begin(), this->pressures_past_.at(i).end(), (T)0);
+    }
+  }
+
+  /// \brief Swap the current and past pressures of a single partition
+  void flipPressurePointers(unsigned int partition) {
+    this->pressures_.at(partition).swap(this->pressures_past_.at(partition));
+  }
+
+  T* getPressurePtrAt(unsigned int partition) {return &(this->pressures_.at(partition)[0]);}
+  T* getPastPressurePtrAt(unsigned int partition) {return &(this->pressures_past_.at(partition)[0]);}
+  unsigned char* getPositionIdxPtrAt(unsigned int partition) {return &(this->position_parts_.at(partition)[0]);}
+  unsigned char* getMaterialIdxPtrAt(unsigned int partition) {return &(this->material_parts_.at(partition)[0]);}
+  const T* getMaterialPtr() const {return &(this->materials_[0]);}
+  const T* getParameterPtr() const {return &(this->parameters_[0]);}
+
+  unsigned int getNumberOfPartitions() const {return (unsigned int)this->partition_indexing_.size();}
+  /// \return false for the partitions skipped by a local makePartition()
+  bool hasPartition(unsigned int partition) const {return !this->pressures_.at(partition).empty();}
+  unsigned int getPartitionSize(unsigned int partition) const {
+    return (unsigned int)this->partition_indexing_.at(partition).size();}
+  unsigned int getFirstSliceIdx(unsigned int partition) const {
+    return this->partition_indexing_.at(partition).at(0);}
+  unsigned int getLastSliceIdx(unsigned int partition) const {
+    return *(this->partition_indexing_.at(partition).end()-1);}
+  const std::vector< std::vector<unsigned int> >& getPartitionIndexing() const {
+    return this->partition_indexing_;}
+
+  unsigned int getDimX() const {return this->dim_x_;}
+  unsigned int getDimY() const {return this->dim_y_;}
+  unsigned int getDimZ() const {return this->dim_z_;}
+  unsigned int getDimXY() const {return this->dim_xy_;}
+  unsigned int getUpdateType() const {return this->update_type_;}
+  unsigned int getHaloDepth() const {return this->halo_depth_;}
+  unsigned int getNumberOfUniqueMaterials() const {return this->number_of_unique_materials_;}
+  unsigned int getNumberOfElements() const {return this->dim_xy_*this->dim_z_;}
+
+  inline int getElementIndex(int x, int y, int z) const {
+    return this->dim_xy_*z+this->dim_x_*y+x;
+  }
+
+  /////////////////////////////////////////////////////////////////////////////
+  /// \brief Find the partition which updates the given node, halo slices are
+  /// not considered
+  /// \param x, y, z The element coordinates in the domain
+  /// \param[out] partition The partition index, -1 if not found
+  /// \param[out] elem The element index inside the partition, -1 if not found
+  /////////////////////////////////////////////////////////////////////////////
+  void getElementIdxAndPartition(unsigned int x, unsigned int y, unsigned int z,
+                                 int* partition, int* elem) const {
+    *partition = -1;
+    *elem = -1;
+    unsigned int np = this->getNumberOfPartitions();
+    for(unsigned int i = 0; i < np; i++) {
+      unsigned int first = this->getFirstSliceIdx(i);
+      unsigned int own_first = (i == 0) ? first : first+this->halo_depth_;
+      unsigned int own_last = (i == np-1) ? this->getLastSliceIdx(i)
+                                          : this->getLastSliceIdx(i)-this->halo_depth_;
+      if(z < own_first || z > own_last)
+        continue;
+      *partition = (int)i;
+      *elem = this->getElementIndex(x, y, z-first);
+      return;
+    }
+  }
+
+  /// \return The current pressure at the given node
+  T getSample(unsigned int x, unsigned int y, unsigned int z) const {
+    int partition, elem;
+    this->getElementIdxAndPartition(x, y, z, &partition, &elem);
+    if(partition == -1 || !this->hasPartition(partition))
+      return (T)0;
+    return this->pressures_.at(partition).at(elem);
+  }
+
+private:
+  unsigned int dim_x_;
+  unsigned int dim_y_;
+  unsigned int dim_z_;
+  unsigned int dim_xy_;
+  unsigned int update_type_;
+  unsigned int number_of_unique_materials_;
+  unsigned int halo_depth_;                   ///< Ghost slices at each internal border
+  unsigned int first_slice_;                  ///< The first slice of the domain held, see setupSlices()
+  bool huge_pages_;                           ///< Back the partitions with huge pages
+
+  std::vector<unsigned char> position_idx_;   ///< Position indices of the slices held
+  std::vector<unsigned char> material_idx_;   ///< Material indices of the slices held
+  std::vector<T> materials_;                  ///< Material coefficients
+  std::vector<T> parameters_;                 ///< Simulation parameters
+
+  std::vector< std::vector<unsigned int> > partition_indexing_;
+  std::vector<int> partition_nodes_;          ///< NUMA node of each partition, see setPlacement()
+  std::vector< HostArray<unsigned char> > position_parts_;
+  std::vector< HostArray<unsigned char> > material_parts_;
+  std::vector< HostArray<T> > pressures_;
+  std::vector< HostArray<T> > pressures_past_;
+};
+
+#endif
@@ -0,0 +1,183 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// This file is a part of the PadallelFDTD Finite-Difference Time-Domain
+// simulation library. It is released under the MIT License. You should have
+// received a copy of the MIT License along with ParallelFDTD.  If not, see
+// http://www.opensource.org/licenses/mit-license.php
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// For details, see the LICENSE file
+//
+// (C) 2013-2014 Jukka Saarelma
+// Aalto University School of Science
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "hostNuma.h"
+#include "../logger.h"
+
+#include <boost/thread.hpp>
+#include <fstream>
+#include <sstream>
+#include <stdlib.h>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace {
+  const size_t huge_page_size = 2*1024*1024;
+
+  bool readLine(const std::string& path, std::string* line) {
+    std::ifstream file(path.c_str());
+    if(!file.good())
+      return false;
+    std::getline(file, *line);
+    return true;
+  }
+}
+
+NumaTopology::NumaTopology() {
+  std::string online;
+  if(readLine("/sys/devices/system/node/online", &online)) {
+    std::vector<unsigned int> ids = parseCpuList(online);
+    for(unsigned int i = 0; i < ids.size(); i++) {
+      std::stringstream path;
+      path<<"/sys/devices/system/node/node"<<ids.at(i)<<"/cpulist";
+      std::string list;
+      if(!readLine(path.str(), &list))
+        continue;
+      std::vector<unsigned int> cpus = parseCpuList(list);
+      // Memory-only nodes can not run the workers
+      if(cpus.empty())
+        continue;
+      this->node_ids_.push_back((int)ids.at(i));
+      this->cpus_.push_back(cpus);
+    }
+  }
+
+  if(this->cpus_.empty()) {
+    unsigned int count = boost::thread::hardware_concurrency();
+    std::vector<unsigned int> cpus;
+    for(unsigned int i = 0; i < (count > 0 ? count : 1); i++)
+      cpus.push_back(i);
+    this->node_ids_.assign(1, -1);
+    this->cpus_.assign(1, cpus);
+  }
+
+  for(unsigned int i = 0; i < this->getNumberOfNodes(); i++)
+    log_msg<LOG_DEBUG>(L"NumaTopology::NumaTopology - node %d, %u cpus")
+                       %this->node_ids_.at(i) %(unsigned int)this->cpus_.at(i).size();
+}
+
+std::vector<unsigned int> NumaTopology::parseCpuList(const std::string& list) {
+  std::vector<unsigned int> cpus;
+  std::stringstream ss(list);
+  std::string range;
+  while(std::getline(ss, range, ',')) {
+    if(range.find_first_of("0123456789") == std::string::npos)
+      continue;
+    size_t dash = range.find('-');
+    unsigned int first = (unsigned int)atoi(range.substr(0, dash).c_str());
+    unsigned int last = first;
+    if(dash != std::string::npos)
+      last = (unsigned int)atoi(range.substr(dash+1).c_str());
+    for(unsigned int cpu = first; cpu <= last; cpu++)
+      cpus.push_back(cpu);
+  }
+  std::sort(cpus.begin(), cpus.end());
+  cpus.erase(std::unique(cpus.begin(), cpus.end()), cpus.end());
+  return cpus;
+}
+
+bool NumaTopology::pinThread(const std::vector<unsigned int>& cpus) {
+#ifdef __linux__
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  for(unsigned int i = 0; i < cpus.size(); i++)
+    if(cpus.at(i) < CPU_SETSIZE)
+      CPU_SET(cpus.at(i), &set);
+  return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+  return false;
+#endif
+}
+
+bool NumaTopology::bindMemory(void* ptr, size_t bytes, int node_id) {
+#if defined(__linux__) && defined(SYS_mbind)
+  if(node_id < 0 || bytes == 0)
+    return false;
+  const int mpol_preferred = 1;
+  const unsigned int bits = 8*sizeof(unsigned long);
+  std::vector<unsigned long> mask(node_id/bits+1, 0);
+  mask.at(node_id/bits) = 1ul<<(node_id%bits);
+  // The kernel reads maxnode-1 bits of the mask
+  unsigned long max_node = (unsigned long)(mask.size()*bits+1);
+  return syscall(SYS_mbind, ptr, bytes, mpol_preferred, &mask[0], max_node, 0) == 0;
+#else
+  return false;
+#endif
+}
+
+void* allocatePages(size_t bytes, int node_id, bool huge_pages, size_t* mapped_bytes) {
+#ifdef __linux__
+  size_t page = huge_pages ? huge_page_size : (size_t)sysconf(_SC_PAGESIZE);
+  size_t length = (bytes+page-1)/page*page;
+  size_t extra = huge_pages ? huge_page_size : 0;
+
+  // Anonymous mappings are zero and get their pages on the first write
+  char* base = (char*)mmap(NULL, length+extra, PROT_READ|PROT_WRITE,
+                           MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+  if(base == (char*)MAP_FAILED) {
+    log_msg<LOG_ERROR>(L"allocatePages - can not map %u MB") %(unsigned int)(bytes>>20);
+    throw(-1);
+  }
+
+  // Huge pages need an aligned range, trim the mapping to one
+  char* ptr = base;
+  if(huge_pages) {
+    ptr = (char*)(((size_t)base+huge_page_size-1)/huge_page_size*huge_page_size);
+    if(ptr > base)
+      munmap(base, (size_t)(ptr-base));
+    if(ptr+length < base+length+extra)
+      munmap(ptr+length, (size_t)(base+length+extra-(ptr+length)));
+#ifdef MADV_HUGEPAGE
+    if(madvise(ptr, length, MADV_HUGEPAGE) != 0)
+      log_msg<LOG_DEBUG>(L"allocatePages - no transparent huge pages");
+#endif
+  }
+
+  if(node_id >= 0 && !NumaTopology::bindMemory(ptr, length, node_id))
+    log_msg<LOG_DEBUG>(L"allocatePages - can not bind to node %d, using first touch") %node_id;
+
+  *mapped_bytes = length;
+  return ptr;
+#else
+  void* ptr = calloc(bytes, 1);
+  if(!ptr) {
+    log_msg<LOG_ERROR>(L"allocatePages - can not allocate %u MB") %(unsigned int)(bytes>>20);
+    throw(-1);
+  }
+  *mapped_bytes = bytes;
+  return ptr;
+#endif
+}
+
+void releasePages(void* ptr, size_t mapped_bytes) {
+#ifdef __linux__
+  munmap(ptr, mapped_bytes);
+#else
+  free(ptr);
+#endif
+}
@@ -0,0 +1,182 @@
+#ifndef HOST_NUMA_H
+#define HOST_NUMA_H
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// This file is a part of the PadallelFDTD Finite-Difference Time-Domain
+// simulation library. It is released under the MIT License. You should have
+// received a copy of the MIT License along with ParallelFDTD.  If not, see
+// http://www.opensource.org/licenses/mit-license.php
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// For details, see the LICENSE file
+//
+// (C) 2013-2014 Jukka Saarelma
+// Aalto University School of Science
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <stdexcept>
+#include <stddef.h>
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief The NUMA nodes of the machine and the CPUs of each node, read
+/// from /sys/devices/system/node. Machines without NUMA information, and
+/// platforms other than Linux, show up as a single node holding all CPUs.
+///////////////////////////////////////////////////////////////////////////////
+class NumaTopology {
+public:
+  NumaTopology();
+  ~NumaTopology() {};
+
+  unsigned int getNumberOfNodes() const {return (unsigned int)this->cpus_.size();}
+  /// \return The id of the node used by the system, not always contiguous
+  int getNodeId(unsigned int node) const {return this->node_ids_.at(node);}
+  const std::vector<unsigned int>& getCpus(unsigned int node) const {return this->cpus_.at(node);}
+
+  /////////////////////////////////////////////////////////////////////////////
+  /// \brief Parse a cpu list of the form "0-3,8,10-11"
+  /// \param list The list as written in the cpulist file of a node
+  /// \return The cpus of the list in ascending order
+  /////////////////////////////////////////////////////////////////////////////
+  static std::vector<unsigned int> parseCpuList(const std::string& list);
+
+  /////////////////////////////////////////////////////////////////////////////
+  /// \brief Restrict the calling thread to a set of cpus
+  /// \return false if the affinity could not be set
+  /////////////////////////////////////////////////////////////////////////////
+  static bool pinThread(const std::vector<unsigned int>& cpus);
+
+  /////////////////////////////////////////////////////////////////////////////
+  /// \brief Ask the kernel to place the pages of a range on a node. The
+  /// policy is a preference, pages go to other nodes when the node is
+  /// full. Only the pages not yet touched are affected.
+  /// \param ptr Page aligned start of the range
+  /// \param bytes The length of the range
+  /// \param node_id The id of the node, see getNodeId()
+  /// \return false if the policy could not be set
+  /////////////////////////////////////////////////////////////////////////////
+  static bool bindMemory(void* ptr, size_t bytes, int node_id);
+
+private:
+  std::vector<int> node_ids_;
+  std::vector< std::vector<unsigned int> > cpus_;
+};
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief Map zeroed, page aligned memory, see HostArray::allocate()
+/// \param[out] mapped_bytes The length to pass to releasePages()
+///////////////////////////////////////////////////////////////////////////////
+void* allocatePages(size_t bytes, int node_id, bool huge_pages, size_t* mapped_bytes);
+void releasePages(void* ptr, size_t mapped_bytes);
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief Page aligned storage which is not touched on allocation. The pages
+/// are placed when they are first written, so the thread initializing a
+/// range decides on which node the range lives. The storage can also be
+/// bound to a node and backed by transparent huge pages.
+///
+/// Used by HostMesh in place of std::vector for the partition data, the
+/// interface follows std::vector where the two overlap.
+///
+/// \tparam T A type which is valid when all bytes are zero
+///////////////////////////////////////////////////////////////////////////////
+template <typename T>
+class HostArray {
+public:
+  HostArray()
+  : data_(NULL),
+    size_(0),
+    bytes_(0)
+  {};
+
+  HostArray(const HostArray& other)
+  : data_(NULL),
+    size_(0),
+    bytes_(0)
+  {
+    this->assign(other.begin(), other.end());
+  }
+
+  HostArray& operator=(const HostArray& other) {
+    if(this != &other)
+      this->assign(other.begin(), other.end());
+    return *this;
+  }
+
+  ~HostArray() {this->clear();}
+
+  /////////////////////////////////////////////////////////////////////////////
+  /// \brief Allocate size elements without writing to them. The old
+  /// contents are released. The elements read as zero.
+  /// \param size The number of elements
+  /// \param node_id The node the pages are bound to, -1 for the default
+  /// first touch placement
+  /// \param huge_pages Back the storage with transparent huge pages
+  /////////////////////////////////////////////////////////////////////////////
+  void allocate(size_t size, int node_id = -1, bool huge_pages = false) {
+    this->clear();
+    if(size == 0)
+      return;
+    this->data_ = (T*)allocatePages(size*sizeof(T), node_id, huge_pages, &this->bytes_);
+    this->size_ = size;
+  }
+
+  void assign(size_t size, const T& value) {
+    this->allocate(size);
+    std::fill(this->begin(), this->end(), value);
+  }
+
+  void assign(const T* first, const T* last) {
+    this->allocate((size_t)(last-first));
+    std::copy(first, last, this->begin());
+  }
+
+  void clear() {
+    if(this->data_)
+      releasePages(this->data_, this->bytes_);
+    this->data_ = NULL;
+    this->size_ = 0;
+    this->bytes_ = 0;
+  }
+
+  void swap(HostArray& other) {
+    std::swap(this->data_, other.data_);
+    std::swap(this->size_, other.size_);
+    std::swap(this->bytes_, other.bytes_);
+  }
+
+  T& operator[](size_t i) {return this->data_[i];}
+  const T& operator[](size_t i) const {return this->data_[i];}
+  T& at(size_t i) {this->check(i); return this->data_[i];}
+  const T& at(size_t i) const {this->check(i); return this->data_[i];}
+
+  T* begin() {return this->data_;}
+  T* end() {return this->data_+this->size_;}
+  const T* begin() const {return this->data_;}
+  const T* end() const {return this->data_+this->size_;}
+  size_t size() const {return this->size_;}
+  bool empty() const {return this->size_ == 0;}
+
+private:
+  void check(size_t i) const {
+    if(i >= this->size_)
+      throw std::out_of_range("HostArray::at");
+  }
+
+  T* data_;
+  size_t size_;
+  size_t bytes_;    ///< The length of the mapping
+};
+
+#endif
@@ -0,0 +1,416 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// This file is a part of the PadallelFDTD Finite-Difference Time-Domain
+// simulation library. It is released under the MIT License. You should have
+// received a copy of the MIT License along with ParallelFDTD.  If not, see
+// http://www.opensource.org/licenses/mit-license.php
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// For details, see the LICENSE file
+//
+// (C) 2013-2014 Jukka Saarelma
+// Aalto University School of Science
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "hostStreamKernels3d.h"
+#include "hostKernels3d.h"
+
+#include <boost/thread.hpp>
+#include <boost/bind.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <string.h>
+#include <algorithm>
+#include <limits>
+
+namespace {
+
+// The slices of one slab in memory. The window holds the slab and
+// time_block ghost slices at both sides, the ghost slices are updated
+// redundantly and dropped after the slab has been stepped
+template <typename T>
+struct StreamWindow {
+  unsigned int first, last;            ///< Global slices held, [first, last)
+  unsigned int core_first, core_last;  ///< Global slices written back
+  std::vector<unsigned char> positions;
+  std::vector<unsigned char> materials;
+  std::vector<T> P;
+  std::vector<T> P_past;
+};
+
+struct StreamSource {
+  unsigned int x, y, z;    ///< Element coordinates in the domain
+  unsigned int source;     ///< Source index
+  bool hard;               ///< Hard sources overwrite the pressure
+};
+
+struct StreamReceiver {
+  unsigned int x, y, z;    ///< Element coordinates in the domain
+  unsigned int receiver;   ///< Receiver index
+};
+
+template <typename T>
+struct StreamContext {
+  HostStreamMesh<T>* mesh;
+  unsigned int num_steps;
+  unsigned int time_block;
+  unsigned int threads;
+  std::vector<unsigned int> slabs;     ///< First slice of each slab and dim_z
+
+  StreamWindow<T> windows[2];
+  StreamWindow<T>* current;
+  StreamWindow<T>* next;               ///< Read by the prefetch thread
+  boost::thread* prefetch;
+
+  // Both time levels of the top ghost slices of the next slab, taken
+  // before the current slab overwrites them in the files
+  std::vector<T> carry_P;
+  std::vector<T> carry_P_past;
+
+  boost::barrier* barrier;
+  bool stop;                           ///< Written by the leader only
+  unsigned int update_begin, update_end;  ///< Local slices of the current step
+
+  std::vector<StreamSource> sources;
+  std::vector<StreamReceiver> receivers;
+  const std::vector<T>* source_samples;  ///< num_sources*num_steps
+  T* h_return_ptr;
+
+  bool (*interruptCallback)(void);
+  void (*progressCallback)(int, int, float);
+};
+
+template <typename T>
+void setWindow(StreamContext<T>* ctx, StreamWindow<T>* w, unsigned int slab) {
+  unsigned int k = ctx->time_block;
+  unsigned int dim_z = ctx->mesh->getDimZ();
+  w->core_first = ctx->slabs.at(slab);
+  w->core_last = ctx->slabs.at(slab+1);
+  w->first = w->core_first > k ? w->core_first-k : 0;
+  w->last = std::min(w->core_last+k, dim_z);
+  size_t size = (size_t)(w->last-w->first)*ctx->mesh->getDimXY();
+  w->positions.resize(size);
+  w->materials.resize(size);
+  w->P.resize(size);
+  w->P_past.resize(size);
+}
+
+// Read a window from the files, the pressures from pressure_first up. The
+// pages read are dropped from the mapping, the window holds the copy
+template <typename T>
+void loadWindow(HostStreamMesh<T>* mesh, StreamWindow<T>* w, unsigned int pressure_first) {
+  size_t dim_xy = mesh->getDimXY();
+  size_t offset = w->first*dim_xy;
+  size_t size = (w->last-w->first)*dim_xy;
+  memcpy(&w->positions[0], mesh->getPositionIdxPtr()+offset, size);
+  memcpy(&w->materials[0], mesh->getMaterialIdxPtr()+offset, size);
+  mesh->getPositionFile().release(offset, size);
+  mesh->getMaterialFile().release(offset, size);
+
+  size_t local = (pressure_first-w->first)*dim_xy;
+  size_t count = size-local;
+  memcpy(&w->P[local], mesh->getPressurePtr()+offset+local, count*sizeof(T));
+  memcpy(&w->P_past[local], mesh->getPastPressurePtr()+offset+local, count*sizeof(T));
+  mesh->getPressureFile().release((offset+local)*sizeof(T), count*sizeof(T));
+  mesh->getPastPressureFile().release((offset+local)*sizeof(T), count*sizeof(T));
+}
+
+// Bring the window of a slab to memory and start reading the next one
+template <typename T>
+void prepareSlab(StreamContext<T>* ctx, unsigned int slab) {
+  HostStreamMesh<T>* mesh = ctx->mesh;
+  size_t dim_xy = mesh->getDimXY();
+
+  if(ctx->prefetch) {
+    ctx->prefetch->join();
+    delete ctx->prefetch;
+    ctx->prefetch = (boost::thread*)NULL;
+    std::swap(ctx->current, ctx->next);
+  }
+  else {
+    setWindow(ctx, ctx->current, slab);
+    loadWindow(mesh, ctx->current, slab > 0 ? ctx->current->core_first : ctx->current->first);
+  }
+
+  // The bottom ghost slices were written back by the previous slab
+  StreamWindow<T>* w = ctx->current;
+  if(slab > 0) {
+    std::copy(ctx->carry_P.begin(), ctx->carry_P.end(), w->P.begin());
+    std::copy(ctx->carry_P_past.begin(), ctx->carry_P_past.end(), w->P_past.begin());
+  }
+
+  if(slab+1 < ctx->slabs.size()-1) {
+    size_t offset = (w->core_last-ctx->time_block-w->first)*dim_xy;
+    size_t size = ctx->time_block*dim_xy;
+    ctx->carry_P.assign(w->P.begin()+offset, w->P.begin()+offset+size);
+    ctx->carry_P_past.assign(w->P_past.begin()+offset, w->P_past.begin()+offset+size);
+
+    setWindow(ctx, ctx->next, slab+1);
+    ctx->prefetch = new boost::thread(boost::bind(&loadWindow<T>, mesh, ctx->next,
+                                                  ctx->next->core_first));
+  }
+}
+
+// Write the slab of the window back to the files
+template <typename T>
+void writeBack(StreamContext<T>* ctx) {
+  HostStreamMesh<T>* mesh = ctx->mesh;
+  StreamWindow<T>* w = ctx->current;
+  size_t dim_xy = mesh->getDimXY();
+  size_t offset = w->core_first*dim_xy;
+  size_t local = (w->core_first-w->first)*dim_xy;
+  size_t size = (w->core_last-w->core_first)*dim_xy;
+  memcpy(mesh->getPressurePtr()+offset, &w->P[local], size*sizeof(T));
+  memcpy(mesh->getPastPressurePtr()+offset, &w->P_past[local], size*sizeof(T));
+  mesh->getPressureFile().release(offset*sizeof(T), size*sizeof(T));
+  mesh->getPastPressureFile().release(offset*sizeof(T), size*sizeof(T));
+}
+
+// Inject the sources held by the window and set the slices updated on the
+// inner step. The valid ghost slices shrink by one slice each step
+template <typename T>
+void prepareStep(StreamContext<T>* ctx, unsigned int step, unsigned int inner_step) {
+  StreamWindow<T>* w = ctx->current;
+  HostStreamMesh<T>* mesh = ctx->mesh;
+  for(unsigned int i = 0; i < ctx->sources.size(); i++) {
+    const StreamSource& src = ctx->sources[i];
+    if(src.z < w->first || src.z >= w->last)
+      continue;
+    size_t elem = mesh->getElementIndex(src.x, src.y, src.z-w->first);
+    T sample = (*ctx->source_samples)[src.source*ctx->num_steps+step];
+    if(src.hard)
+      w->P[elem] = sample;
+    else
+      w->P[elem] += sample;
+  }
+
+  unsigned int size = w->last-w->first;
+  ctx->update_begin = w->first == 0 ? 1 : 1+inner_step;
+  ctx->update_end = w->last == mesh->getDimZ() ? size-1 : size-1-inner_step;
+}
+
+template <typename T>
+void finishStep(StreamContext<T>* ctx, unsigned int step) {
+  StreamWindow<T>* w = ctx->current;
+  w->P.swap(w->P_past);
+  for(unsigned int i = 0; i < ctx->receivers.size(); i++) {
+    const StreamReceiver& rec = ctx->receivers[i];
+    if(rec.z < w->core_first || rec.z >= w->core_last)
+      continue;
+    ctx->h_return_ptr[rec.receiver*ctx->num_steps+step] =
+      w->P[ctx->mesh->getElementIndex(rec.x, rec.y, rec.z-w->first)];
+  }
+}
+
+template <typename T>
+void streamWorker(StreamContext<T>* ctx, unsigned int rank) {
+  HostStreamMesh<T>* mesh = ctx->mesh;
+  bool leader = (rank == 0);
+  unsigned int num_slabs = (unsigned int)ctx->slabs.size()-1;
+  boost::posix_time::ptime sweep_start;
+
+  for(unsigned int step = 0; step < ctx->num_steps; step += ctx->time_block) {
+    unsigned int steps = std::min(ctx->time_block, ctx->num_steps-step);
+    if(leader)
+      sweep_start = boost::posix_time::microsec_clock::local_time();
+
+    for(unsigned int slab = 0; slab < num_slabs; slab++) {
+      if(leader) {
+        if(slab == 0 && ctx->interruptCallback()) {
+          log_msg<LOG_INFO>(L"launchFDTD3dHostStream - interrupted at step %u") %step;
+          ctx->stop = true;
+        }
+        else {
+          prepareSlab(ctx, slab);
+        }
+      }
+      ctx->barrier->wait();
+      if(ctx->stop)
+        return;
+
+      for(unsigned int i = 0; i < steps; i++) {
+        if(leader)
+          prepareStep(ctx, step+i, i);
+        ctx->barrier->wait();
+
+        StreamWindow<T>* w = ctx->current;
+        unsigned int count = ctx->update_end-ctx->update_begin;
+        fdtd3dHostSlices<T>(&w->positions[0], &w->materials[0], &w->P[0], &w->P_past[0],
+                            mesh->getParameterPtr(), mesh->getMaterialPtr(),
+                            mesh->getDimXY(), mesh->getDimX(), mesh->getDimY(),
+                            ctx->update_begin+(count*rank)/ctx->threads,
+                            ctx->update_begin+(count*(rank+1))/ctx->threads,
+                            mesh->getUpdateType());
+        ctx->barrier->wait();
+
+        if(leader)
+          finishStep(ctx, step+i);
+      }
+
+      if(leader)
+        writeBack(ctx);
+    }
+
+    if(leader) {
+      boost::posix_time::time_duration d =
+        boost::posix_time::microsec_clock::local_time()-sweep_start;
+      ctx->progressCallback(step, ctx->num_steps, (float)d.total_microseconds()/1e6f/steps);
+    }
+  }
+}
+
+template <typename T>
+float launchStream(HostStreamMesh<T>* mesh,
+                   SimulationParameters* sp,
+                   T* h_return_ptr,
+                   const std::vector<T>& source_samples,
+                   bool (*interruptCallback)(void),
+                   void (*progressCallback)(int, int, float),
+                   unsigned int slab_slices,
+                   unsigned int time_block,
+                   unsigned int threads) {
+  boost::posix_time::ptime start = boost::posix_time::microsec_clock::local_time();
+
+  unsigned int dim_z = mesh->getDimZ();
+  unsigned int num_steps = sp->getNumSteps();
+  if(time_block == 0)
+    time_block = 1;
+  if(threads == 0)
+    threads = 1;
+  slab_slices = std::max(slab_slices, time_block);
+
+  // The slabs are at least slab_slices thick, the last one takes the rest
+  unsigned int num_slabs = std::max(dim_z/slab_slices, 1u);
+  StreamContext<T> ctx;
+  unsigned int thickest = 0;
+  for(unsigned int i = 0; i <= num_slabs; i++) {
+    ctx.slabs.push_back((unsigned int)(((size_t)dim_z*i)/num_slabs));
+    if(i > 0)
+      thickest = std::max(thickest, ctx.slabs.at(i)-ctx.slabs.at(i-1));
+  }
+
+  // The kernel indexes the window with 32 bits
+  size_t window = (size_t)(thickest+2*time_block)*mesh->getDimXY();
+  if(window > (size_t)std::numeric_limits<unsigned int>::max()) {
+    log_msg<LOG_ERROR>(L"launchFDTD3dHostStream - window of %u slices too large, "
+                       L"use thinner slabs") %(unsigned int)(window/mesh->getDimXY());
+    throw(-1);
+  }
+
+  log_msg<LOG_INFO>(L"launchFDTD3dHostStream - begin, %u slabs of %u slices, time block %u, "
+                    L"%u threads, %u steps") %num_slabs %(dim_z/num_slabs) %time_block
+                    %threads %num_steps;
+
+  boost::barrier barrier(threads);
+  ctx.mesh = mesh;
+  ctx.num_steps = num_steps;
+  ctx.time_block = time_block;
+  ctx.threads = threads;
+  ctx.current = &ctx.windows[0];
+  ctx.next = &ctx.windows[1];
+  ctx.prefetch = (boost::thread*)NULL;
+  ctx.barrier = &barrier;
+  ctx.stop = false;
+  ctx.update_begin = 0;
+  ctx.update_end = 0;
+  ctx.source_samples = &source_samples;
+  ctx.h_return_ptr = h_return_ptr;
+  ctx.interruptCallback = interruptCallback;
+  ctx.progressCallback = progressCallback;
+
+  if(sp->getNumArraySources() > 0) {
+    log_msg<LOG_ERROR>(L"launchFDTD3dHostStream - array sources are not supported");
+    throw(-1);
+  }
+  if(sp->hasMovingPositions()) {
+    log_msg<LOG_ERROR>(L"launchFDTD3dHostStream - moving sources and receivers are not supported");
+    throw(-1);
+  }
+  if(sp->hasBFormatReceivers()) {
+    log_msg<LOG_ERROR>(L"launchFDTD3dHostStream - B-format receivers are not supported");
+    throw(-1);
+  }
+
+  for(unsigned int s = 0; s < sp->getNumSources(); s++) {
+    nv::Vec3i pos = sp->getSourceElementCoordinates(s);
+    StreamSource src;
+    src.x = pos.x;
+    src.y = pos.y;
+    src.z = pos.z;
+    src.source = s;
+    src.hard = (sp->getSource(s).getSourceType() == SRC_HARD);
+    ctx.sources.push_back(src);
+  }
+
+  for(unsigned int r = 0; r < sp->getNumReceivers(); r++) {
+    nv::Vec3i pos = sp->getReceiverElementCoordinates(r);
+    if(pos.x < 0 || pos.y < 0 || pos.z < 0 || (unsigned int)pos.x >= mesh->getDimX() ||
+       (unsigned int)pos.y >= mesh->getDimY() || (unsigned int)pos.z >= dim_z) {
+      log_msg<LOG_WARNING>(L"launchFDTD3dHostStream - receiver %u outside of the domain") %r;
+      continue;
+    }
+    StreamReceiver rec;
+    rec.x = pos.x;
+    rec.y = pos.y;
+    rec.z = pos.z;
+    rec.receiver = r;
+    ctx.receivers.push_back(rec);
+  }
+
+  boost::thread_group workers;
+  for(unsigned int r = 0; r < threads; r++)
+    workers.create_thread(boost::bind(&streamWorker<T>, &ctx, r));
+  workers.join_all();
+
+  boost::posix_time::time_duration d = boost::posix_time::microsec_clock::local_time()-start;
+  float seconds = (float)d.total_microseconds()/1e6f;
+  float per_step = num_steps > 0 ? seconds/(float)num_steps : 0.f;
+  log_msg<LOG_INFO>(L"launchFDTD3dHostStream - time: %f seconds, per step: %f")
+                    %seconds %per_step;
+  return per_step;
+}
+
+} // namespace
+
+float launchFDTD3dHostStream(HostStreamMesh<float>* mesh,
+                             SimulationParameters* sp,
+                             float* h_return_ptr,
+                             bool (*interruptCallback)(void),
+                             void (*progressCallback)(int, int, float),
+                             unsigned int slab_slices,
+                             unsigned int time_block,
+                             unsigned int threads) {
+  unsigned int num_steps = sp->getNumSteps();
+  std::vector<float> samples(sp->getNumSources()*num_steps, 0.f);
+  for(unsigned int s = 0; s < sp->getNumSources(); s++)
+    for(unsigned int i = 0; i < num_steps; i++)
+      samples.at(s*num_steps+i) = sp->getSourceSample(s, i);
+
+  return launchStream<float>(mesh, sp, h_return_ptr, samples, interruptCallback,
+                             progressCallback, slab_slices, time_block, threads);
+}
+
+float launchFDTD3dHostStreamDouble(HostStreamMesh<double>* mesh,
+                                   SimulationParameters* sp,
+                                   double* h_return_ptr,
+                                   bool (*interruptCallback)(void),
+                                   void (*progressCallback)(int, int, float),
+                                   unsigned int slab_slices,
+                                   unsigned int time_block,
+                                   unsigned int threads) {
+  unsigned int num_steps = sp->getNumSteps();
+  std::vector<double> samples(sp->getNumSources()*num_steps, 0.0);
+  for(unsigned int s = 0; s < sp->getNumSources(); s++)
+    for(unsigned int i = 0; i < num_steps; i++)
+      samples.at(s*num_steps+i) = sp->getSourceSampleDouble(s, i);
+
+  return launchStream<double>(mesh, sp, h_return_ptr, samples, interruptCallback,
+                              progressCallback, slab_slices, time_block, threads);
+}
@@ -0,0 +1,75 @@
+#ifndef HOST_STREAM_KERNELS_3D_H
+#define HOST_STREAM_KERNELS_3D_H
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// This file is a part of the PadallelFDTD Finite-Difference Time-Domain
+// simulation library. It is released under the MIT License. You should have
+// received a copy of the MIT License along with ParallelFDTD.  If not, see
+// http://www.opensource.org/licenses/mit-license.php
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// For details, see the LICENSE file
+//
+// (C) 2013-2014 Jukka Saarelma
+// Aalto University School of Science
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "hostStreamMesh.h"
+#include "../base/SimulationParameters.h"
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief Launch a predefined number of FDTD steps in single precision on a
+/// domain kept in memory mapped files. The domain is swept bottom to top
+/// in z-slabs. Each slab is loaded with time_block ghost slices on both
+/// sides and stepped time_block steps in memory before its slices are
+/// written back, so the files are read and written once per time_block
+/// steps. The ghost slices shared with the previous slab are kept in
+/// memory, and the next slab is read by a background thread while the
+/// current one is stepped.
+///
+/// The working set is two windows of slab_slices+2*time_block slices.
+/// \param[in] mesh HostStreamMesh containing the simulation domain
+/// \param[in] sp The simulation parameters of the simulation
+/// \param[in, out] h_return_ptr Return values of the simulation,
+/// num_receivers*num_steps
+/// \param interruptCallback Called between each sweep over the slabs to
+/// check if the simulation is interrupted by the user
+/// \param progressCallback Called after each sweep over the slabs
+/// \param slab_slices The number of slices written back from each slab, at
+/// least time_block
+/// \param time_block The number of steps taken on each slab
+/// \param threads The number of threads updating a slab
+/// \return The average time per step in seconds
+///////////////////////////////////////////////////////////////////////////////
+float launchFDTD3dHostStream(HostStreamMesh<float>* mesh,
+                             SimulationParameters* sp,
+                             float* h_return_ptr,
+                             bool (*interruptCallback)(void),
+                             void (*progressCallback)(int, int, float),
+                             unsigned int slab_slices,
+                             unsigned int time_block,
+                             unsigned int threads);
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief Launch a predefined number of FDTD steps in double precision on a
+/// domain kept in memory mapped files, see launchFDTD3dHostStream()
+///////////////////////////////////////////////////////////////////////////////
+float launchFDTD3dHostStreamDouble(HostStreamMesh<double>* mesh,
+                                   SimulationParameters* sp,
+                                   double* h_return_ptr,
+                                   bool (*interruptCallback)(void),
+                                   void (*progressCallback)(int, int, float),
+                                   unsigned int slab_slices,
+                                   unsigned int time_block,
+                                   unsigned int threads);
+
+#endif
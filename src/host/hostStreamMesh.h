@@ -0,0 +1,171 @@
+#ifndef HOST_STREAM_MESH_H
+#define HOST_STREAM_MESH_H
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// This file is a part of the PadallelFDTD Finite-Difference Time-Domain
+// simulation library. It is released under the MIT License. You should have
+// received a copy of the MIT License along with ParallelFDTD.  If not, see
+// http://www.opensource.org/licenses/mit-license.php
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// For details, see the LICENSE file
+//
+// (C) 2013-2014 Jukka Saarelma
+// Aalto University School of Science
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "../io/MappedFile.h"
+#include "../base/MaterialHandler.h"
+#include "../logger.h"
+#include "../global_includes.h"
+#include <vector>
+#include <string>
+#include <string.h>
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief Simulation domain kept in memory mapped files for domains larger
+/// than the main memory. The position and material indices and both time
+/// levels of the pressure are each held in a file, the solver streams
+/// windows of z-slices through memory, see launchFDTD3dHostStream().
+///
+/// \tparam T The precision of the pressure values, float / double
+///////////////////////////////////////////////////////////////////////////////
+template <typename T>
+class HostStreamMesh {
+public:
+  HostStreamMesh()
+  : dim_x_(0),
+    dim_y_(0),
+    dim_z_(0),
+    dim_xy_(0),
+    update_type_(0),
+    number_of_unique_materials_(0)
+  {};
+
+  ~HostStreamMesh() {};
+
+  /////////////////////////////////////////////////////////////////////////////
+  /// \brief Create the files of an empty domain. The indices are filled with
+  /// writeSlices(), the pressures start at zero
+  /// \param path_prefix The files are named path_prefix followed by
+  /// _positions.bin, _materials.bin, _pressure.bin and _pressure_past.bin
+  /// \param dim_x, dim_y, dim_z The dimensions of the domain
+  /// \param material_coefs Material coefficients, MATERIAL_COEF_NUM per material
+  /// \param number_of_unique_materials The number of materials
+  /// \param params The simulation parameters, see SimulationParameters::getParameterPtr()
+  /// \param update_type The update scheme, enum UpdateType
+  /// \param keep_files Leave the files on the disk when the mesh is destroyed
+  /////////////////////////////////////////////////////////////////////////////
+  void setupMesh(const std::string& path_prefix,
+                 unsigned int dim_x, unsigned int dim_y, unsigned int dim_z,
+                 const T* material_coefs,
+                 unsigned int number_of_unique_materials,
+                 const T* params,
+                 unsigned int update_type,
+                 bool keep_files = false) {
+    this->dim_x_ = dim_x;
+    this->dim_y_ = dim_y;
+    this->dim_z_ = dim_z;
+    this->dim_xy_ = dim_x*dim_y;
+    this->update_type_ = update_type;
+    this->number_of_unique_materials_ = number_of_unique_materials;
+    this->materials_.assign(material_coefs,
+                            material_coefs+number_of_unique_materials*MATERIAL_COEF_NUM);
+    this->parameters_.assign(params, params+4);
+
+    size_t num_elements = this->getNumberOfElements();
+    if(!this->position_file_.create(path_prefix+"_positions.bin", num_elements, !keep_files) ||
+       !this->material_file_.create(path_prefix+"_materials.bin", num_elements, !keep_files) ||
+       !this->pressure_file_.create(path_prefix+"_pressure.bin",
+                                    num_elements*sizeof(T), !keep_files) ||
+       !this->pressure_past_file_.create(path_prefix+"_pressure_past.bin",
+                                         num_elements*sizeof(T), !keep_files)) {
+      log_msg<LOG_ERROR>(L"HostStreamMesh::setupMesh - can not create the files of %s")
+                         %path_prefix.c_str();
+      throw(-1);
+    }
+
+    log_msg<LOG_INFO>(L"HostStreamMesh::setupMesh - dim %u %u %u, %u materials, update type %u")
+                      %dim_x %dim_y %dim_z %number_of_unique_materials %update_type;
+  }
+
+  /////////////////////////////////////////////////////////////////////////////
+  /// \brief Write the position and material indices of a range of slices
+  /// \param first_slice The first slice written
+  /// \param number_of_slices The number of slices
+  /// \param position_idx, material_idx The indices, number_of_slices*dim_xy
+  /////////////////////////////////////////////////////////////////////////////
+  void writeSlices(unsigned int first_slice, unsigned int number_of_slices,
+                   const unsigned char* position_idx, const unsigned char* material_idx) {
+    size_t offset = (size_t)first_slice*this->dim_xy_;
+    size_t size = (size_t)number_of_slices*this->dim_xy_;
+    memcpy(this->getPositionIdxPtr()+offset, position_idx, size);
+    memcpy(this->getMaterialIdxPtr()+offset, material_idx, size);
+    this->position_file_.release(offset, size);
+    this->material_file_.release(offset, size);
+  }
+
+  void resetPressures() {
+    size_t bytes = this->getNumberOfElements()*sizeof(T);
+    memset(this->pressure_file_.getPtr(), 0, bytes);
+    memset(this->pressure_past_file_.getPtr(), 0, bytes);
+    this->pressure_file_.release(0, bytes);
+    this->pressure_past_file_.release(0, bytes);
+  }
+
+  unsigned char* getPositionIdxPtr() {return (unsigned char*)this->position_file_.getPtr();}
+  unsigned char* getMaterialIdxPtr() {return (unsigned char*)this->material_file_.getPtr();}
+  T* getPressurePtr() {return (T*)this->pressure_file_.getPtr();}
+  T* getPastPressurePtr() {return (T*)this->pressure_past_file_.getPtr();}
+  const T* getMaterialPtr() const {return &(this->materials_[0]);}
+  const T* getParameterPtr() const {return &(this->parameters_[0]);}
+
+  MappedFile& getPositionFile() {return this->position_file_;}
+  MappedFile& getMaterialFile() {return this->material_file_;}
+  MappedFile& getPressureFile() {return this->pressure_file_;}
+  MappedFile& getPastPressureFile() {return this->pressure_past_file_;}
+
+  unsigned int getDimX() const {return this->dim_x_;}
+  unsigned int getDimY() const {return this->dim_y_;}
+  unsigned int getDimZ() const {return this->dim_z_;}
+  unsigned int getDimXY() const {return this->dim_xy_;}
+  unsigned int getUpdateType() const {return this->update_type_;}
+  unsigned int getNumberOfUniqueMaterials() const {return this->number_of_unique_materials_;}
+  size_t getNumberOfElements() const {return (size_t)this->dim_xy_*this->dim_z_;}
+
+  inline size_t getElementIndex(unsigned int x, unsigned int y, unsigned int z) const {
+    return (size_t)this->dim_xy_*z+this->dim_x_*y+x;
+  }
+
+  /// \return The current pressure at the given node
+  T getSample(unsigned int x, unsigned int y, unsigned int z) {
+    return this->getPressurePtr()[this->getElementIndex(x, y, z)];
+  }
+
+private:
+  unsigned int dim_x_;
+  unsigned int dim_y_;
+  unsigned int dim_z_;
+  unsigned int dim_xy_;
+  unsigned int update_type_;
+  unsigned int number_of_unique_materials_;
+
+  std::vector<T> materials_;                  ///< Material coefficients
+  std::vector<T> parameters_;                 ///< Simulation parameters
+
+  MappedFile position_file_;
+  MappedFile material_file_;
+  MappedFile pressure_file_;                  ///< Pressure of the current step
+  MappedFile pressure_past_file_;             ///< Pressure of the past step
+};
+
+#endif
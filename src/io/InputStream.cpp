@@ -0,0 +1,190 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// This file is a part of the PadallelFDTD Finite-Difference Time-Domain
+// simulation library. It is released under the MIT License. You should have
+// received a copy of the MIT License along with ParallelFDTD.  If not, see
+// http://www.opensource.org/licenses/mit-license.php
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// For details, see the LICENSE file
+//
+// (C) 2013-2014 Jukka Saarelma
+// Aalto University School of Science
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "InputStream.h"
+#include "../base/StateHash.h"
+#include "../logger.h"
+#include <string.h>
+#include <algorithm>
+
+namespace {
+  unsigned int readU16(const unsigned char* p) {return (unsigned int)p[0]|((unsigned int)p[1]<<8);}
+  unsigned int readU32(const unsigned char* p) {return readU16(p)|(readU16(p+2)<<16);}
+}
+
+InputStream::InputStream()
+: data_offset_(0),
+  num_samples_(0),
+  num_channels_(1),
+  channel_(0),
+  sample_rate_(0),
+  bytes_per_sample_(4),
+  is_float_(true),
+  buffer_first_(0),
+  buffer_size_(0),
+  released_(0)
+{}
+
+bool InputStream::open(const std::string& path, enum InputStreamFormat format,
+                       unsigned int channel, unsigned int lookahead) {
+  this->buffer_size_ = 0;
+  this->buffer_first_ = 0;
+  this->released_ = 0;
+  this->buffer_.assign(std::max(lookahead, 1u), 0.0);
+  if(!this->file_.open(path))
+    return false;
+
+  this->data_offset_ = 0;
+  this->num_channels_ = 1;
+  this->sample_rate_ = 0;
+  this->is_float_ = true;
+  this->bytes_per_sample_ = (format == STREAM_RAW_DOUBLE) ? 8 : 4;
+  if(format == STREAM_WAV && !this->parseWav()) {
+    this->file_.close();
+    return false;
+  }
+
+  if(channel >= this->num_channels_) {
+    log_msg<LOG_ERROR>(L"InputStream::open - %s has %u channels, channel %u requested")
+                       %path.c_str() %this->num_channels_ %channel;
+    this->file_.close();
+    return false;
+  }
+  this->channel_ = channel;
+
+  size_t frame = (size_t)this->bytes_per_sample_*this->num_channels_;
+  if(format != STREAM_WAV)
+    this->num_samples_ = this->file_.getSize()/frame;
+  log_msg<LOG_INFO>(L"InputStream::open - %s, %u samples, %u channels")
+                    %path.c_str() %(unsigned int)this->num_samples_ %this->num_channels_;
+  this->file_.willNeed(this->data_offset_, this->buffer_.size()*frame);
+  return true;
+}
+
+bool InputStream::parseWav() {
+  const unsigned char* p = (const unsigned char*)this->file_.getPtr();
+  size_t size = this->file_.getSize();
+  if(size < 12 || memcmp(p, "RIFF", 4) != 0 || memcmp(p+8, "WAVE", 4) != 0) {
+    log_msg<LOG_ERROR>(L"InputStream::parseWav - %s is not a WAV file")
+                       %this->file_.getPath().c_str();
+    return false;
+  }
+
+  bool has_format = false;
+  size_t pos = 12;
+  while(pos+8 <= size) {
+    size_t chunk = readU32(p+pos+4);
+    const unsigned char* body = p+pos+8;
+    if(memcmp(p+pos, "fmt ", 4) == 0 && chunk >= 16 && pos+8+chunk <= size) {
+      unsigned int tag = readU16(body);
+      this->num_channels_ = readU16(body+2);
+      this->sample_rate_ = readU32(body+4);
+      unsigned int bits = readU16(body+14);
+      // The extensible format keeps the actual tag in the sub format
+      if(tag == 0xFFFE && chunk >= 26)
+        tag = readU16(body+24);
+      this->is_float_ = (tag == 3);
+      this->bytes_per_sample_ = bits/8;
+      bool pcm = (tag == 1 && (bits == 16 || bits == 24 || bits == 32));
+      bool ieee = (tag == 3 && (bits == 32 || bits == 64));
+      if((!pcm && !ieee) || this->num_channels_ == 0) {
+        log_msg<LOG_ERROR>(L"InputStream::parseWav - unsupported format %u, %u bits")
+                           %tag %bits;
+        return false;
+      }
+      has_format = true;
+    }
+    if(memcmp(p+pos, "data", 4) == 0 && has_format) {
+      this->data_offset_ = pos+8;
+      size_t bytes = std::min(chunk, size-this->data_offset_);
+      this->num_samples_ = bytes/((size_t)this->bytes_per_sample_*this->num_channels_);
+      return true;
+    }
+    // The chunks are padded to an even size
+    pos += 8+chunk+(chunk&1);
+  }
+
+  log_msg<LOG_ERROR>(L"InputStream::parseWav - no data in %s") %this->file_.getPath().c_str();
+  return false;
+}
+
+double InputStream::convert(size_t i) const {
+  size_t frame = (size_t)this->bytes_per_sample_*this->num_channels_;
+  const unsigned char* p = (const unsigned char*)this->file_.getPtr()+this->data_offset_+
+                           i*frame+(size_t)this->channel_*this->bytes_per_sample_;
+  if(this->is_float_) {
+    if(this->bytes_per_sample_ == 8) {
+      double v;
+      memcpy(&v, p, 8);
+      return v;
+    }
+    float v;
+    memcpy(&v, p, 4);
+    return (double)v;
+  }
+
+  // PCM is little endian and signed
+  if(this->bytes_per_sample_ == 2)
+    return (double)(short)readU16(p)/32768.0;
+  if(this->bytes_per_sample_ == 3) {
+    int v = (int)(((unsigned int)p[0]<<8)|((unsigned int)p[1]<<16)|((unsigned int)p[2]<<24))>>8;
+    return (double)v/8388608.0;
+  }
+  return (double)(int)readU32(p)/2147483648.0;
+}
+
+void InputStream::fill(size_t first) {
+  size_t frame = (size_t)this->bytes_per_sample_*this->num_channels_;
+  size_t count = std::min(this->buffer_.size(), this->num_samples_-first);
+  for(size_t i = 0; i < count; i++)
+    this->buffer_[i] = this->convert(first+i);
+  this->buffer_first_ = first;
+  this->buffer_size_ = count;
+
+  // Read the next chunk ahead and drop the pages already consumed
+  this->file_.willNeed(this->data_offset_+(first+count)*frame, this->buffer_.size()*frame);
+  if(first > this->released_) {
+    this->file_.release(this->data_offset_+this->released_*frame, (first-this->released_)*frame);
+    this->released_ = first;
+  }
+}
+
+double InputStream::getSample(size_t i) {
+  if(!this->file_.isOpen() || i >= this->num_samples_)
+    return 0.0;
+  if(i < this->buffer_first_ || i >= this->buffer_first_+this->buffer_size_)
+    this->fill(i);
+  return this->buffer_[i-this->buffer_first_];
+}
+
+void InputStream::hashState(StateHash& hash) const {
+  // The bytes of the file identify the samples with the format, channel
+  // and sample layout found in it
+  hash.addValue(this->num_samples_);
+  hash.addValue(this->num_channels_);
+  hash.addValue(this->channel_);
+  hash.addValue(this->bytes_per_sample_);
+  hash.addValue(this->is_float_);
+  if(this->file_.isOpen())
+    hash.add(this->file_.getPtr()+this->data_offset_,
+             this->num_samples_*this->num_channels_*this->bytes_per_sample_);
+}
@@ -0,0 +1,102 @@
+#ifndef INPUT_STREAM_H
+#define INPUT_STREAM_H
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// This file is a part of the PadallelFDTD Finite-Difference Time-Domain
+// simulation library. It is released under the MIT License. You should have
+// received a copy of the MIT License along with ParallelFDTD.  If not, see
+// http://www.opensource.org/licenses/mit-license.php
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// For details, see the LICENSE file
+//
+// (C) 2013-2014 Jukka Saarelma
+// Aalto University School of Science
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "MappedFile.h"
+#include <string>
+#include <vector>
+#include <stddef.h>
+
+class StateHash;
+
+enum InputStreamFormat {STREAM_WAV, STREAM_RAW_FLOAT, STREAM_RAW_DOUBLE};
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief A long input signal read from a memory mapped file. The samples
+/// are converted to a lookahead buffer in chunks as the signal is read
+/// forward, the next chunk is prefetched and the pages behind the buffer
+/// are released, so the memory used does not grow with the length of the
+/// signal.
+///
+/// Raw files hold native endian float or double samples. WAV files can be
+/// 16, 24 or 32 bit PCM or 32 or 64 bit float, one channel is read.
+///////////////////////////////////////////////////////////////////////////////
+class InputStream {
+public:
+  InputStream();
+  ~InputStream() {};
+
+  /////////////////////////////////////////////////////////////////////////////
+  /// \brief Open a signal file
+  /// \param path The path of the file
+  /// \param format The format of the file
+  /// \param channel The channel read from a multichannel WAV file
+  /// \param lookahead The number of samples in the buffer
+  /// \return false if the file can not be read
+  /////////////////////////////////////////////////////////////////////////////
+  bool open(const std::string& path, enum InputStreamFormat format,
+            unsigned int channel = 0, unsigned int lookahead = 1<<16);
+
+  /////////////////////////////////////////////////////////////////////////////
+  /// \brief Returns a sample of the signal. Reading forward is cheap, a
+  /// sample outside the buffer refills it starting from the sample.
+  /// \param i The index of the sample
+  /// \return The sample, 0 after the end of the signal
+  /////////////////////////////////////////////////////////////////////////////
+  double getSample(size_t i);
+
+  size_t getNumSamples() const {return this->num_samples_;}
+  unsigned int getNumChannels() const {return this->num_channels_;}
+  unsigned int getSampleRate() const {return this->sample_rate_;}
+  const std::string& getPath() const {return this->file_.getPath();}
+
+  /// \brief Add the samples of the channel read to a hash, the whole file
+  /// is read through
+  void hashState(StateHash& hash) const;
+
+private:
+  // Not copyable, the mapping has a single owner
+  InputStream(const InputStream&);
+  InputStream& operator=(const InputStream&);
+
+  bool parseWav();
+  void fill(size_t first);
+  double convert(size_t i) const;
+
+  MappedFile file_;
+  size_t data_offset_;           ///< Byte offset of the first sample
+  size_t num_samples_;           ///< Samples in one channel
+  unsigned int num_channels_;
+  unsigned int channel_;
+  unsigned int sample_rate_;     ///< 0 for raw files
+  unsigned int bytes_per_sample_;
+  bool is_float_;
+
+  std::vector<double> buffer_;   ///< The lookahead buffer
+  size_t buffer_first_;          ///< The sample at the beginning of the buffer
+  size_t buffer_size_;           ///< The valid samples in the buffer
+  size_t released_;              ///< Samples whose pages are released
+};
+
+#endif
@@ -0,0 +1,154 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// This file is a part of the PadallelFDTD Finite-Difference Time-Domain
+// simulation library. It is released under the MIT License. You should have
+// received a copy of the MIT License along with ParallelFDTD.  If not, see
+// http://www.opensource.org/licenses/mit-license.php
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// For details, see the LICENSE file
+//
+// (C) 2013-2014 Jukka Saarelma
+// Aalto University School of Science
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "MappedFile.h"
+#include "../logger.h"
+#include <algorithm>
+
+#ifndef WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdio.h>
+#endif
+
+namespace {
+#ifndef WIN32
+  // madvise needs a page aligned start
+  void pageRange(size_t offset, size_t bytes, size_t size, size_t* begin, size_t* length) {
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t end = std::min(offset+bytes, size);
+    *begin = offset/page*page;
+    *length = end > *begin ? end-*begin : 0;
+  }
+#endif
+}
+
+MappedFile::MappedFile()
+: data_(NULL),
+  size_(0),
+  fd_(-1),
+  remove_on_close_(false)
+{}
+
+MappedFile::~MappedFile() {
+  this->close();
+}
+
+bool MappedFile::create(const std::string& path, size_t bytes, bool remove_on_close) {
+  this->close();
+#ifdef WIN32
+  log_msg<LOG_ERROR>(L"MappedFile::create - not available on Windows");
+  return false;
+#else
+  int fd = ::open(path.c_str(), O_RDWR|O_CREAT|O_TRUNC, 0644);
+  if(fd == -1 || ftruncate(fd, (off_t)bytes) != 0) {
+    log_msg<LOG_ERROR>(L"MappedFile::create - can not create %s of %u MB")
+                       %path.c_str() %(unsigned int)(bytes>>20);
+    if(fd != -1) ::close(fd);
+    return false;
+  }
+
+  void* data = bytes > 0 ? mmap(NULL, bytes, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0) : NULL;
+  if(data == MAP_FAILED) {
+    log_msg<LOG_ERROR>(L"MappedFile::create - can not map %s") %path.c_str();
+    ::close(fd);
+    unlink(path.c_str());
+    return false;
+  }
+
+  this->path_ = path;
+  this->data_ = (char*)data;
+  this->size_ = bytes;
+  this->fd_ = fd;
+  this->remove_on_close_ = remove_on_close;
+  log_msg<LOG_DEBUG>(L"MappedFile::create - %s, %u MB") %path.c_str() %(unsigned int)(bytes>>20);
+  return true;
+#endif
+}
+
+bool MappedFile::open(const std::string& path) {
+  this->close();
+#ifdef WIN32
+  log_msg<LOG_ERROR>(L"MappedFile::open - not available on Windows");
+  return false;
+#else
+  int fd = ::open(path.c_str(), O_RDONLY);
+  struct stat st;
+  if(fd == -1 || fstat(fd, &st) != 0) {
+    log_msg<LOG_ERROR>(L"MappedFile::open - can not open %s") %path.c_str();
+    if(fd != -1) ::close(fd);
+    return false;
+  }
+
+  size_t bytes = (size_t)st.st_size;
+  void* data = bytes > 0 ? mmap(NULL, bytes, PROT_READ, MAP_SHARED, fd, 0) : NULL;
+  if(data == MAP_FAILED) {
+    log_msg<LOG_ERROR>(L"MappedFile::open - can not map %s") %path.c_str();
+    ::close(fd);
+    return false;
+  }
+
+  this->path_ = path;
+  this->data_ = (char*)data;
+  this->size_ = bytes;
+  this->fd_ = fd;
+  this->remove_on_close_ = false;
+  log_msg<LOG_DEBUG>(L"MappedFile::open - %s, %u MB") %path.c_str() %(unsigned int)(bytes>>20);
+  return true;
+#endif
+}
+
+void MappedFile::close() {
+#ifndef WIN32
+  if(this->data_)
+    munmap(this->data_, this->size_);
+  if(this->fd_ != -1) {
+    ::close(this->fd_);
+    if(this->remove_on_close_)
+      unlink(this->path_.c_str());
+  }
+#endif
+  this->data_ = NULL;
+  this->size_ = 0;
+  this->fd_ = -1;
+  this->remove_on_close_ = false;
+}
+
+void MappedFile::willNeed(size_t offset, size_t bytes) {
+#ifndef WIN32
+  size_t begin, length;
+  pageRange(offset, bytes, this->size_, &begin, &length);
+  if(this->data_ && length > 0)
+    madvise(this->data_+begin, length, MADV_WILLNEED);
+#endif
+}
+
+void MappedFile::release(size_t offset, size_t bytes) {
+#ifndef WIN32
+  size_t begin, length;
+  pageRange(offset, bytes, this->size_, &begin, &length);
+  if(this->data_ && length > 0)
+    madvise(this->data_+begin, length, MADV_DONTNEED);
+#endif
+}
@@ -0,0 +1,94 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// This file is a part of the PadallelFDTD Finite-Difference Time-Domain
+// simulation library. It is released under the MIT License. You should have
+// received a copy of the MIT License along with ParallelFDTD.  If not, see
+// http://www.opensource.org/licenses/mit-license.php
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// For details, see the LICENSE file
+//
+// (C) 2013-2014 Jukka Saarelma
+// Aalto University School of Science
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <string>
+#include <stddef.h>
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief A file mapped to memory for reading and writing. Used to keep
+/// volumes larger than the main memory on disk, the pages are read on
+/// demand and written back by the operating system.
+///
+/// Only available on POSIX systems, create() fails elsewhere.
+///////////////////////////////////////////////////////////////////////////////
+class MappedFile {
+public:
+  MappedFile();
+  ~MappedFile();
+
+  /////////////////////////////////////////////////////////////////////////////
+  /// \brief Create a file of the given size and map it. An existing file is
+  /// truncated. The contents read as zero and take no disk space until
+  /// written.
+  /// \param path The path of the file
+  /// \param bytes The size of the file
+  /// \param remove_on_close Remove the file in close()
+  /// \return false if the file could not be created or mapped
+  /////////////////////////////////////////////////////////////////////////////
+  bool create(const std::string& path, size_t bytes, bool remove_on_close);
+
+  /////////////////////////////////////////////////////////////////////////////
+  /// \brief Map an existing file for reading, the pages must not be written
+  /// \param path The path of the file
+  /// \return false if the file could not be opened or mapped
+  /////////////////////////////////////////////////////////////////////////////
+  bool open(const std::string& path);
+
+  /// \brief Unmap and close the file
+  void close();
+
+  /////////////////////////////////////////////////////////////////////////////
+  /// \brief Start reading a range from the disk ahead of its use
+  /// \param offset, bytes The range in bytes from the beginning of the file
+  /////////////////////////////////////////////////////////////////////////////
+  void willNeed(size_t offset, size_t bytes);
+
+  /////////////////////////////////////////////////////////////////////////////
+  /// \brief Drop a range from the memory of the process, written pages go to
+  /// the disk and are read back on the next access. Keeps the resident
+  /// set bounded while the file is streamed through.
+  /// \param offset, bytes The range in bytes from the beginning of the file
+  /////////////////////////////////////////////////////////////////////////////
+  void release(size_t offset, size_t bytes);
+
+  char* getPtr() {return this->data_;}
+  const char* getPtr() const {return this->data_;}
+  size_t getSize() const {return this->size_;}
+  const std::string& getPath() const {return this->path_;}
+  bool isOpen() const {return this->data_ != NULL;}
+
+private:
+  // Not copyable, the mapping has a single owner
+  MappedFile(const MappedFile&);
+  MappedFile& operator=(const MappedFile&);
+
+  std::string path_;
+  char* data_;
+  size_t size_;
+  int fd_;
+  bool remove_on_close_;
+};
+
+#endif
@@ -0,0 +1,338 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// This file is a part of the PadallelFDTD Finite-Difference Time-Domain
+// simulation library. It is released under the MIT License. You should have
+// received a copy of the MIT License along with ParallelFDTD.  If not, see
+// http://www.opensource.org/licenses/mit-license.php
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// For details, see the LICENSE file
+//
+// (C) 2013-2014 Jukka Saarelma
+// Aalto University School of Science
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "ResponseWriter.h"
+#include "../logger.h"
+#include <boost/thread.hpp>
+#include <boost/bind.hpp>
+#include <string.h>
+#include <algorithm>
+
+namespace {
+  void putU16(std::vector<unsigned char>& b, unsigned int v) {
+    b.push_back((unsigned char)(v&0xFF));
+    b.push_back((unsigned char)((v>>8)&0xFF));
+  }
+  void putU32(std::vector<unsigned char>& b, unsigned int v) {
+    putU16(b, v&0xFFFF);
+    putU16(b, (v>>16)&0xFFFF);
+  }
+  void putTag(std::vector<unsigned char>& b, const char* tag) {
+    b.insert(b.end(), tag, tag+4);
+  }
+
+  // The sub format of the extensible header, KSDATAFORMAT_SUBTYPE_IEEE_FLOAT
+  const unsigned char float_guid[16] = {0x03, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x00,
+                                        0x80, 0x00, 0x00, 0xAA, 0x00, 0x38, 0x9B, 0x71};
+}
+
+struct ResponseWriter::Sync {
+  boost::mutex mutex;
+  boost::condition_variable changed;
+  boost::thread thread;
+};
+
+const unsigned int ResponseWriter::no_chunk;
+
+ResponseWriter::ResponseWriter()
+: file_((FILE*)NULL),
+  format_(RESPONSE_RAW_FLOAT),
+  num_channels_(0),
+  sample_rate_(0),
+  num_steps_(0),
+  chunk_steps_(1),
+  num_written_(0),
+  frames_written_(0),
+  failed_(false),
+  next_chunk_(0),
+  closing_(false),
+  sync_(new Sync())
+{
+  for(unsigned int i = 0; i < 2; i++) {
+    this->chunks_[i].index = no_chunk;
+    this->chunks_[i].filled = 0;
+    this->chunks_[i].last_step = 0;
+  }
+}
+
+ResponseWriter::~ResponseWriter() {
+  this->close();
+  delete this->sync_;
+}
+
+bool ResponseWriter::open(const std::string& path, enum ResponseFormat format,
+                          unsigned int num_channels, unsigned int sample_rate) {
+  this->close();
+  this->file_ = fopen(path.c_str(), "wb");
+  if(!this->file_) {
+    log_msg<LOG_ERROR>(L"ResponseWriter::open - can not create %s") %path.c_str();
+    return false;
+  }
+  this->path_ = path;
+  this->format_ = format;
+  this->num_channels_ = num_channels;
+  this->sample_rate_ = sample_rate;
+  this->num_steps_ = 0;
+  this->chunk_steps_ = 1;
+  this->num_written_ = 0;
+  this->frames_written_ = 0;
+  this->failed_ = false;
+  this->next_chunk_ = 0;
+  this->closing_ = false;
+  for(unsigned int i = 0; i < 2; i++)
+    this->chunks_[i].index = no_chunk;
+  if(format == RESPONSE_WAV && !this->writeHeader(0)) {
+    log_msg<LOG_ERROR>(L"ResponseWriter::open - can not write %s") %path.c_str();
+    fclose(this->file_);
+    this->file_ = (FILE*)NULL;
+    return false;
+  }
+
+  this->sync_->thread = boost::thread(boost::bind(&ResponseWriter::run, this));
+  log_msg<LOG_INFO>(L"ResponseWriter::open - %s, %u channels") %path.c_str() %num_channels;
+  return true;
+}
+
+void ResponseWriter::begin(unsigned int num_steps, unsigned int chunk_steps,
+                           unsigned int num_written) {
+  boost::unique_lock<boost::mutex> lock(this->sync_->mutex);
+  this->num_steps_ = num_steps;
+  this->chunk_steps_ = std::max(chunk_steps, 1u);
+  this->num_written_ = num_written;
+}
+
+void ResponseWriter::write(unsigned int first_step, unsigned int num_steps,
+                           const unsigned int* channels, unsigned int num_channels,
+                           const float* samples, size_t step_stride, size_t channel_stride) {
+  this->writeSamples(first_step, num_steps, channels, num_channels, samples,
+                     step_stride, channel_stride);
+}
+
+void ResponseWriter::write(unsigned int first_step, unsigned int num_steps,
+                           const unsigned int* channels, unsigned int num_channels,
+                           const double* samples, size_t step_stride, size_t channel_stride) {
+  this->writeSamples(first_step, num_steps, channels, num_channels, samples,
+                     step_stride, channel_stride);
+}
+
+template <typename T>
+void ResponseWriter::writeSamples(unsigned int first_step, unsigned int num_steps,
+                                  const unsigned int* channels, unsigned int num_channels,
+                                  const T* samples, size_t step_stride, size_t channel_stride) {
+  if(!this->file_ || num_steps == 0 || num_channels == 0)
+    return;
+  boost::unique_lock<boost::mutex> lock(this->sync_->mutex);
+
+  // The steps are split at the chunk borders
+  while(num_steps > 0) {
+    unsigned int index = first_step/this->chunk_steps_;
+    unsigned int offset = first_step-index*this->chunk_steps_;
+    unsigned int count = std::min(num_steps, this->chunk_steps_-offset);
+    if(index < this->next_chunk_) {
+      log_msg<LOG_WARNING>(L"ResponseWriter::write - chunk %u is already written") %index;
+      return;
+    }
+    // Wait for a free buffer
+    Chunk* chunk = (Chunk*)NULL;
+    while(!(chunk = this->acquire(index)))
+      this->sync_->changed.wait(lock);
+
+    for(unsigned int k = 0; k < count; k++) {
+      double* dest = &chunk->samples[(size_t)(offset+k)*this->num_channels_];
+      const T* src = samples+k*step_stride;
+      for(unsigned int c = 0; c < num_channels; c++)
+        dest[channels[c]] = (double)src[c*channel_stride];
+    }
+    chunk->filled += (size_t)count*num_channels;
+    chunk->last_step = std::max(chunk->last_step, first_step+count);
+    this->sync_->changed.notify_all();
+
+    first_step += count;
+    num_steps -= count;
+    samples += count*step_stride;
+  }
+}
+
+// The buffer of a chunk, NULL if both buffers hold other chunks
+ResponseWriter::Chunk* ResponseWriter::acquire(unsigned int index) {
+  for(unsigned int i = 0; i < 2; i++)
+    if(this->chunks_[i].index == index)
+      return &this->chunks_[i];
+  for(unsigned int i = 0; i < 2; i++) {
+    Chunk& chunk = this->chunks_[i];
+    if(chunk.index != no_chunk)
+      continue;
+    chunk.index = index;
+    chunk.filled = 0;
+    chunk.last_step = index*this->chunk_steps_;
+    chunk.samples.assign((size_t)this->chunk_steps_*this->num_channels_, 0.0);
+    return &chunk;
+  }
+  return (Chunk*)NULL;
+}
+
+unsigned int ResponseWriter::getChunkSteps(unsigned int index) const {
+  unsigned int first = index*this->chunk_steps_;
+  if(first >= this->num_steps_)
+    return 0;
+  return std::min(this->chunk_steps_, this->num_steps_-first);
+}
+
+void ResponseWriter::run() {
+  while(true) {
+    Chunk* chunk = (Chunk*)NULL;
+    unsigned int frames = 0;
+    {
+      boost::unique_lock<boost::mutex> lock(this->sync_->mutex);
+      while(true) {
+        Chunk* later = (Chunk*)NULL;
+        for(unsigned int i = 0; i < 2; i++) {
+          if(this->chunks_[i].index == this->next_chunk_)
+            chunk = &this->chunks_[i];
+          else if(this->chunks_[i].index != no_chunk)
+            later = &this->chunks_[i];
+        }
+        unsigned int steps = this->getChunkSteps(this->next_chunk_);
+        if(chunk && chunk->filled >= (size_t)steps*this->num_written_) {
+          frames = steps;
+          break;
+        }
+        // On close an interrupted chunk keeps the steps written to it,
+        // a chunk followed by another one is written whole
+        if(this->closing_) {
+          if(chunk)
+            frames = later ? steps : chunk->last_step-chunk->index*this->chunk_steps_;
+          else if(later)
+            this->next_chunk_ = later->index;
+          if(chunk || later)
+            break;
+          return;
+        }
+        chunk = (Chunk*)NULL;
+        this->sync_->changed.wait(lock);
+      }
+    }
+    if(!chunk)
+      continue;
+
+    // After a failure the chunks are dropped so the writers do not block
+    unsigned int written = this->failed_ ? 0 : this->writeChunk(*chunk, frames);
+
+    boost::unique_lock<boost::mutex> lock(this->sync_->mutex);
+    chunk->index = no_chunk;
+    this->frames_written_ += written;
+    this->next_chunk_++;
+    this->sync_->changed.notify_all();
+  }
+}
+
+unsigned int ResponseWriter::writeChunk(const Chunk& chunk, unsigned int frames) {
+  size_t count = (size_t)frames*this->num_channels_;
+  if(count == 0)
+    return frames;
+  size_t samples_written = 0;
+  if(this->format_ == RESPONSE_RAW_DOUBLE) {
+    samples_written = fwrite(&chunk.samples[0], sizeof(double), count, this->file_);
+  }
+  else {
+    std::vector<float> samples(chunk.samples.begin(), chunk.samples.begin()+count);
+    samples_written = fwrite(&samples[0], sizeof(float), count, this->file_);
+  }
+  // Only whole steps are counted, and none of a chunk which did not reach
+  // the file
+  unsigned int written = (unsigned int)(samples_written/this->num_channels_);
+  bool ok = samples_written == count;
+  if(fflush(this->file_) != 0) {
+    written = 0;
+    ok = false;
+  }
+  if(this->format_ == RESPONSE_WAV)
+    ok = this->writeHeader(this->frames_written_+written) && fflush(this->file_) == 0 && ok;
+  if(!ok) {
+    log_msg<LOG_ERROR>(L"ResponseWriter::writeChunk - write to %s failed after %u steps")
+                       %this->path_.c_str() %(unsigned int)(this->frames_written_+written);
+    this->failed_ = true;
+  }
+  return written;
+}
+
+bool ResponseWriter::writeHeader(size_t frames) {
+  bool extensible = this->num_channels_ > 2;
+  unsigned int block = this->num_channels_*4;
+  size_t data_bytes = frames*block;
+  if(data_bytes > 0xFFFFFFF0u-80u) {
+    log_msg<LOG_WARNING>(L"ResponseWriter::writeHeader - %s exceeds the size of a WAV file")
+                         %this->path_.c_str();
+    data_bytes = 0xFFFFFFF0u-80u;
+  }
+  unsigned int fmt_bytes = extensible ? 40 : 16;
+
+  std::vector<unsigned char> b;
+  putTag(b, "RIFF");
+  putU32(b, (unsigned int)(4+8+fmt_bytes+12+8+data_bytes));
+  putTag(b, "WAVE");
+  putTag(b, "fmt ");
+  putU32(b, fmt_bytes);
+  putU16(b, extensible ? 0xFFFE : 3);
+  putU16(b, this->num_channels_);
+  putU32(b, this->sample_rate_);
+  putU32(b, this->sample_rate_*block);
+  putU16(b, block);
+  putU16(b, 32);
+  if(extensible) {
+    putU16(b, 22);
+    putU16(b, 32);
+    putU32(b, 0);
+    b.insert(b.end(), float_guid, float_guid+16);
+  }
+  putTag(b, "fact");
+  putU32(b, 4);
+  putU32(b, (unsigned int)frames);
+  putTag(b, "data");
+  putU32(b, (unsigned int)data_bytes);
+
+  return fseek(this->file_, 0, SEEK_SET) == 0 &&
+         fwrite(&b[0], 1, b.size(), this->file_) == b.size() &&
+         fseek(this->file_, 0, SEEK_END) == 0;
+}
+
+bool ResponseWriter::close() {
+  if(!this->file_)
+    return !this->failed_;
+  {
+    boost::unique_lock<boost::mutex> lock(this->sync_->mutex);
+    this->closing_ = true;
+    this->sync_->changed.notify_all();
+  }
+  this->sync_->thread.join();
+  if(fclose(this->file_) != 0)
+    this->failed_ = true;
+  this->file_ = (FILE*)NULL;
+  if(this->failed_) {
+    log_msg<LOG_ERROR>(L"ResponseWriter::close - %s is incomplete, %u steps written")
+                       %this->path_.c_str() %(unsigned int)this->frames_written_;
+    return false;
+  }
+  log_msg<LOG_INFO>(L"ResponseWriter::close - %s, %u steps written")
+                    %this->path_.c_str() %(unsigned int)this->frames_written_;
+  return true;
+}
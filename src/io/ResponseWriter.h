@@ -0,0 +1,160 @@
+#ifndef RESPONSE_WRITER_H
+#define RESPONSE_WRITER_H
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// This file is a part of the PadallelFDTD Finite-Difference Time-Domain
+// simulation library. It is released under the MIT License. You should have
+// received a copy of the MIT License along with ParallelFDTD.  If not, see
+// http://www.opensource.org/licenses/mit-license.php
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// For details, see the LICENSE file
+//
+// (C) 2013-2014 Jukka Saarelma
+// Aalto University School of Science
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include <string>
+#include <vector>
+#include <stdio.h>
+#include <stddef.h>
+
+enum ResponseFormat {RESPONSE_RAW_FLOAT, RESPONSE_RAW_DOUBLE, RESPONSE_WAV};
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief Writes the receiver responses to a file while the simulation runs.
+///
+/// The file holds one channel per receiver, interleaved: the samples of all
+/// the receivers of a step are contiguous. Raw files hold native endian
+/// float or double samples, WAV files 32 bit float samples. The header of a
+/// WAV file is updated after each chunk, so the file is valid up to the
+/// last chunk written if the run is lost.
+///
+/// The samples are collected to chunks of steps. A chunk is written by a
+/// background thread once all its samples have arrived, meanwhile the
+/// next chunk is collected to the other buffer. A chunk which needs a
+/// buffer while both are in use waits until the oldest one is written, so
+/// the writers of the samples may be at most one chunk apart.
+///
+/// A failed write, e.g. on a full disk, stops the writing: the following
+/// chunks are dropped, the WAV header counts the steps which were written
+/// and close() reports the failure.
+///////////////////////////////////////////////////////////////////////////////
+class ResponseWriter {
+public:
+  ResponseWriter();
+  ~ResponseWriter();
+
+  /////////////////////////////////////////////////////////////////////////////
+  /// \brief Create the file and start the writer thread
+  /// \param path The path of the file
+  /// \param format The format of the file
+  /// \param num_channels The number of receivers
+  /// \param sample_rate The sample rate written to a WAV header
+  /// \return false if the file can not be created
+  /////////////////////////////////////////////////////////////////////////////
+  bool open(const std::string& path, enum ResponseFormat format,
+            unsigned int num_channels, unsigned int sample_rate);
+
+  /////////////////////////////////////////////////////////////////////////////
+  /// \brief Set the layout of the run, called before the samples are written
+  /// \param num_steps The number of steps of the run
+  /// \param chunk_steps The number of steps in a chunk
+  /// \param num_written The number of channels written by the run, a chunk
+  /// is complete when all of them have been written. The other channels
+  /// are zero
+  /////////////////////////////////////////////////////////////////////////////
+  void begin(unsigned int num_steps, unsigned int chunk_steps, unsigned int num_written);
+
+  /////////////////////////////////////////////////////////////////////////////
+  /// \brief Write samples of a set of channels, thread safe. The steps
+  /// may span several chunks, a chunk is acquired at a time
+  /// \param first_step The step of the first sample
+  /// \param num_steps The number of steps written
+  /// \param channels The channels written
+  /// \param num_channels The number of channels written
+  /// \param samples The samples
+  /// \param step_stride, channel_stride The distance of the samples of
+  /// consecutive steps and channels
+  /////////////////////////////////////////////////////////////////////////////
+  void write(unsigned int first_step, unsigned int num_steps,
+             const unsigned int* channels, unsigned int num_channels,
+             const float* samples, size_t step_stride, size_t channel_stride);
+  void write(unsigned int first_step, unsigned int num_steps,
+             const unsigned int* channels, unsigned int num_channels,
+             const double* samples, size_t step_stride, size_t channel_stride);
+
+  /////////////////////////////////////////////////////////////////////////////
+  /// \brief Write the pending chunks and close the file. The steps of an
+  /// interrupted chunk up to the last one written are kept
+  /// \return false if a write to the file failed
+  /////////////////////////////////////////////////////////////////////////////
+  bool close();
+
+  bool isOpen() const {return this->file_ != NULL;}
+  const std::string& getPath() const {return this->path_;}
+
+  /// The number of steps written to the file
+  size_t getFramesWritten() const {return this->frames_written_;}
+
+  /// True if a write to the file has failed since open()
+  bool hasFailed() const {return this->failed_;}
+
+private:
+  // Not copyable, the file and the thread have a single owner
+  ResponseWriter(const ResponseWriter&);
+  ResponseWriter& operator=(const ResponseWriter&);
+
+  struct Chunk {
+    unsigned int index;         ///< The chunk of steps, no_chunk if free
+    size_t filled;              ///< Samples written to the chunk
+    unsigned int last_step;     ///< One past the last step written
+    std::vector<double> samples;
+  };
+
+  // The mutex, condition and thread, kept out of the header which is
+  // included in the device code
+  struct Sync;
+
+  static const unsigned int no_chunk = 0xFFFFFFFFu;
+
+  template <typename T>
+  void writeSamples(unsigned int first_step, unsigned int num_steps,
+                    const unsigned int* channels, unsigned int num_channels,
+                    const T* samples, size_t step_stride, size_t channel_stride);
+  Chunk* acquire(unsigned int index);
+  unsigned int getChunkSteps(unsigned int index) const;
+  void run();
+  /// \return The number of steps written, less than frames on a failure
+  unsigned int writeChunk(const Chunk& chunk, unsigned int frames);
+  /// \return false if the header can not be written
+  bool writeHeader(size_t frames);
+
+  FILE* file_;
+  std::string path_;
+  enum ResponseFormat format_;
+  unsigned int num_channels_;
+  unsigned int sample_rate_;
+
+  unsigned int num_steps_;
+  unsigned int chunk_steps_;
+  unsigned int num_written_;
+  size_t frames_written_;
+  bool failed_;                 ///< A write to the file has failed
+
+  Chunk chunks_[2];             ///< The double buffer
+  unsigned int next_chunk_;     ///< The next chunk written to the file
+  bool closing_;
+  Sync* sync_;
+};
+
+#endif
@@ -0,0 +1,208 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// This file is a part of the PadallelFDTD Finite-Difference Time-Domain
+// simulation library. It is released under the MIT License. You should have
+// received a copy of the MIT License along with ParallelFDTD.  If not, see
+// http://www.opensource.org/licenses/mit-license.php
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// For details, see the LICENSE file
+//
+// (C) 2013-2014 Jukka Saarelma
+// Aalto University School of Science
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "ResultCache.h"
+#include "../logger.h"
+
+#include <boost/thread/mutex.hpp>
+#include <boost/lexical_cast.hpp>
+#include <algorithm>
+#include <stdio.h>
+#include <string.h>
+
+#ifndef WIN32
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <utime.h>
+#include <unistd.h>
+#endif
+
+namespace {
+  const char result_magic[8] = {'P', 'F', 'R', 'E', 'S', 'U', 'L', 'T'};
+  const char result_suffix[] = ".pfr";
+
+  // Serializes the caches of the process, the temporary files of a
+  // process are named by its pid
+  boost::mutex cache_mutex;
+
+  struct CacheEntry {
+    std::string name;
+    unsigned long long bytes;
+    long long mtime;                 ///< Nanoseconds
+
+    bool operator<(const CacheEntry& other) const {
+      if(this->mtime != other.mtime)
+        return this->mtime < other.mtime;
+      return this->name < other.name;
+    }
+  };
+
+  // The result files of a directory
+  std::vector<CacheEntry> listEntries(const std::string& dir) {
+    std::vector<CacheEntry> ret;
+#ifndef WIN32
+    DIR* d = opendir(dir.c_str());
+    if(!d)
+      return ret;
+    size_t suffix_len = strlen(result_suffix);
+    struct dirent* e;
+    while((e = readdir(d)) != NULL) {
+      std::string name = e->d_name;
+      if(name.size() <= suffix_len ||
+         name.compare(name.size()-suffix_len, suffix_len, result_suffix) != 0)
+        continue;
+      struct stat st;
+      if(stat((dir+"/"+name).c_str(), &st) != 0)
+        continue;
+      CacheEntry entry;
+      entry.name = name;
+      entry.bytes = (unsigned long long)st.st_size;
+      entry.mtime = (long long)st.st_mtim.tv_sec*1000000000LL+st.st_mtim.tv_nsec;
+      ret.push_back(entry);
+    }
+    closedir(d);
+#endif
+    return ret;
+  }
+}
+
+bool ResultCache::load(const std::string& key, CachedResult& ret) {
+#ifdef WIN32
+  return false;
+#else
+  boost::mutex::scoped_lock lock(cache_mutex);
+  std::string path = this->getPath(key);
+  FILE* f = fopen(path.c_str(), "rb");
+  if(!f)
+    return false;
+
+  char magic[8];
+  unsigned int sample_size = 0;
+  bool ok = fread(magic, 1, 8, f) == 8 &&
+            fread(&ret.num_receivers, sizeof(unsigned int), 1, f) == 1 &&
+            fread(&ret.length, sizeof(unsigned int), 1, f) == 1 &&
+            fread(&ret.fs, sizeof(unsigned int), 1, f) == 1 &&
+            fread(&sample_size, sizeof(unsigned int), 1, f) == 1 &&
+            memcmp(magic, result_magic, 8) == 0 &&
+            (sample_size == sizeof(float) || sample_size == sizeof(double));
+
+  size_t size = (size_t)ret.num_receivers*ret.length;
+  ret.responses.clear();
+  ret.responses_double.clear();
+  if(ok && sample_size == sizeof(double)) {
+    ret.responses_double.assign(size, 0.0);
+    ok = size == 0 || fread(&ret.responses_double[0], sizeof(double), size, f) == size;
+  }
+  else if(ok) {
+    ret.responses.assign(size, 0.f);
+    ok = size == 0 || fread(&ret.responses[0], sizeof(float), size, f) == size;
+  }
+  fclose(f);
+
+  if(!ok) {
+    log_msg<LOG_WARNING>(L"ResultCache::load - removing invalid result %s") %path.c_str();
+    remove(path.c_str());
+    return false;
+  }
+
+  // The modification time orders the results for eviction
+  utime(path.c_str(), NULL);
+  return true;
+#endif
+}
+
+bool ResultCache::store(const std::string& key, const CachedResult& result) {
+#ifdef WIN32
+  return false;
+#else
+  bool is_double = !result.responses_double.empty();
+  size_t size = (size_t)result.num_receivers*result.length;
+  unsigned int sample_size = is_double ? sizeof(double) : sizeof(float);
+  unsigned long long bytes = 8+4*sizeof(unsigned int)+(unsigned long long)size*sample_size;
+  if((is_double ? result.responses_double.size() : result.responses.size()) != size)
+    return false;
+  if(bytes > this->max_bytes_) {
+    log_msg<LOG_DEBUG>(L"ResultCache::store - the result of %llu bytes does not fit the cache")
+                       %bytes;
+    return false;
+  }
+
+  boost::mutex::scoped_lock lock(cache_mutex);
+  mkdir(this->dir_.c_str(), 0755);
+  std::string path = this->getPath(key);
+  std::string tmp = path+".tmp"+boost::lexical_cast<std::string>(getpid());
+  FILE* f = fopen(tmp.c_str(), "wb");
+  if(!f) {
+    log_msg<LOG_WARNING>(L"ResultCache::store - can not write %s") %tmp.c_str();
+    return false;
+  }
+
+  bool ok = fwrite(result_magic, 1, 8, f) == 8 &&
+            fwrite(&result.num_receivers, sizeof(unsigned int), 1, f) == 1 &&
+            fwrite(&result.length, sizeof(unsigned int), 1, f) == 1 &&
+            fwrite(&result.fs, sizeof(unsigned int), 1, f) == 1 &&
+            fwrite(&sample_size, sizeof(unsigned int), 1, f) == 1;
+  if(ok && size > 0) {
+    if(is_double)
+      ok = fwrite(&result.responses_double[0], sizeof(double), size, f) == size;
+    else
+      ok = fwrite(&result.responses[0], sizeof(float), size, f) == size;
+  }
+  ok = (fclose(f) == 0) && ok;
+  ok = ok && rename(tmp.c_str(), path.c_str()) == 0;
+  if(!ok) {
+    log_msg<LOG_WARNING>(L"ResultCache::store - can not write %s") %path.c_str();
+    remove(tmp.c_str());
+    return false;
+  }
+
+  this->evict(key+result_suffix);
+  return true;
+#endif
+}
+
+unsigned long long ResultCache::getSize() const {
+  boost::mutex::scoped_lock lock(cache_mutex);
+  std::vector<CacheEntry> entries = listEntries(this->dir_);
+  unsigned long long ret = 0;
+  for(unsigned int i = 0; i < entries.size(); i++)
+    ret += entries.at(i).bytes;
+  return ret;
+}
+
+void ResultCache::evict(const std::string& keep) {
+  std::vector<CacheEntry> entries = listEntries(this->dir_);
+  unsigned long long total = 0;
+  for(unsigned int i = 0; i < entries.size(); i++)
+    total += entries.at(i).bytes;
+
+  std::sort(entries.begin(), entries.end());
+  for(unsigned int i = 0; i < entries.size() && total > this->max_bytes_; i++) {
+    const CacheEntry& entry = entries.at(i);
+    if(entry.name == keep)
+      continue;
+    remove((this->dir_+"/"+entry.name).c_str());
+    total -= entry.bytes;
+    log_msg<LOG_DEBUG>(L"ResultCache::evict - removed %s") %entry.name.c_str();
+  }
+}
@@ -0,0 +1,100 @@
+#ifndef RESULT_CACHE_H
+#define RESULT_CACHE_H
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// This file is a part of the PadallelFDTD Finite-Difference Time-Domain
+// simulation library. It is released under the MIT License. You should have
+// received a copy of the MIT License along with ParallelFDTD.  If not, see
+// http://www.opensource.org/licenses/mit-license.php
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// For details, see the LICENSE file
+//
+// (C) 2013-2014 Jukka Saarelma
+// Aalto University School of Science
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include <string>
+#include <vector>
+
+/// The responses of a simulation kept in a ResultCache
+struct CachedResult {
+  CachedResult()
+  : num_receivers(0),
+    length(0),
+    fs(0)
+  {};
+
+  unsigned int num_receivers;
+  unsigned int length;                  ///< Samples in each response
+  unsigned int fs;                      ///< Rate of the responses
+  std::vector<float> responses;         ///< Receiver major, single precision runs
+  std::vector<double> responses_double; ///< Receiver major, double precision runs
+};
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief Simulation responses kept on the local disk, addressed by the
+/// digest of the simulation state, see StateHash.
+///
+/// Each result is a file <digest>.pfr in the cache directory. A read
+/// touches the modification time of the file, and when a store makes the
+/// directory larger than the size of the cache the files with the oldest
+/// modification times are removed first. Results are written to a
+/// temporary file and renamed, so processes can share a directory.
+///
+/// Only available on POSIX systems, the cache is empty elsewhere.
+///////////////////////////////////////////////////////////////////////////////
+class ResultCache {
+public:
+  /// \param dir The directory of the cache, created on the first store
+  /// \param max_bytes The size of the cache
+  ResultCache(const std::string& dir, unsigned long long max_bytes)
+  : dir_(dir),
+    max_bytes_(max_bytes)
+  {};
+
+  /////////////////////////////////////////////////////////////////////////////
+  /// \brief Read a result
+  /// \param key The digest of the simulation
+  /// \param ret The result
+  /// \return false if the result is not in the cache or can not be read
+  /////////////////////////////////////////////////////////////////////////////
+  bool load(const std::string& key, CachedResult& ret);
+
+  /////////////////////////////////////////////////////////////////////////////
+  /// \brief Write a result and remove the least recently used ones while
+  /// the cache is over its size
+  /// \param key The digest of the simulation
+  /// \param result The result, either of the response vectors is stored
+  /// \return false if the result is larger than the cache or can not be
+  /// written
+  /////////////////////////////////////////////////////////////////////////////
+  bool store(const std::string& key, const CachedResult& result);
+
+  /// \return The bytes in the result files of the directory
+  unsigned long long getSize() const;
+
+  const std::string& getDir() const {return this->dir_;}
+  unsigned long long getMaxBytes() const {return this->max_bytes_;}
+
+private:
+  std::string getPath(const std::string& key) const
+    {return this->dir_+"/"+key+".pfr";}
+
+  /// Remove the oldest results until the cache fits, keep is not removed
+  void evict(const std::string& keep);
+
+  std::string dir_;
+  unsigned long long max_bytes_;
+};
+
+#endif
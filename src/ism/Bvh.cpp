@@ -0,0 +1,259 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// This file is a part of the PadallelFDTD Finite-Difference Time-Domain
+// simulation library. It is released under the MIT License. You should have
+// received a copy of the MIT License along with ParallelFDTD.  If not, see
+// http://www.opensource.org/licenses/mit-license.php
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// For details, see the LICENSE file
+//
+// (C) 2013-2014 Jukka Saarelma
+// Aalto University School of Science
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "Bvh.h"
+#include "../global_includes.h"
+#include <algorithm>
+#include <float.h>
+
+namespace {
+  // Sorts triangle indices along one axis by their centroid
+  struct CentroidCompare {
+    CentroidCompare(std::vector<nv::Vec3f>* centroids, int axis)
+    : centroids_(centroids), axis_(axis) {};
+    bool operator()(unsigned int a, unsigned int b) const {
+      return (*centroids_)[a][axis_] < (*centroids_)[b][axis_];
+    }
+    std::vector<nv::Vec3f>* centroids_;
+    int axis_;
+  };
+
+  // Relative epsilon for the ray - triangle tests
+  const float BVH_EPS = 1e-6f;
+}
+
+void Bvh::build(GeometryHandler* geometry) {
+  unsigned int num_tris = geometry->getNumberOfTriangles();
+  this->triangles_.assign(num_tris*9, 0.f);
+  this->order_.assign(num_tris, 0);
+  this->nodes_.clear();
+
+  std::vector<nv::Vec3f> centroids(num_tris);
+
+  for(unsigned int i = 0; i < num_tris; i++) {
+    unsigned int* tri = geometry->getTriangleAt(i);
+    nv::Vec3f c(0.f, 0.f, 0.f);
+    for(unsigned int v = 0; v < 3; v++) {
+      float* vert = geometry->getVertexAt(tri[v]);
+      for(unsigned int k = 0; k < 3; k++) {
+        this->triangles_.at(i*9+v*3+k) = vert[k];
+        c[k] += vert[k]/3.f;
+      }
+    }
+    centroids.at(i) = c;
+    this->order_.at(i) = i;
+  }
+
+  if(this->groups_.size() != num_tris) {
+    this->groups_.assign(num_tris, -1);
+    for(unsigned int i = 0; i < num_tris; i++)
+      this->groups_.at(i) = (int)i;
+  }
+
+  if(num_tris == 0)
+    return;
+
+  this->nodes_.reserve(2*num_tris);
+  this->nodes_.push_back(node_t());
+  this->buildRecursive(0, 0, num_tris, centroids);
+
+  log_msg<LOG_DEBUG>(L"Bvh::build - %u triangles, %u nodes")
+                     %num_tris %this->getNumberOfNodes();
+}
+
+void Bvh::buildRecursive(unsigned int node_idx, unsigned int first, unsigned int count,
+                         std::vector<nv::Vec3f>& centroids) {
+  nv::Vec3f b_min(FLT_MAX, FLT_MAX, FLT_MAX);
+  nv::Vec3f b_max(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+  nv::Vec3f c_min(FLT_MAX, FLT_MAX, FLT_MAX);
+  nv::Vec3f c_max(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+
+  for(unsigned int i = first; i < first+count; i++) {
+    unsigned int tri = this->order_.at(i);
+    for(unsigned int v = 0; v < 3; v++) {
+      nv::Vec3f p = this->getVertex(tri, v);
+      for(int k = 0; k < 3; k++) {
+        b_min[k] = MIN(b_min[k], p[k]);
+        b_max[k] = MAX(b_max[k], p[k]);
+      }
+    }
+    for(int k = 0; k < 3; k++) {
+      c_min[k] = MIN(c_min[k], centroids[tri][k]);
+      c_max[k] = MAX(c_max[k], centroids[tri][k]);
+    }
+  }
+
+  this->nodes_.at(node_idx).min = b_min;
+  this->nodes_.at(node_idx).max = b_max;
+
+  if(count <= this->leaf_size_) {
+    this->nodes_.at(node_idx).first = first;
+    this->nodes_.at(node_idx).count = count;
+    return;
+  }
+
+  // Median split along the longest centroid axis
+  nv::Vec3f extent = c_max-c_min;
+  int axis = 0;
+  if(extent.y > extent[axis]) axis = 1;
+  if(extent.z > extent[axis]) axis = 2;
+
+  unsigned int half = count/2;
+  std::nth_element(this->order_.begin()+first,
+                   this->order_.begin()+first+half,
+                   this->order_.begin()+first+count,
+                   CentroidCompare(&centroids, axis));
+
+  unsigned int left = (unsigned int)this->nodes_.size();
+  this->nodes_.push_back(node_t());
+  this->nodes_.push_back(node_t());
+  this->nodes_.at(node_idx).first = left;
+  this->nodes_.at(node_idx).count = 0;
+
+  this->buildRecursive(left, first, half, centroids);
+  this->buildRecursive(left+1, first+half, count-half, centroids);
+}
+
+bool Bvh::intersectBox(const node_t& node, nv::Vec3f origin, nv::Vec3f inv_dir,
+                       float t_max) {
+  float t0 = 0.f;
+  float t1 = t_max;
+  for(int k = 0; k < 3; k++) {
+    float t_near = (node.min[k]-origin[k])*inv_dir[k];
+    float t_far = (node.max[k]-origin[k])*inv_dir[k];
+    if(t_near > t_far) {float tmp = t_near; t_near = t_far; t_far = tmp;}
+    t0 = MAX(t0, t_near);
+    t1 = MIN(t1, t_far);
+    if(t0 > t1)
+      return false;
+  }
+  return true;
+}
+
+// Moller-Trumbore
+bool Bvh::intersectTriangle(unsigned int tri, nv::Vec3f origin, nv::Vec3f dir,
+                            float t_max, float* t) {
+  nv::Vec3f v0 = this->getVertex(tri, 0);
+  nv::Vec3f e1 = this->getVertex(tri, 1)-v0;
+  nv::Vec3f e2 = this->getVertex(tri, 2)-v0;
+  nv::Vec3f p = crossed(dir, e2);
+  float det = dot_(e1, p);
+  if(fabs(det) < BVH_EPS*length_(e1)*length_(e2)*length_(dir))
+    return false;
+
+  float inv_det = 1.f/det;
+  nv::Vec3f s = origin-v0;
+  float u = dot_(s, p)*inv_det;
+  if(u < -BVH_EPS || u > 1.f+BVH_EPS)
+    return false;
+
+  nv::Vec3f q = crossed(s, e1);
+  float v = dot_(dir, q)*inv_det;
+  if(v < -BVH_EPS || u+v > 1.f+BVH_EPS)
+    return false;
+
+  float t_hit = dot_(e2, q)*inv_det;
+  if(t_hit <= 0.f || t_hit >= t_max)
+    return false;
+
+  *t = t_hit;
+  return true;
+}
+
+int Bvh::intersect(nv::Vec3f origin, nv::Vec3f dir, float t_max, float* t) {
+  int ret = -1;
+  if(this->nodes_.empty())
+    return ret;
+
+  nv::Vec3f inv_dir(1.f/dir.x, 1.f/dir.y, 1.f/dir.z);
+  float closest = t_max;
+
+  std::vector<unsigned int> stack;
+  stack.reserve(64);
+  stack.push_back(0);
+
+  while(!stack.empty()) {
+    const node_t& node = this->nodes_[stack.back()];
+    stack.pop_back();
+    if(!this->intersectBox(node, origin, inv_dir, closest))
+      continue;
+
+    if(node.count == 0) {
+      stack.push_back(node.first);
+      stack.push_back(node.first+1);
+      continue;
+    }
+
+    for(unsigned int i = node.first; i < node.first+node.count; i++) {
+      unsigned int tri = this->order_[i];
+      float t_hit = 0.f;
+      if(this->intersectTriangle(tri, origin, dir, closest, &t_hit)) {
+        closest = t_hit;
+        ret = (int)tri;
+      }
+    }
+  }
+
+  *t = closest;
+  return ret;
+}
+
+bool Bvh::isOccluded(nv::Vec3f from, nv::Vec3f to, int ignore_a, int ignore_b) {
+  if(this->nodes_.empty())
+    return false;
+
+  nv::Vec3f dir = to-from;
+  nv::Vec3f inv_dir(1.f/dir.x, 1.f/dir.y, 1.f/dir.z);
+
+  // Shrink the segment slightly so that hits at the end points, which lie
+  // on the reflecting surfaces, are not counted
+  const float t_min = 1e-4f;
+  const float t_max = 1.f-1e-4f;
+
+  std::vector<unsigned int> stack;
+  stack.reserve(64);
+  stack.push_back(0);
+
+  while(!stack.empty()) {
+    const node_t& node = this->nodes_[stack.back()];
+    stack.pop_back();
+    if(!this->intersectBox(node, from, inv_dir, t_max))
+      continue;
+
+    if(node.count == 0) {
+      stack.push_back(node.first);
+      stack.push_back(node.first+1);
+      continue;
+    }
+
+    for(unsigned int i = node.first; i < node.first+node.count; i++) {
+      unsigned int tri = this->order_[i];
+      int group = this->groups_[tri];
+      if(group == ignore_a || group == ignore_b)
+        continue;
+      float t_hit = 0.f;
+      if(this->intersectTriangle(tri, from, dir, t_max, &t_hit) && t_hit > t_min)
+        return true;
+    }
+  }
+  return false;
+}
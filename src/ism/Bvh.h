@@ -0,0 +1,107 @@
+#ifndef BVH_H
+#define BVH_H
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// This file is a part of the PadallelFDTD Finite-Difference Time-Domain
+// simulation library. It is released under the MIT License. You should have
+// received a copy of the MIT License along with ParallelFDTD.  If not, see
+// http://www.opensource.org/licenses/mit-license.php
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// For details, see the LICENSE file
+//
+// (C) 2013-2014 Jukka Saarelma
+// Aalto University School of Science
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "../math/geomMath.h"
+#include "../base/GeometryHandler.h"
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief Bounding volume hierarchy over the triangles of the model. Used for
+/// the visibility tests of the image source engine
+///////////////////////////////////////////////////////////////////////////////
+class Bvh {
+public:
+  Bvh()
+  : leaf_size_(4)
+  {};
+
+  ~Bvh() {};
+
+  struct node_t {
+    nv::Vec3f min;
+    nv::Vec3f max;
+    unsigned int first;  ///< First child node, or first triangle in a leaf
+    unsigned int count;  ///< Number of triangles, 0 for inner nodes
+  };
+
+  /////////////////////////////////////////////////////////////////////////////
+  /// \brief Build the hierarchy from the triangles of the geometry
+  /// \param geometry An initialized geometry handler
+  /////////////////////////////////////////////////////////////////////////////
+  void build(GeometryHandler* geometry);
+
+  /////////////////////////////////////////////////////////////////////////////
+  /// \brief Find the closest triangle hit by a ray
+  /// \param origin The origin of the ray
+  /// \param dir The direction of the ray, need not be normalized
+  /// \param t_max Hits further than origin+t_max*dir are ignored
+  /// \param[out] t The ray parameter of the closest hit
+  /// \return The index of the hit triangle, -1 if nothing was hit
+  /////////////////////////////////////////////////////////////////////////////
+  int intersect(nv::Vec3f origin, nv::Vec3f dir, float t_max, float* t);
+
+  /////////////////////////////////////////////////////////////////////////////
+  /// \brief Check if the segment between two points is blocked
+  /// \param from Start point of the segment
+  /// \param to End point of the segment
+  /// \param ignore_a A triangle plane id which is not tested, -1 for none
+  /// \param ignore_b A second triangle plane id which is not tested
+  /// \return true if any other triangle intersects the segment
+  /////////////////////////////////////////////////////////////////////////////
+  bool isOccluded(nv::Vec3f from, nv::Vec3f to, int ignore_a, int ignore_b);
+
+  /////////////////////////////////////////////////////////////////////////////
+  /// \brief Set a group id for each triangle. isOccluded() ignores the
+  /// triangles by the group id, so that all the triangles of a reflecting
+  /// plane can be skipped at once
+  /////////////////////////////////////////////////////////////////////////////
+  void setTriangleGroups(std::vector<int> groups) {this->groups_ = groups;}
+
+  unsigned int getNumberOfNodes() {return (unsigned int)this->nodes_.size();}
+  unsigned int getNumberOfTriangles() {return (unsigned int)this->triangles_.size()/9;}
+
+private:
+  unsigned int leaf_size_;               ///< Maximum number of triangles in a leaf
+  std::vector<node_t> nodes_;            ///< Flattened tree, root at 0
+  std::vector<float> triangles_;         ///< Triangle vertices, 9 floats per triangle
+  std::vector<unsigned int> order_;      ///< Triangle indices in leaf order
+  std::vector<int> groups_;              ///< Group id of each triangle
+
+  void buildRecursive(unsigned int node_idx, unsigned int first, unsigned int count,
+                      std::vector<nv::Vec3f>& centroids);
+
+  bool intersectTriangle(unsigned int tri, nv::Vec3f origin, nv::Vec3f dir,
+                         float t_max, float* t);
+
+  bool intersectBox(const node_t& node, nv::Vec3f origin, nv::Vec3f inv_dir,
+                    float t_max);
+
+  nv::Vec3f getVertex(unsigned int tri, unsigned int v) {
+    float* p = &(this->triangles_[tri*9+v*3]);
+    return nv::Vec3f(p[0], p[1], p[2]);
+  }
+};
+
+#endif
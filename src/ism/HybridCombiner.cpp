@@ -0,0 +1,125 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// This file is a part of the PadallelFDTD Finite-Difference Time-Domain
+// simulation library. It is released under the MIT License. You should have
+// received a copy of the MIT License along with ParallelFDTD.  If not, see
+// http://www.opensource.org/licenses/mit-license.php
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// For details, see the LICENSE file
+//
+// (C) 2013-2014 Jukka Saarelma
+// Aalto University School of Science
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "HybridCombiner.h"
+#include "../global_includes.h"
+#include "../math/geomMath.h"
+#include <math.h>
+
+std::vector<float> HybridCombiner::resample(const std::vector<float>& input,
+                                            unsigned int fs_in,
+                                            unsigned int fs_out,
+                                            unsigned int output_len) {
+  std::vector<float> output(output_len, 0.f);
+  if(input.empty() || fs_in == 0 || fs_out == 0)
+    return output;
+
+  // Cut off slightly below the lower Nyquist frequency
+  double ratio = MIN(1.0, (double)fs_out/(double)fs_in)*0.95;
+  int half_width = (int)ceil(16.0/ratio);
+  int len = (int)input.size();
+
+  for(unsigned int n = 0; n < output_len; n++) {
+    double x = (double)n*(double)fs_in/(double)fs_out;
+    int center = (int)floor(x);
+    double acc = 0.0;
+    for(int k = center-half_width+1; k <= center+half_width; k++) {
+      if(k < 0 || k >= len)
+        continue;
+      double d = x-(double)k;
+      double arg = PI*d*ratio;
+      double sinc = fabs(arg) < 1e-9 ? 1.0 : sin(arg)/arg;
+      // Blackman window
+      double w = (d+half_width)/(2.0*half_width);
+      double window = 0.42-0.5*cos(2.0*PI*w)+0.08*cos(4.0*PI*w);
+      acc += (double)input[k]*ratio*sinc*window;
+    }
+    output[n] = (float)acc;
+  }
+  return output;
+}
+
+float HybridCombiner::getSoftSourceGain(float dx, float c, unsigned int fdtd_fs,
+                                        unsigned int output_fs) {
+  // A unit sample added to a node radiates p[n] = dx^3*fs^2/(4*pi*c^2*r)
+  // in the grid. The resampler keeps the continuous time signal, so the
+  // levels are matched through the pulse areas, h_fdtd/fdtd_fs == h_ism/output_fs
+  double dx3 = (double)dx*(double)dx*(double)dx;
+  double gain = 4.0*PI*(double)c*(double)c/(dx3*(double)fdtd_fs*(double)output_fs);
+  return (float)gain;
+}
+
+void HybridCombiner::linkwitzRiley(std::vector<double>& signal, bool highpass) {
+  double k = tan(PI*(double)this->crossover_/(double)this->output_fs_);
+  double q = 1.0/sqrt(2.0);
+  double norm = 1.0/(1.0+k/q+k*k);
+
+  double b0, b1, b2;
+  if(highpass) {
+    b0 = norm; b1 = -2.0*norm; b2 = norm;
+  }
+  else {
+    b0 = k*k*norm; b1 = 2.0*b0; b2 = b0;
+  }
+  double a1 = 2.0*(k*k-1.0)*norm;
+  double a2 = (1.0-k/q+k*k)*norm;
+
+  for(unsigned int section = 0; section < 2; section++) {
+    double z1 = 0.0;
+    double z2 = 0.0;
+    for(unsigned int i = 0; i < signal.size(); i++) {
+      double x = signal[i];
+      double y = b0*x+z1;
+      z1 = b1*x-a1*y+z2;
+      z2 = b2*x-a2*y;
+      signal[i] = y;
+    }
+  }
+}
+
+std::vector<float> HybridCombiner::combine(const std::vector<float>& fdtd,
+                                           unsigned int fdtd_fs,
+                                           const std::vector<float>& ism) {
+  unsigned int len = (unsigned int)ism.size();
+
+  if(this->crossover_ > 0.2f*(float)fdtd_fs)
+    log_msg<LOG_WARNING>(L"HybridCombiner::combine - crossover %f Hz above the "
+                         L"valid band of the FDTD, fs %u") %this->crossover_ %fdtd_fs;
+
+  std::vector<float> low = HybridCombiner::resample(fdtd, fdtd_fs, this->output_fs_, len);
+
+  std::vector<double> low_d(len, 0.0);
+  std::vector<double> high_d(len, 0.0);
+  for(unsigned int i = 0; i < len; i++) {
+    low_d[i] = (double)low[i]*(double)this->fdtd_gain_;
+    high_d[i] = (double)ism[i];
+  }
+
+  this->linkwitzRiley(low_d, false);
+  this->linkwitzRiley(high_d, true);
+
+  std::vector<float> ret(len, 0.f);
+  for(unsigned int i = 0; i < len; i++)
+    ret[i] = (float)(low_d[i]+high_d[i]);
+
+  return ret;
+}
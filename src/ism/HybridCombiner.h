@@ -0,0 +1,96 @@
+#ifndef HYBRID_COMBINER_H
+#define HYBRID_COMBINER_H
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// This file is a part of the PadallelFDTD Finite-Difference Time-Domain
+// simulation library. It is released under the MIT License. You should have
+// received a copy of the MIT License along with ParallelFDTD.  If not, see
+// http://www.opensource.org/licenses/mit-license.php
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// For details, see the LICENSE file
+//
+// (C) 2013-2014 Jukka Saarelma
+// Aalto University School of Science
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief Combines a low band FDTD response with a full band image source
+/// response. The FDTD response is resampled to the output rate, the two are
+/// split with a 4th order Linkwitz-Riley crossover and summed.
+///////////////////////////////////////////////////////////////////////////////
+class HybridCombiner {
+public:
+  HybridCombiner()
+  : crossover_(500.f),
+    output_fs_(48000),
+    fdtd_gain_(1.f)
+  {};
+
+  ~HybridCombiner() {};
+
+  /////////////////////////////////////////////////////////////////////////////
+  /// \brief Combine the responses of one receiver
+  /// \param fdtd The FDTD response sampled at fdtd_fs
+  /// \param fdtd_fs The sampling frequency of the FDTD response, the spatial
+  /// fs or the output fs it was resampled to
+  /// \param ism The image source response sampled at the output fs
+  /// \return The full band response at output fs, the length of ism
+  /////////////////////////////////////////////////////////////////////////////
+  std::vector<float> combine(const std::vector<float>& fdtd,
+                             unsigned int fdtd_fs,
+                             const std::vector<float>& ism);
+
+  /////////////////////////////////////////////////////////////////////////////
+  /// \brief Band limited resampling with a windowed sinc interpolator
+  /// \param input The input signal
+  /// \param fs_in Sampling frequency of the input
+  /// \param fs_out Sampling frequency of the output
+  /// \param output_len Number of output samples
+  /////////////////////////////////////////////////////////////////////////////
+  static std::vector<float> resample(const std::vector<float>& input,
+                                     unsigned int fs_in,
+                                     unsigned int fs_out,
+                                     unsigned int output_len);
+
+  /////////////////////////////////////////////////////////////////////////////
+  /// \brief The gain which scales the response of a soft impulse source in
+  /// the FDTD grid to the 1/r free field level used by the image sources
+  /// \param dx The grid spacing
+  /// \param c The speed of sound
+  /// \param fdtd_fs The sampling frequency of the FDTD simulation
+  /// \param output_fs The sampling frequency of the image source response
+  /////////////////////////////////////////////////////////////////////////////
+  static float getSoftSourceGain(float dx, float c, unsigned int fdtd_fs,
+                                 unsigned int output_fs);
+
+  void setCrossover(float crossover) {this->crossover_ = crossover;}
+  void setOutputFs(unsigned int output_fs) {this->output_fs_ = output_fs;}
+  void setFdtdGain(float fdtd_gain) {this->fdtd_gain_ = fdtd_gain;}
+
+  float getCrossover() {return this->crossover_;}
+  unsigned int getOutputFs() {return this->output_fs_;}
+  float getFdtdGain() {return this->fdtd_gain_;}
+
+private:
+  float crossover_;          ///< Crossover frequency in Hz
+  unsigned int output_fs_;   ///< Sampling frequency of the combined response
+  float fdtd_gain_;          ///< Gain applied to the FDTD response
+
+  /// Filter the signal in place with a 4th order Linkwitz-Riley section,
+  /// two cascaded 2nd order Butterworth sections
+  void linkwitzRiley(std::vector<double>& signal, bool highpass);
+};
+
+#endif
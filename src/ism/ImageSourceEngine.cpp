@@ -0,0 +1,275 @@
+///////////////////////////////////////////////////////////////////////////////
+//
+// This file is a part of the PadallelFDTD Finite-Difference Time-Domain
+// simulation library. It is released under the MIT License. You should have
+// received a copy of the MIT License along with ParallelFDTD.  If not, see
+// http://www.opensource.org/licenses/mit-license.php
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// For details, see the LICENSE file
+//
+// (C) 2013-2014 Jukka Saarelma
+// Aalto University School of Science
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "ImageSourceEngine.h"
+#include "../global_includes.h"
+#include <math.h>
+
+namespace {
+  // Tolerances for merging coplanar triangles
+  const float PLANE_NORMAL_EPS = 1e-4f;
+  const float PLANE_DIST_EPS = 1e-4f;
+  // Tolerance of the point in triangle test, in barycentric coordinates
+  const float BARY_EPS = 1e-5f;
+}
+
+void ImageSourceEngine::initialize(GeometryHandler* geometry,
+                                   MaterialHandler* materials) {
+  unsigned int num_tris = geometry->getNumberOfTriangles();
+  this->box_max_ = geometry->getBoundingBox();
+  this->plane_normals_.clear();
+  this->plane_d_.clear();
+  this->plane_tris_.clear();
+  this->images_.clear();
+  this->triangles_.assign(num_tris*9, 0.f);
+  this->reflection_.assign(num_tris, 1.f);
+
+  if(materials->getNumberOfSurfaces() < num_tris)
+    log_msg<LOG_WARNING>(L"ImageSourceEngine::initialize - %u materials for %u "
+                         L"triangles, missing surfaces are rigid")
+                         %materials->getNumberOfSurfaces() %num_tris;
+
+  std::vector<int> groups(num_tris, -2);
+
+  for(unsigned int i = 0; i < num_tris; i++) {
+    unsigned int* tri = geometry->getTriangleAt(i);
+    nv::Vec3f v[3];
+    for(unsigned int k = 0; k < 3; k++) {
+      float* vert = geometry->getVertexAt(tri[k]);
+      v[k] = nv::Vec3f(vert[0], vert[1], vert[2]);
+      this->triangles_.at(i*9+k*3) = vert[0];
+      this->triangles_.at(i*9+k*3+1) = vert[1];
+      this->triangles_.at(i*9+k*3+2) = vert[2];
+    }
+
+    if(i < materials->getNumberOfSurfaces()) {
+      float coef = materials->getSurfaceCoefAt(i, this->coef_idx_);
+      this->reflection_.at(i) = materials->isAdmitance() ? admitance2Reflection(coef) : coef;
+    }
+
+    nv::Vec3f n = crossed(v[1]-v[0], v[2]-v[0]);
+    if(length_(n) <= 0.f)
+      continue; // degenerate triangle, can not reflect
+
+    n = normalized(n);
+
+    // Canonical orientation: the largest component of the normal is positive
+    int axis = 0;
+    if(fabs(n.y) > fabs(n[axis])) axis = 1;
+    if(fabs(n.z) > fabs(n[axis])) axis = 2;
+    if(n[axis] < 0.f) n = -n;
+    float d = dot_(n, v[0]);
+
+    int plane = -1;
+    for(unsigned int p = 0; p < this->plane_d_.size(); p++) {
+      if(dot_(n, this->plane_normals_[p]) > 1.f-PLANE_NORMAL_EPS &&
+         fabs(d-this->plane_d_[p]) < PLANE_DIST_EPS) {
+        plane = (int)p;
+        break;
+      }
+    }
+
+    if(plane == -1) {
+      plane = (int)this->plane_d_.size();
+      this->plane_normals_.push_back(n);
+      this->plane_d_.push_back(d);
+      this->plane_tris_.push_back(std::vector<unsigned int>());
+    }
+    this->plane_tris_.at(plane).push_back(i);
+    groups.at(i) = plane;
+  }
+
+  this->bvh_.setTriangleGroups(groups);
+  this->bvh_.build(geometry);
+
+  log_msg<LOG_INFO>(L"ImageSourceEngine::initialize - %u triangles, %u planes")
+                    %num_tris %this->getNumberOfPlanes();
+}
+
+float ImageSourceEngine::distanceToBox(nv::Vec3f p) {
+  float dist = 0.f;
+  for(int k = 0; k < 3; k++) {
+    float delta = 0.f;
+    if(p[k] < 0.f) delta = -p[k];
+    if(p[k] > this->box_max_[k]) delta = p[k]-this->box_max_[k];
+    dist += delta*delta;
+  }
+  return sqrtf(dist);
+}
+
+unsigned int ImageSourceEngine::computeImageSources(nv::Vec3f source) {
+  this->source_ = source;
+  this->images_.clear();
+
+  image_t src;
+  src.p = source;
+  src.plane = -1;
+  src.parent = -1;
+  src.order = 0;
+  this->images_.push_back(src);
+
+  float max_dist = this->c_*this->max_time_;
+  unsigned int num_planes = this->getNumberOfPlanes();
+
+  // Breadth first, images of order n are expanded after all of order n-1
+  for(unsigned int i = 0; i < this->images_.size(); i++) {
+    if(this->images_[i].order >= this->max_order_)
+      break;
+
+    for(unsigned int p = 0; p < num_planes; p++) {
+      if((int)p == this->images_[i].plane)
+        continue;
+
+      nv::Vec3f parent_p = this->images_[i].p;
+      float dist = dot_(this->plane_normals_[p], parent_p)-this->plane_d_[p];
+      if(fabs(dist) < PLANE_DIST_EPS)
+        continue;
+
+      image_t img;
+      img.p = parent_p-this->plane_normals_[p]*(2.f*dist);
+
+      // Any path through this image, or its children, is at least as long
+      // as the distance from the image to the model
+      if(this->distanceToBox(img.p) > max_dist)
+        continue;
+
+      img.plane = (int)p;
+      img.parent = (int)i;
+      img.order = this->images_[i].order+1;
+      this->images_.push_back(img);
+    }
+  }
+
+  log_msg<LOG_DEBUG>(L"ImageSourceEngine::computeImageSources - %u images, order %u")
+                     %this->getNumberOfImageSources() %this->max_order_;
+
+  return this->getNumberOfImageSources();
+}
+
+int ImageSourceEngine::findTriangleOnPlane(int plane, nv::Vec3f p) {
+  const std::vector<unsigned int>& tris = this->plane_tris_.at(plane);
+  for(unsigned int i = 0; i < tris.size(); i++) {
+    const float* t = &(this->triangles_[tris[i]*9]);
+    nv::Vec3f v0(t[0], t[1], t[2]);
+    nv::Vec3f e1 = nv::Vec3f(t[3], t[4], t[5])-v0;
+    nv::Vec3f e2 = nv::Vec3f(t[6], t[7], t[8])-v0;
+    nv::Vec3f w = p-v0;
+
+    float d11 = dot_(e1, e1);
+    float d12 = dot_(e1, e2);
+    float d22 = dot_(e2, e2);
+    float dw1 = dot_(w, e1);
+    float dw2 = dot_(w, e2);
+    float denom = d11*d22-d12*d12;
+    if(denom <= 0.f)
+      continue;
+
+    float v = (d22*dw1-d12*dw2)/denom;
+    float u = (d11*dw2-d12*dw1)/denom;
+    if(v >= -BARY_EPS && u >= -BARY_EPS && u+v <= 1.f+BARY_EPS)
+      return (int)tris[i];
+  }
+  return -1;
+}
+
+std::vector<ImageSourceEngine::path_t> ImageSourceEngine::getPaths(nv::Vec3f receiver) {
+  std::vector<path_t> paths;
+  float max_dist = this->c_*this->max_time_;
+
+  for(unsigned int i = 0; i < this->images_.size(); i++) {
+    float length = length_(receiver-this->images_[i].p);
+    if(length > max_dist || length <= 0.f)
+      continue;
+
+    // Trace back from the receiver through each reflecting plane
+    nv::Vec3f current = receiver;
+    int previous_plane = -1;
+    int idx = (int)i;
+    float gain = 1.f;
+    bool valid = true;
+
+    while(this->images_[idx].plane != -1) {
+      const image_t& img = this->images_[idx];
+      nv::Vec3f n = this->plane_normals_[img.plane];
+      nv::Vec3f dir = img.p-current;
+      float denom = dot_(n, dir);
+      if(fabs(denom) < 1e-12f) {valid = false; break;}
+
+      float t = (this->plane_d_[img.plane]-dot_(n, current))/denom;
+      if(t <= 0.f || t >= 1.f) {valid = false; break;}
+
+      nv::Vec3f hit = current+dir*t;
+      int tri = this->findTriangleOnPlane(img.plane, hit);
+      if(tri == -1) {valid = false; break;}
+
+      if(this->bvh_.isOccluded(current, hit, img.plane, previous_plane)) {
+        valid = false; break;
+      }
+
+      gain *= this->reflection_[tri];
+      current = hit;
+      previous_plane = img.plane;
+      idx = img.parent;
+    }
+
+    if(!valid)
+      continue;
+
+    if(this->bvh_.isOccluded(current, this->source_, previous_plane, -1))
+      continue;
+
+    path_t path;
+    path.length = length;
+    path.gain = gain/length;
+    path.order = this->images_[i].order;
+    paths.push_back(path);
+  }
+
+  return paths;
+}
+
+unsigned int ImageSourceEngine::getResponse(nv::Vec3f receiver, unsigned int fs,
+                                            std::vector<float>& response) {
+  std::vector<path_t> paths = this->getPaths(receiver);
+  int half_width = (int)this->sinc_half_width_;
+  int len = (int)response.size();
+
+  for(unsigned int i = 0; i < paths.size(); i++) {
+    double delay = (double)paths[i].length/(double)this->c_*(double)fs;
+    int n0 = (int)floor(delay);
+
+    // Hann windowed sinc fractional delay
+    for(int k = n0-half_width+1; k <= n0+half_width; k++) {
+      if(k < 0 || k >= len)
+        continue;
+      double x = (double)k-delay;
+      double sinc = fabs(x) < 1e-9 ? 1.0 : sin(PI*x)/(PI*x);
+      double window = 0.5*(1.0+cos(PI*x/(double)half_width));
+      response[k] += (float)(paths[i].gain*sinc*window);
+    }
+  }
+
+  log_msg<LOG_DEBUG>(L"ImageSourceEngine::getResponse - %u valid paths of %u images")
+                     %(unsigned int)paths.size() %this->getNumberOfImageSources();
+
+  return (unsigned int)paths.size();
+}
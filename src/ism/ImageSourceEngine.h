@@ -0,0 +1,140 @@
+#ifndef IMAGE_SOURCE_ENGINE_H
+#define IMAGE_SOURCE_ENGINE_H
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// This file is a part of the PadallelFDTD Finite-Difference Time-Domain
+// simulation library. It is released under the MIT License. You should have
+// received a copy of the MIT License along with ParallelFDTD.  If not, see
+// http://www.opensource.org/licenses/mit-license.php
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+//
+// For details, see the LICENSE file
+//
+// (C) 2013-2014 Jukka Saarelma
+// Aalto University School of Science
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include "../math/geomMath.h"
+#include "../base/GeometryHandler.h"
+#include "../base/MaterialHandler.h"
+#include "Bvh.h"
+#include <vector>
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief Image source method on the triangle mesh of the model. Used to
+/// calculate the early reflections above the band of the FDTD simulation.
+///
+/// Coplanar triangles are merged into reflecting planes, image sources are
+/// generated up to a given order and validated for each receiver by tracing
+/// the path back through the planes with the visibility tested using a BVH.
+/// The reflection coefficient of each reflection is taken from the material
+/// of the triangle that is hit.
+///////////////////////////////////////////////////////////////////////////////
+class ImageSourceEngine {
+public:
+  ImageSourceEngine()
+  : max_order_(3),
+    max_time_(0.1f),
+    c_(344.f),
+    coef_idx_(0),
+    sinc_half_width_(8),
+    source_(nv::Vec3f(0.f, 0.f, 0.f)),
+    box_max_(nv::Vec3f(0.f, 0.f, 0.f))
+  {};
+
+  ~ImageSourceEngine() {};
+
+  struct image_t {
+    nv::Vec3f p;         ///< Position of the image source
+    int plane;           ///< The plane the image is mirrored over, -1 for the source
+    int parent;          ///< Index of the parent image, -1 for the source
+    unsigned int order;  ///< Reflection order
+  };
+
+  struct path_t {
+    float length;        ///< Length of the path in meters
+    float gain;          ///< Product of the reflection coefficients divided by length
+    unsigned int order;  ///< Reflection order of the path
+  };
+
+  /////////////////////////////////////////////////////////////////////////////
+  /// \brief Build the reflecting planes and the visibility structure
+  /// \param geometry The geometry of the model, the same used in the FDTD
+  /// \param materials The materials of each triangle of the model
+  /////////////////////////////////////////////////////////////////////////////
+  void initialize(GeometryHandler* geometry, MaterialHandler* materials);
+
+  /////////////////////////////////////////////////////////////////////////////
+  /// \brief Generate the image sources of a source position. Images whose
+  /// all paths would arrive after the max time are culled with their children
+  /// \param source The position of the source in the model coordinates
+  /// \return The number of image sources generated
+  /////////////////////////////////////////////////////////////////////////////
+  unsigned int computeImageSources(nv::Vec3f source);
+
+  /////////////////////////////////////////////////////////////////////////////
+  /// \brief Validate the image sources for a receiver
+  /// \param receiver The position of the receiver in the model coordinates
+  /// \return The valid paths including the direct sound if it is visible
+  /////////////////////////////////////////////////////////////////////////////
+  std::vector<path_t> getPaths(nv::Vec3f receiver);
+
+  /////////////////////////////////////////////////////////////////////////////
+  /// \brief Render the valid paths to an impulse response. Each path is added
+  /// as a windowed sinc fractional delay with amplitude gain (R/r)
+  /// \param receiver The position of the receiver
+  /// \param fs The sampling frequency of the response
+  /// \param[in,out] response The response to which the paths are added
+  /// \return The number of valid paths
+  /////////////////////////////////////////////////////////////////////////////
+  unsigned int getResponse(nv::Vec3f receiver, unsigned int fs,
+                           std::vector<float>& response);
+
+  void setMaxOrder(unsigned int max_order) {this->max_order_ = max_order;}
+  void setMaxTime(float max_time) {this->max_time_ = max_time;}
+  void setC(float c) {this->c_ = c;}
+  /// \brief Set which material coefficient is used, call before initialize()
+  void setCoefIdx(unsigned int coef_idx) {this->coef_idx_ = coef_idx;}
+
+  unsigned int getMaxOrder() {return this->max_order_;}
+  float getMaxTime() {return this->max_time_;}
+  unsigned int getNumberOfPlanes() {return (unsigned int)this->plane_d_.size();}
+  unsigned int getNumberOfImageSources() {return (unsigned int)this->images_.size();}
+
+private:
+  unsigned int max_order_;         ///< Maximum reflection order
+  float max_time_;                 ///< Paths longer than c*max_time are discarded
+  float c_;                        ///< Speed of sound
+  unsigned int coef_idx_;          ///< Which material coefficient is used
+  unsigned int sinc_half_width_;   ///< Half width of the fractional delay filter
+
+  nv::Vec3f source_;               ///< Position of the current source
+  nv::Vec3f box_max_;              ///< Bounding box max of the model, min at 0
+
+  std::vector<nv::Vec3f> plane_normals_;                 ///< Unit normal of each plane
+  std::vector<float> plane_d_;                           ///< n.x = d
+  std::vector< std::vector<unsigned int> > plane_tris_;  ///< Triangles on each plane
+  std::vector<float> triangles_;                         ///< Vertices, 9 per triangle
+  std::vector<float> reflection_;                        ///< Reflection coefficient of each triangle
+  std::vector<image_t> images_;                          ///< Images of the current source
+
+  Bvh bvh_;
+
+  /// \return the index of the triangle of the plane containing point p,
+  /// -1 if p is not on any of the triangles
+  int findTriangleOnPlane(int plane, nv::Vec3f p);
+
+  /// \return the shortest distance from a point to the bounding box
+  float distanceToBox(nv::Vec3f p);
+};
+
+#endif
@@ -225,6 +225,9 @@ public:
     if(partition < (int)np) ret = (unsigned int)this->partition_indexing_.at(partition).size();   
     return ret;}
   
+  const std::vector< std::vector<unsigned int> >& getPartitionSlices() const
+    {return this->partition_indexing_;}
+
   unsigned int getFirstSliceIdx(int partition) {return this->partition_indexing_.at(partition).at(0);}
   unsigned int getDeviceAt(int i) {return this->device_list_.at(i);}
   unsigned int getBlockX() {return this->block_size_x_;}
@@ -277,7 +280,7 @@ public:
     return ret;
   }
 
-  std::vector< std::vector <unsigned int> > getPartitionIndexing(int num_parts,
+  static std::vector< std::vector <unsigned int> > getPartitionIndexing(int num_parts,
                                                                  int dim) {
     int part_size = dim/num_parts;
     std::vector< std::vector<unsigned int> > ret;
@@ -363,7 +366,7 @@ public:
       T* dest = domain.at(i)+getElementIndex(x, y, z-first);
       cudasafe(cudaMemcpy(&domain_smp, dest, sizeof(T), cudaMemcpyDeviceToHost), "addSample T : Memcopy To Host");
       domain_smp+=sample;
-      cudasafe(cudaMemcpy(dest, &sample, sizeof(T), cudaMemcpyHostToDevice), "addSample T : Memcopy To Device");
+      cudasafe(cudaMemcpy(dest, &domain_smp, sizeof(T), cudaMemcpyHostToDevice), "addSample T : Memcopy To Device");
         
     }  
   }
@@ -647,6 +650,15 @@ public:
 
   void makePartition(unsigned int number_of_partitions, 
                      std::vector<unsigned int> device_list = std::vector<unsigned int>()) {
+    this->makePartition(getPartitionIndexing(number_of_partitions, this->getDimZ()),
+                        device_list);
+  }
+
+  /// \brief Partition the mesh with a given slice indexing, see
+  /// getPartitionIndexing() and PartitionPlanner
+  void makePartition(std::vector< std::vector<unsigned int> > partition_indexing,
+                     std::vector<unsigned int> device_list = std::vector<unsigned int>()) {
+    unsigned int number_of_partitions = (unsigned int)partition_indexing.size();
     c_log_msg(LOG_INFO, "CudaMesh::makePartition - begin, number of partitions %d, dim z %u", 
               number_of_partitions, this->getDimZ());
 
@@ -659,7 +671,7 @@ public:
     }
 
     this->device_list_ = device_list;
-    this->partition_indexing_ = getPartitionIndexing(number_of_partitions, this->getDimZ());
+    this->partition_indexing_ = partition_indexing;
     
     clock_t start_t;
     clock_t end_t;
@@ -781,11 +793,15 @@ public:
   /// \brief reset pressure values of the mesh to 0
   void resetPressures() {
     for(unsigned int i = 0; i < this->getNumberOfPartitions(); i++){
-      float* temp = this->pressures_.at(i);
-      float* temp_past = this->pressures_past_.at(i);
       unsigned int num_elements = this->getNumberOfElementsAt(i);
-      resetData(num_elements, temp, i);
-      resetData(num_elements, temp_past, i);
+      if(this->isDouble()) {
+        resetData(num_elements, this->pressures_double_.at(i), this->getDeviceAt(i));
+        resetData(num_elements, this->pressures_past_double_.at(i), this->getDeviceAt(i));
+      }
+      else {
+        resetData(num_elements, this->pressures_.at(i), this->getDeviceAt(i));
+        resetData(num_elements, this->pressures_past_.at(i), this->getDeviceAt(i));
+      }
     }
     cudasafe(cudaDeviceSynchronize(), "Device synch after reset pressures");
   }
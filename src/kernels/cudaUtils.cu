@@ -106,6 +106,7 @@ void resetData(unsigned int mem_size, float* d_data, unsigned int device) {
 template <>
 void resetData(unsigned int mem_size, double* d_data, unsigned int device) {
   c_log_msg(LOG_DEBUG, "cudaUtils.cu: resetDouble(data) - mem_size %u, device %d", mem_size, device);
+  cudasafe(cudaSetDevice(device), "resetData: cudaSetDevice");
 
   dim3 block(128);
   dim3 grid(mem_size/block.x+1);
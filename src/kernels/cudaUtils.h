@@ -143,6 +143,13 @@ void copyDeviceToHost(unsigned int mem_size, T* h_dest, T* d_src, unsigned int d
     cudasafe(cudaMemcpy(h_dest, d_src,  mem_size*sizeof(T), cudaMemcpyDeviceToHost), "Memcopy");
 }
 
+template < typename T>
+void copyDeviceToDevice(unsigned int mem_size, T* d_dest, const T* d_src, unsigned int device) {
+    cudasafe(cudaSetDevice(device), " copyDeviceToDevice: cudaSetDevice");
+    c_log_msg(LOG_DEBUG, "cudaUtils.cu: T copyDeviceToDevice - mem_size %u, device %u", mem_size, device);
+    cudasafe(cudaMemcpy(d_dest, d_src,  mem_size*sizeof(T), cudaMemcpyDeviceToDevice), "Memcopy");
+}
+
 int getCurrentDevice();
 
 void printMemInfo(const char* message, int device);
@@ -23,11 +23,423 @@
 #include "../global_includes.h"
 #include "kernels3d.h"
 #include "cudaUtils.h"
+#include "../base/MaterialHandler.h"
 
 #include <math.h>
 #include <stdio.h>
 #include <stdarg.h>
 
+// A SourceBank on the devices of the partitions, the buffers of the samples
+// hold a chunk of steps and are refilled by uploadSourceChunk()
+template <typename T>
+struct DeviceSourceBank {
+  std::vector<unsigned int*> element_idx;
+  std::vector<unsigned char*> hard;
+  std::vector<T*> samples;
+  std::vector<unsigned int> num_entries;
+
+  std::vector<unsigned int*> segment_element;
+  std::vector<unsigned int*> segment_begin;
+  std::vector<unsigned int*> tap_signal;
+  std::vector<unsigned int*> tap_delay;
+  std::vector<T*> tap_gain;
+  std::vector<T*> tap_gain_frac;
+  std::vector<T*> array_signals;
+  std::vector<unsigned int> num_segments;
+  unsigned int window_steps;
+  unsigned int history_steps;
+
+  std::vector<unsigned int*> moving_element;
+  std::vector<T*> moving_value;
+  unsigned int num_moving;
+  unsigned int chunk_steps;
+};
+
+template <typename T>
+static void sourceBankToDevice(CudaMesh* d_mesh, const SourceBank<T>& bank,
+                               DeviceSourceBank<T>* d_bank) {
+  for(unsigned int i = 0; i < bank.getNumberOfPartitions(); i++) {
+    unsigned int num_entries = bank.getNumberOfEntries(i);
+    unsigned int dev = d_mesh->getDeviceAt(i);
+    d_bank->num_entries.push_back(num_entries);
+    if(num_entries == 0) {
+      d_bank->element_idx.push_back((unsigned int*)NULL);
+      d_bank->hard.push_back((unsigned char*)NULL);
+      d_bank->samples.push_back((T*)NULL);
+      continue;
+    }
+    d_bank->element_idx.push_back(toDevice<unsigned int>(num_entries, &bank.getElementIndices(i)[0], dev));
+    d_bank->hard.push_back(toDevice<unsigned char>(num_entries, &bank.getHardFlags(i)[0], dev));
+    d_bank->samples.push_back(toDevice<T>((unsigned int)bank.getSamples(i).size(),
+                                          &bank.getSamples(i)[0], dev));
+  }
+
+  d_bank->window_steps = bank.getWindowSteps();
+  d_bank->history_steps = bank.getHistorySteps();
+  d_bank->chunk_steps = bank.getChunkSteps();
+  for(unsigned int i = 0; i < bank.getNumberOfPartitions(); i++) {
+    unsigned int num_segments = bank.getNumberOfSegments(i);
+    unsigned int dev = d_mesh->getDeviceAt(i);
+    d_bank->num_segments.push_back(num_segments);
+    if(num_segments == 0) {
+      d_bank->segment_element.push_back((unsigned int*)NULL);
+      d_bank->segment_begin.push_back((unsigned int*)NULL);
+      d_bank->tap_signal.push_back((unsigned int*)NULL);
+      d_bank->tap_delay.push_back((unsigned int*)NULL);
+      d_bank->tap_gain.push_back((T*)NULL);
+      d_bank->tap_gain_frac.push_back((T*)NULL);
+      d_bank->array_signals.push_back((T*)NULL);
+      continue;
+    }
+    unsigned int num_taps = (unsigned int)bank.getTapSignals(i).size();
+    d_bank->segment_element.push_back(toDevice<unsigned int>(num_segments, &bank.getSegmentElements(i)[0], dev));
+    d_bank->segment_begin.push_back(toDevice<unsigned int>(num_segments+1, &bank.getSegmentTaps(i)[0], dev));
+    d_bank->tap_signal.push_back(toDevice<unsigned int>(num_taps, &bank.getTapSignals(i)[0], dev));
+    d_bank->tap_delay.push_back(toDevice<unsigned int>(num_taps, &bank.getTapDelays(i)[0], dev));
+    d_bank->tap_gain.push_back(toDevice<T>(num_taps, &bank.getTapGains(i)[0], dev));
+    d_bank->tap_gain_frac.push_back(toDevice<T>(num_taps, &bank.getTapFractionGains(i)[0], dev));
+    d_bank->array_signals.push_back(toDevice<T>((unsigned int)bank.getArraySignals(i).size(),
+                                                &bank.getArraySignals(i)[0], dev));
+  }
+
+  d_bank->num_moving = bank.getNumberOfMovingSources();
+  for(unsigned int i = 0; i < bank.getNumberOfPartitions(); i++) {
+    unsigned int dev = d_mesh->getDeviceAt(i);
+    unsigned int num_corners = (unsigned int)bank.getMovingElements(i).size();
+    if(num_corners == 0) {
+      d_bank->moving_element.push_back((unsigned int*)NULL);
+      d_bank->moving_value.push_back((T*)NULL);
+      continue;
+    }
+    d_bank->moving_element.push_back(toDevice<unsigned int>(num_corners, &bank.getMovingElements(i)[0], dev));
+    d_bank->moving_value.push_back(toDevice<T>(num_corners, &bank.getMovingValues(i)[0], dev));
+  }
+}
+
+// Fill the chunk of the sources starting at a step and copy it to the
+// device of the partition, the buffers keep their size
+template <typename T>
+static void uploadSourceChunk(CudaMesh* d_mesh, SourceBank<T>* bank,
+                              DeviceSourceBank<T>* d_bank, unsigned int partition,
+                              unsigned int step) {
+  unsigned int dev = d_mesh->getDeviceAt(partition);
+  bank->fill(partition, step);
+  if(d_bank->num_entries.at(partition) > 0)
+    copyHostToDevice((unsigned int)bank->getSamples(partition).size(),
+                     d_bank->samples.at(partition),
+                     (T*)&bank->getSamples(partition)[0], dev);
+  if(d_bank->num_segments.at(partition) > 0)
+    copyHostToDevice((unsigned int)bank->getArraySignals(partition).size(),
+                     d_bank->array_signals.at(partition),
+                     (T*)&bank->getArraySignals(partition)[0], dev);
+  if(d_bank->moving_element.at(partition) != NULL) {
+    unsigned int num_corners = (unsigned int)bank->getMovingElements(partition).size();
+    copyHostToDevice(num_corners, d_bank->moving_element.at(partition),
+                     (unsigned int*)&bank->getMovingElements(partition)[0], dev);
+    copyHostToDevice(num_corners, d_bank->moving_value.at(partition),
+                     (T*)&bank->getMovingValues(partition)[0], dev);
+  }
+}
+
+template <typename T>
+static void destroySourceBank(CudaMesh* d_mesh, DeviceSourceBank<T>* d_bank) {
+  for(unsigned int i = 0; i < d_bank->num_entries.size(); i++) {
+    if(d_bank->num_entries.at(i) == 0) continue;
+    unsigned int dev = d_mesh->getDeviceAt(i);
+    destroyMem(d_bank->element_idx.at(i), dev);
+    destroyMem(d_bank->hard.at(i), dev);
+    destroyMem(d_bank->samples.at(i), dev);
+  }
+  for(unsigned int i = 0; i < d_bank->num_segments.size(); i++) {
+    if(d_bank->num_segments.at(i) == 0) continue;
+    unsigned int dev = d_mesh->getDeviceAt(i);
+    destroyMem(d_bank->segment_element.at(i), dev);
+    destroyMem(d_bank->segment_begin.at(i), dev);
+    destroyMem(d_bank->tap_signal.at(i), dev);
+    destroyMem(d_bank->tap_delay.at(i), dev);
+    destroyMem(d_bank->tap_gain.at(i), dev);
+    destroyMem(d_bank->tap_gain_frac.at(i), dev);
+    destroyMem(d_bank->array_signals.at(i), dev);
+  }
+  for(unsigned int i = 0; i < d_bank->moving_element.size(); i++) {
+    if(d_bank->moving_element.at(i) == NULL) continue;
+    unsigned int dev = d_mesh->getDeviceAt(i);
+    destroyMem(d_bank->moving_element.at(i), dev);
+    destroyMem(d_bank->moving_value.at(i), dev);
+  }
+}
+
+// Launched on the device of the partition in the default stream, the
+// stencil launched after it sees the injected pressures
+template <typename T>
+static void launchInjectSources(const DeviceSourceBank<T>& d_bank, unsigned int partition,
+                                T* P, unsigned int step) {
+  unsigned int threads = 128;
+  unsigned int slot = step%d_bank.chunk_steps;
+  unsigned int num_entries = d_bank.num_entries.at(partition);
+  if(num_entries > 0)
+    injectSources<T><<<(num_entries+threads-1)/threads, threads>>>(P,
+        d_bank.element_idx.at(partition), d_bank.hard.at(partition),
+        d_bank.samples.at(partition)+(size_t)slot*num_entries, num_entries);
+
+  // The array sources are added after the point sources
+  unsigned int num_segments = d_bank.num_segments.at(partition);
+  if(num_segments > 0)
+    injectArraySources<T><<<(num_segments+threads-1)/threads, threads>>>(P,
+        d_bank.segment_element.at(partition), d_bank.segment_begin.at(partition),
+        d_bank.tap_signal.at(partition), d_bank.tap_delay.at(partition),
+        d_bank.tap_gain.at(partition), d_bank.tap_gain_frac.at(partition),
+        d_bank.array_signals.at(partition), d_bank.window_steps, step,
+        slot+d_bank.history_steps, num_segments);
+
+  // The moving sources last
+  if(d_bank.num_moving > 0 && d_bank.moving_element.at(partition) != NULL) {
+    size_t offset = (size_t)slot*d_bank.num_moving*8;
+    injectMovingSources<T><<<1, 8>>>(P, d_bank.moving_element.at(partition)+offset,
+                                     d_bank.moving_value.at(partition)+offset,
+                                     d_bank.num_moving);
+  }
+}
+
+static float* getPressureAt(CudaMesh* d_mesh, unsigned int i, float*)
+  {return d_mesh->getPressurePtrAt(i);}
+static double* getPressureAt(CudaMesh* d_mesh, unsigned int i, double*)
+  {return d_mesh->getPressureDoublePtrAt(i);}
+
+// The ring buffers of a ReceiverBank on the devices of the partitions
+template <typename T>
+struct DeviceReceiverBank {
+  std::vector<unsigned int*> element_idx;
+  std::vector<unsigned int*> minus_idx;   ///< NULL without velocity channels
+  std::vector<T*> ring;
+};
+
+template <typename T>
+static void setupReceiverBank(CudaMesh* d_mesh, SimulationParameters* sp,
+                              ReceiverBank<T>* bank, DeviceReceiverBank<T>* d_bank) {
+  bank->setup(d_mesh->getNumberOfPartitions(), sp->getNumSteps());
+  bank->setResampler(sp->getResampler());
+  bank->setWriter(sp->getResponseWriter());
+  bank->setGradientScale((T)sp->getLambda());
+  for(unsigned int i = 0; i < sp->getNumReceivers(); i++) {
+    if(sp->isReceiverMoving(i)) {
+      if(sp->getResponseWriter())
+        c_log_msg(LOG_WARNING, "kernels3d.cu: setupReceiverBank - moving receiver %u is not streamed", i);
+      continue;
+    }
+    nv::Vec3i pos = sp->getReceiverElementCoordinates(i);
+    int element_idx;
+    int device_idx;
+    enum ReceiverComponent component = sp->getReceiverComponent(i);
+    if(component == RECEIVER_PRESSURE) {
+      d_mesh->getElementIdxAndDevice(pos.x, pos.y, pos.z, &device_idx, &element_idx);
+      if(device_idx == -1)
+        continue;
+      bank->addReceiver((unsigned int)device_idx, (unsigned int)element_idx, i);
+      continue;
+    }
+
+    // A velocity channel is read from a partition which updates the node,
+    // so both neighbours are on the device
+    device_idx = -1;
+    for(unsigned int p = 0; p < d_mesh->getNumberOfPartitions(); p++) {
+      int first = (int)d_mesh->getFirstSliceIdx(p);
+      if(pos.z > first && pos.z < first+(int)d_mesh->getPartitionSize(p)-1) {
+        device_idx = (int)p;
+        element_idx = d_mesh->getElementIndex(pos.x, pos.y, pos.z-first);
+        break;
+      }
+    }
+    if(device_idx == -1 || pos.x < 1 || pos.y < 1 ||
+       pos.x+1 >= (int)d_mesh->getDimX() || pos.y+1 >= (int)d_mesh->getDimY()) {
+      c_log_msg(LOG_WARNING, "kernels3d.cu: setupReceiverBank - B-format receiver %u on the edge of the domain", i);
+      continue;
+    }
+    unsigned int offset = component == RECEIVER_X ? 1 :
+                          component == RECEIVER_Y ? d_mesh->getDimX() : d_mesh->getDimXY();
+    bank->addGradient((unsigned int)device_idx, (unsigned int)element_idx, i, offset);
+  }
+
+  // A plane of grid points lies on one device
+  sp->setupReceiverGrids(d_mesh->getDimX(), d_mesh->getDimY(), d_mesh->getDimZ());
+  for(unsigned int g = 0; g < sp->getNumReceiverGrids(); g++) {
+    ReceiverGrid* grid = &sp->getReceiverGrid(g);
+    unsigned int grid_idx = bank->addGrid(grid);
+    for(unsigned int z = 0; z < grid->getNumPointsZ(); z++) {
+      nv::Vec3i pos = grid->getPlaneOrigin(z);
+      int element_idx;
+      int device_idx;
+      d_mesh->getElementIdxAndDevice(pos.x, pos.y, pos.z, &device_idx, &element_idx);
+      if(device_idx == -1)
+        continue;
+      bank->addGridPlane((unsigned int)device_idx, (unsigned int)element_idx, grid_idx, z,
+                         d_mesh->getDimX());
+    }
+  }
+  bank->compile();
+
+  for(unsigned int p = 0; p < bank->getNumberOfPartitions(); p++) {
+    unsigned int num = bank->getNumberOfReceivers(p);
+    unsigned int dev = d_mesh->getDeviceAt(p);
+    unsigned int gradients = bank->getNumberOfGradients(p);
+    d_bank->minus_idx.push_back(gradients == 0 ? (unsigned int*)NULL
+                                : toDevice<unsigned int>(gradients, &bank->getMinusIndices(p)[0], dev));
+    if(num == 0) {
+      d_bank->element_idx.push_back((unsigned int*)NULL);
+      d_bank->ring.push_back((T*)NULL);
+      continue;
+    }
+    d_bank->element_idx.push_back(toDevice<unsigned int>(num, &bank->getElementIndices(p)[0], dev));
+    d_bank->ring.push_back(toDevice<T>(num*bank->getChunkSteps(), dev));
+  }
+}
+
+template <typename T>
+static void flushReceiverBank(CudaMesh* d_mesh, ReceiverBank<T>* bank,
+                              DeviceReceiverBank<T>* d_bank, unsigned int step,
+                              T* h_return_ptr) {
+  for(unsigned int p = 0; p < bank->getNumberOfPartitions(); p++) {
+    unsigned int num = bank->getNumberOfReceivers(p);
+    if(num == 0)
+      continue;
+    copyDeviceToHost(num*(bank->getSlot(step)+1), bank->getRing(p), d_bank->ring.at(p),
+                     d_mesh->getDeviceAt(p));
+    bank->flush(p, step, h_return_ptr);
+  }
+}
+
+// Gather the receivers of every partition, the ring buffers are copied to
+// the host when a chunk of steps is full
+template <typename T>
+static void gatherReceiverBank(CudaMesh* d_mesh, ReceiverBank<T>* bank,
+                               DeviceReceiverBank<T>* d_bank, unsigned int step,
+                               T* h_return_ptr) {
+  unsigned int threads = 128;
+  for(unsigned int p = 0; p < bank->getNumberOfPartitions(); p++) {
+    unsigned int num = bank->getNumberOfReceivers(p);
+    unsigned int gradients = bank->getNumberOfGradients(p);
+    if(num == gradients)
+      continue;
+    cudasafe(cudaSetDevice(d_mesh->getDeviceAt(p)), "kernels3d.cu: gatherReceiverBank - set device");
+    gatherReceivers<T><<<(num-gradients+threads-1)/threads, threads>>>(d_bank->ring.at(p)+bank->getSlot(step)*num+gradients,
+                                                                       getPressureAt(d_mesh, p, (T*)NULL),
+                                                                       d_bank->element_idx.at(p)+gradients,
+                                                                       num-gradients);
+  }
+  if(bank->isChunkEnd(step))
+    flushReceiverBank(d_mesh, bank, d_bank, step, h_return_ptr);
+}
+
+// Gather the velocity channels of every partition before the update, the
+// halos hold the level the update reads
+template <typename T>
+static void gatherGradientBank(CudaMesh* d_mesh, ReceiverBank<T>* bank,
+                               DeviceReceiverBank<T>* d_bank, unsigned int step) {
+  for(unsigned int p = 0; p < bank->getNumberOfPartitions(); p++) {
+    unsigned int gradients = bank->getNumberOfGradients(p);
+    if(gradients == 0)
+      continue;
+    cudasafe(cudaSetDevice(d_mesh->getDeviceAt(p)), "kernels3d.cu: gatherGradientBank - set device");
+    launchGatherGradients<T>(getPressureAt(d_mesh, p, (T*)NULL), d_bank->element_idx.at(p),
+                             d_bank->minus_idx.at(p),
+                             d_bank->ring.at(p)+bank->getSlot(step)*bank->getNumberOfReceivers(p),
+                             gradients);
+  }
+}
+
+template <typename T>
+static void destroyReceiverBank(CudaMesh* d_mesh, DeviceReceiverBank<T>* d_bank) {
+  for(unsigned int p = 0; p < d_bank->ring.size(); p++) {
+    if(d_bank->minus_idx.at(p) != NULL)
+      destroyMem(d_bank->minus_idx.at(p), d_mesh->getDeviceAt(p));
+    if(d_bank->ring.at(p) == NULL) continue;
+    unsigned int dev = d_mesh->getDeviceAt(p);
+    destroyMem(d_bank->element_idx.at(p), dev);
+    destroyMem(d_bank->ring.at(p), dev);
+  }
+}
+
+// Moving receivers are interpolated from a partition holding both slices
+// of their cell. The partition may change between the steps, so each
+// partition gets a buffer of its own and the buffers are summed at the end
+template <typename T>
+struct DeviceMovingReceivers {
+  std::vector<Trajectory> trajectories;   ///< Empty for a static receiver
+  std::vector< std::vector<T*> > data;    ///< Buffer of each receiver and partition
+};
+
+template <typename T>
+static void setupMovingReceivers(CudaMesh* d_mesh, SimulationParameters* sp,
+                                 DeviceMovingReceivers<T>* d_moving) {
+  d_moving->trajectories.assign(sp->getNumReceivers(), Trajectory());
+  d_moving->data.assign(sp->getNumReceivers(), std::vector<T*>());
+  for(unsigned int i = 0; i < sp->getNumReceivers(); i++) {
+    if(!sp->isReceiverMoving(i))
+      continue;
+    d_moving->trajectories.at(i) = sp->getReceiverTrajectory(i);
+    d_moving->data.at(i).assign(d_mesh->getNumberOfPartitions(), (T*)NULL);
+  }
+}
+
+template <typename T>
+static void gatherMovingReceivers(CudaMesh* d_mesh, DeviceMovingReceivers<T>* d_moving,
+                                  unsigned int step) {
+  const std::vector< std::vector<unsigned int> >& slices = d_mesh->getPartitionSlices();
+  for(unsigned int i = 0; i < d_moving->data.size(); i++) {
+    if(d_moving->data.at(i).empty())
+      continue;
+    nv::Vec3i base;
+    nv::Vec3f frac;
+    d_moving->trajectories.at(i).getCell(step, d_mesh->getDimX(), d_mesh->getDimY(),
+                                         d_mesh->getDimZ(), base, frac);
+    unsigned int p = 0;
+    while(p < slices.size() &&
+          (slices.at(p).empty() || (unsigned int)base.z < slices.at(p).front() ||
+           (unsigned int)base.z+1 > slices.at(p).back()))
+      p++;
+    if(p == slices.size())
+      continue;
+
+    unsigned int dev = d_mesh->getDeviceAt(p);
+    T*& dest = d_moving->data.at(i).at(p);
+    if(dest == NULL)
+      dest = toDevice<T>(d_moving->trajectories.at(i).getNumSteps(), dev);
+    cudasafe(cudaSetDevice(dev), "kernels3d.cu: gatherMovingReceivers - set device");
+    T* P = getPressureAt(d_mesh, p, (T*)NULL)+
+           d_mesh->getElementIndex(base.x, base.y, base.z-slices.at(p).front());
+    gatherMovingReceiver<T><<<1, 1>>>(dest+step, P, d_mesh->getDimX(), d_mesh->getDimXY(),
+                                      (T)frac.x, (T)frac.y, (T)frac.z);
+  }
+}
+
+// The responses are summed over the partitions at the spatial fs and
+// resampled as the responses of the bank
+template <typename T>
+static void movingReceiversToHost(CudaMesh* d_mesh, DeviceMovingReceivers<T>* d_moving,
+                                  const ReceiverBank<T>* bank, T* h_return_ptr,
+                                  unsigned int num_steps) {
+  std::vector<T> buffer(num_steps);
+  std::vector<T> response(num_steps);
+  for(unsigned int i = 0; i < d_moving->data.size(); i++) {
+    if(d_moving->data.at(i).empty())
+      continue;
+    for(unsigned int k = 0; k < num_steps; k++)
+      response[k] = (T)0;
+    for(unsigned int p = 0; p < d_moving->data.at(i).size(); p++) {
+      T* src = d_moving->data.at(i).at(p);
+      if(src == NULL)
+        continue;
+      unsigned int dev = d_mesh->getDeviceAt(p);
+      copyDeviceToHost(num_steps, &buffer[0], src, dev);
+      destroyMem(src, dev);
+      for(unsigned int k = 0; k < num_steps; k++)
+        response[k] += buffer[k];
+    }
+    if(h_return_ptr)
+      bank->writeResponse(i, &response[0], h_return_ptr);
+  }
+}
+
 float launchFDTD3d(CudaMesh* d_mesh,
                    SimulationParameters* sp,
                    float* h_return_ptr,
@@ -63,19 +475,18 @@ float launchFDTD3d(CudaMesh* d_mesh,
   /////////////////////////////////////////////////////////////////////////////
   // Allocate return data on the device
 
-  std::vector< std::pair <float*, std::pair<int, int> > > d_receiver_data;
-  for(unsigned int i = 0; i < sp->getNumReceivers(); i++) {
-    nv::Vec3i pos = sp->getReceiverElementCoordinates(i);
-    int element_idx;
-    int device_idx;
-    d_mesh->getElementIdxAndDevice(pos.x, pos.y, pos.z, &device_idx, &element_idx);
-    float* d_return_ptr = (float*)NULL;
-    if(device_idx != -1)
-      d_return_ptr = toDevice<float>(sp->getNumSteps(), d_mesh->getDeviceAt(device_idx));
-    std::pair<int, int> temp_i(element_idx, device_idx);
-    std::pair<float*, std::pair<int,int> > temp_d(d_return_ptr, temp_i);
-    d_receiver_data.push_back(temp_d);
-  }
+  // The static receivers are gathered to ring buffers on the devices
+  ReceiverBank<float> receivers;
+  DeviceReceiverBank<float> d_receivers;
+  setupReceiverBank(d_mesh, sp, &receivers, &d_receivers);
+
+  DeviceMovingReceivers<float> d_moving;
+  setupMovingReceivers(d_mesh, sp, &d_moving);
+
+  SourceBank<float> bank;
+  bank.compile(sp, d_mesh->getDimX(), d_mesh->getDimY(), d_mesh->getPartitionSlices());
+  DeviceSourceBank<float> d_bank;
+  sourceBankToDevice(d_mesh, bank, &d_bank);
 
   unsigned int step;
   cudaDeviceSetCacheConfig(cudaFuncCachePreferL1);
@@ -88,27 +499,15 @@ float launchFDTD3d(CudaMesh* d_mesh,
       break;
     }
 
-    ///////// Source Loop
-    
-    for(unsigned int i = 0; i < sp->getNumSources(); i++) {
-      float sample = sp->getSourceSample(i, step);
-      nv::Vec3i pos = sp->getSourceElementCoordinates(i);
-      
-      if(sp->getSource(i).getSourceType() == SRC_HARD) {
-        d_mesh->setSample<float>(sample, pos.x, pos.y, pos.z);
-      }
-      else {
-        float h_sample = sp->getSourceSample(i, step);
-        d_mesh->addSample<float>(h_sample, pos.x, pos.y, pos.z);
-      }
-    }
-    
-    cudasafe(cudaDeviceSynchronize(), "kernels3d.cu: launchFDTD3d - cudaDeviceSynchronize after Source insert");
-    
-    ////// FDTD partition loop
+    gatherGradientBank(d_mesh, &receivers, &d_receivers, step);
+
+    ////// FDTD partition loop, the sources are injected before the update
     for(unsigned int i = 0; i < d_mesh->getNumberOfPartitions(); i++) {
       cudasafe(cudaSetDevice(d_mesh->getDeviceAt(i)), "kernels3d.cu: launchFDTD3d - set device");
-      
+      if(bank.isChunkBegin(step) && step > 0)
+        uploadSourceChunk(d_mesh, &bank, &d_bank, i, step);
+      launchInjectSources(d_bank, i, d_mesh->getPressurePtrAt(i), step);
+
       grid.z = d_mesh->getPartitionSize(i);
       grid.z = grid.z-2;
 
@@ -161,16 +560,8 @@ float launchFDTD3d(CudaMesh* d_mesh,
     d_mesh->switchHalos();
     
     /////// Receiver loop
-    for(unsigned int i = 0; i < sp->getNumReceivers(); i++) {
-      nv::Vec3i pos = sp->getReceiverElementCoordinates(i);
-      int d_idx = d_receiver_data.at(i).second.second;
-      int e_idx = d_receiver_data.at(i).second.first;
-      if(d_receiver_data.at(i).second.second == -1) continue;
-      float* dest = (d_receiver_data.at(i).first)+step;
-      float* src = d_mesh->getPressurePtrAt(d_idx)+e_idx;
-      cudaSetDevice(d_mesh->getDeviceAt(d_idx));
-      cudasafe(cudaMemcpy(dest, src,  sizeof(float), cudaMemcpyDeviceToDevice), "Memcopy");
-    } // End receiver Loop
+    gatherReceiverBank(d_mesh, &receivers, &d_receivers, step, h_return_ptr);
+    gatherMovingReceivers(d_mesh, &d_moving, step);
 
     cudasafe(cudaDeviceSynchronize(), "cudaDeviceSynchronize after step");
     if((step%PROGRESS_MOD) == 0) {
@@ -180,17 +571,15 @@ float launchFDTD3d(CudaMesh* d_mesh,
 
   }// End step loop
 
-  /////// Copy device return data to host
-  for(unsigned int i = 0; i < sp->getNumReceivers(); i++) {
-    float* dest = h_return_ptr+i*sp->getNumSteps();
-    float* src = d_receiver_data.at(i).first;
-    if(d_receiver_data.at(i).second.second == -1) continue;
-    int dev = d_mesh->getDeviceAt(d_receiver_data.at(i).second.second);
-    copyDeviceToHost(sp->getNumSteps(), dest, src, dev);
-    destroyMem(d_receiver_data.at(i).first, dev);
-  } // End receiver Loop
+  /////// Copy the samples of an interrupted chunk to host
+  if(step > 0 && !receivers.isChunkEnd(step-1))
+    flushReceiverBank(d_mesh, &receivers, &d_receivers, step-1, h_return_ptr);
+  destroyReceiverBank(d_mesh, &d_receivers);
 
 
+  movingReceiversToHost(d_mesh, &d_moving, &receivers, h_return_ptr, sp->getNumSteps());
+  destroySourceBank(d_mesh, &d_bank);
+
   cudasafe(cudaDeviceSynchronize(), "cudaDeviceSynchronize before return");
   
   end_t = clock()-start_t;
@@ -231,21 +620,19 @@ float launchFDTD3dDouble(CudaMesh* d_mesh,
   /////////////////////////////////////////////////////////////////////////////
   // Allocate return data on the device
 
-  std::vector< std::pair <double*, std::pair<int, int> > > d_receiver_data;
-  for(unsigned int i = 0; i < sp->getNumReceivers(); i++) {
-    c_log_msg(LOG_INFO, "kernel3d.cu: launchFDTD3dDouble - allocating receiver %u", i);
-    nv::Vec3i pos = sp->getReceiverElementCoordinates(i);
-    int element_idx;
-    int device_idx;
-    d_mesh->getElementIdxAndDevice(pos.x, pos.y, pos.z, &device_idx, &element_idx);
-    double* d_return_ptr = (double*)NULL;
-    if(device_idx != -1)
-      d_return_ptr = toDevice<double>(sp->getNumSteps(), d_mesh->getDeviceAt(device_idx));
-    std::pair<int, int> temp_i(element_idx, device_idx);
-    std::pair<double*, std::pair<int,int> > temp_d(d_return_ptr, temp_i);
-    d_receiver_data.push_back(temp_d);
-  }
+  // The static receivers are gathered to ring buffers on the devices
+  ReceiverBank<double> receivers;
+  DeviceReceiverBank<double> d_receivers;
+  setupReceiverBank(d_mesh, sp, &receivers, &d_receivers);
   c_log_msg(LOG_INFO, "kernel3d.cu: launchFDTD3dDouble - after recevier allocation");
+
+  DeviceMovingReceivers<double> d_moving;
+  setupMovingReceivers(d_mesh, sp, &d_moving);
+
+  SourceBank<double> bank;
+  bank.compile(sp, d_mesh->getDimX(), d_mesh->getDimY(), d_mesh->getPartitionSlices());
+  DeviceSourceBank<double> d_bank;
+  sourceBankToDevice(d_mesh, bank, &d_bank);
   
   unsigned int step;
   cudaDeviceSetCacheConfig(cudaFuncCachePreferL1);
@@ -259,22 +646,14 @@ float launchFDTD3dDouble(CudaMesh* d_mesh,
       break;
     }
     
-    ///////// Source Loop
-    for(unsigned int i = 0; i < sp->getNumSources(); i++) {
-      double sample = sp->getSourceSampleDouble(i, step);
-      nv::Vec3i pos = sp->getSourceElementCoordinates(i);
-      if(sp->getSource(i).getSourceType() == SRC_HARD) {
-        d_mesh->setSample<double>(sample, pos.x, pos.y, pos.z);
-      }
-      else {
-        d_mesh->addSample<double>(sample, pos.x, pos.y, pos.z);
-      }
-    }
-    
-    cudasafe(cudaDeviceSynchronize(), "kernels3d.cu: launchFDTD3dDouble - cudaDeviceSynchronize after Source insert");
-    ////// FDTD partition loop
+    gatherGradientBank(d_mesh, &receivers, &d_receivers, step);
+
+    ////// FDTD partition loop, the sources are injected before the update
     for(unsigned int i = 0; i < d_mesh->getNumberOfPartitions(); i++) {
       cudasafe(cudaSetDevice(d_mesh->getDeviceAt(i)), "kernels3d.cu: launchFDTD3dDouble - set device");
+      if(bank.isChunkBegin(step) && step > 0)
+        uploadSourceChunk(d_mesh, &bank, &d_bank, i, step);
+      launchInjectSources(d_bank, i, d_mesh->getPressureDoublePtrAt(i), step);
 
       grid.z = d_mesh->getPartitionSize(i);
       grid.z = grid.z-2;
@@ -329,17 +708,8 @@ float launchFDTD3dDouble(CudaMesh* d_mesh,
     d_mesh->switchHalos();
 
     /////// Receiver loop
-    
-    for(unsigned int i = 0; i < sp->getNumReceivers(); i++) {
-      nv::Vec3i pos = sp->getReceiverElementCoordinates(i);
-      int d_idx = d_receiver_data.at(i).second.second;
-      int e_idx = d_receiver_data.at(i).second.first;
-      if(d_idx == -1) continue;
-      double* dest = (d_receiver_data.at(i).first)+step;
-      double* src = d_mesh->getPressureDoublePtrAt(d_idx)+e_idx;
-      cudaSetDevice(d_mesh->getDeviceAt(d_idx));
-      cudasafe(cudaMemcpy(dest, src,  sizeof(double), cudaMemcpyDeviceToDevice), "Memcopy");
-    } // End receiver Loop
+    gatherReceiverBank(d_mesh, &receivers, &d_receivers, step, h_return_ptr);
+    gatherMovingReceivers(d_mesh, &d_moving, step);
     
     cudasafe(cudaDeviceSynchronize(), "cudaDeviceSynchronize after step");
 
@@ -349,16 +719,14 @@ float launchFDTD3dDouble(CudaMesh* d_mesh,
     }
   }// End step loop
 
-   /////// Copy device return data to host
-  for(unsigned int i = 0; i < sp->getNumReceivers(); i++) {
-    double* dest = h_return_ptr+i*sp->getNumSteps();
-    double* src = d_receiver_data.at(i).first;
-    if(d_receiver_data.at(i).second.second == -1) continue;
-    int dev = d_mesh->getDeviceAt(d_receiver_data.at(i).second.second);
-    copyDeviceToHost(sp->getNumSteps(), dest, src, dev);
-    destroyMem(d_receiver_data.at(i).first, dev);
-  } // End receiver Loop
+  /////// Copy the samples of an interrupted chunk to host
+  if(step > 0 && !receivers.isChunkEnd(step-1))
+    flushReceiverBank(d_mesh, &receivers, &d_receivers, step-1, h_return_ptr);
+  destroyReceiverBank(d_mesh, &d_receivers);
+
 
+  movingReceiversToHost(d_mesh, &d_moving, &receivers, h_return_ptr, sp->getNumSteps());
+  destroySourceBank(d_mesh, &d_bank);
 
   cudasafe(cudaDeviceSynchronize(), "cudaDeviceSynchronize before return");
   
@@ -378,12 +746,12 @@ void launchFDTD3dStep(CudaMesh* d_mesh,
                       float* h_return_ptr,
                       unsigned int step,
                       int step_direction,
+                      int* past_step_direction,
                       void (*progressCallback)(int, int, float)) {
   
     clock_t step_start, step_end;
     step_start = clock();
     
-    static int past_step_directon = 1;
     dim3 block(d_mesh->getBlockX(), d_mesh->getBlockY(), 1);
     dim3 grid(d_mesh->getGridDimX(),
               d_mesh->getGridDimY(),
@@ -459,10 +827,10 @@ void launchFDTD3dStep(CudaMesh* d_mesh,
     
     ////// TODO boundary loop
     
-    if(past_step_directon == step_direction)
+    if(*past_step_direction == step_direction)
       d_mesh->flipPressurePointers();
     
-    past_step_directon = step_direction;
+    *past_step_direction = step_direction;
 
     d_mesh->switchHalos();
     
@@ -482,6 +850,220 @@ void launchFDTD3dStep(CudaMesh* d_mesh,
 }
 
 
+template <typename T>
+void launchFDTD3dSlices(const unsigned char* d_positions,
+                        const unsigned char* d_materials,
+                        const T* d_P, T* d_P_past,
+                        const T* d_params,
+                        const T* d_material_coefs,
+                        unsigned int dim_xy, unsigned int dim_x, unsigned int dim_y,
+                        unsigned int slice_begin, unsigned int slice_end,
+                        unsigned int update_type,
+                        unsigned int block_x, unsigned int block_y) {
+  if(slice_begin >= slice_end)
+    return;
+
+  size_t offset = (size_t)slice_begin*dim_xy;
+  dim3 block(block_x, block_y, 1);
+  dim3 grid(dim_x/block_x, dim_y/block_y, slice_end-slice_begin);
+
+  if(update_type == SRL_FORWARD)
+    fdtd3dStdMaterials<T><<<grid, block>>>(d_positions+offset, d_materials+offset,
+                                           d_P+offset, d_P_past+offset,
+                                           d_params, d_material_coefs,
+                                           dim_xy, dim_x);
+
+  if(update_type == SRL)
+    fdtd3dStdKowalczykMaterials<T><<<grid, block>>>((unsigned char*)d_positions+offset,
+                                                    (unsigned char*)d_materials+offset,
+                                                    d_P+offset, d_P_past+offset,
+                                                    d_params, d_material_coefs,
+                                                    dim_xy, dim_x);
+
+  if(update_type == SHARED) {
+    block.x = 32; block.y = 4;
+    grid.x = dim_x/32; grid.y = dim_y/4; grid.z = 1;
+    fdtd3dSliced<T,32,4><<<grid, block>>>(d_positions+offset, d_materials+offset,
+                                          d_P+offset, d_P_past+offset,
+                                          d_params, d_material_coefs,
+                                          dim_xy, dim_x, slice_end-slice_begin);
+  }
+
+  cudasafe(cudaPeekAtLastError(), "kernels3d.cu: launchFDTD3dSlices - Peek after launch");
+}
+
+template void launchFDTD3dSlices<float>(const unsigned char*, const unsigned char*,
+                                        const float*, float*, const float*, const float*,
+                                        unsigned int, unsigned int, unsigned int,
+                                        unsigned int, unsigned int, unsigned int,
+                                        unsigned int, unsigned int);
+
+template void launchFDTD3dSlices<double>(const unsigned char*, const unsigned char*,
+                                         const double*, double*, const double*, const double*,
+                                         unsigned int, unsigned int, unsigned int,
+                                         unsigned int, unsigned int, unsigned int,
+                                         unsigned int, unsigned int);
+
+template <typename T>
+void launchGatherReceivers(const T* d_P,
+                           const unsigned int* d_element_idx,
+                           T* d_dest,
+                           unsigned int num_receivers) {
+  if(num_receivers == 0)
+    return;
+  unsigned int threads = 128;
+  gatherReceivers<T><<<(num_receivers+threads-1)/threads, threads>>>(d_dest, d_P, d_element_idx,
+                                                                     num_receivers);
+  cudasafe(cudaPeekAtLastError(), "kernels3d.cu: launchGatherReceivers - Peek after launch");
+}
+
+template void launchGatherReceivers<float>(const float*, const unsigned int*, float*, unsigned int);
+template void launchGatherReceivers<double>(const double*, const unsigned int*, double*, unsigned int);
+
+template <typename T>
+void launchGatherGradients(const T* d_P,
+                           const unsigned int* d_plus,
+                           const unsigned int* d_minus,
+                           T* d_dest,
+                           unsigned int num_gradients) {
+  if(num_gradients == 0)
+    return;
+  unsigned int threads = 128;
+  gatherGradients<T><<<(num_gradients+threads-1)/threads, threads>>>(d_dest, d_P, d_plus, d_minus,
+                                                                     num_gradients);
+  cudasafe(cudaPeekAtLastError(), "kernels3d.cu: launchGatherGradients - Peek after launch");
+}
+
+template void launchGatherGradients<float>(const float*, const unsigned int*, const unsigned int*,
+                                           float*, unsigned int);
+template void launchGatherGradients<double>(const double*, const unsigned int*, const unsigned int*,
+                                            double*, unsigned int);
+
+template <typename T>
+void launchInjectSamples(T* d_P,
+                         const unsigned int* d_element_idx,
+                         const unsigned char* d_hard,
+                         const T* d_samples,
+                         unsigned int num_samples) {
+  if(num_samples == 0)
+    return;
+  unsigned int threads = 128;
+  injectSources<T><<<(num_samples+threads-1)/threads, threads>>>(d_P, d_element_idx, d_hard,
+                                                                 d_samples, num_samples);
+  cudasafe(cudaPeekAtLastError(), "kernels3d.cu: launchInjectSamples - Peek after launch");
+}
+
+template void launchInjectSamples<float>(float*, const unsigned int*, const unsigned char*,
+                                         const float*, unsigned int);
+template void launchInjectSamples<double>(double*, const unsigned int*, const unsigned char*,
+                                          const double*, unsigned int);
+
+template <typename T>
+void launchInjectMovingSamples(T* d_P,
+                               const unsigned int* d_moving_element,
+                               const T* d_moving_value,
+                               unsigned int num_moving) {
+  if(num_moving == 0)
+    return;
+  injectMovingSources<T><<<1, 8>>>(d_P, d_moving_element, d_moving_value, num_moving);
+  cudasafe(cudaPeekAtLastError(), "kernels3d.cu: launchInjectMovingSamples - Peek after launch");
+}
+
+template void launchInjectMovingSamples<float>(float*, const unsigned int*, const float*,
+                                               unsigned int);
+template void launchInjectMovingSamples<double>(double*, const unsigned int*, const double*,
+                                                unsigned int);
+
+template <typename T>
+__global__ void injectSources(T* P,
+                              const unsigned int* __restrict d_element_idx,
+                              const unsigned char* __restrict d_hard,
+                              const T* __restrict d_samples,
+                              unsigned int num_entries) {
+  unsigned int e = blockIdx.x*blockDim.x+threadIdx.x;
+  if(e >= num_entries)
+    return;
+  T* p = P+d_element_idx[e];
+  T sample = d_samples[e];
+  *p = d_hard[e] ? sample : *p+sample;
+}
+
+template <typename T>
+__global__ void injectArraySources(T* P,
+                                   const unsigned int* __restrict d_segment_element,
+                                   const unsigned int* __restrict d_segment_begin,
+                                   const unsigned int* __restrict d_tap_signal,
+                                   const unsigned int* __restrict d_tap_delay,
+                                   const T* __restrict d_tap_gain,
+                                   const T* __restrict d_tap_gain_frac,
+                                   const T* __restrict d_signals,
+                                   unsigned int window_steps,
+                                   unsigned int step,
+                                   unsigned int window_step,
+                                   unsigned int num_segments) {
+  unsigned int g = blockIdx.x*blockDim.x+threadIdx.x;
+  if(g >= num_segments)
+    return;
+  T value = 0;
+  for(unsigned int t = d_segment_begin[g]; t < d_segment_begin[g+1]; t++) {
+    unsigned int delay = d_tap_delay[t];
+    if(step < delay)
+      continue;
+    const T* signal = d_signals+(size_t)d_tap_signal[t]*window_steps;
+    value += d_tap_gain[t]*signal[window_step-delay];
+    if(step > delay)
+      value += d_tap_gain_frac[t]*signal[window_step-delay-1];
+  }
+  P[d_segment_element[g]] += value;
+}
+
+template <typename T>
+__global__ void injectMovingSources(T* P,
+                                    const unsigned int* __restrict d_moving_element,
+                                    const T* __restrict d_moving_value,
+                                    unsigned int num_moving) {
+  unsigned int c = threadIdx.x;
+  for(unsigned int m = 0; m < num_moving; m++) {
+    unsigned int element = d_moving_element[m*8+c];
+    if(element != SourceBank<T>::no_element)
+      P[element] += d_moving_value[m*8+c];
+    __syncthreads();
+  }
+}
+
+template <typename T>
+__global__ void gatherReceivers(T* d_dest, const T* __restrict P,
+                                const unsigned int* __restrict d_element_idx,
+                                unsigned int num_receivers) {
+  unsigned int r = blockIdx.x*blockDim.x+threadIdx.x;
+  if(r >= num_receivers)
+    return;
+  d_dest[r] = P[d_element_idx[r]];
+}
+
+template <typename T>
+__global__ void gatherGradients(T* d_dest, const T* __restrict P,
+                                const unsigned int* __restrict d_plus,
+                                const unsigned int* __restrict d_minus,
+                                unsigned int num_gradients) {
+  unsigned int r = blockIdx.x*blockDim.x+threadIdx.x;
+  if(r >= num_gradients)
+    return;
+  d_dest[r] = (P[d_plus[r]]-P[d_minus[r]])*(T)0.5;
+}
+
+template <typename T>
+__global__ void gatherMovingReceiver(T* dest, const T* __restrict P,
+                                     unsigned int dim_x, unsigned int dim_xy,
+                                     T fx, T fy, T fz) {
+  T value = 0;
+  for(unsigned int c = 0; c < 8; c++) {
+    T w = ((c&1) ? fx : (T)1-fx)*((c&2) ? fy : (T)1-fy)*((c&4) ? fz : (T)1-fz);
+    value += w*P[(c>>2)*dim_xy+((c>>1)&1)*dim_x+(c&1)];
+  }
+  *dest = value;
+}
+
 template <typename T>
 __global__ void fdtd3dStdMaterials(const unsigned char* __restrict d_position_ptr, 
                                    const unsigned char* __restrict d_material_idx_ptr,  
@@ -510,7 +1092,7 @@ __global__ void fdtd3dStdMaterials(const unsigned char* __restrict d_position_pt
   T switchBit = (T)(pos>>INSIDE_SWITCH);
 
       
-  unsigned int mat_idx = ((unsigned int)d_material_idx_ptr[current])*20*+d_params_ptr[3];
+  unsigned int mat_idx = ((unsigned int)d_material_idx_ptr[current])*MATERIAL_COEF_NUM+(unsigned int)d_params_ptr[3];
   T beta =  0.5*((T)d_material_ptr[mat_idx]*(6.f-position)*d_params_ptr[0]);
   
   T _p_z = P[((z_)+current_y+x)];
@@ -558,7 +1140,7 @@ __global__ void fdtd3dSliced(const unsigned char* __restrict d_position_ptr,
     T switchBit = (T)(pos>>INSIDE_SWITCH);
     T position = (T)pos;
 
-    unsigned int mat_idx = ((unsigned int)d_material_idx_ptr[current])*20*+d_params_ptr[3];
+    unsigned int mat_idx = ((unsigned int)d_material_idx_ptr[current])*MATERIAL_COEF_NUM+(unsigned int)d_params_ptr[3];
     T beta = 0.5*(d_material_ptr[mat_idx]*(6.f-position)*d_params_ptr[0]);
   
     T p_z_ = P[current+dim_xy];
@@ -636,7 +1218,7 @@ __global__ void fdtd3dStdKowalczykMaterials(unsigned char* d_position_ptr, unsig
   T dir_y =  (T)((pos&DIR_Y)>>1);
   T dir_z =  (T)((pos&DIR_Z)>>2);
 
-  unsigned int mat_idx = ((unsigned int)d_material_idx_ptr[current])*20+d_params_ptr[3];
+  unsigned int mat_idx = ((unsigned int)d_material_idx_ptr[current])*MATERIAL_COEF_NUM+(unsigned int)d_params_ptr[3];
   T beta = d_material_ptr[mat_idx]*d_params_ptr[0]*(dir_x+dir_y+dir_z);
   
   T p_z[2], p_y[2], p_x[2]; 
@@ -32,6 +32,8 @@
 #include <cuda.h>
 #include <cuda_runtime.h>
 #include "../base/SimulationParameters.h"
+#include "../base/SourceBank.h"
+#include "../base/ReceiverBank.h"
 
 #define PROGRESS_MOD 100
 
@@ -40,7 +42,8 @@
 /// \param[in] d_mesh CudaMesh containing the simulation domain
 /// \param[in] sp The simulation parameters of the simulation
 /// \param[in, out] h_retur_ptr A memory allocation for the return values of
-/// the simulation in the host memory
+/// the simulation in the host memory, may be NULL when the responses are
+/// streamed to the response writer of sp
 /// \param interruptCallback A callback function which is called between each
 /// step to check if the simulation is interrupted by the user
 /// \param prgressCallback A callback function that is called between each
@@ -79,6 +82,8 @@ float launchFDTD3dDouble(CudaMesh* d_mesh,
 /// \param[in] step The index of the current step beeing executed
 /// \param[in] direction The direction of simulation step. -1 swithces
 /// the direction of the particle velocity
+/// \param[in, out] past_step_direction The direction of the previous step
+/// of the mesh, updated to step_direction
 /// \param prgressCallback A callback function that is called between each
 /// PROGRESS_MOD number of steps to print progress information
 ///////////////////////////////////////////////////////////////////////////////
@@ -87,10 +92,213 @@ void launchFDTD3dStep(CudaMesh* d_mesh,
                       float* h_return_ptr,
                       unsigned int step,
                       int step_direction,
+                      int* past_step_direction,
                       void (*progressCallback)(int, int, float));
 
+///////////////////////////////////////////////////////////////////////////////
+/// \brief Launch the update of a range of slices of a partition held in
+/// device memory. Used by the device targets of the host solver, the
+/// partition has the layout of a HostMesh partition
+/// \tparam T The precision, float / double
+/// \param slice_begin, slice_end The local slices updated
+/// \param update_type The update scheme, enum UpdateType
+/// \param block_x, block_y The thread block size, dim_x and dim_y have to be
+/// multiples of it as in CudaMesh
+///////////////////////////////////////////////////////////////////////////////
+template <typename T>
+void launchFDTD3dSlices(const unsigned char* d_positions,
+                        const unsigned char* d_materials,
+                        const T* d_P, T* d_P_past,
+                        const T* d_params,
+                        const T* d_material_coefs,
+                        unsigned int dim_xy, unsigned int dim_x, unsigned int dim_y,
+                        unsigned int slice_begin, unsigned int slice_end,
+                        unsigned int update_type,
+                        unsigned int block_x, unsigned int block_y);
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief Gather the receivers of a partition in device memory to a slot of
+/// a ring buffer, one thread per receiver. Used by the device targets of
+/// the host solver, see ReceiverBank
+/// \tparam T The precision, float / double
+/// \param d_P The pressures of the partition
+/// \param d_element_idx The sorted local element indices of the receivers
+/// \param d_dest The slot of the current step in the ring buffer
+/// \param num_receivers The number of receivers
+///////////////////////////////////////////////////////////////////////////////
+template <typename T>
+void launchGatherReceivers(const T* d_P,
+                           const unsigned int* d_element_idx,
+                           T* d_dest,
+                           unsigned int num_receivers);
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief Gather the central differences of the velocity channels of a
+/// partition in device memory to a slot of a ring buffer, see
+/// ReceiverBank::gatherGradients
+/// \tparam T The precision, float / double
+/// \param d_P The pressures of the partition, the level the update reads
+/// \param d_plus, d_minus The neighbours of the nodes along the axis
+/// \param d_dest The slot of the current step in the ring buffer
+/// \param num_gradients The number of velocity channels
+///////////////////////////////////////////////////////////////////////////////
+template <typename T>
+void launchGatherGradients(const T* d_P,
+                           const unsigned int* d_plus,
+                           const unsigned int* d_minus,
+                           T* d_dest,
+                           unsigned int num_gradients);
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief Inject the samples of a step to a partition in device memory, one
+/// thread per sample, see injectSources. Used by the device targets of the
+/// host solver
+/// \tparam T The precision, float / double
+/// \param d_P The pressures of the partition
+/// \param d_element_idx The distinct local element indices of the samples
+/// \param d_hard 1 for a sample which sets the pressure, 0 for one added to it
+/// \param d_samples The samples of the current step
+/// \param num_samples The number of samples
+///////////////////////////////////////////////////////////////////////////////
+template <typename T>
+void launchInjectSamples(T* d_P,
+                         const unsigned int* d_element_idx,
+                         const unsigned char* d_hard,
+                         const T* d_samples,
+                         unsigned int num_samples);
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief Add the corners of the moving sources of a step to a partition in
+/// device memory, see injectMovingSources
+/// \tparam T The precision, float / double
+/// \param d_P The pressures of the partition
+/// \param d_moving_element The local element index of each corner,
+/// SourceBank::no_element outside the partition
+/// \param d_moving_value The weighted sample of each corner
+/// \param num_moving The number of moving sources
+///////////////////////////////////////////////////////////////////////////////
+template <typename T>
+void launchInjectMovingSamples(T* d_P,
+                               const unsigned int* d_moving_element,
+                               const T* d_moving_value,
+                               unsigned int num_moving);
+
 //// Kernels
 
+///////////////////////////////////////////////////////////////////////////////
+/// \brief Kernel injecting the sources of a step to a partition, one thread
+/// per entry of a SourceBank. The entries have distinct elements, so the
+/// threads do not race
+/// \tparam T defines the precision used in the calculation (float / double)
+/// \param P A device pointer to the current pressure value mesh of the
+/// partition
+/// \param d_element_idx The local element indices of the entries
+/// \param d_hard 1 for an entry which sets the pressure, 0 for an entry
+/// added to it
+/// \param d_samples The samples of the entries for the current step
+/// \param num_entries The number of entries
+///////////////////////////////////////////////////////////////////////////////
+template <typename T>
+__global__ void injectSources(T* P,
+                              const unsigned int* __restrict d_element_idx,
+                              const unsigned char* __restrict d_hard,
+                              const T* __restrict d_samples,
+                              unsigned int num_entries);
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief Kernel adding the array sources of a step to a partition, one
+/// thread per segment of the scatter list of a SourceBank. The thread sums
+/// the taps of its element, so the threads do not race
+/// \tparam T defines the precision used in the calculation (float / double)
+/// \param P A device pointer to the current pressure value mesh of the
+/// partition
+/// \param d_segment_element The local element index of each segment
+/// \param d_segment_begin The first tap of each segment, num_segments+1
+/// \param d_tap_signal, d_tap_delay, d_tap_gain, d_tap_gain_frac The taps
+/// \param d_signals The windows of the signals of the arrays,
+/// num_arrays*window_steps, see SourceBank::getArraySignals()
+/// \param window_steps The number of steps of a window
+/// \param step The current step
+/// \param window_step The column of the current step in the window
+/// \param num_segments The number of segments
+///////////////////////////////////////////////////////////////////////////////
+template <typename T>
+__global__ void injectArraySources(T* P,
+                                   const unsigned int* __restrict d_segment_element,
+                                   const unsigned int* __restrict d_segment_begin,
+                                   const unsigned int* __restrict d_tap_signal,
+                                   const unsigned int* __restrict d_tap_delay,
+                                   const T* __restrict d_tap_gain,
+                                   const T* __restrict d_tap_gain_frac,
+                                   const T* __restrict d_signals,
+                                   unsigned int window_steps,
+                                   unsigned int step,
+                                   unsigned int window_step,
+                                   unsigned int num_segments);
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief Kernel adding the moving sources of a step to a partition. Launched
+/// with eight threads, one per corner of a cell, which go through the
+/// sources in order so that sources sharing a node do not race
+/// \tparam T defines the precision used in the calculation (float / double)
+/// \param P A device pointer to the current pressure value mesh of the
+/// partition
+/// \param d_moving_element The local element index of each corner of the
+/// step, SourceBank::no_element outside the partition
+/// \param d_moving_value The weighted sample of each corner of the step
+/// \param num_moving The number of moving sources
+///////////////////////////////////////////////////////////////////////////////
+template <typename T>
+__global__ void injectMovingSources(T* P,
+                                    const unsigned int* __restrict d_moving_element,
+                                    const T* __restrict d_moving_value,
+                                    unsigned int num_moving);
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief Kernel interpolating a moving receiver trilinearly from the eight
+/// nodes of its cell, launched with a single thread
+/// \tparam T defines the precision used in the calculation (float / double)
+/// \param dest A device pointer to the sample of the receiver
+/// \param P A device pointer to the lower corner of the cell
+/// \param dim_x, dim_xy The dimensions of the mesh
+/// \param fx, fy, fz The offsets of the receiver in the cell
+///////////////////////////////////////////////////////////////////////////////
+///////////////////////////////////////////////////////////////////////////////
+/// \brief Kernel reading the receivers of a partition to a slot of a ring
+/// buffer, one thread per receiver. The elements are sorted, so the
+/// neighbouring threads read nearby addresses
+/// \tparam T defines the precision used in the calculation (float / double)
+/// \param d_dest The slot of the current step in the ring buffer
+/// \param P A device pointer to the current pressure value mesh of the
+/// partition
+/// \param d_element_idx The local element indices of the receivers
+/// \param num_receivers The number of receivers
+///////////////////////////////////////////////////////////////////////////////
+template <typename T>
+__global__ void gatherReceivers(T* d_dest, const T* __restrict P,
+                                const unsigned int* __restrict d_element_idx,
+                                unsigned int num_receivers);
+
+///////////////////////////////////////////////////////////////////////////////
+/// \brief Kernel reading the central differences of the velocity channels
+/// of the B-format receivers, one thread per channel
+/// \tparam T defines the precision used in the calculation (float / double)
+/// \param d_dest The slot of the current step in the ring buffer
+/// \param P A device pointer to the pressures read by the update
+/// \param d_plus, d_minus The neighbours of the nodes along the axis
+/// \param num_gradients The number of channels
+///////////////////////////////////////////////////////////////////////////////
+template <typename T>
+__global__ void gatherGradients(T* d_dest, const T* __restrict P,
+                                const unsigned int* __restrict d_plus,
+                                const unsigned int* __restrict d_minus,
+                                unsigned int num_gradients);
+
+template <typename T>
+__global__ void gatherMovingReceiver(T* dest, const T* __restrict P,
+                                     unsigned int dim_x, unsigned int dim_xy,
+                                     T fx, T fy, T fz);
+
 ///////////////////////////////////////////////////////////////////////////////
 /// \brief Kernel for FDTD step using the forward difference boundary
 /// \tparam T defines the precision used in the calculation (float / double)
@@ -135,6 +135,78 @@ void voxelizeGeometry(float* vertices,
   printMemInfo("voxelizeGeometryDevice memory before return", getCurrentDevice());
 }
 
+uint3 getVoxelizationDim(float* vertices,
+                         unsigned int* indices,
+                         unsigned int number_of_triangles,
+                         unsigned int number_of_vertices,
+                         double voxel_edge) {
+  vox::Voxelizer<vox::LongNode> voxelizer(vertices,
+                                          indices,
+                                          number_of_vertices,
+                                          number_of_triangles);
+
+  // A slice along x spans y and z, a slice along z spans x and y
+  vox::NodePointer<vox::LongNode> x_slice = voxelizer.voxelizeSlice(voxel_edge, 0, 0);
+  vox::NodePointer<vox::LongNode> z_slice = voxelizer.voxelizeSlice(voxel_edge, 2, 0);
+  uint3 dim = make_uint3(z_slice.dim.x, z_slice.dim.y, x_slice.dim.z);
+  cudasafe(cudaFree(x_slice.ptr), "cudaFree x slice");
+  cudasafe(cudaFree(z_slice.ptr), "cudaFree z slice");
+
+  c_log_msg(LOG_INFO, "voxelizationUtils.cu: getVoxelizationDim - dim x: %d y: %d z: %d",
+            dim.x, dim.y, dim.z);
+  return dim;
+}
+
+void voxelizeGeometrySlab(float* vertices,
+                          unsigned int* indices,
+                          unsigned char* materials,
+                          unsigned int number_of_triangles,
+                          unsigned int number_of_vertices,
+                          unsigned int number_of_unique_materials,
+                          double voxel_edge,
+                          unsigned int first_slice,
+                          unsigned int number_of_slices,
+                          unsigned char* h_position_idx,
+                          unsigned char* h_material_idx) {
+  c_log_msg(LOG_DEBUG, "voxelizationUtils.cu: voxelizeGeometrySlab - slices %u - %u",
+            first_slice, first_slice+number_of_slices-1);
+
+  vox::Voxelizer<vox::LongNode> voxelizer(vertices,
+                                          indices,
+                                          number_of_vertices,
+                                          number_of_triangles);
+  if(materials) {
+    voxelizer.setMaterials(materials, number_of_unique_materials);
+    voxelizer.setMaterialOutput(true);
+  }
+
+  unsigned char* d_position_idx = (unsigned char*)NULL;
+  unsigned char* d_material_idx = (unsigned char*)NULL;
+  unsigned int dim_xy = 0;
+
+  for(unsigned int i = 0; i < number_of_slices; i++) {
+    vox::NodePointer<vox::LongNode> slice = voxelizer.voxelizeSlice(voxel_edge, 2, first_slice+i);
+    cudasafe(cudaDeviceSynchronize(),
+             "voxelizationUtils: voxelizeGeometrySlab - cudaDeviceSynchronize after voxelization");
+
+    // The slice buffers are allocated with the first slice and reused
+    if(!d_position_idx) {
+      dim_xy = slice.dim.x*slice.dim.y;
+      d_position_idx = valueToDevice<unsigned char>(dim_xy, (unsigned char)0, 0);
+      d_material_idx = valueToDevice<unsigned char>(dim_xy, (unsigned char)0, 0);
+    }
+
+    nodes2Vectors(slice.ptr, &d_position_idx, &d_material_idx,
+                  make_uint3(slice.dim.x, slice.dim.y, 1));
+    copyDeviceToHost(dim_xy, h_position_idx+(size_t)i*dim_xy, d_position_idx, 0);
+    copyDeviceToHost(dim_xy, h_material_idx+(size_t)i*dim_xy, d_material_idx, 0);
+    cudasafe(cudaFree(slice.ptr), "cudaFree slice nodes");
+  }
+
+  destroyMem(d_position_idx);
+  destroyMem(d_material_idx);
+}
+
 template<class Node>
 __global__ void nodes2VectorsKernel(Node* nodes, 
                                      unsigned char* d_position_idx_ptr, 
@@ -49,6 +49,34 @@ void voxelizeGeometry(float* vertices,
                       unsigned char** d_materials_idx,
                       uint3* voxelization_dim);
 
+//////////////////////////////////////////////////////
+// The dimensions voxelizeGeometry() gives for the geometry,
+// found by voxelizing a single slice along x and along z
+
+uint3 getVoxelizationDim(float* vertices,
+                         unsigned int* indices,
+                         unsigned int number_of_triangles,
+                         unsigned int number_of_vertices,
+                         double voxel_edge);
+
+//////////////////////////////////////////////////////
+// Voxelize a slab of z-slices straight to host memory,
+// one slice is held on the device at a time. The
+// slices are written to h_position_idx and
+// h_material_idx, number_of_slices*dim.x*dim.y each
+
+void voxelizeGeometrySlab(float* vertices,
+                          unsigned int* indices,
+                          unsigned char* materials,
+                          unsigned int number_of_triangles,
+                          unsigned int number_of_vertices,
+                          unsigned int number_of_unique_materials,
+                          double voxel_edge,
+                          unsigned int first_slice,
+                          unsigned int number_of_slices,
+                          unsigned char* h_position_idx,
+                          unsigned char* h_material_idx);
+
 template<class Node>
 __global__ void nodes2VectorsKernel(Node* nodes, 
                                     unsigned char* d_position_idx_ptr, 
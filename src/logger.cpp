@@ -20,9 +20,56 @@
 //
 ///////////////////////////////////////////////////////////////////////////////
 #include "logger.h"
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/tss.hpp>
 
+namespace {
+  boost::mutex log_mutex;
+  bool log_initialized = false;
+
+  // The sinks are owned by their apps
+  void keepSink(LogSink*) {}
+  boost::thread_specific_ptr<LogSink> thread_sink(keepSink);
+}
 
 void loggerInit() {
+	boost::mutex::scoped_lock lock(log_mutex);
 	std::wofstream logfile("solver_log.txt",  std::fstream::out | std::fstream::trunc);
+	log_initialized = true;
+}
+
+void loggerInitOnce() {
+	{
+		boost::mutex::scoped_lock lock(log_mutex);
+		if(log_initialized)
+			return;
+	}
+	loggerInit();
+}
+
+LogSink* setThreadLogSink(LogSink* sink) {
+	LogSink* previous = thread_sink.get();
+	thread_sink.reset(sink);
+	return previous;
+}
+
+LogSink* getThreadLogSink() {
+	return thread_sink.get();
 }
 
+void logWrite(log_level level, const std::wstring& msg) {
+	LogSink* sink = thread_sink.get();
+	boost::mutex::scoped_lock lock(log_mutex);
+	if(LOG_COUT >= level)
+		std::wcout<<level<<L" "<<msg<<std::endl;
+
+	if(LOG_TO_FILE >= level) {
+		if(sink && sink->file_.is_open()) {
+			sink->file_<<level<<L" "<<msg<<std::endl;
+		}
+		else {
+			std::wofstream logfile("solver_log.txt",  std::fstream::out | std::fstream::app);
+			logfile<<level<<L" "<<msg<<std::endl;
+		}
+	}
+}
@@ -27,6 +27,7 @@
 #include <iostream>
 #include <fstream>
 #include <sstream>
+#include <string>
 #include <time.h> 
 
 #define LOG_COUT 2
@@ -43,22 +44,50 @@ enum log_level {
 };
 
 
+///////////////////////////////////////////////////////////////////////////////
+/// \brief A log file of its own for the messages of one thread, used by an
+/// FDTD::App instance so that concurrent instances do not share a log.
+/// Messages of threads without a sink go to solver_log.txt.
+///////////////////////////////////////////////////////////////////////////////
+class LogSink {
+public:
+  LogSink(const std::string& path)
+  : path_(path),
+    file_(path.c_str(), std::fstream::out | std::fstream::trunc)
+  {};
+
+  const std::string& getPath() const {return this->path_;}
+  bool isOpen() const {return this->file_.is_open();}
+
+private:
+  // Not copyable, the file has a single owner
+  LogSink(const LogSink&);
+  LogSink& operator=(const LogSink&);
+
+  friend void logWrite(log_level level, const std::wstring& msg);
+
+  std::string path_;
+  std::wofstream file_;
+};
+
+/// Route the messages of the calling thread to a sink, NULL for the
+/// default log. Returns the previous sink of the thread.
+LogSink* setThreadLogSink(LogSink* sink);
+LogSink* getThreadLogSink();
+
+/// Write a message to the console and to the log of the calling thread,
+/// the writes of all threads are serialized
+void logWrite(log_level level, const std::wstring& msg);
+
 class Logger {
 public:
 	Logger(log_level level, const wchar_t* msg )
-	: fmt_(msg),
-	  level_(level),
-	  logfile_("solver_log.txt",  std::fstream::out | std::fstream::app)
+	: level_(level),
+	  fmt_(msg)
 	  {};
 
 	~Logger() {
-		if(LOG_COUT >= level_)
-			std::wcout<<level_<<L" "<<fmt_<<std::endl;
-
-		if(LOG_TO_FILE >= level_) {
-			logfile_<<level_<<L" "<<fmt_<<std::endl;
-			logfile_.close();
-		}
+		logWrite(level_, fmt_.str());
 	}
 
 	template<typename T>
@@ -69,14 +98,12 @@ public:
 
 	Logger(const Logger& other)
 	: level_(other.level_),
-	  fmt_(other.fmt_),
-	  logfile_("solver_log.txt",  std::fstream::out | std::fstream::app)
+	  fmt_(other.fmt_)
 	  {}; 
 	
 private:
 	log_level level_;
 	boost::wformat fmt_;
-	std::wofstream logfile_;
 };
 
 template <log_level level>
@@ -86,6 +113,10 @@ Logger log_msg(const wchar_t* msg) {
 
 void loggerInit(); 
 
+/// Truncate solver_log.txt only on the first call of the process, used by
+/// each FDTD::App instance
+void loggerInitOnce();
+
 
 // The C interface
 //typedef struct c_Logger Logger;
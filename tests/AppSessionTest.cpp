@@ -0,0 +1,111 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MAIN
+
+#include <boost/test/unit_test.hpp>
+#include "../src/App.h"
+#include "../src/global_includes.h"
+
+namespace {
+  // A closed cube with the corners at 0 and size
+  void setupCube(FDTD::App& app, float size) {
+    float vertices[] = {0.f, 0.f, 0.f,   size, 0.f, 0.f,
+                        size, size, 0.f, 0.f, size, 0.f,
+                        0.f, 0.f, size,  size, 0.f, size,
+                        size, size, size, 0.f, size, size};
+    unsigned int indices[] = {0, 2, 1,  0, 3, 2,
+                              4, 5, 6,  4, 6, 7,
+                              0, 1, 5,  0, 5, 4,
+                              1, 2, 6,  1, 6, 5,
+                              2, 3, 7,  2, 7, 6,
+                              3, 0, 4,  3, 4, 7};
+    app.initializeGeometry(indices, vertices, 36, 24);
+  }
+
+  void setupApp(FDTD::App& app, float reflection) {
+    app.initializeDevices();
+    setupCube(app, 1.f);
+    app.setUniformMaterial(reflection);
+    app.setSpatialFs(7000);
+    app.setNumSteps(200);
+    app.addSource(0.3f, 0.4f, 0.5f, SRC_SOFT, IMPULSE, 0);
+    app.addReceiver(0.6f, 0.5f, 0.7f);
+  }
+}
+
+BOOST_AUTO_TEST_SUITE(AppSessionTest)
+
+// A material change in the middle of a session builds the mesh again, so
+// the run matches a new instance with the new material
+BOOST_AUTO_TEST_CASE(AppSession_materialChange) {
+  FDTD::App app;
+  setupApp(app, 0.9f);
+  app.prepareSession();
+  BOOST_REQUIRE(app.isSessionPrepared());
+  app.runSimulation();
+  BOOST_CHECK(app.isSessionPrepared());
+  std::vector<float> hard = app.getResponse(0);
+
+  app.setUniformMaterial(0.1f);
+  BOOST_CHECK(!app.isSessionPrepared());
+  app.runSimulation();
+  std::vector<float> soft = app.getResponse(0);
+  app.close();
+
+  FDTD::App reference;
+  setupApp(reference, 0.1f);
+  reference.runSimulation();
+  std::vector<float> expected = reference.getResponse(0);
+  reference.close();
+
+  BOOST_REQUIRE_EQUAL(soft.size(), expected.size());
+  float difference = 0.f;
+  for(unsigned int i = 0; i < soft.size(); i++) {
+    BOOST_CHECK_EQUAL(soft.at(i), expected.at(i));
+    difference += fabs(soft.at(i)-hard.at(i));
+  }
+  BOOST_CHECK(difference > 0.f);
+}
+
+BOOST_AUTO_TEST_CASE(AppSession_geometryChange) {
+  FDTD::App app;
+  setupApp(app, 0.9f);
+  app.prepareSession();
+  BOOST_REQUIRE(app.isSessionPrepared());
+  setupCube(app, 1.2f);
+  BOOST_CHECK(!app.isSessionPrepared());
+  app.close();
+}
+
+// The hybrid combines the low band from the responses at the output fs,
+// which matches the low band combined from the responses at the spatial fs
+BOOST_AUTO_TEST_CASE(AppSession_hybridOutputFs) {
+  FDTD::App reference;
+  setupApp(reference, 0.9f);
+  reference.runHybrid(48000, 300.f, 2);
+  std::vector<float> expected = reference.getHybridResponse(0);
+  reference.close();
+
+  FDTD::App app;
+  setupApp(app, 0.9f);
+  app.setOutputFs(16000);
+  app.runHybrid(48000, 300.f, 2);
+  BOOST_CHECK(app.getResponseLength() > 200);
+  std::vector<float> hybrid = app.getHybridResponse(0);
+
+  BOOST_REQUIRE_EQUAL(hybrid.size(), expected.size());
+  float peak = 0.f;
+  float difference = 0.f;
+  for(unsigned int i = 0; i < hybrid.size(); i++) {
+    peak = std::max(peak, (float)fabs(expected.at(i)));
+    difference = std::max(difference, (float)fabs(hybrid.at(i)-expected.at(i)));
+  }
+  BOOST_CHECK(peak > 0.f);
+  BOOST_CHECK(difference < 0.05f*peak);
+
+  // Responses streamed to a file and not kept can not be combined
+  app.setResponseStream("AppSessionTest.raw", 0, false);
+  BOOST_CHECK_THROW(app.runHybrid(48000, 300.f, 2), int);
+  app.close();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,50 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MAIN
+
+#include <boost/test/unit_test.hpp>
+#include "../src/base/CallbackSlot.h"
+#include "../src/global_includes.h"
+
+namespace {
+  // The context of a callback slot counts the calls it gets
+  struct SlotCounter {
+    unsigned int interrupts;
+    int last_step;
+    bool stop;
+  };
+
+  bool countInterrupt(void* context) {
+    SlotCounter* c = (SlotCounter*)context;
+    c->interrupts++;
+    return c->stop;
+  }
+
+  void countProgress(void* context, int step, int, float) {
+    ((SlotCounter*)context)->last_step = step;
+  }
+}
+
+BOOST_AUTO_TEST_SUITE(CallbackSlotTest)
+
+BOOST_AUTO_TEST_CASE(CallbackSlot_bind) {
+  SlotCounter a = {0, -1, false};
+  SlotCounter b = {0, -1, true};
+  {
+    CallbackSlot slot_a(&a, countInterrupt, countProgress, NULL);
+    CallbackSlot slot_b(&b, countInterrupt, countProgress, NULL);
+    BOOST_CHECK(slot_a.getIndex() != slot_b.getIndex());
+    BOOST_CHECK_EQUAL(CallbackSlot::getNumBound(), 2u);
+
+    BOOST_CHECK(!slot_a.getInterrupt()());
+    BOOST_CHECK(slot_b.getInterrupt()());
+    slot_a.getProgress()(7, 10, 0.f);
+    slot_b.getProgress()(3, 10, 0.f);
+    BOOST_CHECK_EQUAL(a.interrupts, 1u);
+    BOOST_CHECK_EQUAL(b.interrupts, 1u);
+    BOOST_CHECK_EQUAL(a.last_step, 7);
+    BOOST_CHECK_EQUAL(b.last_step, 3);
+  }
+  BOOST_CHECK_EQUAL(CallbackSlot::getNumBound(), 0u);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
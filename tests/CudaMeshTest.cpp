@@ -12,6 +12,8 @@
 #include "../src/kernels/kernels3d.h"
 #include "../src/base/GeometryHandler.h"
 #include "../src/io/FileReader.h"
+#include <algorithm>
+#include <cmath>
 
 SimulationParameters parameters;
 MaterialHandler materials;
@@ -177,6 +179,72 @@ CudaMesh* getTestMeshDouble(unsigned int number_of_partitions) {
   return cuda_mesh;
 }
 
+// Run the test room on a single partition with every other surface of
+// material a and the rest of material b, simulating the given octave
+std::vector<float> runTwoMaterials(const std::vector<float>& a,
+                                   const std::vector<float>& b,
+                                   unsigned int octave) {
+  cudaSetDevice(0);
+  cudaDeviceReset();
+
+  FileReader fr;
+  GeometryHandler room;
+  if(!fr.readVTK(&room, "./Data/hytti.vtk"))
+    throw(-1);
+
+  MaterialHandler room_materials;
+  unsigned int number_of_triangles = room.getNumberOfTriangles();
+  std::vector<float> surface_coefs;
+  for(unsigned int i = 0; i < number_of_triangles; i++) {
+    const std::vector<float>& coefs = (i%2) ? b : a;
+    surface_coefs.insert(surface_coefs.end(), coefs.begin(), coefs.end());
+  }
+  room_materials.addMaterials(&surface_coefs[0], number_of_triangles, MATERIAL_COEF_NUM);
+
+  parameters.setSpatialFs(10000);
+  parameters.setNumSteps(NUM_STEPS);
+  parameters.resetSourcesAndReceivers();
+  parameters.setOctave(octave);
+
+  float dx = parameters.getDx();
+  parameters.addSource(Source( 2.f, 1.f, 23.f*dx, SRC_HARD));
+  parameters.addReceiver(Receiver( 3.f, 1.f, 5.f*dx));
+  parameters.addReceiver(Receiver( 3.f, 1.f, 42.f*dx));
+  parameters.setUpdateType(SRL_FORWARD);
+
+  unsigned char* d_position_idx = (unsigned char*)NULL;
+  unsigned char* d_material_idx = (unsigned char*)NULL;
+  uint3 voxelization_dim = make_uint3(0,0,0);
+  voxelizeGeometry(room.getVerticePtr(),
+                   room.getIndexPtr(),
+                   room_materials.getMaterialIdxPtr(),
+                   number_of_triangles,
+                   room.getNumberOfVertices(),
+                   room_materials.getNumberOfUniqueMaterials(),
+                   parameters.getDx(),
+                   &d_position_idx,
+                   &d_material_idx,
+                   &voxelization_dim);
+
+  CudaMesh mesh;
+  mesh.setupMesh(d_position_idx,
+                 d_material_idx,
+                 room_materials.getNumberOfUniqueMaterials(),
+                 room_materials.getMaterialCoefficientPtr(),
+                 parameters.getParameterPtr(),
+                 voxelization_dim,
+                 make_uint3(32,4,1),
+                 (unsigned int)parameters.getUpdateType());
+  mesh.makePartition(1, getDebugDevices(1));
+
+  std::vector<float> ret(parameters.getNumSteps()*parameters.getNumReceivers(), 0.f);
+  launchFDTD3d(&mesh, &parameters, &ret[0], interruptCallbackLocal, progressCallbackLocal);
+  mesh.destroyPartitions();
+
+  parameters.setOctave(0);
+  return ret;
+}
+
 BOOST_AUTO_TEST_SUITE(CudaMeshTest)
 
 BOOST_AUTO_TEST_CASE(CudaMesh_partition_idx) {
@@ -573,6 +641,41 @@ BOOST_AUTO_TEST_CASE(CudaMesh_Run_single_double_core_double) {
   delete[] ret2;
   delete[] ret3;
 }
+
+BOOST_AUTO_TEST_CASE(CudaMesh_Run_materials_octave) {
+  // Two materials whose coefficients differ between the octaves. Running
+  // octave 1 must give the same responses as running octave 0 with the
+  // octave columns of both materials swapped
+  std::vector<float> a(MATERIAL_COEF_NUM, 0.5f);
+  std::vector<float> b(MATERIAL_COEF_NUM, 0.5f);
+  a.at(0) = 0.2f; a.at(1) = 0.8f;
+  b.at(0) = 0.7f; b.at(1) = 0.3f;
+
+  std::vector<float> a_swapped(a);
+  std::vector<float> b_swapped(b);
+  std::swap(a_swapped.at(0), a_swapped.at(1));
+  std::swap(b_swapped.at(0), b_swapped.at(1));
+
+  std::vector<float> ret_octave = runTwoMaterials(a, b, 1);
+  std::vector<float> ret_swapped = runTwoMaterials(a_swapped, b_swapped, 0);
+  std::vector<float> ret_single = runTwoMaterials(a, a, 1);
+
+  float peak = 0.f;
+  bool equal = true;
+  bool material_visible = false;
+  for(unsigned int i = 0; i < ret_octave.size(); i++) {
+    peak = std::max(peak, std::fabs(ret_octave.at(i)));
+    if(ret_octave.at(i) != ret_swapped.at(i))
+      equal = false;
+    if(ret_octave.at(i) != ret_single.at(i))
+      material_visible = true;
+  }
+
+  BOOST_CHECK(peak > 0.f);
+  BOOST_CHECK_EQUAL(equal, true);
+  // The second material has to reach the receivers
+  BOOST_CHECK_EQUAL(material_visible, true);
+}
 /*
 */
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,158 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MAIN
+
+#include <boost/test/unit_test.hpp>
+#include "../src/dist/RankLauncher.h"
+#include "../src/dist/distKernels3d.h"
+#include "../src/host/hostMesh.h"
+#include "../src/host/hostKernels3d.h"
+#include "../src/base/SimulationParameters.h"
+#include "../src/global_includes.h"
+#include "TestFixtures.h"
+
+// The forked ranks report errors through their return value, the checks
+// are made in the calling process
+namespace {
+  bool noInterrupt() {return false;}
+  void noProgress(int, int, float) {}
+
+  const unsigned int dim_x = 12;
+  const unsigned int dim_y = 11;
+  const unsigned int dim_z = 24;
+
+  void setupParameters(SimulationParameters& sp) {
+    sp.setSpatialFs(7000);
+    sp.setNumSteps(80);
+    float dx = sp.getDx();
+    sp.addSource(Source(4*dx, 3*dx, 5*dx, SRC_SOFT, IMPULSE, 0));
+    sp.addReceiver(6*dx, 5*dx, 6*dx);
+    sp.addReceiver(7*dx, 6*dx, 18*dx);
+    sp.addReceiver(3*dx, 4*dx, 11*dx);
+  }
+
+  // Each rank sends a pattern larger than the shared memory ring to both
+  // neighbours and checks the ones it receives
+  int exchangeMain(HaloTransport* transport, void*) {
+    unsigned int rank = transport->getRank();
+    unsigned int size = transport->getSize();
+    const unsigned int count = 3*(1<<18)+17;
+    std::vector<unsigned int> send(count), recv(count);
+    for(unsigned int i = 0; i < count; i++)
+      send[i] = rank*count+i;
+
+    for(unsigned int peer = 0; peer < size; peer++) {
+      if(peer == rank || (peer+1 != rank && peer != rank+1))
+        continue;
+      transport->exchange(peer, &send[0], &recv[0], count*sizeof(unsigned int));
+      for(unsigned int i = 0; i < count; i++)
+        if(recv[i] != peer*count+i)
+          return -1;
+    }
+    return 0;
+  }
+
+  struct SolverRun {
+    unsigned int halo_depth;
+    std::vector<float> responses;
+  };
+
+  int solverMain(HaloTransport* transport, void* arg) {
+    SolverRun* run = (SolverRun*)arg;
+    std::vector<unsigned char> position, material;
+    makeBox(position, material, dim_x, dim_y, dim_z);
+    SimulationParameters sp;
+    setupParameters(sp);
+
+    std::vector<float> coefs(MATERIAL_COEF_NUM, 0.2f);
+    std::vector<float> params(4, 0.f);
+    params[0] = sp.getLambda();
+    params[1] = sp.getLambda()*sp.getLambda();
+    params[2] = 1.f/3.f;
+
+    // Each rank holds only the slices of its own partition
+    unsigned int rank = transport->getRank();
+    unsigned int size = transport->getSize();
+    std::vector< std::vector<unsigned int> > indexing =
+      HostMesh<float>::getHaloIndexing(CudaMesh::getPartitionIndexing(size, dim_z),
+                                       run->halo_depth);
+    unsigned int first = indexing.at(rank).front();
+    unsigned int count = (unsigned int)indexing.at(rank).size();
+
+    HostMesh<float> mesh;
+    mesh.setupSlices(&position[first*dim_x*dim_y], &material[first*dim_x*dim_y],
+                     first, count, dim_x, dim_y, dim_z,
+                     &coefs[0], 1, &params[0], SRL_FORWARD);
+
+    // The partitions of the other ranks are not in the mesh
+    bool thrown = false;
+    try {
+      mesh.makePartition(size, run->halo_depth, (int)((rank+1)%size));
+    }
+    catch(...) {
+      thrown = true;
+    }
+    if(!thrown)
+      return -1;
+
+    mesh.makePartition(size, run->halo_depth, (int)rank);
+    if(mesh.hasPartition((rank+1)%size))
+      return -1;
+
+    float* ret = rank == 0 ? &run->responses[0] : NULL;
+    launchFDTD3dDistributed(&mesh, &sp, ret, transport, noInterrupt, noProgress);
+    return 0;
+  }
+
+  std::vector<float> runSingle() {
+    std::vector<unsigned char> position, material;
+    makeBox(position, material, dim_x, dim_y, dim_z);
+    SimulationParameters sp;
+    setupParameters(sp);
+
+    std::vector<float> coefs(MATERIAL_COEF_NUM, 0.2f);
+    std::vector<float> params(4, 0.f);
+    params[0] = sp.getLambda();
+    params[1] = sp.getLambda()*sp.getLambda();
+    params[2] = 1.f/3.f;
+
+    HostMesh<float> mesh;
+    mesh.setupMesh(&position[0], &material[0], dim_x, dim_y, dim_z,
+                   &coefs[0], 1, &params[0], SRL_FORWARD);
+    mesh.makePartition(1);
+
+    std::vector<float> responses(sp.getNumSteps()*sp.getNumReceivers(), 0.f);
+    launchFDTD3dHost(&mesh, &sp, &responses[0], noInterrupt, noProgress, 1);
+    return responses;
+  }
+}
+
+BOOST_AUTO_TEST_SUITE(DistributedTest)
+
+BOOST_AUTO_TEST_CASE(RankLauncher_exchange) {
+  BOOST_CHECK_EQUAL(launchRanks(3, TRANSPORT_SHM, exchangeMain, NULL), 0);
+  BOOST_CHECK_EQUAL(launchRanks(3, TRANSPORT_TCP, exchangeMain, NULL), 0);
+}
+
+BOOST_AUTO_TEST_CASE(DistKernels_equal) {
+  std::vector<float> ref = runSingle();
+  float energy = 0.f;
+  for(unsigned int i = 0; i < ref.size(); i++)
+    energy += ref[i]*ref[i];
+  BOOST_CHECK(energy > 0.f);
+
+  enum TransportType transports[] = {TRANSPORT_SHM, TRANSPORT_TCP};
+  unsigned int depths[] = {1, 2};
+
+  for(unsigned int t = 0; t < 2; t++) {
+    for(unsigned int d = 0; d < 2; d++) {
+      SolverRun run;
+      run.halo_depth = depths[d];
+      run.responses.assign(ref.size(), 0.f);
+      BOOST_CHECK_EQUAL(launchRanks(3, transports[t], solverMain, &run), 0);
+      for(unsigned int i = 0; i < ref.size(); i++)
+        BOOST_CHECK_EQUAL(ref[i], run.responses[i]);
+    }
+  }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,879 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MAIN
+
+#include <boost/test/unit_test.hpp>
+#include "../src/host/hostMesh.h"
+#include "../src/host/hostKernels3d.h"
+#include "../src/host/hostNuma.h"
+#include "../src/host/hostStreamKernels3d.h"
+#include "../src/base/PartitionPlanner.h"
+#include "../src/base/Reciprocity.h"
+#include "../src/base/SimulationParameters.h"
+#include "../src/io/ResponseWriter.h"
+#include "../src/global_includes.h"
+#include "TestFixtures.h"
+#include <fstream>
+
+namespace {
+  bool noInterrupt() {return false;}
+  void noProgress(int, int, float) {}
+
+  void launch(HostMesh<float>* mesh, SimulationParameters* sp, float* ret,
+              unsigned int threads) {
+    launchFDTD3dHost(mesh, sp, ret, noInterrupt, noProgress, threads);
+  }
+
+  void launch(HostMesh<double>* mesh, SimulationParameters* sp, double* ret,
+              unsigned int threads) {
+    launchFDTD3dHostDouble(mesh, sp, ret, noInterrupt, noProgress, threads);
+  }
+
+  void launch(HostBlockMesh<float>* mesh, SimulationParameters* sp, float* ret) {
+    launchFDTD3dHostBlocks(mesh, sp, ret, noInterrupt, noProgress);
+  }
+
+  void launch(HostStreamMesh<float>* mesh, SimulationParameters* sp, float* ret,
+              unsigned int slab_slices, unsigned int time_block) {
+    launchFDTD3dHostStream(mesh, sp, ret, noInterrupt, noProgress, slab_slices, time_block, 2);
+  }
+
+  void launch(HostStreamMesh<double>* mesh, SimulationParameters* sp, double* ret,
+              unsigned int slab_slices, unsigned int time_block) {
+    launchFDTD3dHostStreamDouble(mesh, sp, ret, noInterrupt, noProgress,
+                                 slab_slices, time_block, 2);
+  }
+
+  void launch(HostBlockMesh<double>* mesh, SimulationParameters* sp, double* ret) {
+    launchFDTD3dHostBlocksDouble(mesh, sp, ret, noInterrupt, noProgress);
+  }
+
+  const unsigned int dim_x = 12;
+  const unsigned int dim_y = 11;
+  const unsigned int dim_z = 24;
+
+  void setupParameters(SimulationParameters& sp) {
+    sp.setSpatialFs(7000);
+    sp.setNumSteps(80);
+    float dx = sp.getDx();
+    // Element coordinates are shifted by the padding node
+    sp.addSource(Source(4*dx, 3*dx, 5*dx, SRC_SOFT, IMPULSE, 0));
+    sp.addReceiver(6*dx, 5*dx, 6*dx);
+    sp.addReceiver(7*dx, 6*dx, 18*dx);
+    sp.addReceiver(3*dx, 4*dx, 11*dx);
+  }
+
+  // With a writer the responses are only streamed, an empty vector is
+  // returned
+  template <typename T>
+  std::vector<T> run(unsigned int partitions, unsigned int threads, unsigned int update_type,
+                     unsigned int halo_depth = 1, ResponseWriter* writer = NULL) {
+    std::vector<unsigned char> position, material;
+    makeBox(position, material, dim_x, dim_y, dim_z);
+    SimulationParameters sp;
+    setupParameters(sp);
+    sp.setResponseWriter(writer);
+
+    std::vector<T> coefs(MATERIAL_COEF_NUM, (T)0.2);
+    std::vector<T> params(4, (T)0);
+    params[0] = (T)sp.getLambda();
+    params[1] = (T)(sp.getLambda()*sp.getLambda());
+    params[2] = (T)1/(T)3;
+
+    HostMesh<T> mesh;
+    mesh.setupMesh(&position[0], &material[0], dim_x, dim_y, dim_z,
+                   &coefs[0], 1, &params[0], update_type);
+    mesh.makePartition(partitions, halo_depth);
+
+    if(writer) {
+      launch(&mesh, &sp, (T*)NULL, threads);
+      return std::vector<T>();
+    }
+    std::vector<T> responses(sp.getNumSteps()*sp.getNumReceivers(), (T)0);
+    launch(&mesh, &sp, &responses[0], threads);
+    return responses;
+  }
+
+  // Run the box with the given sources and receivers
+  template <typename T>
+  void runParameters(SimulationParameters& sp, unsigned int partitions, T* ret,
+                     unsigned int halo_depth = 1) {
+    std::vector<unsigned char> position, material;
+    makeBox(position, material, dim_x, dim_y, dim_z);
+    std::vector<T> coefs(MATERIAL_COEF_NUM, (T)0.2);
+    std::vector<T> params(4, (T)0);
+    params[0] = (T)sp.getLambda();
+    params[1] = (T)(sp.getLambda()*sp.getLambda());
+    params[2] = (T)1/(T)3;
+
+    HostMesh<T> mesh;
+    mesh.setupMesh(&position[0], &material[0], dim_x, dim_y, dim_z,
+                   &coefs[0], 1, &params[0], SRL_FORWARD);
+    mesh.makePartition(partitions, halo_depth);
+    launch(&mesh, &sp, ret, 1);
+  }
+
+  template <typename T>
+  std::vector<T> runBlocks(unsigned int px, unsigned int py, unsigned int pz,
+                           unsigned int update_type) {
+    std::vector<unsigned char> position, material;
+    makeBox(position, material, dim_x, dim_y, dim_z);
+    SimulationParameters sp;
+    setupParameters(sp);
+
+    std::vector<T> coefs(MATERIAL_COEF_NUM, (T)0.2);
+    std::vector<T> params(4, (T)0);
+    params[0] = (T)sp.getLambda();
+    params[1] = (T)(sp.getLambda()*sp.getLambda());
+    params[2] = (T)1/(T)3;
+
+    HostBlockMesh<T> mesh;
+    mesh.setupMesh(&position[0], &material[0], dim_x, dim_y, dim_z,
+                   &coefs[0], 1, &params[0], update_type);
+    mesh.makeBlocks(px, py, pz);
+
+    std::vector<T> responses(sp.getNumSteps()*sp.getNumReceivers(), (T)0);
+    launch(&mesh, &sp, &responses[0]);
+    return responses;
+  }
+
+  template <typename T>
+  std::vector<T> runStream(unsigned int slab_slices, unsigned int time_block,
+                           unsigned int update_type) {
+    std::vector<unsigned char> position, material;
+    makeBox(position, material, dim_x, dim_y, dim_z);
+    SimulationParameters sp;
+    setupParameters(sp);
+
+    std::vector<T> coefs(MATERIAL_COEF_NUM, (T)0.2);
+    std::vector<T> params(4, (T)0);
+    params[0] = (T)sp.getLambda();
+    params[1] = (T)(sp.getLambda()*sp.getLambda());
+    params[2] = (T)1/(T)3;
+
+    HostStreamMesh<T> mesh;
+    mesh.setupMesh("HostStreamMeshTest", dim_x, dim_y, dim_z,
+                   &coefs[0], 1, &params[0], update_type);
+    for(unsigned int z = 0; z < dim_z; z += 5) {
+      unsigned int count = std::min(5u, dim_z-z);
+      mesh.writeSlices(z, count, &position[z*dim_x*dim_y], &material[z*dim_x*dim_y]);
+    }
+
+    std::vector<T> responses(sp.getNumSteps()*sp.getNumReceivers(), (T)0);
+    launch(&mesh, &sp, &responses[0], slab_slices, time_block);
+    return responses;
+  }
+}
+
+BOOST_AUTO_TEST_SUITE(HostMeshTest)
+
+BOOST_AUTO_TEST_CASE(HostMesh_partition) {
+  std::vector<unsigned char> position, material;
+  makeBox(position, material, dim_x, dim_y, dim_z);
+  std::vector<float> coefs(MATERIAL_COEF_NUM, 0.f);
+  std::vector<float> params(4, 0.f);
+
+  HostMesh<float> mesh;
+  mesh.setupMesh(&position[0], &material[0], dim_x, dim_y, dim_z,
+                 &coefs[0], 1, &params[0], SRL_FORWARD);
+  mesh.makePartition(3);
+
+  BOOST_CHECK_EQUAL(mesh.getNumberOfPartitions(), 3);
+  BOOST_CHECK_EQUAL(mesh.getFirstSliceIdx(0), 0);
+  BOOST_CHECK_EQUAL(mesh.getLastSliceIdx(2), dim_z-1);
+
+  // Neighbouring partitions overlap by the two halo slices
+  for(unsigned int i = 0; i < 2; i++)
+    BOOST_CHECK_EQUAL(mesh.getLastSliceIdx(i), mesh.getFirstSliceIdx(i+1)+1);
+
+  // Every slice is owned by exactly one partition
+  for(unsigned int z = 0; z < dim_z; z++) {
+    int partition, elem;
+    mesh.getElementIdxAndPartition(5, 5, z, &partition, &elem);
+    BOOST_CHECK(partition != -1);
+    BOOST_CHECK_EQUAL(mesh.getPositionIdxPtrAt(partition)[elem],
+                      position[z*dim_x*dim_y+5*dim_x+5]);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(HostKernels_partitioned_equal) {
+  unsigned int schemes[] = {SRL_FORWARD, SRL};
+  for(unsigned int s = 0; s < 2; s++) {
+    std::vector<float> ref = run<float>(1, 1, schemes[s]);
+    std::vector<float> part = run<float>(3, 1, schemes[s]);
+    std::vector<float> group = run<float>(3, 2, schemes[s]);
+
+    float energy = 0.f;
+    for(unsigned int i = 0; i < ref.size(); i++) {
+      energy += ref[i]*ref[i];
+      BOOST_CHECK_EQUAL(ref[i], part[i]);
+      BOOST_CHECK_EQUAL(ref[i], group[i]);
+    }
+    BOOST_CHECK(energy > 0.f);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(HostKernels_partitioned_double) {
+  std::vector<double> ref = run<double>(1, 1, SRL_FORWARD);
+  std::vector<double> part = run<double>(4, 3, SRL_FORWARD);
+  std::vector<float> single = run<float>(1, 1, SRL_FORWARD);
+
+  for(unsigned int i = 0; i < ref.size(); i++) {
+    BOOST_CHECK_EQUAL(ref[i], part[i]);
+    BOOST_CHECK_SMALL(ref[i]-(double)single[i], 1e-4);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(HostKernels_streamed_responses) {
+  std::vector<float> ref = run<float>(1, 1, SRL_FORWARD);
+  std::vector<double> ref_double = run<double>(1, 1, SRL_FORWARD);
+  unsigned int num_steps = (unsigned int)ref.size()/3;
+
+  ResponseWriter writer;
+  BOOST_CHECK(writer.open("/tmp/pfdtd_responses.wav", RESPONSE_WAV, 3, 7000));
+  BOOST_CHECK(run<float>(3, 2, SRL_FORWARD, 1, &writer).empty());
+  BOOST_CHECK(writer.close());
+  BOOST_CHECK(!writer.hasFailed());
+  BOOST_CHECK_EQUAL(writer.getFramesWritten(), num_steps);
+
+  // The WAV file has a channel per receiver
+  for(unsigned int r = 0; r < 3; r++) {
+    InputStream stream;
+    BOOST_CHECK(stream.open("/tmp/pfdtd_responses.wav", STREAM_WAV, r, 16));
+    BOOST_CHECK_EQUAL(stream.getNumSamples(), num_steps);
+    BOOST_CHECK_EQUAL(stream.getSampleRate(), 7000);
+    for(unsigned int i = 0; i < num_steps; i++)
+      BOOST_CHECK_EQUAL((float)stream.getSample(i), ref[r*num_steps+i]);
+  }
+
+  BOOST_CHECK(writer.open("/tmp/pfdtd_responses.raw", RESPONSE_RAW_DOUBLE, 3, 7000));
+  run<double>(4, 1, SRL_FORWARD, 1, &writer);
+  writer.close();
+  std::vector<double> raw(3*num_steps, 0.0);
+  FILE* f = fopen("/tmp/pfdtd_responses.raw", "rb");
+  BOOST_CHECK_EQUAL(fread(&raw[0], sizeof(double), raw.size(), f), raw.size());
+  fclose(f);
+  for(unsigned int i = 0; i < num_steps; i++)
+    for(unsigned int r = 0; r < 3; r++)
+      BOOST_CHECK_EQUAL(raw[i*3+r], ref_double[r*num_steps+i]);
+
+  remove("/tmp/pfdtd_responses.wav");
+  remove("/tmp/pfdtd_responses.raw");
+}
+
+BOOST_AUTO_TEST_CASE(HostKernels_receiver_grid) {
+  SimulationParameters sp;
+  setupParameters(sp);
+  float dx = sp.getDx();
+  sp.addReceiverGrid(ReceiverGrid(1*dx, 2*dx, 2*dx, 9*dx, 8*dx, 20*dx, 3*dx, GRID_FLOAT32));
+  sp.addReceiverGrid(ReceiverGrid(1*dx, 2*dx, 2*dx, 9*dx, 8*dx, 20*dx, 3*dx, GRID_DELTA, 4));
+  std::vector<float> responses(sp.getNumSteps()*sp.getNumReceivers(), 0.f);
+  runParameters<float>(sp, 3, &responses[0]);
+
+  const ReceiverGrid& grid = sp.getReceiverGrid(0);
+  BOOST_CHECK_EQUAL(grid.getNumPointsX(), 3);
+  BOOST_CHECK_EQUAL(grid.getNumPointsY(), 3);
+  BOOST_CHECK_EQUAL(grid.getNumPointsZ(), 7);
+
+  // The same points as receivers, in one partition
+  SimulationParameters ref_sp;
+  setupParameters(ref_sp);
+  ref_sp.resetSourcesAndReceivers();
+  ref_sp.addSource(Source(4*dx, 3*dx, 5*dx, SRC_SOFT, IMPULSE, 0));
+  for(unsigned int i = 0; i < grid.getNumPoints(); i++) {
+    nv::Vec3i node = grid.getPointElementCoordinates(i);
+    ref_sp.addReceiver((float)(node.x-1)*dx, (float)(node.y-1)*dx, (float)(node.z-1)*dx);
+  }
+  unsigned int num_steps = ref_sp.getNumSteps();
+  std::vector<float> ref(num_steps*ref_sp.getNumReceivers(), 0.f);
+  runParameters<float>(ref_sp, 1, &ref[0]);
+
+  // The receivers of the run are not affected by the grids
+  std::vector<float> plain = run<float>(1, 1, SRL_FORWARD);
+  for(unsigned int i = 0; i < plain.size(); i++)
+    BOOST_CHECK_EQUAL(responses.at(i), plain.at(i));
+
+  const ReceiverGrid& decimated = sp.getReceiverGrid(1);
+  BOOST_CHECK_EQUAL(decimated.getNumSamples(), num_steps/4);
+  float energy = 0.f;
+  for(unsigned int i = 0; i < grid.getNumPoints(); i++) {
+    std::vector<float> response = grid.getResponse(i);
+    std::vector<float> mean = decimated.getResponse(i);
+    for(unsigned int k = 0; k < num_steps; k++) {
+      BOOST_CHECK_EQUAL(response.at(k), ref.at(i*num_steps+k));
+      energy += response.at(k)*response.at(k);
+    }
+    for(unsigned int k = 0; k < num_steps/4; k++) {
+      double sum = 0.0;
+      for(unsigned int j = 0; j < 4; j++)
+        sum += ref.at(i*num_steps+k*4+j);
+      BOOST_CHECK_EQUAL(mean.at(k), (float)(sum/4));
+    }
+  }
+  BOOST_CHECK(energy > 0.f);
+}
+
+BOOST_AUTO_TEST_CASE(HostKernels_b_format) {
+  // Receivers around the partition borders, the velocity of the border
+  // slices reads the halos
+  SimulationParameters sp;
+  sp.setSpatialFs(7000);
+  sp.setNumSteps(80);
+  float dx = sp.getDx();
+  sp.addSource(Source(4*dx, 3*dx, 5*dx, SRC_SOFT, IMPULSE, 0));
+  unsigned int heights[] = {6, 7, 8, 9, 14, 15, 16, 17};
+  for(unsigned int i = 0; i < 8; i++)
+    BOOST_CHECK_EQUAL(sp.addBFormatReceiver(6*dx, 5*dx, heights[i]*dx), i*4);
+  unsigned int num_steps = sp.getNumSteps();
+  std::vector<float> single(num_steps*sp.getNumReceivers(), 0.f);
+  std::vector<float> split(single.size(), 0.f);
+  std::vector<float> deep(single.size(), 0.f);
+  runParameters<float>(sp, 1, &single[0]);
+  runParameters<float>(sp, 3, &split[0]);
+  runParameters<float>(sp, 3, &deep[0], 2);
+  for(unsigned int i = 0; i < single.size(); i++) {
+    BOOST_CHECK_EQUAL(single.at(i), split.at(i));
+    BOOST_CHECK_EQUAL(single.at(i), deep.at(i));
+  }
+
+  // The centre and the neighbours of each receiver as plain receivers
+  SimulationParameters ref_sp;
+  ref_sp.setSpatialFs(7000);
+  ref_sp.setNumSteps(80);
+  ref_sp.addSource(Source(4*dx, 3*dx, 5*dx, SRC_SOFT, IMPULSE, 0));
+  for(unsigned int i = 0; i < 8; i++) {
+    float z = (float)heights[i];
+    ref_sp.addReceiver(6*dx, 5*dx, z*dx);
+    ref_sp.addReceiver(7*dx, 5*dx, z*dx);
+    ref_sp.addReceiver(5*dx, 5*dx, z*dx);
+    ref_sp.addReceiver(6*dx, 6*dx, z*dx);
+    ref_sp.addReceiver(6*dx, 4*dx, z*dx);
+    ref_sp.addReceiver(6*dx, 5*dx, (z+1)*dx);
+    ref_sp.addReceiver(6*dx, 5*dx, (z-1)*dx);
+  }
+  std::vector<float> ref(num_steps*ref_sp.getNumReceivers(), 0.f);
+  runParameters<float>(ref_sp, 1, &ref[0]);
+
+  float lambda = (float)sp.getLambda();
+  for(unsigned int i = 0; i < 8; i++) {
+    const float* taps = &ref[i*7*num_steps];
+    const float* w = &single[i*4*num_steps];
+    for(unsigned int c = 1; c < 4; c++) {
+      // The velocity lags the pressure by half a step
+      const float* plus = taps+(2*c-1)*num_steps;
+      const float* minus = taps+2*c*num_steps;
+      const float* channel = w+c*num_steps;
+      float velocity = 0.f;
+      BOOST_CHECK_EQUAL(channel[0], 0.f);
+      for(unsigned int k = 1; k < num_steps; k++) {
+        velocity += lambda*((plus[k-1]-minus[k-1])*0.5f);
+        BOOST_CHECK_SMALL(channel[k]-velocity, 1e-6f);
+      }
+    }
+    for(unsigned int k = 0; k < num_steps; k++)
+      BOOST_CHECK_EQUAL(w[k], taps[k]);
+  }
+
+  // Above the source the sound arrives from below
+  const float* w = &single[7*4*num_steps];
+  float wz = 0.f;
+  for(unsigned int k = 0; k < num_steps; k++)
+    wz += w[k]*w[3*num_steps+k];
+  BOOST_CHECK(wz < 0.f);
+}
+
+BOOST_AUTO_TEST_CASE(HostKernels_resampled_responses) {
+  SimulationParameters sp;
+  setupParameters(sp);
+  sp.setNumSteps(600);
+  float dx = sp.getDx();
+  sp.addReceiverWaypoint(2, 300.f, 5*dx, 5*dx, 12*dx);
+  unsigned int num_steps = sp.getNumSteps();
+  std::vector<double> full(3*num_steps, 0.0);
+  runParameters<double>(sp, 1, &full[0]);
+
+  // 7 kHz to 48 kHz, the writer gets the resampled chunks
+  sp.setOutputFs(48000);
+  unsigned int num_samples = sp.getNumOutputSamples();
+  BOOST_CHECK_EQUAL(num_samples, 4115);
+  ResponseWriter writer;
+  BOOST_CHECK(writer.open("/tmp/pfdtd_resampled.raw", RESPONSE_RAW_DOUBLE, 3, 48000));
+  sp.setResponseWriter(&writer);
+  std::vector<double> resampled(3*num_samples, 0.0);
+  runParameters<double>(sp, 3, &resampled[0]);
+  writer.close();
+  BOOST_CHECK_EQUAL(writer.getFramesWritten(), num_samples);
+
+  Resampler resampler = sp.getResampler();
+  std::vector<double> ref(num_samples, 0.0);
+  std::vector<double> raw(3*num_samples, 0.0);
+  FILE* f = fopen("/tmp/pfdtd_resampled.raw", "rb");
+  BOOST_CHECK_EQUAL(fread(&raw[0], sizeof(double), raw.size(), f), raw.size());
+  fclose(f);
+  for(unsigned int r = 0; r < 3; r++) {
+    resampler.resample(&full[r*num_steps], num_steps, &ref[0]);
+    for(unsigned int q = 0; q < num_samples; q++) {
+      BOOST_CHECK_SMALL(resampled[r*num_samples+q]-ref[q], 1e-12);
+      // The moving receiver is not streamed
+      BOOST_CHECK_EQUAL(raw[q*3+r], r < 2 ? resampled[r*num_samples+q] : 0.0);
+    }
+  }
+  remove("/tmp/pfdtd_resampled.raw");
+}
+
+BOOST_AUTO_TEST_CASE(HostKernels_reciprocity) {
+  // More sources than receivers, two reciprocal runs
+  SimulationParameters sp;
+  sp.setSpatialFs(7000);
+  sp.setNumSteps(80);
+  float dx = sp.getDx();
+  std::vector<double> data(30, 0.0);
+  for(unsigned int i = 0; i < data.size(); i++)
+    data.at(i) = sin(0.7*i)*(30.0-i)/30.0;
+  sp.addInputDataDouble(data);
+  sp.addSource(Source(4*dx, 3*dx, 5*dx, SRC_SOFT, IMPULSE, 0));
+  sp.addSource(Source(7*dx, 6*dx, 15*dx, SRC_SOFT, DATA, 0));
+  sp.addSource(Source(3*dx, 7*dx, 10*dx, SRC_SOFT, GAUSSIAN, 0));
+  sp.addReceiver(6*dx, 5*dx, 6*dx);
+  sp.addReceiver(5*dx, 4*dx, 19*dx);
+  unsigned int num_steps = sp.getNumSteps();
+
+  BOOST_CHECK(ReciprocityPlan::isSupported(sp));
+  ReciprocityPlan plan(sp);
+  BOOST_CHECK(plan.isReciprocal());
+  BOOST_CHECK_EQUAL(plan.getNumRuns(), 2u);
+  for(unsigned int run = 0; run < plan.getNumRuns(); run++) {
+    SimulationParameters run_sp = plan.getRunParameters(run);
+    BOOST_CHECK_EQUAL(run_sp.getNumSources(), 1u);
+    BOOST_CHECK_EQUAL(run_sp.getNumReceivers(), 3u);
+    std::vector<double> ret(num_steps*run_sp.getNumReceivers(), 0.0);
+    runParameters<double>(run_sp, 2, &ret[0]);
+    plan.addRunResponses(run, &ret[0]);
+  }
+
+  std::vector<double> ref(num_steps*sp.getNumReceivers(), 0.0);
+  std::vector<double> sum(ref.size(), 0.0);
+  runParameters<double>(sp, 1, &ref[0]);
+  plan.sumResponses(&sum[0]);
+  double energy = 0.0;
+  for(unsigned int i = 0; i < ref.size(); i++) {
+    energy += ref.at(i)*ref.at(i);
+    BOOST_CHECK_SMALL(sum.at(i)-ref.at(i), 1e-9);
+  }
+  BOOST_CHECK(energy > 0.0);
+
+  // A pair against the source alone, and the forward plan
+  SimulationParameters single = sp;
+  single.removeSource(2);
+  single.removeSource(0);
+  std::vector<double> alone(ref.size(), 0.0);
+  runParameters<double>(single, 1, &alone[0]);
+  std::vector<double> pair = plan.getPairResponse(1, 1);
+  BOOST_CHECK_EQUAL(pair.size(), num_steps);
+  for(unsigned int i = 0; i < num_steps; i++)
+    BOOST_CHECK_SMALL(pair.at(i)-alone.at(num_steps+i), 1e-9);
+  BOOST_CHECK(plan.getPairResponse(3, 0).empty());
+
+  single.addReceiver(4*dx, 3*dx, 5*dx);
+  single.addReceiver(3*dx, 7*dx, 10*dx);
+  ReciprocityPlan forward(single);
+  BOOST_CHECK(!forward.isReciprocal());
+  BOOST_CHECK_EQUAL(forward.getNumRuns(), 1u);
+
+  single.addReceiverWaypoint(0, 40.f, 6*dx, 6*dx, 6*dx);
+  BOOST_CHECK(!ReciprocityPlan::isSupported(single));
+}
+
+BOOST_AUTO_TEST_CASE(HostKernels_deep_halo) {
+  std::vector<float> ref = run<float>(1, 1, SRL_FORWARD);
+  unsigned int depths[] = {2, 3, 5};
+  for(unsigned int d = 0; d < 3; d++) {
+    std::vector<float> deep = run<float>(3, 1, SRL_FORWARD, depths[d]);
+    std::vector<float> group = run<float>(4, 2, SRL_FORWARD, depths[d]);
+    for(unsigned int i = 0; i < ref.size(); i++) {
+      BOOST_CHECK_EQUAL(ref[i], deep[i]);
+      BOOST_CHECK_EQUAL(ref[i], group[i]);
+    }
+  }
+
+  // The ghost slices come from the neighbour only
+  std::vector<unsigned char> position, material;
+  makeBox(position, material, dim_x, dim_y, dim_z);
+  std::vector<float> coefs(MATERIAL_COEF_NUM, 0.f);
+  std::vector<float> params(4, 0.f);
+  HostMesh<float> mesh;
+  mesh.setupMesh(&position[0], &material[0], dim_x, dim_y, dim_z,
+                 &coefs[0], 1, &params[0], SRL_FORWARD);
+  mesh.makePartition(3, 4);
+  BOOST_CHECK_EQUAL(mesh.getHaloDepth(), 4);
+  BOOST_CHECK_EQUAL(mesh.getLastSliceIdx(0), mesh.getFirstSliceIdx(1)+7);
+  BOOST_CHECK_THROW(mesh.makePartition(3, 9), int);
+}
+
+BOOST_AUTO_TEST_CASE(HostKernels_moving_receiver) {
+  std::vector<unsigned char> position, material;
+  makeBox(position, material, dim_x, dim_y, dim_z);
+  SimulationParameters sp;
+  setupParameters(sp);
+  sp.resetSourcesAndReceivers();
+  float dx = sp.getDx();
+  sp.addSource(Source(4*dx, 3*dx, 5*dx, SRC_SOFT, IMPULSE, 0));
+
+  // Static receivers at the nodes the moving one passes, the element
+  // coordinates are shifted by the padding node
+  for(unsigned int z = 5; z < 17; z++)
+    for(unsigned int c = 0; c < 4; c++)
+      sp.addReceiver((float)(4+(c&1))*dx, (float)(3+(c>>1))*dx, (float)z*dx);
+  Receiver moving(0.f, 0.f, 0.f);
+  moving.addWaypoint(0.f, 4.3f*dx, 3.6f*dx, 5.2f*dx);
+  moving.addWaypoint(79.f, 4.3f*dx, 3.6f*dx, 15.7f*dx);
+  sp.addReceiver(moving);
+  unsigned int m = sp.getNumReceivers()-1;
+
+  std::vector<float> coefs(MATERIAL_COEF_NUM, 0.2f);
+  std::vector<float> params(4, 0.f);
+  params[0] = sp.getLambda();
+  params[1] = sp.getLambda()*sp.getLambda();
+  params[2] = 1.f/3.f;
+  HostMesh<float> mesh;
+  mesh.setupMesh(&position[0], &material[0], dim_x, dim_y, dim_z,
+                 &coefs[0], 1, &params[0], SRL_FORWARD);
+  mesh.makePartition(3, 2);
+
+  unsigned int num_steps = sp.getNumSteps();
+  std::vector<float> responses(num_steps*sp.getNumReceivers(), 0.f);
+  launch(&mesh, &sp, &responses[0], 1);
+
+  Trajectory trajectory = sp.getReceiverTrajectory(m);
+  float energy = 0.f;
+  for(unsigned int step = 0; step < num_steps; step++) {
+    nv::Vec3i base;
+    nv::Vec3f frac;
+    trajectory.getCell(step, dim_x, dim_y, dim_z, base, frac);
+    float expected = 0.f;
+    for(unsigned int c = 0; c < 8; c++) {
+      nv::Vec3i pos = Trajectory::getCorner(base, c);
+      unsigned int r = (pos.z-6)*4+(pos.x-5)+(pos.y-4)*2;
+      expected += Trajectory::getWeight<float>(frac, c)*responses.at(r*num_steps+step);
+    }
+    energy += expected*expected;
+    BOOST_CHECK_SMALL(responses.at(m*num_steps+step)-expected, 1e-6f);
+  }
+  BOOST_CHECK(energy > 0.f);
+}
+
+BOOST_AUTO_TEST_CASE(HostKernels_targets) {
+  std::vector<float> ref = run<float>(1, 1, SRL_FORWARD);
+  BOOST_CHECK(estimateHostThroughput(1) > 0.f);
+
+  std::vector<unsigned char> position, material;
+  makeBox(position, material, dim_x, dim_y, dim_z);
+  SimulationParameters sp;
+  setupParameters(sp);
+  std::vector<float> coefs(MATERIAL_COEF_NUM, 0.2f);
+  std::vector<float> params(4, 0.f);
+  params[0] = sp.getLambda();
+  params[1] = sp.getLambda()*sp.getLambda();
+  params[2] = 1.f/3.f;
+
+  // A fast and a slow group of threads, weighted 3:1
+  std::vector<ExecutionTarget> targets;
+  targets.push_back(makeHostTarget(3, 300.f));
+  targets.push_back(makeHostTarget(1, 100.f));
+
+  PartitionPlanner planner;
+  planner.countSlices(&position[0], dim_x, dim_y, dim_z, 0x86);
+  for(unsigned int i = 0; i < targets.size(); i++)
+    planner.addTarget(targets.at(i).throughput, targets.at(i).memory_in_MB);
+  std::vector< std::vector<unsigned int> > indexing = planner.plan(2);
+  BOOST_CHECK(indexing.at(0).size() > 2*indexing.at(1).size());
+
+  unsigned int depths[] = {1, 2};
+  for(unsigned int d = 0; d < 2; d++) {
+    HostMesh<float> mesh;
+    mesh.setupMesh(&position[0], &material[0], dim_x, dim_y, dim_z,
+                   &coefs[0], 1, &params[0], SRL_FORWARD);
+    mesh.makePartition(indexing, depths[d]);
+
+    std::vector<float> responses(ref.size(), 0.f);
+    launchFDTD3dHostTargets(&mesh, &sp, &responses[0], noInterrupt, noProgress, targets);
+    for(unsigned int i = 0; i < ref.size(); i++)
+      BOOST_CHECK_EQUAL(ref[i], responses[i]);
+
+    targets.push_back(makeHostTarget(1, 0.f));
+    BOOST_CHECK_THROW(launchFDTD3dHostTargets(&mesh, &sp, &responses[0], noInterrupt,
+                                              noProgress, targets), int);
+    targets.pop_back();
+  }
+}
+
+// The block and stream solvers fail on the features they do not have
+BOOST_AUTO_TEST_CASE(HostKernels_unsupported) {
+  std::vector<unsigned char> position, material;
+  makeBox(position, material, dim_x, dim_y, dim_z);
+  std::vector<float> coefs(MATERIAL_COEF_NUM, 0.2f);
+  std::vector<float> params(4, 0.f);
+
+  HostBlockMesh<float> block_mesh;
+  block_mesh.setupMesh(&position[0], &material[0], dim_x, dim_y, dim_z,
+                       &coefs[0], 1, &params[0], SRL_FORWARD);
+  block_mesh.makeBlocks(1, 1, 2);
+  HostStreamMesh<float> stream_mesh;
+  stream_mesh.setupMesh("HostStreamMeshTest", dim_x, dim_y, dim_z,
+                        &coefs[0], 1, &params[0], SRL_FORWARD);
+  stream_mesh.writeSlices(0, dim_z, &position[0], &material[0]);
+
+  for(unsigned int f = 0; f < 3; f++) {
+    SimulationParameters sp;
+    setupParameters(sp);
+    float dx = sp.getDx();
+    if(f == 0) {
+      ArraySource array(IMPULSE, 0);
+      array.addNode(3*dx, 3*dx, 9*dx, 1.f, 0.f);
+      sp.addArraySource(array);
+    }
+    if(f == 1)
+      sp.addReceiverWaypoint(0, 40.f, 6*dx, 6*dx, 6*dx);
+    if(f == 2)
+      sp.addBFormatReceiver(6*dx, 5*dx, 8*dx);
+    params[0] = sp.getLambda();
+    std::vector<float> responses(sp.getNumSteps()*sp.getNumReceivers(), 0.f);
+    BOOST_CHECK_THROW(launch(&block_mesh, &sp, &responses[0]), int);
+    BOOST_CHECK_THROW(launch(&stream_mesh, &sp, &responses[0], 4, 2), int);
+  }
+}
+
+// The same run on host targets and on device targets, with two materials
+// read on octave 1 and point, array and moving sources
+BOOST_AUTO_TEST_CASE(HostKernels_deviceTargets) {
+  std::vector<unsigned char> position, material;
+  makeBox(position, material, dim_x, dim_y, dim_z);
+  for(unsigned int i = 0; i < material.size(); i++)
+    material[i] = (unsigned char)((i%dim_x) > dim_x/2);
+
+  SimulationParameters sp;
+  setupParameters(sp);
+  float dx = sp.getDx();
+  sp.addSource(Source(7*dx, 6*dx, 14*dx, SRC_HARD, IMPULSE, 0));
+  ArraySource array(SINE, 0);
+  array.addNode(3*dx, 3*dx, 9*dx, 0.5f, 2.f);
+  array.addNode(8*dx, 5*dx, 16*dx, 1.f, 0.5f);
+  sp.addArraySource(array);
+  Source moving(0.f, 0.f, 0.f, SRC_SOFT, SINE, 0);
+  moving.addWaypoint(0.f, 5.3f*dx, 4.6f*dx, 8.2f*dx);
+  moving.addWaypoint(599.f, 5.3f*dx, 4.6f*dx, 17.7f*dx);
+  sp.addSource(moving);
+
+  std::vector<float> coefs(2*MATERIAL_COEF_NUM, 0.2f);
+  for(unsigned int i = MATERIAL_COEF_NUM; i < coefs.size(); i++)
+    coefs[i] = 0.05f*(float)(i%4);
+  std::vector<float> params(4, 0.f);
+  params[0] = sp.getLambda();
+  params[1] = sp.getLambda()*sp.getLambda();
+  params[2] = 1.f/3.f;
+  params[3] = 1.f;
+
+  unsigned int update_types[] = {SRL_FORWARD, SRL};
+  for(unsigned int u = 0; u < 2; u++) {
+    // The forward scheme runs long enough to cross a chunk of the sources,
+    // the Kowalczyk scheme is not stable that long on the Bilbao box
+    sp.setNumSteps(u == 0 ? 600 : 80);
+    std::vector< std::vector<float> > responses(2);
+    for(unsigned int t = 0; t < 2; t++) {
+      std::vector<ExecutionTarget> targets;
+      for(unsigned int i = 0; i < 3; i++)
+        targets.push_back(t == 0 ? makeHostTarget(1, 0.f) : makeDeviceTarget(0, 0.f, 1e9f, 4, 1));
+      HostMesh<float> mesh;
+      mesh.setupMesh(&position[0], &material[0], dim_x, dim_y, dim_z,
+                     &coefs[0], 2, &params[0], update_types[u]);
+      mesh.makePartition(3, 2);
+      responses.at(t).assign(sp.getNumSteps()*sp.getNumReceivers(), 0.f);
+      launchFDTD3dHostTargets(&mesh, &sp, &responses.at(t)[0], noInterrupt, noProgress, targets);
+    }
+
+    float energy = 0.f;
+    for(unsigned int i = 0; i < responses.at(0).size(); i++) {
+      BOOST_CHECK_CLOSE(responses.at(0)[i], responses.at(1)[i], 1e-3f);
+      energy += responses.at(0)[i]*responses.at(0)[i];
+    }
+    BOOST_CHECK(energy > 0.f);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(HostKernels_numa) {
+  std::vector<unsigned int> cpus = NumaTopology::parseCpuList("0-3,8,10-11\n");
+  BOOST_CHECK_EQUAL(cpus.size(), 7);
+  BOOST_CHECK_EQUAL(cpus.at(4), 8);
+  BOOST_CHECK_EQUAL(cpus.at(6), 11);
+  BOOST_CHECK(NumaTopology::parseCpuList("").empty());
+
+  NumaTopology topology;
+  BOOST_REQUIRE(topology.getNumberOfNodes() > 0);
+  BOOST_CHECK(!topology.getCpus(0).empty());
+
+  // Untouched storage reads as zero, also on huge pages
+  HostArray<float> array;
+  array.allocate(3*1024*1024, topology.getNodeId(0), true);
+  BOOST_CHECK_EQUAL(array.size(), 3*1024*1024);
+  BOOST_CHECK_EQUAL(array[array.size()-1], 0.f);
+
+  std::vector<float> ref = run<float>(1, 1, SRL_FORWARD);
+
+  std::vector<unsigned char> position, material;
+  makeBox(position, material, dim_x, dim_y, dim_z);
+  SimulationParameters sp;
+  setupParameters(sp);
+  std::vector<float> coefs(MATERIAL_COEF_NUM, 0.2f);
+  std::vector<float> params(4, 0.f);
+  params[0] = sp.getLambda();
+  params[1] = sp.getLambda()*sp.getLambda();
+  params[2] = 1.f/3.f;
+
+  // Pinned groups first touching their own slices, one group unpinned
+  std::vector<ExecutionTarget> targets;
+  targets.push_back(makeHostTarget(2, 0.f, 1e9f, 0));
+  targets.push_back(makeHostTarget(1, 0.f, 1e9f, 0));
+  targets.push_back(makeHostTarget(2, 0.f));
+  std::vector<int> nodes(3, topology.getNodeId(0));
+  nodes.at(2) = -1;
+
+  for(unsigned int h = 0; h < 2; h++) {
+    HostMesh<float> mesh;
+    mesh.setupMesh(&position[0], &material[0], dim_x, dim_y, dim_z,
+                   &coefs[0], 1, &params[0], SRL_FORWARD);
+    mesh.setPlacement(nodes, h == 1);
+    mesh.makePartition(3, 2);
+    BOOST_CHECK(mesh.isPlaced());
+
+    std::vector<NodeBandwidth> report;
+    std::vector<float> responses(ref.size(), 0.f);
+    launchFDTD3dHostTargets(&mesh, &sp, &responses[0], noInterrupt, noProgress,
+                            targets, &report);
+    for(unsigned int i = 0; i < ref.size(); i++)
+      BOOST_CHECK_EQUAL(ref[i], responses[i]);
+
+    BOOST_REQUIRE_EQUAL(report.size(), 2);
+    BOOST_CHECK_EQUAL(report.at(0).node, 0);
+    BOOST_CHECK_EQUAL(report.at(0).partitions, 2);
+    BOOST_CHECK_EQUAL(report.at(0).threads, 3);
+    BOOST_CHECK(report.at(0).gb_per_s > 0.f);
+    BOOST_CHECK_EQUAL(report.at(1).node, -1);
+  }
+
+  targets.at(0).numa_node = (int)topology.getNumberOfNodes();
+  HostMesh<float> mesh;
+  mesh.setupMesh(&position[0], &material[0], dim_x, dim_y, dim_z,
+                 &coefs[0], 1, &params[0], SRL_FORWARD);
+  mesh.makePartition(3);
+  std::vector<float> responses(ref.size(), 0.f);
+  BOOST_CHECK_THROW(launchFDTD3dHostTargets(&mesh, &sp, &responses[0], noInterrupt,
+                                            noProgress, targets), int);
+}
+
+BOOST_AUTO_TEST_CASE(HostStreamMesh_equal) {
+  std::vector<float> ref = run<float>(1, 1, SRL_FORWARD);
+  unsigned int slabs[] = {24, 5, 4, 7};
+  unsigned int blocks[] = {1, 1, 3, 7};
+  for(unsigned int s = 0; s < 4; s++) {
+    std::vector<float> responses = runStream<float>(slabs[s], blocks[s], SRL_FORWARD);
+    for(unsigned int i = 0; i < ref.size(); i++)
+      BOOST_CHECK_EQUAL(ref[i], responses[i]);
+  }
+
+  std::vector<double> ref_double = run<double>(1, 1, SRL);
+  std::vector<double> responses = runStream<double>(6, 4, SRL);
+  for(unsigned int i = 0; i < ref_double.size(); i++)
+    BOOST_CHECK_EQUAL(ref_double[i], responses[i]);
+
+  // The files go with the mesh
+  std::ifstream file("HostStreamMeshTest_pressure.bin");
+  BOOST_CHECK(!file.good());
+}
+
+BOOST_AUTO_TEST_CASE(HostBlockMesh_shape) {
+  unsigned int shape[3];
+  size_t halo = 0;
+
+  // Wide and low rooms are split along x and y
+  BOOST_CHECK(HostBlockMesh<float>::chooseShape(402, 302, 22, 16, shape, &halo));
+  BOOST_CHECK_EQUAL(shape[0], 4);
+  BOOST_CHECK_EQUAL(shape[1], 4);
+  BOOST_CHECK_EQUAL(shape[2], 1);
+  BOOST_CHECK_EQUAL(halo, 2*(3*300*20+3*400*20));
+
+  // Tall ones along z
+  BOOST_CHECK(HostBlockMesh<float>::chooseShape(12, 12, 402, 4, shape));
+  BOOST_CHECK_EQUAL(shape[2], 4);
+
+  // More blocks than slices
+  BOOST_CHECK(HostBlockMesh<float>::chooseShape(102, 102, 5, 8, shape));
+  BOOST_CHECK(shape[2] <= 3);
+  BOOST_CHECK(!HostBlockMesh<float>::chooseShape(4, 4, 4, 9, shape));
+}
+
+BOOST_AUTO_TEST_CASE(HostBlockMesh_faces) {
+  std::vector<unsigned char> position, material;
+  makeBox(position, material, dim_x, dim_y, dim_z);
+  std::vector<float> coefs(MATERIAL_COEF_NUM, 0.f);
+  std::vector<float> params(4, 0.f);
+
+  HostBlockMesh<float> mesh;
+  mesh.setupMesh(&position[0], &material[0], dim_x, dim_y, dim_z,
+                 &coefs[0], 1, &params[0], SRL_FORWARD);
+  mesh.makeBlocks(2, 3, 2);
+  BOOST_CHECK_THROW(mesh.makeBlocks(11, 1, 1), int);
+  BOOST_CHECK_EQUAL(mesh.getNumberOfBlocks(), 12);
+
+  // Every updated node is owned by one block, the ghost layers mirror
+  // the domain
+  for(unsigned int z = 1; z < dim_z-1; z++) {
+    for(unsigned int y = 1; y < dim_y-1; y++) {
+      for(unsigned int x = 1; x < dim_x-1; x++) {
+        int block, elem;
+        mesh.getElementIdxAndBlock(x, y, z, &block, &elem);
+        BOOST_CHECK(block != -1);
+        int ghost = mesh.getLocalIndex(block, x-1, y, z+1);
+        BOOST_CHECK(ghost != -1);
+        BOOST_CHECK_EQUAL(mesh.getPositionIdxPtrAt(block)[ghost],
+                          position[(z+1)*dim_x*dim_y+y*dim_x+x-1]);
+      }
+    }
+  }
+
+  // Pack and unpack each axis of a block
+  const HostBlock& block = mesh.getBlock(7);
+  size_t size = (size_t)block.dim[0]*block.dim[1]*block.dim[2];
+  std::vector<float> data(size), copy(size, 0.f);
+  for(size_t i = 0; i < size; i++)
+    data[i] = (float)i;
+  for(unsigned int a = 0; a < 3; a++) {
+    std::vector<float> face(HostBlockMesh<float>::getFaceSize(block, a));
+    for(unsigned int i = 0; i < block.dim[a]; i++) {
+      HostBlockMesh<float>::packFace(&data[0], block, a, i, &face[0]);
+      HostBlockMesh<float>::unpackFace(&copy[0], block, a, i, &face[0]);
+    }
+    for(size_t i = 0; i < size; i++)
+      BOOST_CHECK_EQUAL(data[i], copy[i]);
+    std::fill(copy.begin(), copy.end(), 0.f);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(HostKernels_blocks_equal) {
+  unsigned int schemes[] = {SRL_FORWARD, SRL};
+  unsigned int shapes[][3] = {{2, 2, 1}, {3, 1, 2}, {1, 2, 3}, {2, 2, 2}};
+  for(unsigned int s = 0; s < 2; s++) {
+    std::vector<float> ref = run<float>(1, 1, schemes[s]);
+    for(unsigned int i = 0; i < 4; i++) {
+      std::vector<float> blocks = runBlocks<float>(shapes[i][0], shapes[i][1], shapes[i][2],
+                                                   schemes[s]);
+      for(unsigned int j = 0; j < ref.size(); j++)
+        BOOST_CHECK_EQUAL(ref[j], blocks[j]);
+    }
+  }
+
+  std::vector<double> ref = run<double>(1, 1, SRL_FORWARD);
+  std::vector<double> blocks = runBlocks<double>(2, 3, 2, SRL_FORWARD);
+  for(unsigned int j = 0; j < ref.size(); j++)
+    BOOST_CHECK_EQUAL(ref[j], blocks[j]);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,128 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MAIN
+
+#include <boost/test/unit_test.hpp>
+#include "../src/base/GeometryHandler.h"
+#include "../src/base/MaterialHandler.h"
+#include "../src/ism/Bvh.h"
+#include "../src/ism/ImageSourceEngine.h"
+#include "../src/ism/HybridCombiner.h"
+#include "../src/global_includes.h"
+
+namespace {
+  // A shoebox room of 4 x 3 x 2.5 m, two triangles per wall
+  void makeShoebox(GeometryHandler* gh) {
+    float lx = 4.f, ly = 3.f, lz = 2.5f;
+    float v[] = {0.f, 0.f, 0.f,   lx, 0.f, 0.f,   lx, ly, 0.f,   0.f, ly, 0.f,
+                 0.f, 0.f, lz,    lx, 0.f, lz,    lx, ly, lz,    0.f, ly, lz};
+    unsigned int idx[] = {0,1,2, 0,2,3,   4,6,5, 4,7,6,
+                          0,5,1, 0,4,5,   3,2,6, 3,6,7,
+                          0,3,7, 0,7,4,   1,5,6, 1,6,2};
+    std::vector<float> vertices(v, v+24);
+    std::vector<unsigned int> indices(idx, idx+36);
+    gh->initialize(indices, vertices);
+  }
+}
+
+BOOST_AUTO_TEST_SUITE(ImageSourceTest)
+
+BOOST_AUTO_TEST_CASE(Bvh_intersect) {
+  GeometryHandler gh;
+  makeShoebox(&gh);
+  Bvh bvh;
+  bvh.build(&gh);
+
+  BOOST_CHECK_EQUAL(bvh.getNumberOfTriangles(), 12);
+
+  float t = 0.f;
+  int tri = bvh.intersect(nv::Vec3f(1.f, 1.f, 1.f), nv::Vec3f(1.f, 0.f, 0.f), 100.f, &t);
+  BOOST_CHECK(tri == 10 || tri == 11);
+  BOOST_CHECK_CLOSE(t, 3.f, 1e-3);
+
+  // Nothing between two points inside the room
+  BOOST_CHECK(!bvh.isOccluded(nv::Vec3f(1.f, 1.f, 1.f), nv::Vec3f(3.f, 2.f, 2.f), -1, -1));
+  // Segment through the floor
+  BOOST_CHECK(bvh.isOccluded(nv::Vec3f(1.f, 1.f, 1.f), nv::Vec3f(1.f, 1.f, -1.f), -1, -1));
+}
+
+BOOST_AUTO_TEST_CASE(ImageSource_shoebox) {
+  GeometryHandler gh;
+  makeShoebox(&gh);
+  MaterialHandler mh;
+  mh.setGlobalMaterial(gh.getNumberOfTriangles(), reflection2Admitance(0.8f));
+
+  ImageSourceEngine ism;
+  ism.setMaxTime(1.f);
+  ism.setMaxOrder(1);
+  ism.initialize(&gh, &mh);
+  BOOST_CHECK_EQUAL(ism.getNumberOfPlanes(), 6);
+
+  nv::Vec3f src(1.f, 1.f, 1.2f);
+  nv::Vec3f rec(3.f, 2.f, 1.5f);
+  ism.computeImageSources(src);
+  BOOST_CHECK_EQUAL(ism.getNumberOfImageSources(), 7);
+
+  std::vector<ImageSourceEngine::path_t> paths = ism.getPaths(rec);
+  BOOST_CHECK_EQUAL(paths.size(), 7);
+
+  // Direct sound and the floor reflection
+  float direct = length_(rec-src);
+  float floor = length_(rec-nv::Vec3f(1.f, 1.f, -1.2f));
+  bool found_direct = false;
+  bool found_floor = false;
+  for(unsigned int i = 0; i < paths.size(); i++) {
+    if(paths[i].order == 0) {
+      found_direct = true;
+      BOOST_CHECK_CLOSE(paths[i].length, direct, 1e-3);
+      BOOST_CHECK_CLOSE(paths[i].gain, 1.f/direct, 1e-3);
+    }
+    if(fabs(paths[i].length-floor) < 1e-4f) {
+      found_floor = true;
+      BOOST_CHECK_CLOSE(paths[i].gain, 0.8f/floor, 1e-2);
+    }
+  }
+  BOOST_CHECK(found_direct);
+  BOOST_CHECK(found_floor);
+
+  // In a shoebox 6 + 12 different second order images are valid
+  ism.setMaxOrder(2);
+  ism.computeImageSources(src);
+  paths = ism.getPaths(rec);
+  BOOST_CHECK_EQUAL(paths.size(), 25);
+
+  // The direct sound lands on the right sample
+  std::vector<float> response(1000, 0.f);
+  ism.setMaxOrder(0);
+  ism.computeImageSources(src);
+  ism.getResponse(rec, 48000, response);
+  unsigned int peak = 0;
+  for(unsigned int i = 0; i < response.size(); i++)
+    if(fabs(response[i]) > fabs(response[peak])) peak = i;
+  BOOST_CHECK_EQUAL(peak, (unsigned int)(direct/344.f*48000.f+0.5f));
+}
+
+BOOST_AUTO_TEST_CASE(HybridCombiner_crossover) {
+  // The Linkwitz-Riley sum is allpass, the energy of an impulse is kept
+  std::vector<float> impulse(4096, 0.f);
+  impulse[100] = 1.f;
+
+  HybridCombiner combiner;
+  combiner.setOutputFs(48000);
+  combiner.setCrossover(1000.f);
+  std::vector<float> out = combiner.combine(impulse, 48000, impulse);
+
+  BOOST_CHECK_EQUAL(out.size(), impulse.size());
+  double energy = 0.0;
+  for(unsigned int i = 0; i < out.size(); i++)
+    energy += out[i]*out[i];
+  BOOST_CHECK_CLOSE(energy, 1.0, 1.0);
+
+  // Upsampling keeps a low frequency sine
+  std::vector<float> sine(1000, 0.f);
+  for(unsigned int i = 0; i < sine.size(); i++)
+    sine[i] = (float)sin(2.0*PI*200.0*(double)i/8000.0);
+  std::vector<float> up = HybridCombiner::resample(sine, 8000, 48000, 6000);
+  BOOST_CHECK_CLOSE(up[3003], (float)sin(2.0*PI*200.0*3003.0/48000.0), 1.0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,168 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MAIN
+
+#include <boost/test/unit_test.hpp>
+#include <boost/property_tree/json_parser.hpp>
+#include "../src/batch/JobSpec.h"
+#include "../src/base/MaterialHandler.h"
+#include "../src/base/SimulationParameters.h"
+#include "../src/io/ResponseWriter.h"
+#include "../src/global_includes.h"
+#include <sstream>
+
+namespace {
+  bool parseBatch(const std::string& json, BatchSpec& batch) {
+    std::stringstream ss(json);
+    boost::property_tree::ptree root;
+    boost::property_tree::read_json(ss, root);
+    return batch.parse(root);
+  }
+
+  const char* const batch_json =
+    "{\"concurrency\": 3,"
+    " \"defaults\": {\"geometry\": \"room.vtk\", \"fs\": 8000, \"steps\": 200,"
+    "                \"materials\": {\"reflection\": 0.9},"
+    "                \"receivers\": [[1, 1, 1]]},"
+    " \"jobs\": ["
+    "  {\"name\": \"a\", \"sources\": [{\"position\": [1, 2, 3], \"type\": \"soft\"}],"
+    "   \"output\": {\"path\": \"a.bin\"}},"
+    "  {\"sources\": [{\"position\": [2, 2, 3], \"type\": 2, \"input\": \"gaussian\"}],"
+    "   \"receivers\": [[1, 1, 1], [2, 2, 2]], \"precision\": \"double\","
+    "   \"output\": {\"path\": \"b.wav\", \"format\": \"wav\"}},"
+    "  {\"sources\": [{\"position\": [1, 2, 3]}], \"fs\": 9000,"
+    "   \"materials\": {\"admittance\": [0.1, 0.2],"
+    "                   \"layers\": [{\"triangles\": [0, 3], \"reflection\": 0.5}]},"
+    "   \"output\": {\"path\": \"c.bin\"}},"
+    "  {\"sources\": [{\"position\": [1, 2, 3]}], \"precision\": \"double\","
+    "   \"output\": {\"path\": \"d.bin\"}},"
+    "  {\"sources\": [{\"position\": [1, 2, 3]}], \"solver\": \"host\", \"threads\": 4,"
+    "   \"output\": {\"path\": \"e.bin\"}},"
+    "  {\"sources\": [{\"position\": [1, 2, 3]}], \"solver\": \"host\","
+    "   \"output\": {\"path\": \"f.bin\"}}"
+    " ]}";
+}
+
+BOOST_AUTO_TEST_SUITE(JobSpecTest)
+
+BOOST_AUTO_TEST_CASE(JobSpec_parse) {
+  BatchSpec batch;
+  BOOST_REQUIRE(parseBatch(batch_json, batch));
+  BOOST_CHECK_EQUAL(batch.concurrency, 3);
+  BOOST_REQUIRE_EQUAL(batch.jobs.size(), 6);
+
+  const JobSpec& a = batch.jobs.at(0);
+  BOOST_CHECK_EQUAL(a.name, "a");
+  BOOST_CHECK_EQUAL(a.geometry, "room.vtk");
+  BOOST_CHECK_EQUAL(a.fs, 8000);
+  BOOST_CHECK_EQUAL(a.num_steps, 200);
+  BOOST_CHECK_EQUAL(a.update_type, SRL_FORWARD);
+  BOOST_CHECK(!a.is_double);
+  BOOST_CHECK_EQUAL(a.solver, JOB_SOLVER_CUDA);
+  BOOST_CHECK_EQUAL(a.receivers.size(), 1);
+  BOOST_REQUIRE_EQUAL(a.sources.size(), 1);
+  BOOST_CHECK_EQUAL(a.sources.at(0).getSourceType(), SRC_SOFT);
+  BOOST_CHECK_EQUAL(a.sources.at(0).getInputType(), IMPULSE);
+  BOOST_CHECK_EQUAL(a.output_path, "a.bin");
+  BOOST_CHECK_EQUAL(a.output_format, RESPONSE_RAW_FLOAT);
+  BOOST_REQUIRE_EQUAL(a.coefficients.size(), MATERIAL_COEF_NUM);
+  BOOST_CHECK_CLOSE(a.coefficients.at(0), reflection2Admitance(0.9f), 1e-4);
+
+  const JobSpec& b = batch.jobs.at(1);
+  BOOST_CHECK_EQUAL(b.name, "job_1");
+  BOOST_CHECK(b.is_double);
+  BOOST_CHECK_EQUAL(b.receivers.size(), 2);
+  BOOST_CHECK_EQUAL(b.sources.at(0).getSourceType(), SRC_TRANSPARENT);
+  BOOST_CHECK_EQUAL(b.sources.at(0).getInputType(), GAUSSIAN);
+  BOOST_CHECK_EQUAL(b.output_format, RESPONSE_WAV);
+
+  const JobSpec& c = batch.jobs.at(2);
+  BOOST_CHECK_EQUAL(c.fs, 9000);
+  BOOST_CHECK_CLOSE(c.coefficients.at(0), 0.1f, 1e-4);
+  BOOST_CHECK_CLOSE(c.coefficients.at(1), 0.2f, 1e-4);
+  BOOST_CHECK_EQUAL(c.coefficients.at(2), 0.f);
+  BOOST_REQUIRE_EQUAL(c.layers.size(), 1);
+  BOOST_CHECK_EQUAL(c.layers.at(0).triangles.size(), 2);
+  BOOST_CHECK_EQUAL(c.layers.at(0).triangles.at(1), 3);
+  BOOST_CHECK_CLOSE(c.layers.at(0).coefficients.at(0), reflection2Admitance(0.5f), 1e-4);
+
+  BOOST_CHECK_EQUAL(batch.jobs.at(4).solver, JOB_SOLVER_HOST);
+  BOOST_CHECK_EQUAL(batch.jobs.at(4).threads, 4);
+}
+
+BOOST_AUTO_TEST_CASE(JobSpec_invalid) {
+  BatchSpec batch;
+  // No output
+  BOOST_CHECK(!parseBatch("{\"jobs\": [{\"geometry\": \"g.vtk\", \"fs\": 8000, \"steps\": 10,"
+                          " \"sources\": [{\"position\": [1, 2, 3]}], \"receivers\": [[1, 1, 1]]}]}",
+                          batch));
+  // Unknown solver
+  BOOST_CHECK(!parseBatch("{\"jobs\": [{\"geometry\": \"g.vtk\", \"fs\": 8000, \"steps\": 10,"
+                          " \"solver\": \"gpu\", \"output\": {\"path\": \"o.bin\"},"
+                          " \"sources\": [{\"position\": [1, 2, 3]}], \"receivers\": [[1, 1, 1]]}]}",
+                          batch));
+  // A position of two coordinates
+  BOOST_CHECK(!parseBatch("{\"jobs\": [{\"geometry\": \"g.vtk\", \"fs\": 8000, \"steps\": 10,"
+                          " \"output\": {\"path\": \"o.bin\"},"
+                          " \"sources\": [{\"position\": [1, 2, 3]}], \"receivers\": [[1, 1]]}]}",
+                          batch));
+  // No steps
+  BOOST_CHECK(!parseBatch("{\"jobs\": [{\"geometry\": \"g.vtk\", \"fs\": 8000,"
+                          " \"output\": {\"path\": \"o.bin\"},"
+                          " \"sources\": [{\"position\": [1, 2, 3]}], \"receivers\": [[1, 1, 1]]}]}",
+                          batch));
+  BOOST_CHECK(!parseBatch("{\"concurrency\": 2}", batch));
+}
+
+BOOST_AUTO_TEST_CASE(JobSpec_groupByMesh) {
+  BatchSpec batch;
+  BOOST_REQUIRE(parseBatch(batch_json, batch));
+  std::vector< std::vector<unsigned int> > groups = groupByMesh(batch.jobs);
+
+  // a and b differ in precision, b and d share their mesh, c has another
+  // fs and materials and the host jobs do not share
+  BOOST_REQUIRE_EQUAL(groups.size(), 5);
+  BOOST_CHECK_EQUAL(groups.at(0).size(), 1);
+  BOOST_CHECK_EQUAL(groups.at(0).at(0), 0);
+  BOOST_REQUIRE_EQUAL(groups.at(1).size(), 2);
+  BOOST_CHECK_EQUAL(groups.at(1).at(0), 1);
+  BOOST_CHECK_EQUAL(groups.at(1).at(1), 3);
+  BOOST_CHECK_EQUAL(groups.at(2).at(0), 2);
+  BOOST_CHECK_EQUAL(groups.at(3).at(0), 4);
+  BOOST_CHECK_EQUAL(groups.at(4).at(0), 5);
+
+  batch.jobs.at(1).is_double = false;
+  batch.jobs.at(3).is_double = false;
+  groups = groupByMesh(batch.jobs);
+  BOOST_REQUIRE_EQUAL(groups.size(), 4);
+  BOOST_CHECK_EQUAL(groups.at(0).size(), 3);
+
+  // Coefficients which differ in the eighth digit make another mesh
+  batch.jobs.at(0).coefficients.at(0) = 0.12345678f;
+  batch.jobs.at(1).coefficients.at(0) = 0.12345678f;
+  batch.jobs.at(3).coefficients.at(0) = 0.12345678f;
+  BOOST_CHECK_EQUAL(groupByMesh(batch.jobs).size(), 4);
+  batch.jobs.at(3).coefficients.at(0) = 0.12345679f;
+  BOOST_CHECK_EQUAL(groupByMesh(batch.jobs).size(), 5);
+}
+
+BOOST_AUTO_TEST_CASE(JobSpec_getLanesPerGroup) {
+  std::vector< std::vector<unsigned int> > groups(2);
+  for(unsigned int i = 0; i < 6; i++)
+    groups.at(0).push_back(i);
+  groups.at(1).push_back(6);
+
+  // A lane for each group, the spare lanes go to the larger group
+  std::vector<unsigned int> lanes = getLanesPerGroup(groups, 1);
+  BOOST_REQUIRE_EQUAL(lanes.size(), 2);
+  BOOST_CHECK_EQUAL(lanes.at(0), 1);
+  BOOST_CHECK_EQUAL(lanes.at(1), 1);
+  lanes = getLanesPerGroup(groups, 4);
+  BOOST_CHECK_EQUAL(lanes.at(0), 3);
+  BOOST_CHECK_EQUAL(lanes.at(1), 1);
+  // No more lanes than jobs
+  lanes = getLanesPerGroup(groups, 16);
+  BOOST_CHECK_EQUAL(lanes.at(0), 6);
+  BOOST_CHECK_EQUAL(lanes.at(1), 1);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
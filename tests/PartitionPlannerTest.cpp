@@ -0,0 +1,116 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MAIN
+
+#include <boost/test/unit_test.hpp>
+#include "../src/base/PartitionPlanner.h"
+#include "../src/kernels/cudaMesh.h"
+#include "../src/global_includes.h"
+#include <math.h>
+
+namespace {
+  const unsigned int dim_x = 10;
+  const unsigned int dim_y = 10;
+  const unsigned int dim_z = 40;
+
+  // Lower half of the domain is solid, upper half air
+  std::vector<unsigned char> makeVolume() {
+    std::vector<unsigned char> position(dim_x*dim_y*dim_z, 0);
+    for(unsigned int i = dim_x*dim_y*dim_z/2; i < position.size(); i++)
+      position[i] = 0x86;
+    return position;
+  }
+
+  unsigned int ownedSlices(const std::vector< std::vector<unsigned int> >& indexing,
+                           unsigned int i) {
+    unsigned int size = (unsigned int)indexing.at(i).size();
+    return size-(i > 0)-(i < indexing.size()-1);
+  }
+}
+
+BOOST_AUTO_TEST_SUITE(PartitionPlannerTest)
+
+BOOST_AUTO_TEST_CASE(PartitionPlanner_indexing) {
+  std::vector<unsigned int> counts(4, 10);
+  BOOST_CHECK(PartitionPlanner::countsToIndexing(counts) ==
+              CudaMesh::getPartitionIndexing(4, 40));
+}
+
+BOOST_AUTO_TEST_CASE(PartitionPlanner_calibrate) {
+  std::vector<float> estimates(3);
+  estimates.at(0) = 1000.f;
+  estimates.at(1) = 500.f;
+  estimates.at(2) = 2000.f;
+  std::vector<float> measured(3, 0.f);
+
+  // Nothing measured, the estimates are kept
+  std::vector<float> weights = PartitionPlanner::calibrateThroughputs(estimates, measured);
+  BOOST_CHECK_EQUAL(weights.at(0), 1000.f);
+  BOOST_CHECK_EQUAL(weights.at(2), 2000.f);
+
+  // The first device runs at a tenth of its estimate, so do the others
+  measured.at(0) = 100.f;
+  weights = PartitionPlanner::calibrateThroughputs(estimates, measured);
+  BOOST_CHECK_CLOSE(weights.at(0), 100.f, 1e-4);
+  BOOST_CHECK_CLOSE(weights.at(1), 50.f, 1e-4);
+  BOOST_CHECK_CLOSE(weights.at(2), 200.f, 1e-4);
+
+  measured.at(2) = 600.f;
+  weights = PartitionPlanner::calibrateThroughputs(estimates, measured);
+  BOOST_CHECK_CLOSE(weights.at(1), 100.f, 1e-4);
+  BOOST_CHECK_CLOSE(weights.at(2), 600.f, 1e-4);
+}
+
+BOOST_AUTO_TEST_CASE(PartitionPlanner_cost) {
+  std::vector<unsigned char> position = makeVolume();
+  PartitionPlanner planner;
+  planner.countSlices(&position[0], dim_x, dim_y, dim_z, 0x86);
+
+  BOOST_CHECK_EQUAL(planner.getNumberOfAirNodesAt(0), 0);
+  BOOST_CHECK_EQUAL(planner.getNumberOfAirNodesAt(dim_z-1), dim_x*dim_y);
+
+  // Equal targets get equal cost, the solid half goes to the first one
+  planner.addTarget(1.f, 1000.f);
+  planner.addTarget(1.f, 1000.f);
+  std::vector< std::vector<unsigned int> > indexing = planner.plan(2);
+  BOOST_CHECK_EQUAL(indexing.size(), 2);
+  unsigned int first = ownedSlices(indexing, 0);
+  BOOST_CHECK(first > dim_z/2);
+  BOOST_CHECK_EQUAL(first+ownedSlices(indexing, 1), dim_z);
+  float diff = planner.getCost(0, first)-planner.getCost(first, dim_z);
+  BOOST_CHECK(fabs(diff) <= planner.getSliceCost(dim_z-1));
+
+  // A three times faster target gets three times the cost
+  planner.clearTargets();
+  planner.addTarget(1.f, 1000.f);
+  planner.addTarget(3.f, 1000.f);
+  indexing = planner.plan(2);
+  first = ownedSlices(indexing, 0);
+  float ratio = planner.getCost(first, dim_z)/planner.getCost(0, first);
+  BOOST_CHECK_CLOSE(ratio, 3.f, 15.f);
+}
+
+BOOST_AUTO_TEST_CASE(PartitionPlanner_memory) {
+  std::vector<unsigned char> position = makeVolume();
+  PartitionPlanner planner;
+  planner.setBytesPerNode(10);
+  planner.countSlices(&position[0], dim_x, dim_y, dim_z, 0x86);
+
+  // The first target holds 10 slices and a halo
+  float slice_in_MB = 10.f*dim_x*dim_y/1e6f;
+  planner.addTarget(10.f, 11.f*slice_in_MB);
+  planner.addTarget(1.f, 1000.f);
+  BOOST_CHECK_EQUAL(planner.getMinimumNumberOfTargets(), 2);
+
+  std::vector< std::vector<unsigned int> > indexing = planner.plan(2);
+  BOOST_CHECK_EQUAL(ownedSlices(indexing, 0), 10);
+  BOOST_CHECK_EQUAL(ownedSlices(indexing, 1), dim_z-10);
+
+  // Not enough memory on the targets
+  planner.clearTargets();
+  planner.addTarget(1.f, 11.f*slice_in_MB);
+  planner.addTarget(1.f, 11.f*slice_in_MB);
+  BOOST_CHECK_EQUAL(planner.getMinimumNumberOfTargets(), 0);
+  BOOST_CHECK_THROW(planner.plan(2), int);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,55 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MAIN
+
+#include <boost/test/unit_test.hpp>
+#include "../src/base/ReceiverBank.h"
+#include "../src/global_includes.h"
+
+BOOST_AUTO_TEST_SUITE(ReceiverBankTest)
+
+BOOST_AUTO_TEST_CASE(ReceiverBank_chunks) {
+  // Seven steps in chunks of three, the last chunk is partial
+  const unsigned int steps = 7;
+  unsigned int elements[] = {9, 2, 5, 2};
+  ReceiverBank<float> bank;
+  bank.setup(2, steps, 3);
+  for(unsigned int r = 0; r < 4; r++)
+    bank.addReceiver(r == 2 ? 1 : 0, elements[r], r);
+  bank.compile();
+  BOOST_CHECK_EQUAL(bank.getChunkSteps(), 3);
+  BOOST_CHECK_EQUAL(bank.getNumberOfReceivers(0), 3);
+  BOOST_CHECK_EQUAL(bank.getNumberOfReceivers(1), 1);
+  BOOST_CHECK_EQUAL(bank.getElementIndices(0).at(0), 2);
+  BOOST_CHECK_EQUAL(bank.getElementIndices(0).at(2), 9);
+
+  std::vector<float> responses(4*steps, -1.f);
+  std::vector<float> P(10);
+  for(unsigned int step = 0; step < steps; step++) {
+    for(unsigned int i = 0; i < P.size(); i++)
+      P.at(i) = (float)(step*100+i);
+    for(unsigned int p = 0; p < 2; p++) {
+      bank.gather(&P[0], p, step);
+      if(bank.isChunkEnd(step))
+        bank.flush(p, step, &responses[0]);
+    }
+  }
+  for(unsigned int r = 0; r < 4; r++)
+    for(unsigned int step = 0; step < steps; step++)
+      BOOST_CHECK_EQUAL(responses.at(r*steps+step), (float)(step*100+elements[r]));
+
+  // An interrupted run flushes the partial chunk
+  std::vector<float> partial(4*steps, -1.f);
+  for(unsigned int step = 0; step < 5; step++) {
+    for(unsigned int i = 0; i < P.size(); i++)
+      P.at(i) = (float)(step*100+i);
+    bank.gather(&P[0], 0, step);
+    if(bank.isChunkEnd(step))
+      bank.flush(0, step, &partial[0]);
+  }
+  BOOST_CHECK(!bank.isChunkEnd(4));
+  bank.flush(0, 4, &partial[0]);
+  for(unsigned int step = 0; step < steps; step++)
+    BOOST_CHECK_EQUAL(partial.at(step), step < 5 ? (float)(step*100+9) : -1.f);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
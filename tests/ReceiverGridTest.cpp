@@ -0,0 +1,81 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MAIN
+
+#include <boost/test/unit_test.hpp>
+#include "../src/base/ReceiverGrid.h"
+#include "../src/base/ReceiverBank.h"
+#include "../src/global_includes.h"
+#include <math.h>
+
+BOOST_AUTO_TEST_SUITE(ReceiverGridTest)
+
+BOOST_AUTO_TEST_CASE(ReceiverGrid_encodings) {
+  // 3 x 2 x 1 points two nodes apart, the region is clipped to the domain
+  const unsigned int steps = 50;
+  enum GridEncoding encodings[] = {GRID_FLOAT32, GRID_FLOAT16, GRID_DELTA};
+  std::vector<float> signal(steps, 0.f);
+  for(unsigned int k = 10; k < steps; k++)
+    signal.at(k) = (float)(sin(0.3*k)*exp(-0.05*k));
+
+  for(unsigned int e = 0; e < 3; e++) {
+    ReceiverGrid grid(0.f, 0.f, 2.f, 4.f, 2.f, 2.f, 2.f, encodings[e]);
+    grid.setup(1.f, false, steps, 5, 10, 10);
+    BOOST_CHECK_EQUAL(grid.getNumPoints(), 6);
+    BOOST_CHECK_EQUAL(grid.getPointElementCoordinates(5).x, 4);
+    BOOST_CHECK_EQUAL(grid.getPointElementCoordinates(5).y, 2);
+    BOOST_CHECK_EQUAL(grid.getPointElementCoordinates(5).z, 2);
+
+    // Recorded in chunks as the bank flushes them
+    for(unsigned int p = 0; p < grid.getNumPoints(); p++)
+      for(unsigned int first = 0; first < steps; first += 16)
+        grid.record(p, first, std::min(16u, steps-first), &signal[first], 1);
+
+    std::vector<float> response = grid.getResponse(3);
+    for(unsigned int k = 0; k < steps; k++) {
+      if(encodings[e] == GRID_FLOAT16)
+        BOOST_CHECK_SMALL(response.at(k)-signal.at(k), 1e-3f);
+      else
+        BOOST_CHECK_EQUAL(response.at(k), signal.at(k));
+    }
+    if(encodings[e] == GRID_DELTA)
+      BOOST_CHECK(grid.getStorageBytes() < 6*steps*sizeof(float));
+  }
+
+  // The last sample of a decimated response averages the remaining steps
+  ReceiverGrid decimated(0.f, 0.f, 0.f, 0.f, 0.f, 0.f, 1.f, GRID_FLOAT32, 3);
+  decimated.setup(1.f, false, 7, 2, 2, 2);
+  float ramp[] = {1.f, 2.f, 3.f, 4.f, 5.f, 6.f, 7.f};
+  decimated.record(0, 0, 7, ramp, 1);
+  std::vector<float> mean = decimated.getResponse(0);
+  BOOST_CHECK_EQUAL(mean.size(), 3);
+  BOOST_CHECK_EQUAL(mean.at(0), 2.f);
+  BOOST_CHECK_EQUAL(mean.at(1), 5.f);
+  BOOST_CHECK_EQUAL(mean.at(2), 7.f);
+
+  // Grid points are gathered with the receivers and recorded to the grid
+  ReceiverGrid grid(0.f, 0.f, 0.f, 2.f, 2.f, 0.f, 2.f, GRID_FLOAT32);
+  grid.setup(1.f, false, 4, 4, 4, 1);
+  ReceiverBank<float> bank;
+  bank.setup(1, 4, 2);
+  bank.addReceiver(0, 6, 0);
+  bank.addGridPlane(0, 0, bank.addGrid(&grid), 0, 4);
+  bank.compile();
+  BOOST_CHECK_EQUAL(bank.getNumberOfReceivers(0), 5);
+  std::vector<float> responses(4, 0.f);
+  std::vector<float> P(16);
+  for(unsigned int step = 0; step < 4; step++) {
+    for(unsigned int i = 0; i < P.size(); i++)
+      P.at(i) = (float)(step*100+i);
+    bank.gather(&P[0], 0, step);
+    if(bank.isChunkEnd(step))
+      bank.flush(0, step, &responses[0]);
+  }
+  unsigned int nodes[] = {0, 2, 8, 10};
+  for(unsigned int step = 0; step < 4; step++) {
+    BOOST_CHECK_EQUAL(responses.at(step), (float)(step*100+6));
+    for(unsigned int p = 0; p < 4; p++)
+      BOOST_CHECK_EQUAL(grid.getResponse(p).at(step), (float)(step*100+nodes[p]));
+  }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,84 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MAIN
+
+#include <boost/test/unit_test.hpp>
+#include "../src/base/Resampler.h"
+#include "../src/base/ReceiverBank.h"
+#include "../src/global_includes.h"
+#include <math.h>
+
+BOOST_AUTO_TEST_SUITE(ResamplerTest)
+
+BOOST_AUTO_TEST_CASE(Resampler_stream) {
+  // 100 kHz to 48 kHz, L/M = 12/25
+  Resampler resampler(100000, 48000, 0.196*100000);
+  BOOST_CHECK_EQUAL(resampler.getUp(), 12);
+  BOOST_CHECK_EQUAL(resampler.getDown(), 25);
+  const size_t n = 5000;
+  BOOST_CHECK_EQUAL(resampler.getNumOutputSamples(n), 2400);
+
+  // A tone in the pass band is kept, in time with the input
+  std::vector<double> tone(n), fast(n);
+  for(size_t i = 0; i < n; i++) {
+    tone.at(i) = sin(2.0*PI*3000.0*(double)i/100000.0);
+    fast.at(i) = sin(2.0*PI*30000.0*(double)i/100000.0);
+  }
+  std::vector<double> out(2400), out_fast(2400);
+  resampler.resample(&tone[0], n, &out[0]);
+  resampler.resample(&fast[0], n, &out_fast[0]);
+  double err = 0.0, fast_peak = 0.0;
+  for(size_t q = 200; q < 2200; q++) {
+    err = std::max(err, fabs(out.at(q)-sin(2.0*PI*3000.0*(double)q/48000.0)));
+    fast_peak = std::max(fast_peak, fabs(out_fast.at(q)));
+  }
+  BOOST_CHECK_SMALL(err, 1e-3);
+  // Above the Nyquist frequency of the output
+  BOOST_CHECK_SMALL(fast_peak, 1e-3);
+
+  // Blocks of any size give the same output
+  std::vector<double> history(resampler.getHistoryLength(), 0.0);
+  std::vector<double> blocked(2400, -1.0);
+  size_t first = 0, written = 0;
+  unsigned int sizes[] = {1, 7, 512, 33};
+  for(unsigned int b = 0; first < n; b++) {
+    size_t count = std::min((size_t)sizes[b%4], n-first);
+    BOOST_CHECK_EQUAL(resampler.getNumAvailable(first, n), written);
+    written += resampler.process(&history[0], &tone[first], 1, first, count, n,
+                                 &blocked[written]);
+    first += count;
+  }
+  BOOST_CHECK_EQUAL(written, 2400);
+  for(size_t q = 0; q < 2400; q++)
+    BOOST_CHECK_EQUAL(blocked.at(q), out.at(q));
+
+  // The bank resamples its chunks as the whole response
+  const unsigned int steps = 700;
+  Resampler up(7000, 48000, 0.196*7000);
+  ReceiverBank<double> bank;
+  bank.setup(2, steps, 64);
+  bank.setResampler(up);
+  bank.addReceiver(0, 3, 0);
+  bank.addReceiver(1, 1, 1);
+  bank.compile();
+  BOOST_CHECK_EQUAL(bank.getNumSamples(), 4800);
+  std::vector<double> responses(2*bank.getNumSamples(), -1.0);
+  std::vector<double> P(4), full(2*steps);
+  for(unsigned int step = 0; step < steps; step++) {
+    for(unsigned int i = 0; i < P.size(); i++)
+      P.at(i) = cos(0.05*step*(i+1))*exp(-0.004*step);
+    full.at(step) = P.at(3);
+    full.at(steps+step) = P.at(1);
+    for(unsigned int p = 0; p < 2; p++) {
+      bank.gather(&P[0], p, step);
+      if(bank.isChunkEnd(step))
+        bank.flush(p, step, &responses[0]);
+    }
+  }
+  std::vector<double> ref(2*bank.getNumSamples());
+  for(unsigned int r = 0; r < 2; r++)
+    bank.writeResponse(r, &full[r*steps], &ref[0]);
+  for(unsigned int i = 0; i < ref.size(); i++)
+    BOOST_CHECK_CLOSE(responses.at(i)+2.0, ref.at(i)+2.0, 1e-10);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,24 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MAIN
+
+#include <boost/test/unit_test.hpp>
+#include "../src/io/ResponseWriter.h"
+#include "../src/global_includes.h"
+
+BOOST_AUTO_TEST_SUITE(ResponseWriterTest)
+
+BOOST_AUTO_TEST_CASE(ResponseWriter_writeError) {
+  // Every write to /dev/full fails, the failure is reported on close and
+  // no steps are counted as written
+  std::vector<float> samples(2*40, 0.5f);
+  unsigned int channels[] = {0, 1};
+  ResponseWriter writer;
+  BOOST_REQUIRE(writer.open("/dev/full", RESPONSE_RAW_FLOAT, 2, 7000));
+  writer.begin(40, 8, 2);
+  writer.write(0, 40, channels, 2, &samples[0], 1, 40);
+  BOOST_CHECK(!writer.close());
+  BOOST_CHECK(writer.hasFailed());
+  BOOST_CHECK_EQUAL(writer.getFramesWritten(), 0u);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,63 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MAIN
+
+#include <boost/test/unit_test.hpp>
+#include "../src/io/ResultCache.h"
+#include <boost/thread.hpp>
+#include "../src/global_includes.h"
+#include <stdio.h>
+
+BOOST_AUTO_TEST_SUITE(ResultCacheTest)
+
+BOOST_AUTO_TEST_CASE(ResultCache_evict) {
+  const std::string dir = "/tmp/pfdtd_result_cache_test";
+  CachedResult result;
+  result.num_receivers = 2;
+  result.length = 1000;
+  result.fs = 48000;
+  for(unsigned int i = 0; i < 2000; i++)
+    result.responses.push_back((float)i*0.25f);
+  unsigned long long entry_bytes = 8+4*sizeof(unsigned int)+2000*sizeof(float);
+
+  ResultCache cache(dir, entry_bytes*5/2);
+  CachedResult ret;
+  BOOST_CHECK(!cache.load("a", ret));
+  BOOST_REQUIRE(cache.store("a", result));
+  boost::this_thread::sleep(boost::posix_time::milliseconds(20));
+  BOOST_REQUIRE(cache.store("b", result));
+  boost::this_thread::sleep(boost::posix_time::milliseconds(20));
+
+  BOOST_REQUIRE(cache.load("a", ret));
+  BOOST_CHECK_EQUAL(ret.num_receivers, 2u);
+  BOOST_CHECK_EQUAL(ret.length, 1000u);
+  BOOST_CHECK_EQUAL(ret.fs, 48000u);
+  BOOST_CHECK(ret.responses == result.responses);
+  BOOST_CHECK(ret.responses_double.empty());
+  boost::this_thread::sleep(boost::posix_time::milliseconds(20));
+
+  // The read made b the least recently used
+  BOOST_REQUIRE(cache.store("c", result));
+  BOOST_CHECK(cache.load("a", ret));
+  BOOST_CHECK(!cache.load("b", ret));
+  BOOST_CHECK(cache.load("c", ret));
+  BOOST_CHECK_EQUAL(cache.getSize(), 2*entry_bytes);
+
+  // A double result, and one larger than the cache
+  CachedResult result_double;
+  result_double.num_receivers = 1;
+  result_double.length = 3;
+  result_double.responses_double.assign(3, 0.5);
+  BOOST_REQUIRE(cache.store("d", result_double));
+  BOOST_REQUIRE(cache.load("d", ret));
+  BOOST_CHECK(ret.responses.empty());
+  BOOST_CHECK(ret.responses_double == result_double.responses_double);
+  ResultCache small(dir, entry_bytes/2);
+  BOOST_CHECK(!small.store("e", result));
+
+  remove((dir+"/a.pfr").c_str());
+  remove((dir+"/c.pfr").c_str());
+  remove((dir+"/d.pfr").c_str());
+  remove(dir.c_str());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
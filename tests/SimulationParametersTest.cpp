@@ -2,6 +2,7 @@
 #define BOOST_TEST_MAIN
 #include <boost/test/unit_test.hpp>
 #include "../src/base/SimulationParameters.h"
+#include <stdio.h>
 
 BOOST_AUTO_TEST_SUITE(SimulationParametersTest)
 
@@ -10,7 +11,6 @@ BOOST_AUTO_TEST_CASE(SimulationParameters_constructor) {
 	// Check default values
 	BOOST_CHECK_EQUAL(sp.getC() , 344);
 	BOOST_CHECK_EQUAL(sp.getLambda() , (double)1/sqrt((double)3));
-	BOOST_CHECK_EQUAL(sp.getRho() , 1.225f);
 }
 
 BOOST_AUTO_TEST_CASE(SimulationParameters_getters) {
@@ -21,6 +21,18 @@ BOOST_AUTO_TEST_CASE(SimulationParameters_getters) {
 	BOOST_CHECK_EQUAL(sp.getDx(), reference);
 }
 
+BOOST_AUTO_TEST_CASE(SimulationParameters_band_limit) {
+	SimulationParameters sp;
+	sp.setOutputFs(48000);
+	BOOST_CHECK_CLOSE(sp.getBandLimit(), 0.196, 0.1);
+
+	// The default follows the Courant number, a given limit is kept
+	sp.setLambda(0.5);
+	BOOST_CHECK_CLOSE(sp.getBandLimit(), 1.0/6.0, 1e-6);
+	sp.setOutputFs(48000, 0.1);
+	BOOST_CHECK_EQUAL(sp.getBandLimit(), 0.1);
+}
+
 BOOST_AUTO_TEST_CASE(SimulationParameters_add_source_receiver) {
 	SimulationParameters sp;
 	sp.addSource(Source(3.f,4.f,5.f));
@@ -206,4 +218,52 @@ BOOST_AUTO_TEST_CASE(SimulationParameters_getTransparentSample) {
 
 }
 
+BOOST_AUTO_TEST_CASE(SimulationParameters_transparentFft) {
+	SimulationParameters sp;
+	// A decaying oscillating impulse response, long enough for the FFT path
+	std::vector<float> grid_ir(3000, 0.f);
+	for(unsigned int i = 1; i < grid_ir.size(); i++)
+		grid_ir.at(i) = expf(-(float)i/400.f)*sinf(0.3f*(float)i)*0.2f;
+	sp.setGridIr(grid_ir);
+	sp.addSource(Source(1.f,1.f,1.f, SRC_TRANSPARENT, GAUSSIAN, 0));
+	sp.setNumSteps(2000);
+
+	// Direct evaluation of the convolution
+	for(unsigned int step = 0; step < 2200; step += 37) {
+		double reference = 0.0;
+		for(unsigned int i = 0; i < step; i++)
+			reference += (double)grid_ir.at(step-i)*exp(-0.5*((double)i-40.0)*((double)i-40.0)/16.0);
+		reference = exp(-0.5*((double)step-40.0)*((double)step-40.0)/16.0)-reference;
+		BOOST_CHECK_SMALL(sp.getSourceSampleDouble(0, step)-reference, 1e-9);
+		BOOST_CHECK_SMALL(sp.getSourceSample(0, step)-(float)reference, 1e-5f);
+	}
+
+	// The cached signal is dropped with the impulse response
+	sp.setGridIr(std::vector<float>());
+	BOOST_CHECK_EQUAL(sp.getSourceSampleDouble(0, 40), 1.0);
+}
+
+BOOST_AUTO_TEST_CASE(SimulationParameters_generateGridIr) {
+	SimulationParameters sp;
+	sp.setUpdateType(SRL_FORWARD);
+	sp.generateGridIr(120, true, ".");
+
+	// With lambda^2 = 1/3 the odd samples vanish
+	BOOST_CHECK_EQUAL(sp.getGridIrDataSample(0), 0.f);
+	BOOST_CHECK_SMALL(sp.getGridIrDataSample(1), 1e-7f);
+	BOOST_CHECK_CLOSE(sp.getGridIrDataSample(2), -1.f/3.f, 1e-4);
+	BOOST_CHECK_CLOSE(sp.getGridIrDataSample(4), 1.f/9.f, 1e-4);
+
+	// The second call reads the cache
+	std::vector<float> generated;
+	for(unsigned int i = 0; i < 120; i++)
+		generated.push_back(sp.getGridIrDataSample(i));
+	SimulationParameters cached;
+	cached.setUpdateType(SRL_FORWARD);
+	cached.generateGridIr(120, true, ".");
+	for(unsigned int i = 0; i < 120; i++)
+		BOOST_CHECK_EQUAL(cached.getGridIrDataSample(i), generated.at(i));
+	BOOST_CHECK_EQUAL(remove("./grid_ir_srl_forward_f64_120.bin"), 0);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
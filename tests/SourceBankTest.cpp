@@ -0,0 +1,285 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MAIN
+
+#include <boost/test/unit_test.hpp>
+#include "../src/base/SourceBank.h"
+#include "../src/kernels/cudaMesh.h"
+#include "TestFixtures.h"
+#include "../src/global_includes.h"
+#include <math.h>
+
+namespace {
+  const unsigned int dim_x = 8;
+  const unsigned int dim_y = 6;
+  const unsigned int dim_z = 12;
+  const unsigned int num_steps = 5;
+
+  unsigned int elementIdx(SimulationParameters& sp, unsigned int s) {
+    nv::Vec3i pos = sp.getSourceElementCoordinates(s);
+    return pos.z*dim_x*dim_y+pos.y*dim_x+pos.x;
+  }
+
+  // Inject the sources one by one to the whole domain
+  void injectReference(SimulationParameters& sp, std::vector<float>& P, unsigned int step) {
+    for(unsigned int s = 0; s < sp.getNumSources(); s++) {
+      unsigned int idx = elementIdx(sp, s);
+      float sample = sp.getSourceSample(s, step);
+      if(sp.getSource(s).getSourceType() == SRC_HARD)
+        P.at(idx) = sample;
+      else
+        P.at(idx) += sample;
+    }
+  }
+}
+
+BOOST_AUTO_TEST_SUITE(SourceBankTest)
+
+BOOST_AUTO_TEST_CASE(SourceBank_merge) {
+  SimulationParameters sp;
+  setupDataSources(sp, num_steps);
+  std::vector< std::vector<unsigned int> > indexing = CudaMesh::getPartitionIndexing(2, dim_z);
+
+  // Chunks of two steps, the last one partial
+  SourceBank<float> bank;
+  bank.compile(&sp, dim_x, dim_y, indexing, 2);
+  BOOST_CHECK_EQUAL(bank.getNumberOfPartitions(), 2);
+  BOOST_CHECK_EQUAL(bank.getNumSteps(), num_steps);
+  BOOST_CHECK_EQUAL(bank.getChunkSteps(), 2);
+  // Partition 0 holds slices 0-6, partition 1 slices 5-11, the element
+  // coordinates include the padding node
+  BOOST_CHECK_EQUAL(bank.getNumberOfEntries(0), 3);
+  BOOST_CHECK_EQUAL(bank.getNumberOfEntries(1), 3);
+
+  std::vector<float> reference(dim_x*dim_y*dim_z, 0.5f);
+  std::vector< std::vector<float> > partitions;
+  for(unsigned int p = 0; p < indexing.size(); p++)
+    partitions.push_back(std::vector<float>(indexing.at(p).size()*dim_x*dim_y, 0.5f));
+
+  for(unsigned int step = 0; step < num_steps; step++) {
+    injectReference(sp, reference, step);
+    for(unsigned int p = 0; p < indexing.size(); p++) {
+      bank.fill(p, step);
+      bank.inject(&partitions.at(p)[0], p, step);
+      unsigned int offset = indexing.at(p).at(0)*dim_x*dim_y;
+      for(unsigned int i = 0; i < partitions.at(p).size(); i++)
+        BOOST_CHECK_EQUAL(partitions.at(p).at(i), reference.at(offset+i));
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(SourceBank_double) {
+  SimulationParameters sp;
+  setupDataSources(sp, num_steps);
+  std::vector< std::vector<unsigned int> > indexing = CudaMesh::getPartitionIndexing(1, dim_z);
+
+  SourceBank<double> bank;
+  bank.compile(&sp, dim_x, dim_y, indexing);
+  BOOST_CHECK_EQUAL(bank.getNumberOfEntries(0), 4);
+  BOOST_CHECK_EQUAL(bank.getChunkSteps(), num_steps);
+
+  // The merged element keeps the hard flag, the earlier soft source is dropped
+  unsigned int idx = elementIdx(sp, 0);
+  const std::vector<unsigned int>& elements = bank.getElementIndices(0);
+  for(unsigned int e = 0; e < elements.size(); e++) {
+    if(elements.at(e) != idx)
+      continue;
+    BOOST_CHECK_EQUAL(bank.getHardFlags(0).at(e), 1);
+    for(unsigned int i = 0; i < num_steps; i++)
+      BOOST_CHECK_EQUAL(bank.getSamples(0).at(i*elements.size()+e),
+                        sp.getSourceSampleDouble(1, i)+sp.getSourceSampleDouble(2, i));
+  }
+}
+
+BOOST_AUTO_TEST_CASE(SourceBank_arraySource) {
+  SimulationParameters sp;
+  setupDataSources(sp, num_steps);
+  float dx = sp.getDx();
+  // Two nodes share an element, one is in the halo slices
+  float z[] = {2.f, 2.f, 5.f, 9.f};
+  float gains[] = {1.f, 0.5f, -2.f, 0.25f};
+  float delays[] = {0.f, 1.5f, 2.25f, 1.f};
+  ArraySource array(DATA, 4);
+  for(unsigned int n = 0; n < 4; n++)
+    array.addNode(2*dx, 3*dx, z[n]*dx, gains[n], delays[n]);
+  sp.addArraySource(array);
+  std::vector< std::vector<unsigned int> > indexing = CudaMesh::getPartitionIndexing(2, dim_z);
+
+  // The delays reach back over a chunk of two steps
+  SourceBank<double> bank;
+  bank.compile(&sp, dim_x, dim_y, indexing, 2);
+  BOOST_CHECK_EQUAL(bank.getNumberOfArraySources(), 1);
+  BOOST_CHECK_EQUAL(bank.getHistorySteps(), 3);
+  BOOST_CHECK_EQUAL(bank.getNumberOfSegments(0), 2);
+  BOOST_CHECK_EQUAL(bank.getNumberOfSegments(1), 2);
+
+  std::vector<double> reference(dim_x*dim_y*dim_z, 0.0);
+  std::vector< std::vector<double> > partitions;
+  for(unsigned int p = 0; p < indexing.size(); p++)
+    partitions.push_back(std::vector<double>(indexing.at(p).size()*dim_x*dim_y, 0.0));
+
+  for(unsigned int step = 0; step < num_steps; step++) {
+    for(unsigned int s = 0; s < sp.getNumSources(); s++) {
+      unsigned int idx = elementIdx(sp, s);
+      double sample = sp.getSourceSampleDouble(s, step);
+      if(sp.getSource(s).getSourceType() == SRC_HARD)
+        reference.at(idx) = sample;
+      else
+        reference.at(idx) += sample;
+    }
+    // The linearly interpolated delayed signal of each node
+    for(unsigned int n = 0; n < 4; n++) {
+      nv::Vec3i pos = sp.getArrayNodeElementCoordinates(0, n);
+      double t = (double)step-delays[n];
+      unsigned int i0 = (unsigned int)floor(t);
+      double frac = t-floor(t);
+      double value = 0.0;
+      if(t >= 0.0)
+        value += (1.0-frac)*sp.getArraySourceSampleDouble(0, i0);
+      if(t >= 0.0 && frac > 0.0 && i0+1 < num_steps)
+        value += frac*sp.getArraySourceSampleDouble(0, i0+1);
+      if(t < 0.0 && t > -1.0)
+        value += (1.0+t)*sp.getArraySourceSampleDouble(0, 0);
+      reference.at(pos.z*dim_x*dim_y+pos.y*dim_x+pos.x) += gains[n]*value;
+    }
+
+    for(unsigned int p = 0; p < indexing.size(); p++) {
+      bank.fill(p, step);
+      bank.inject(&partitions.at(p)[0], p, step);
+      unsigned int offset = indexing.at(p).at(0)*dim_x*dim_y;
+      for(unsigned int i = 0; i < partitions.at(p).size(); i++)
+        BOOST_CHECK_CLOSE(partitions.at(p).at(i)+1.0, reference.at(offset+i)+1.0, 1e-4);
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(SourceBank_movingSource) {
+  SimulationParameters sp;
+  setupDataSources(sp, num_steps);
+  float dx = sp.getDx();
+  // Crosses the halo slices shared by the partitions
+  Source moving(0.f, 0.f, 0.f, SRC_SOFT, DATA, 2);
+  moving.addWaypoint(0.f, 2.5f*dx, 2.25f*dx, 3.5f*dx);
+  moving.addWaypoint(4.f, 3.5f*dx, 1.75f*dx, 6.1f*dx);
+  sp.addSource(moving);
+  unsigned int m = sp.getNumSources()-1;
+  BOOST_CHECK(sp.isSourceMoving(m));
+  BOOST_CHECK(sp.hasMovingPositions());
+  nv::Vec3f mid = sp.getSource(m).getPositionAt(2.f);
+  BOOST_CHECK_CLOSE(mid.x, 3.f*dx, 1e-4);
+  BOOST_CHECK_CLOSE(mid.z, 4.8f*dx, 1e-4);
+
+  std::vector< std::vector<unsigned int> > indexing = CudaMesh::getPartitionIndexing(2, dim_z);
+  SourceBank<double> bank;
+  bank.compile(&sp, dim_x, dim_y, indexing, 3);
+  BOOST_CHECK_EQUAL(bank.getNumberOfMovingSources(), 1);
+  BOOST_CHECK_EQUAL(bank.getNumberOfEntries(0)+bank.getNumberOfEntries(1), 6);
+
+  std::vector<double> reference(dim_x*dim_y*dim_z, 0.0);
+  std::vector< std::vector<double> > partitions;
+  for(unsigned int p = 0; p < indexing.size(); p++)
+    partitions.push_back(std::vector<double>(indexing.at(p).size()*dim_x*dim_y, 0.0));
+
+  Trajectory trajectory = sp.getSourceTrajectory(m);
+  for(unsigned int step = 0; step < num_steps; step++) {
+    for(unsigned int s = 0; s < m; s++) {
+      unsigned int idx = elementIdx(sp, s);
+      double sample = sp.getSourceSampleDouble(s, step);
+      if(sp.getSource(s).getSourceType() == SRC_HARD)
+        reference.at(idx) = sample;
+      else
+        reference.at(idx) += sample;
+    }
+    nv::Vec3i base;
+    nv::Vec3f frac;
+    trajectory.getCell(step, dim_x, dim_y, dim_z, base, frac);
+    double weights = 0.0;
+    for(unsigned int c = 0; c < 8; c++) {
+      nv::Vec3i pos = Trajectory::getCorner(base, c);
+      double w = Trajectory::getWeight<double>(frac, c);
+      weights += w;
+      reference.at(pos.z*dim_x*dim_y+pos.y*dim_x+pos.x) += w*sp.getSourceSampleDouble(m, step);
+    }
+    BOOST_CHECK_CLOSE(weights, 1.0, 1e-6);
+
+    for(unsigned int p = 0; p < indexing.size(); p++) {
+      bank.fill(p, step);
+      bank.inject(&partitions.at(p)[0], p, step);
+      unsigned int offset = indexing.at(p).at(0)*dim_x*dim_y;
+      for(unsigned int i = 0; i < partitions.at(p).size(); i++)
+        BOOST_CHECK_CLOSE(partitions.at(p).at(i)+1.0, reference.at(offset+i)+1.0, 1e-6);
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE(SourceBank_inputStream) {
+  // A two channel 16 bit WAV file and a raw float file
+  const unsigned int length = 1000;
+  std::vector<short> pcm(2*length);
+  std::vector<float> raw(length);
+  for(unsigned int i = 0; i < length; i++) {
+    pcm.at(2*i) = (short)(i*16);
+    pcm.at(2*i+1) = (short)(-(int)i*8);
+    raw.at(i) = (float)i*0.5f;
+  }
+  unsigned int data_bytes = (unsigned int)(pcm.size()*sizeof(short));
+  unsigned int riff_bytes = 36+data_bytes;
+  unsigned int fmt_bytes = 16, rate = 7000, byte_rate = rate*4;
+  unsigned short pcm_tag = 1, channels = 2, block = 4, bits = 16;
+  FILE* wav = fopen("/tmp/pfdtd_stream_test.wav", "wb");
+  fwrite("RIFF", 1, 4, wav); fwrite(&riff_bytes, 4, 1, wav);
+  fwrite("WAVEfmt ", 1, 8, wav); fwrite(&fmt_bytes, 4, 1, wav);
+  fwrite(&pcm_tag, 2, 1, wav); fwrite(&channels, 2, 1, wav);
+  fwrite(&rate, 4, 1, wav); fwrite(&byte_rate, 4, 1, wav);
+  fwrite(&block, 2, 1, wav); fwrite(&bits, 2, 1, wav);
+  fwrite("data", 1, 4, wav); fwrite(&data_bytes, 4, 1, wav);
+  fwrite(&pcm[0], sizeof(short), pcm.size(), wav);
+  fclose(wav);
+  FILE* f = fopen("/tmp/pfdtd_stream_test.raw", "wb");
+  fwrite(&raw[0], sizeof(float), raw.size(), f);
+  fclose(f);
+
+  // A lookahead shorter than the signal is refilled as the signal is read
+  InputStream stream;
+  BOOST_CHECK(stream.open("/tmp/pfdtd_stream_test.wav", STREAM_WAV, 1, 64));
+  BOOST_CHECK_EQUAL(stream.getNumSamples(), length);
+  BOOST_CHECK_EQUAL(stream.getNumChannels(), 2);
+  BOOST_CHECK_EQUAL(stream.getSampleRate(), rate);
+  for(unsigned int i = 0; i < length; i++)
+    BOOST_CHECK_EQUAL(stream.getSample(i), -(double)i*8/32768.0);
+  BOOST_CHECK_EQUAL(stream.getSample(length), 0.0);
+  BOOST_CHECK_EQUAL(stream.getSample(10), -80/32768.0);
+  BOOST_CHECK(!stream.open("/tmp/pfdtd_stream_test.raw", STREAM_WAV));
+
+  SimulationParameters sp;
+  sp.setSpatialFs(rate);
+  sp.setNumSteps(length+10);
+  float dx = sp.getDx();
+  BOOST_CHECK(sp.addInputStream("/tmp/pfdtd_stream_test.wav", STREAM_WAV));
+  BOOST_CHECK(sp.addInputStream("/tmp/pfdtd_stream_test.raw", STREAM_RAW_FLOAT));
+  BOOST_CHECK_EQUAL(sp.getNumInputStreams(), 2);
+  sp.addSource(Source(3*dx, 2*dx, 3*dx, SRC_SOFT, DATA_STREAM, 0));
+  sp.addSource(Source(3*dx, 2*dx, 8*dx, SRC_SOFT, DATA_STREAM, 1));
+
+  std::vector< std::vector<unsigned int> > indexing = CudaMesh::getPartitionIndexing(1, dim_z);
+  // The samples are read a chunk at a time, the buffers keep their size
+  SourceBank<double> bank;
+  bank.compile(&sp, dim_x, dim_y, indexing, 100);
+  BOOST_CHECK_EQUAL(bank.getNumberOfEntries(0), 2);
+  BOOST_CHECK_EQUAL(bank.getSamples(0).size(), 200);
+  const std::vector<unsigned int>& elements = bank.getElementIndices(0);
+  for(unsigned int i = 0; i < length+10; i++) {
+    bank.fill(0, i);
+    for(unsigned int e = 0; e < elements.size(); e++) {
+      bool is_wav = elements.at(e) == elementIdx(sp, 0);
+      double ref = 0.0;
+      if(i < length)
+        ref = is_wav ? (double)(i*16)/32768.0 : (double)raw.at(i);
+      BOOST_CHECK_EQUAL(bank.getSamples(0).at(bank.getSlot(i)*elements.size()+e), ref);
+    }
+  }
+  BOOST_CHECK_EQUAL(bank.getSamples(0).size(), 200);
+  remove("/tmp/pfdtd_stream_test.wav");
+  remove("/tmp/pfdtd_stream_test.raw");
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,39 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MAIN
+
+#include <boost/test/unit_test.hpp>
+#include "../src/base/StateHash.h"
+#include "../src/base/SimulationParameters.h"
+#include "../src/global_includes.h"
+
+BOOST_AUTO_TEST_SUITE(StateHashTest)
+
+BOOST_AUTO_TEST_CASE(StateHash_parameters) {
+  StateHash abc;
+  abc.add("abc", 3);
+  BOOST_CHECK_EQUAL(abc.getDigest(), "a9993e364706816aba3e25717850c26c9cd0d89d");
+
+  SimulationParameters sp;
+  sp.setSpatialFs(8000);
+  sp.setNumSteps(100);
+  sp.addSource(Source(1.f, 2.f, 3.f, SRC_SOFT, GAUSSIAN, 0));
+  sp.addReceiver(2.f, 2.f, 2.f);
+  SimulationParameters same = sp;
+
+  StateHash h0, h1, h2, h3;
+  sp.hashState(h0);
+  same.hashState(h1);
+  std::string digest = h0.getDigest();
+  BOOST_CHECK_EQUAL(digest.size(), 40u);
+  BOOST_CHECK_EQUAL(digest, h1.getDigest());
+
+  // Any input of the run changes the digest
+  same.addReceiver(3.f, 2.f, 2.f);
+  same.hashState(h2);
+  BOOST_CHECK(digest != h2.getDigest());
+  sp.updateSourceAt(0, Source(1.f, 2.f, 3.f, SRC_HARD, GAUSSIAN, 0));
+  sp.hashState(h3);
+  BOOST_CHECK(digest != h3.getDigest());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,36 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MAIN
+
+#include <boost/test/unit_test.hpp>
+#include "../src/base/SweepConfig.h"
+#include "../src/global_includes.h"
+#include "TestFixtures.h"
+
+BOOST_AUTO_TEST_SUITE(SweepConfigTest)
+
+BOOST_AUTO_TEST_CASE(SweepConfig_apply) {
+  SimulationParameters sp;
+  setupDataSources(sp, 5);
+  sp.addReceiver(1.f, 1.f, 1.f);
+  sp.addReceiver(2.f, 2.f, 2.f);
+  unsigned int steps = sp.getNumSteps();
+
+  SweepConfig config;
+  config.addSource(Source(0.5f, 0.6f, 0.7f, SRC_HARD, IMPULSE, 0));
+  config.addReceiver(0.1f, 0.2f, 0.3f);
+  config.applyTo(sp);
+  BOOST_CHECK_EQUAL(sp.getNumSources(), 1u);
+  BOOST_CHECK_EQUAL(sp.getNumReceivers(), 1u);
+  BOOST_CHECK_EQUAL(sp.getNumSteps(), steps);
+  BOOST_CHECK_EQUAL(sp.getSource(0).getSourceType(), SRC_HARD);
+  BOOST_CHECK_CLOSE(sp.getReceiver(0).getP().z, 0.3f, 1e-4);
+
+  config.num_steps = steps+10;
+  config.addReceiver(0.4f, 0.5f, 0.6f);
+  config.applyTo(sp);
+  BOOST_CHECK_EQUAL(sp.getNumSources(), 1u);
+  BOOST_CHECK_EQUAL(sp.getNumReceivers(), 2u);
+  BOOST_CHECK_EQUAL(sp.getNumSteps(), steps+10);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,48 @@
+#ifndef TEST_FIXTURES_H
+#define TEST_FIXTURES_H
+
+// Domains and parameters shared by the test suites
+
+#include "../src/base/SimulationParameters.h"
+#include <vector>
+
+// A box of air in the Bilbao position format, surrounded by one layer
+// of solid padding
+inline void makeBox(std::vector<unsigned char>& position, std::vector<unsigned char>& material,
+                    unsigned int dim_x, unsigned int dim_y, unsigned int dim_z) {
+  position.assign(dim_x*dim_y*dim_z, 0);
+  material.assign(dim_x*dim_y*dim_z, 0);
+  for(unsigned int z = 1; z < dim_z-1; z++) {
+    for(unsigned int y = 1; y < dim_y-1; y++) {
+      for(unsigned int x = 1; x < dim_x-1; x++) {
+        unsigned char neighbours = 0;
+        neighbours += (x > 1)+(x < dim_x-2);
+        neighbours += (y > 1)+(y < dim_y-2);
+        neighbours += (z > 1)+(z < dim_z-2);
+        position[z*dim_x*dim_y+y*dim_x+x] = 0x80|neighbours;
+      }
+    }
+  }
+}
+
+// Six DATA sources with integer valued data so that merged sums are
+// exact. Three sources share an element, and in a 8 x 6 x 12 domain split
+// in two along z two are in the halo slices shared by both partitions
+inline void setupDataSources(SimulationParameters& sp, unsigned int num_steps) {
+  sp.setSpatialFs(7000);
+  sp.setNumSteps(num_steps);
+  float dx = sp.getDx();
+  enum SrcType types[] = {SRC_SOFT, SRC_HARD, SRC_SOFT, SRC_SOFT, SRC_HARD, SRC_SOFT};
+  float z[] = {3.f, 3.f, 3.f, 8.f, 5.f, 4.f};
+  float y[] = {2.f, 2.f, 2.f, 4.f, 1.f, 1.f};
+  for(unsigned int s = 0; s < 6; s++) {
+    std::vector<float> data(num_steps, 0.f);
+    for(unsigned int i = 0; i < num_steps; i++)
+      data.at(i) = (float)((s+1)*10+i);
+    sp.addInputData(data);
+    sp.addInputDataDouble(std::vector<double>(data.begin(), data.end()));
+    sp.addSource(Source(3*dx, y[s]*dx, z[s]*dx, types[s], DATA, s));
+  }
+}
+
+#endif
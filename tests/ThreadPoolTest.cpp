@@ -0,0 +1,72 @@
+#define BOOST_TEST_DYN_LINK
+#define BOOST_TEST_MAIN
+
+#include <boost/test/unit_test.hpp>
+#include "../src/base/ThreadPool.h"
+#include <boost/bind.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/shared_ptr.hpp>
+#include <fstream>
+#include "../src/global_includes.h"
+#include <stdio.h>
+
+namespace {
+  // Each task logs to a sink of its own and sums a range
+  void sumTask(unsigned int first, unsigned int count, double* sum, LogSink* sink) {
+    LogSink* previous = setThreadLogSink(sink);
+    double s = 0.0;
+    for(unsigned int i = first; i < first+count; i++)
+      s += (double)i;
+    *sum = s;
+    log_msg<LOG_INFO>(L"sumTask - %u") %first;
+    setThreadLogSink(previous);
+  }
+
+  void failTask() {
+    throw(-1);
+  }
+}
+
+BOOST_AUTO_TEST_SUITE(ThreadPoolTest)
+
+BOOST_AUTO_TEST_CASE(ThreadPool_runAll) {
+  const unsigned int num_tasks = 16;
+  const unsigned int count = 1000;
+  ThreadPool pool(4);
+  BOOST_CHECK_EQUAL(pool.getNumThreads(), 4u);
+
+  std::vector<double> sums(num_tasks, 0.0);
+  std::vector<boost::shared_ptr<LogSink> > sinks;
+  std::vector<ThreadPool::Task> tasks;
+  for(unsigned int i = 0; i < num_tasks; i++) {
+    sinks.push_back(boost::shared_ptr<LogSink>(new LogSink("pool_task_"+boost::lexical_cast<std::string>(i)+".log")));
+    tasks.push_back(boost::bind(&sumTask, i*count, count, &sums.at(i), sinks.back().get()));
+  }
+  tasks.push_back(&failTask);
+  BOOST_CHECK_EQUAL(pool.runAll(tasks), 1u);
+
+  for(unsigned int i = 0; i < num_tasks; i++) {
+    double first = (double)(i*count);
+    BOOST_CHECK_EQUAL(sums.at(i), count*first+count*(count-1)/2.0);
+  }
+  BOOST_CHECK(getThreadLogSink() == NULL);
+
+  // Each sink has the message of its own task only
+  sinks.clear();
+  for(unsigned int i = 0; i < num_tasks; i++) {
+    std::string path = "pool_task_"+boost::lexical_cast<std::string>(i)+".log";
+    std::ifstream file(path.c_str());
+    std::string line, expected = "sumTask - "+boost::lexical_cast<std::string>(i*count);
+    unsigned int lines = 0;
+    bool found = false;
+    while(std::getline(file, line)) {
+      lines++;
+      found = found || line.find(expected) != std::string::npos;
+    }
+    BOOST_CHECK_EQUAL(lines, 1u);
+    BOOST_CHECK(found);
+    remove(path.c_str());
+  }
+}
+
+BOOST_AUTO_TEST_SUITE_END()